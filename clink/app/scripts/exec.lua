@@ -21,18 +21,6 @@ settings.add("exec.space_prefix", true, "Whitespace prefix matches files",
 [[If the line begins with whitespace then Clink bypasses executable
 matching and will do normal files matching instead.]])
 
---------------------------------------------------------------------------------
-local function get_environment_paths()
-    local paths = os.getenv("path"):explode(";")
-
-    -- Append slashes.
-    for i = 1, #paths, 1 do
-        paths[i] = paths[i].."\\"
-    end
-
-    return paths
-end
-
 --------------------------------------------------------------------------------
 local function exec_find_dirs(pattern, case_map)
     local ret = {}
@@ -82,7 +70,7 @@ function exec_generator:generate(line_state, match_builder)
     local match_dirs = settings.get("exec.dirs")
     local match_cwd = settings.get("exec.cwd")
 
-    local paths = nil
+    local match_path = false
     local text, expanded = rl.expandtilde(line_state:getword(1))
     local text_dir = (path.getdirectory(text) or ""):gsub("/", "\\")
     if #text_dir == 0 then
@@ -90,10 +78,8 @@ function exec_generator:generate(line_state, match_builder)
         local aliases = os.getaliases()
         match_builder:addmatches(aliases, "alias")
 
-        -- Add environment's PATH variable as paths to search.
-        if settings.get("exec.path") then
-            paths = get_environment_paths()
-        end
+        -- Add executables from the environment's PATH variable.
+        match_path = settings.get("exec.path")
     else
         -- 'text' is an absolute or relative path so override settings and
         -- match current directory and its directories too.
@@ -101,10 +87,6 @@ function exec_generator:generate(line_state, match_builder)
         match_cwd = true
     end
 
-    if not paths then
-        paths = {}
-    end
-
     local add_files = function(pattern, rooted)
         local any_added = false
         local root = nil
@@ -121,16 +103,19 @@ function exec_generator:generate(line_state, match_builder)
         return any_added
     end
 
-    -- Search 'paths' for files ending in 'suffices' and look for matches
+    -- Executables in PATH come from a cached index, which only enumerates a
+    -- directory again after it changes.
     local added = false
-    local suffices = (os.getenv("pathext") or ""):explode(";")
-    for _, suffix in ipairs(suffices) do
-        for _, dir in ipairs(paths) do
-            added = add_files(dir.."*"..suffix) or added
+    if match_path then
+        for _, f in ipairs(os.getexecutables()) do
+            added = match_builder:addmatch({ match = f.name, type = f.type }) or added
         end
+    end
 
-        -- Should we also consider the path referenced by 'text'?
-        if match_cwd then
+    -- Should we also consider the path referenced by 'text'?
+    if match_cwd then
+        local suffices = (os.getenv("pathext") or ""):explode(";")
+        for _, suffix in ipairs(suffices) do
             -- Pass true because these need to include the base path.
             added = add_files(text.."*"..suffix, true) or added
         end
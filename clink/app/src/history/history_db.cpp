@@ -10,14 +10,21 @@
 #include <core/os.h>
 #include <core/settings.h>
 #include <core/str.h>
+#include <core/str_hash.h>
 #include <core/str_tokeniser.h>
 #include <core/str_map.h>
 #include <core/path.h>
 #include <core/log.h>
 #include <assert.h>
 
+#include <memory>
 #include <new>
 #include <Windows.h>
+#include <process.h>
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#   include <emmintrin.h>
+#   define USE_SSE2_LINE_SCAN
+#endif
 extern "C" {
 #include <readline/history.h>
 }
@@ -69,6 +76,18 @@ static setting_enum g_expand_mode(
     "off,on,not_squoted,not_dquoted,not_quoted",
     4);
 
+static setting_enum g_history_format(
+    "history.format",
+    "Format of the master history file",
+    "The 'text' format stores one history line per line of text.  The 'log'\n"
+    "format is a binary log of records with timestamps, where deleting a line\n"
+    "appends a small tombstone record instead of modifying the file, and\n"
+    "compacting the history happens in the background and holds the exclusive\n"
+    "lock only briefly.  Changing this converts the master history file the next\n"
+    "time a Clink instance starts.",
+    "text,log",
+    0);
+
 static setting_bool g_sticky_search(
     "history.sticky_search",
     "Makes it easy to replay a series of commands",
@@ -170,6 +189,81 @@ void concurrency_tag::set(const char* tag)
 
 
 
+//------------------------------------------------------------------------------
+void bank_line_index::clear()
+{
+    m_ctag.clear();
+    m_indexed_size = 0;
+    m_offsets.clear();
+    m_hashes.clear();
+}
+
+//------------------------------------------------------------------------------
+bool bank_line_index::is_valid(const concurrency_tag& tag, unsigned int file_size) const
+{
+    // Compacting or clearing a bank can only be detected by a change in the
+    // concurrency tag or by the bank shrinking.
+    return (file_size >= m_indexed_size && strcmp(tag.get(), m_ctag.get()) == 0);
+}
+
+//------------------------------------------------------------------------------
+void bank_line_index::set_valid(const concurrency_tag& tag, unsigned int file_size)
+{
+    m_ctag.clear();
+    m_ctag.set(tag.get());
+    m_indexed_size = file_size;
+}
+
+//------------------------------------------------------------------------------
+void bank_line_index::insert(unsigned int hash, unsigned int offset)
+{
+    m_offsets.emplace(hash, offset);
+    m_hashes.insert_or_assign(offset, hash);
+}
+
+//------------------------------------------------------------------------------
+void bank_line_index::erase(unsigned int offset)
+{
+    auto const lookup = m_hashes.find(offset);
+    if (lookup == m_hashes.end())
+        return;
+
+    auto range = m_offsets.equal_range(lookup->second);
+    for (auto iter = range.first; iter != range.second; ++iter)
+        if (iter->second == offset)
+        {
+            m_offsets.erase(iter);
+            break;
+        }
+
+    m_hashes.erase(lookup);
+}
+
+
+
+//------------------------------------------------------------------------------
+void log_tombstones::clear()
+{
+    m_ctag.clear();
+    m_scanned_size = 0;
+    m_offsets.clear();
+}
+
+//------------------------------------------------------------------------------
+bool log_tombstones::is_valid(const concurrency_tag& tag, unsigned int file_size) const
+{
+    return (file_size >= m_scanned_size && strcmp(tag.get(), m_ctag.get()) == 0);
+}
+
+//------------------------------------------------------------------------------
+void log_tombstones::set_valid(const concurrency_tag& tag, unsigned int scanned_size)
+{
+    m_ctag.clear();
+    m_ctag.set(tag.get());
+    m_scanned_size = scanned_size;
+}
+
+
 //------------------------------------------------------------------------------
 class auto_free_str
 {
@@ -226,6 +320,81 @@ union line_id_impl
 
 
 
+//------------------------------------------------------------------------------
+// The 'log' history format is a binary log of records.  The file starts with
+// log_magic, followed by records.  Each record is a log_record header followed
+// by `length` bytes of payload:
+//
+//  - log_ctag          The concurrency tag; always the first record.
+//  - log_line          A history line (UTF8, not NUL terminated).
+//  - log_tombstone     Deletes the line record at the offset in the payload.
+//
+// As with the text format, a line id is the file offset of the line's record.
+// Records are never modified in place, so deleting a line is an append.
+static const char log_magic[] = "\x7f" "CLOG01\n";
+static const unsigned int log_magic_len = sizeof(log_magic) - 1;
+
+enum : unsigned char
+{
+    log_ctag        = 1,
+    log_line,
+    log_tombstone,
+};
+
+struct log_record
+{
+    unsigned int    length;         // Bytes of payload following the header.
+    unsigned char   type;
+    unsigned char   reserved[3];
+    long long       time;           // When the record was written.
+};
+static_assert(sizeof(log_record) == 16, "");
+
+//------------------------------------------------------------------------------
+static bool parse_log_record(const char* data, unsigned int available, log_record& record)
+{
+    if (available < sizeof(record))
+        return false;
+
+    memcpy(&record, data, sizeof(record));
+    return (available - sizeof(record) >= record.length);
+}
+
+//------------------------------------------------------------------------------
+static unsigned int get_tombstone_offset(const str_iter& payload)
+{
+    unsigned int offset = 0;
+    if (payload.length() >= sizeof(offset))
+        memcpy(&offset, payload.get_pointer(), sizeof(offset));
+    return offset;
+}
+
+//------------------------------------------------------------------------------
+static void append_log_record(std::vector<char>& out, unsigned char type, long long time, const void* payload, unsigned int length)
+{
+    log_record record = {};
+    record.length = length;
+    record.type = type;
+    record.time = time;
+
+    const char* header = reinterpret_cast<const char*>(&record);
+    const char* data = static_cast<const char*>(payload);
+    out.insert(out.end(), header, header + sizeof(record));
+    out.insert(out.end(), data, data + length);
+}
+
+//------------------------------------------------------------------------------
+static bool is_log_file(void* handle)
+{
+    char magic[log_magic_len];
+    DWORD read = 0;
+    SetFilePointer(handle, 0, nullptr, FILE_BEGIN);
+    ReadFile(handle, magic, sizeof(magic), &read, nullptr);
+    return (read == sizeof(magic) && memcmp(magic, log_magic, sizeof(magic)) == 0);
+}
+
+
+
 //------------------------------------------------------------------------------
 bank_handles::operator bool () const
 {
@@ -255,6 +424,7 @@ class bank_lock
 {
 public:
     explicit        operator bool () const;
+    bool            is_log() const { return m_log; }
 
 protected:
                     bank_lock() = default;
@@ -264,6 +434,7 @@ protected:
     bank_lock&      operator = (bank_lock&& other);
     void*           m_handle_lines = nullptr;       // From bank_master or bank_session.
     void*           m_handle_removals = nullptr;    // Always from bank_session, or nullptr.
+    bool            m_log = false;                  // Lines bank is in the 'log' format.
 };
 
 //------------------------------------------------------------------------------
@@ -285,6 +456,8 @@ bank_lock::bank_lock(const bank_handles& handles, bool exclusive)
     LockFileEx(m_handle_lines, flags, 0, ~0u, ~0u, &overlapped);
     if (m_handle_removals)
         LockFileEx(m_handle_removals, flags, 0, ~0u, ~0u, &overlapped);
+
+    m_log = is_log_file(m_handle_lines);
 }
 
 //------------------------------------------------------------------------------
@@ -310,6 +483,7 @@ bank_lock& bank_lock::operator = (bank_lock&& other)
 {
     m_handle_lines = other.m_handle_lines;
     m_handle_removals = other.m_handle_removals;
+    m_log = other.m_log;
     other.m_handle_lines = nullptr;
     other.m_handle_removals = nullptr;
     return *this;
@@ -330,46 +504,64 @@ class write_lock;
 class read_lock
     : public bank_lock
 {
+    friend class write_lock;
+
 public:
     class file_iter : public no_copy
     {
     public:
                             file_iter() = default;
-                            file_iter(const read_lock& lock, char* buffer, int buffer_size);
-                            file_iter(void* handle, char* buffer, int buffer_size);
+                            file_iter(const read_lock& lock, char* buffer, int buffer_size, bool map=false);
+                            file_iter(void* handle, char* buffer, int buffer_size, bool map=false);
         template <int S>    file_iter(const read_lock& lock, char (&buffer)[S]);
         template <int S>    file_iter(void* handle, char (&buffer)[S]);
+                            ~file_iter();
         unsigned int        next(unsigned int rollback=0);
         unsigned int        get_buffer_offset() const   { return m_buffer_offset; }
         char*               get_buffer() const          { return m_buffer; }
         unsigned int        get_buffer_size() const     { return m_buffer_size; }
         unsigned int        get_remaining() const       { return m_remaining; }
         void                set_file_offset(unsigned int offset);
+        unsigned int        get_file_size() const;
+        bool                is_mapped() const           { return !!m_view; }
+        bool                peek(unsigned int offset, char& c) const;
 
     private:
+        void                map_file();
         char*               m_buffer;
         void*               m_handle;
         unsigned int        m_buffer_size;
         unsigned int        m_buffer_offset;
         unsigned int        m_remaining;
+        void*               m_mapping = nullptr;
+        char*               m_view = nullptr;
+        unsigned int        m_view_size = 0;
     };
 
     class line_iter : public no_copy
     {
     public:
                             line_iter() = default;
-                            line_iter(const read_lock& lock, char* buffer, int buffer_size);
-                            line_iter(void* handle, char* buffer, int buffer_size);
+                            line_iter(const read_lock& lock, char* buffer, int buffer_size, bool map=false, const log_tombstones* tombstones=nullptr);
+                            line_iter(void* handle, char* buffer, int buffer_size, bool map=false, bool log=false, const log_tombstones* tombstones=nullptr);
         template <int S>    line_iter(const read_lock& lock, char (&buffer)[S]);
         template <int S>    line_iter(void* handle, char (&buffer)[S]);
                             ~line_iter() = default;
         line_id_impl        next(str_iter& out);
+        bool                next_record(unsigned int& offset, log_record& record, str_iter& payload);
         void                set_file_offset(unsigned int offset);
         unsigned int        get_deleted_count() const { return m_deleted; }
+        long long           get_record_time() const { return m_time; }
+        bool                is_mapped() const { return m_file_iter.is_mapped(); }
+        bool                is_log() const { return m_log; }
+        bool                is_removed(unsigned int offset) const;
 
     private:
         bool                provision();
         file_iter           m_file_iter;
+        const log_tombstones* m_tombstones = nullptr;
+        bool                m_log = false;
+        long long           m_time = 0;
         unsigned int        m_remaining = 0;
         unsigned int        m_deleted = 0;
         bool                m_first_line = true;
@@ -379,11 +571,13 @@ public:
 
     explicit                read_lock() = default;
     explicit                read_lock(const bank_handles& handles, bool exclusive=false);
-    line_id_impl            find(const char* line) const;
-    template <class T> void find(const char* line, T&& callback) const;
+    unsigned int            get_file_size() const;
+    line_id_impl            find(const char* line, const bank_line_index& index) const;
+    template <class T> void find(const char* line, const bank_line_index& index, T&& callback) const;
     void                    apply_removals(write_lock& lock) const;
 
 private:
+    bool                    is_line_at(unsigned int offset, const char* line, unsigned int len) const;
     template <typename T> static void for_each_removal(void* handle_removals, T&& callback);
 };
 
@@ -395,9 +589,12 @@ public:
                     write_lock() = default;
     explicit        write_lock(const bank_handles& handles);
     void            clear();
+    void            clear(bool log);
     void            add(const char* line);
+    void            add_ctag(const char* tag);
     void            remove(line_id_impl id);
     void            append(const read_lock& src);
+    void            append_records(const std::vector<char>& records);
 };
 
 
@@ -409,34 +606,83 @@ read_lock::read_lock(const bank_handles& handles, bool exclusive)
 }
 
 //------------------------------------------------------------------------------
-template <class T> void read_lock::find(const char* line, T&& callback) const
+unsigned int read_lock::get_file_size() const
 {
-    history_read_buffer buffer;
-    line_iter iter(*this, buffer.data(), buffer.size());
+    return GetFileSize(m_handle_lines, nullptr);
+}
 
-    line_id_impl id;
-    for (str_iter read; id = iter.next(read);)
+//------------------------------------------------------------------------------
+bool read_lock::is_line_at(unsigned int offset, const char* line, unsigned int len) const
+{
+    // In the log format the record header has the exact length.  In the text
+    // format, read one extra byte to make sure the line in the file isn't
+    // longer.
+    unsigned int needed = len + 1;
+    if (m_log)
     {
-        if (strncmp(line, read.get_pointer(), read.length()) != 0)
-            continue;
+        log_record record;
+        DWORD read = 0;
+        SetFilePointer(m_handle_lines, offset, nullptr, FILE_BEGIN);
+        ReadFile(m_handle_lines, &record, sizeof(record), &read, nullptr);
+        if (read != sizeof(record) || record.type != log_line || record.length != len)
+            return false;
 
-        if (line[read.length()] != '\0')
-            continue;
+        offset += sizeof(record);
+        needed = len;
+    }
+
+    char stack_buffer[256];
+    char* buffer = stack_buffer;
+    if (needed > sizeof(stack_buffer))
+        buffer = (char*)malloc(needed);
+
+    DWORD read = 0;
+    SetFilePointer(m_handle_lines, offset, nullptr, FILE_BEGIN);
+    ReadFile(m_handle_lines, buffer, needed, &read, nullptr);
+
+    bool match = (read >= len && memcmp(buffer, line, len) == 0);
+    if (match && !m_log)
+    {
+        // Lines marked as deleted start with '|'.
+        if (*buffer == '|')
+            match = false;
+        else if (read > len)
+            match = (buffer[len] == '\0' || buffer[len] == '\n' || buffer[len] == '\r');
+    }
+
+    if (buffer != stack_buffer)
+        free(buffer);
+    return match;
+}
 
-        unsigned int file_ptr = SetFilePointer(m_handle_lines, 0, nullptr, FILE_CURRENT);
-        bool more = callback(id);
-        SetFilePointer(m_handle_lines, file_ptr, nullptr, FILE_BEGIN);
+//------------------------------------------------------------------------------
+template <class T> void read_lock::find(const char* line, const bank_line_index& index, T&& callback) const
+{
+    // The index can hold stale entries for lines that other instances have
+    // since marked as deleted, so each candidate is verified against the file.
+    // Candidates are visited in file order, to match the order of lines.
+    std::vector<unsigned int> offsets;
+    index.for_each_candidate(str_hash(line), [&] (unsigned int offset) {
+        offsets.push_back(offset);
+    });
+    std::sort(offsets.begin(), offsets.end());
 
-        if (!more)
+    unsigned int len = unsigned(strlen(line));
+    for (unsigned int offset : offsets)
+    {
+        if (!is_line_at(offset, line, len))
+            continue;
+
+        if (!callback(line_id_impl(offset)))
             break;
     }
 }
 
 //------------------------------------------------------------------------------
-line_id_impl read_lock::find(const char* line) const
+line_id_impl read_lock::find(const char* line, const bank_line_index& index) const
 {
     line_id_impl id;
-    find(line, [&] (line_id_impl inner_id) {
+    find(line, index, [&] (line_id_impl inner_id) {
         id = inner_id;
         return false;
     });
@@ -493,26 +739,75 @@ template <int S> read_lock::file_iter::file_iter(void* handle, char (&buffer)[S]
 }
 
 //------------------------------------------------------------------------------
-read_lock::file_iter::file_iter(const read_lock& lock, char* buffer, int buffer_size)
-: m_handle(lock.m_handle_lines)
-, m_buffer(buffer)
-, m_buffer_size(buffer_size)
+read_lock::file_iter::file_iter(const read_lock& lock, char* buffer, int buffer_size, bool map)
+: file_iter(lock.m_handle_lines, buffer, buffer_size, map)
 {
-    set_file_offset(0);
 }
 
 //------------------------------------------------------------------------------
-read_lock::file_iter::file_iter(void* handle, char* buffer, int buffer_size)
+read_lock::file_iter::file_iter(void* handle, char* buffer, int buffer_size, bool map)
 : m_handle(handle)
 , m_buffer(buffer)
 , m_buffer_size(buffer_size)
 {
+    if (map)
+        map_file();
     set_file_offset(0);
 }
 
+//------------------------------------------------------------------------------
+read_lock::file_iter::~file_iter()
+{
+    if (m_view)
+        UnmapViewOfFile(m_view);
+    if (m_mapping)
+        CloseHandle(m_mapping);
+}
+
+//------------------------------------------------------------------------------
+void read_lock::file_iter::map_file()
+{
+    // Mapping the file lets the whole file be presented as a single buffer,
+    // so lines can be returned as pointers into the mapped view without any
+    // ReadFile calls or copying.  Mapping fails for empty files, in which case
+    // the caller's buffer is used as usual.
+    //
+    // NOTE:  The file can't be truncated while it's mapped, so the iterator
+    // must be destroyed before anything rewrites the file.
+    m_view_size = GetFileSize(m_handle, nullptr);
+    if (!m_view_size || m_view_size == INVALID_FILE_SIZE)
+        return;
+
+    m_mapping = CreateFileMapping(m_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!m_mapping)
+        return;
+
+    m_view = static_cast<char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, m_view_size));
+    if (!m_view)
+    {
+        LOG("unable to map history file; error %d", GetLastError());
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+    }
+}
+
 //------------------------------------------------------------------------------
 unsigned int read_lock::file_iter::next(unsigned int rollback)
 {
+    if (m_view)
+    {
+        // The whole remainder of the view is returned at once, so there's
+        // never anything more to read (and nothing to roll back).
+        if (!m_remaining)
+            return 0;
+
+        m_buffer = m_view + m_view_size - m_remaining;
+        m_buffer_offset = m_view_size - m_remaining;
+        m_buffer_size = m_remaining;
+        m_remaining = 0;
+        return m_buffer_size;
+    }
+
     if (!m_remaining)
         return (m_buffer[0] = '\0');
 
@@ -533,13 +828,39 @@ unsigned int read_lock::file_iter::next(unsigned int rollback)
     return m_buffer_size;
 }
 
+//------------------------------------------------------------------------------
+unsigned int read_lock::file_iter::get_file_size() const
+{
+    return m_view ? m_view_size : GetFileSize(m_handle, nullptr);
+}
+
+//------------------------------------------------------------------------------
+bool read_lock::file_iter::peek(unsigned int offset, char& c) const
+{
+    if (!m_view || offset >= m_view_size)
+        return false;
+
+    c = m_view[offset];
+    return true;
+}
+
 //------------------------------------------------------------------------------
 void read_lock::file_iter::set_file_offset(unsigned int offset)
 {
+    if (m_view)
+    {
+        offset = clamp(offset, (unsigned int)0, m_view_size);
+        m_remaining = m_view_size - offset;
+        m_buffer = m_view + offset;
+        m_buffer_offset = offset;
+        m_buffer_size = 0;
+        return;
+    }
+
     m_remaining = GetFileSize(m_handle, nullptr);
     offset = clamp(offset, (unsigned int)0, m_remaining);
     m_remaining -= offset;
-    m_buffer_offset = 0 - m_buffer_size;
+    m_buffer_offset = offset - m_buffer_size;
     SetFilePointer(m_handle, offset, nullptr, FILE_BEGIN);
     m_buffer[0] = '\0';
 }
@@ -559,8 +880,8 @@ template <int S> read_lock::line_iter::line_iter(void* handle, char (&buffer)[S]
 }
 
 //------------------------------------------------------------------------------
-read_lock::line_iter::line_iter(const read_lock& lock, char* buffer, int buffer_size)
-: m_file_iter(lock.m_handle_lines, buffer, buffer_size)
+read_lock::line_iter::line_iter(const read_lock& lock, char* buffer, int buffer_size, bool map, const log_tombstones* tombstones)
+: line_iter(lock.m_handle_lines, buffer, buffer_size, map, lock.is_log(), tombstones)
 {
     if (lock.m_handle_removals)
     {
@@ -572,9 +893,13 @@ read_lock::line_iter::line_iter(const read_lock& lock, char* buffer, int buffer_
 }
 
 //------------------------------------------------------------------------------
-read_lock::line_iter::line_iter(void* handle, char* buffer, int buffer_size)
-: m_file_iter(handle, buffer, buffer_size)
+read_lock::line_iter::line_iter(void* handle, char* buffer, int buffer_size, bool map, bool log, const log_tombstones* tombstones)
+: m_file_iter(handle, buffer, buffer_size, map)
+, m_tombstones(tombstones)
+, m_log(log)
 {
+    // In the log format, lines are only skipped as deleted if the caller
+    // supplies the bank's tombstones (see scan_tombstones()).
 }
 
 //------------------------------------------------------------------------------
@@ -589,9 +914,68 @@ inline bool is_line_breaker(unsigned char c)
     return c == 0x00 || c == 0x0a || c == 0x0d;
 }
 
+//------------------------------------------------------------------------------
+static const char* find_line_breaker(const char* start, const char* last)
+{
+#ifdef USE_SSE2_LINE_SCAN
+    // Test 16 bytes at a time; most history lines are longer than that, and
+    // a mapped history file is scanned in one pass.
+    const __m128i nul = _mm_setzero_si128();
+    const __m128i lf = _mm_set1_epi8(0x0a);
+    const __m128i cr = _mm_set1_epi8(0x0d);
+    while (last - start >= 16)
+    {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(start));
+        __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(chunk, nul),
+                                    _mm_or_si128(_mm_cmpeq_epi8(chunk, lf),
+                                                 _mm_cmpeq_epi8(chunk, cr)));
+        if (unsigned int mask = _mm_movemask_epi8(hits))
+        {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            return start + index;
+#else
+            return start + __builtin_ctz(mask);
+#endif
+        }
+        start += 16;
+    }
+#endif
+
+    for (; start != last; ++start)
+        if (is_line_breaker(*start))
+            break;
+    return start;
+}
+
 //------------------------------------------------------------------------------
 line_id_impl read_lock::line_iter::next(str_iter& out)
 {
+    if (m_log)
+    {
+        unsigned int offset;
+        log_record record;
+        str_iter payload;
+        while (next_record(offset, record, payload))
+        {
+            if (record.type != log_line)
+                continue;
+
+            if (is_removed(offset))
+            {
+                ++m_deleted;
+                continue;
+            }
+
+            m_time = record.time;
+            new (&out) str_iter(payload.get_pointer(), payload.length());
+            return line_id_impl(offset);
+        }
+
+        return line_id_impl();
+    }
+
     while (m_remaining || provision())
     {
         const char* last = m_file_iter.get_buffer() + m_file_iter.get_buffer_size();
@@ -620,13 +1004,9 @@ line_id_impl read_lock::line_iter::next(str_iter& out)
                 break;
             }
 
-        const char* end = start;
-        for (; end != last; ++end)
-            if (is_line_breaker(*end))
-            {
-                m_eating_ctag = false;
-                break;
-            }
+        const char* end = find_line_breaker(start, last);
+        if (end != last)
+            m_eating_ctag = false;
 
         if (end == last && start != m_file_iter.get_buffer())
         {
@@ -660,10 +1040,74 @@ line_id_impl read_lock::line_iter::next(str_iter& out)
     return line_id_impl();
 }
 
+//------------------------------------------------------------------------------
+bool read_lock::line_iter::next_record(unsigned int& offset, log_record& record, str_iter& payload)
+{
+    assert(m_log);
+
+    while (m_remaining || provision())
+    {
+        const char* last = m_file_iter.get_buffer() + m_file_iter.get_buffer_size();
+        const char* start = last - m_remaining;
+        offset = m_file_iter.get_buffer_offset() + unsigned(start - m_file_iter.get_buffer());
+
+        // Skip the file signature.
+        if (offset < log_magic_len)
+        {
+            m_remaining -= min<unsigned>(m_remaining, log_magic_len - offset);
+            continue;
+        }
+
+        if (!parse_log_record(start, m_remaining, record))
+        {
+            // Roll the partial record into the next read.
+            bool have_header = (m_remaining >= sizeof(record));
+            unsigned int partial = m_remaining;
+            if (provision() && m_remaining > partial)
+                continue;
+
+            // A record too large for the buffer is skipped.  A partial record
+            // at the end of the file ends the iteration.
+            unsigned int next_offset = offset + sizeof(record) + record.length;
+            if (have_header && next_offset > offset && next_offset <= m_file_iter.get_file_size())
+            {
+                LOG("skipped history record at offset %u; too long (%u bytes)", offset, record.length);
+                set_file_offset(next_offset);
+                continue;
+            }
+
+            m_remaining = 0;
+            return false;
+        }
+
+        new (&payload) str_iter(start + sizeof(record), int(record.length));
+        m_remaining -= sizeof(record) + record.length;
+        return true;
+    }
+
+    return false;
+}
+
+//------------------------------------------------------------------------------
+bool read_lock::line_iter::is_removed(unsigned int offset) const
+{
+    if (m_removals.find(offset) != m_removals.end())
+        return true;
+    if (m_tombstones && m_tombstones->contains(offset))
+        return true;
+
+    // In the text format, lines are marked as deleted in place.  This can only
+    // be tested cheaply when the file is mapped; callers fall back to reading
+    // the lines otherwise.
+    char c;
+    return !m_log && m_file_iter.peek(offset, c) && c == '|';
+}
+
 //------------------------------------------------------------------------------
 void read_lock::line_iter::set_file_offset(unsigned int offset)
 {
     m_file_iter.set_file_offset(offset);
+    m_remaining = 0;
     m_eating_ctag = false;
 }
 
@@ -677,6 +1121,12 @@ write_lock::write_lock(const bank_handles& handles)
 
 //------------------------------------------------------------------------------
 void write_lock::clear()
+{
+    clear(m_log);
+}
+
+//------------------------------------------------------------------------------
+void write_lock::clear(bool log)
 {
     SetFilePointer(m_handle_lines, 0, nullptr, FILE_BEGIN);
     SetEndOfFile(m_handle_lines);
@@ -685,17 +1135,57 @@ void write_lock::clear()
         SetFilePointer(m_handle_removals, 0, nullptr, FILE_BEGIN);
         SetEndOfFile(m_handle_removals);
     }
+
+    m_log = log;
+    if (m_log)
+    {
+        DWORD written;
+        WriteFile(m_handle_lines, log_magic, log_magic_len, &written, nullptr);
+    }
 }
 
 //------------------------------------------------------------------------------
 void write_lock::add(const char* line)
 {
+    if (m_log)
+    {
+        std::vector<char> record;
+        append_log_record(record, log_line, time(nullptr), line, unsigned(strlen(line)));
+        append_records(record);
+        return;
+    }
+
     DWORD written;
     SetFilePointer(m_handle_lines, 0, nullptr, FILE_END);
     WriteFile(m_handle_lines, line, int(strlen(line)), &written, nullptr);
     WriteFile(m_handle_lines, "\n", 1, &written, nullptr);
 }
 
+//------------------------------------------------------------------------------
+void write_lock::add_ctag(const char* tag)
+{
+    if (m_log)
+    {
+        std::vector<char> record;
+        append_log_record(record, log_ctag, time(nullptr), tag, unsigned(strlen(tag)));
+        append_records(record);
+        return;
+    }
+
+    add(tag);
+}
+
+//------------------------------------------------------------------------------
+void write_lock::append_records(const std::vector<char>& records)
+{
+    if (records.empty())
+        return;
+
+    DWORD written;
+    SetFilePointer(m_handle_lines, 0, nullptr, FILE_END);
+    WriteFile(m_handle_lines, records.data(), DWORD(records.size()), &written, nullptr);
+}
+
 //------------------------------------------------------------------------------
 void write_lock::remove(line_id_impl id)
 {
@@ -708,6 +1198,13 @@ void write_lock::remove(line_id_impl id)
         SetFilePointer(m_handle_removals, 0, nullptr, FILE_END);
         WriteFile(m_handle_removals, s.c_str(), s.length(), &written, nullptr);
     }
+    else if (m_log)
+    {
+        unsigned int offset = id.offset;
+        std::vector<char> record;
+        append_log_record(record, log_tombstone, time(nullptr), &offset, sizeof(offset));
+        append_records(record);
+    }
     else
     {
         DWORD written;
@@ -719,6 +1216,24 @@ void write_lock::remove(line_id_impl id)
 //------------------------------------------------------------------------------
 void write_lock::append(const read_lock& src)
 {
+    if (m_log)
+    {
+        // Session banks always use the text format, so their lines are copied
+        // as records.  Removals are applied separately by apply_removals().
+        std::vector<char> records;
+        long long now = time(nullptr);
+
+        history_read_buffer buffer;
+        read_lock::line_iter src_iter(src.m_handle_lines, buffer.data(), buffer.size(), true/*map*/);
+
+        str_iter line;
+        while (src_iter.next(line))
+            append_log_record(records, log_line, now, line.get_pointer(), line.length());
+
+        append_records(records);
+        return;
+    }
+
     DWORD written;
 
     SetFilePointer(m_handle_lines, 0, nullptr, FILE_END);
@@ -731,6 +1246,35 @@ void write_lock::append(const read_lock& src)
 
 
 
+//------------------------------------------------------------------------------
+static void scan_tombstones(const read_lock& lock, const concurrency_tag& tag, log_tombstones& tombstones)
+{
+    // Collect tombstones appended since the last scan.  This only needs to
+    // visit record headers.  A torn record at the end of the bank isn't
+    // counted as scanned, so it's scanned again once it's complete.
+    unsigned int scanned_size = tombstones.get_scanned_size();
+    if (lock.get_file_size() > scanned_size)
+    {
+        history_read_buffer buffer;
+        read_lock::line_iter iter(lock, buffer.data(), buffer.size(), true/*map*/);
+
+        unsigned int offset;
+        log_record record;
+        str_iter payload;
+        iter.set_file_offset(scanned_size);
+        while (iter.next_record(offset, record, payload))
+        {
+            if (record.type == log_tombstone)
+                tombstones.insert(get_tombstone_offset(payload));
+            scanned_size = offset + sizeof(record) + record.length;
+        }
+    }
+
+    tombstones.set_valid(tag, scanned_size);
+}
+
+
+
 //------------------------------------------------------------------------------
 class read_line_iter
 {
@@ -768,7 +1312,8 @@ bool read_line_iter::next_bank()
             m_lock.~read_lock();
             m_line_iter.~line_iter();
             new (&m_lock) read_lock(handles);
-            new (&m_line_iter) read_lock::line_iter(m_lock, buffer, m_buffer_size);
+            const log_tombstones* tombstones = m_db.update_tombstones(m_lock);
+            new (&m_line_iter) read_lock::line_iter(m_lock, buffer, m_buffer_size, true/*map*/, tombstones);
             return true;
         }
     }
@@ -825,9 +1370,38 @@ unsigned int history_db::iter::get_bank() const
 
 
 
+//------------------------------------------------------------------------------
+static bool extract_log_ctag(const read_lock& lock, concurrency_tag& tag)
+{
+    char buffer[log_magic_len + sizeof(log_record) + max_ctag_size];
+    read_lock::file_iter iter(lock, buffer);
+
+    log_record record;
+    const char* data = buffer + log_magic_len;
+    int bytes_read = iter.next();
+    if (bytes_read <= int(log_magic_len) ||
+        !parse_log_record(data, bytes_read - log_magic_len, record) ||
+        record.type != log_ctag ||
+        record.length >= max_ctag_size)
+    {
+        LOG("first record not a ctag");
+        return false;
+    }
+
+    char ctag[max_ctag_size];
+    memcpy(ctag, data + sizeof(record), record.length);
+    ctag[record.length] = '\0';
+
+    tag.set(ctag);
+    return true;
+}
+
 //------------------------------------------------------------------------------
 static bool extract_ctag(const read_lock& lock, concurrency_tag& tag)
 {
+    if (lock.is_log())
+        return extract_log_ctag(lock, tag);
+
     char buffer[max_ctag_size];
     read_lock::file_iter iter(lock, buffer);
 
@@ -861,7 +1435,7 @@ static bool extract_ctag(const read_lock& lock, concurrency_tag& tag)
 }
 
 //------------------------------------------------------------------------------
-static void rewrite_master_bank(write_lock& lock, size_t* _kept=nullptr, size_t* _deleted=nullptr, bool uniq=false, size_t* _dups=nullptr)
+static void rewrite_master_bank(write_lock& lock, bool log, size_t* _kept=nullptr, size_t* _deleted=nullptr, bool uniq=false, size_t* _dups=nullptr)
 {
     history_read_buffer buffer;
     str_map_case<size_t>::type seen;
@@ -869,45 +1443,225 @@ static void rewrite_master_bank(write_lock& lock, size_t* _kept=nullptr, size_t*
     if (_dups)
         *_dups = 0;
 
-    // Read lines to keep into vector.
-    str_iter out;
-    read_lock::line_iter iter(lock, buffer.data(), buffer.size());
+    // Read lines to keep into vector.  The iterator is scoped so the mapped
+    // view is released before the bank is rewritten.
     std::vector<auto_free_str> lines_to_keep;
-    while (iter.next(out))
+    std::vector<long long> times;
     {
-        auto_free_str line(out.get_pointer(), out.length());
-        if (uniq)
+        // Rewriting reads the whole bank anyway, so the tombstones are
+        // collected here rather than using history_db's set.
+        log_tombstones tombstones;
+        if (lock.is_log())
         {
-            auto const lookup = seen.find(line.get());
-            if (lookup != seen.end())
+            concurrency_tag tag;
+            extract_ctag(lock, tag);
+            scan_tombstones(lock, tag, tombstones);
+        }
+
+        str_iter out;
+        long long now = time(nullptr);
+        read_lock::line_iter iter(lock, buffer.data(), buffer.size(), true/*map*/, &tombstones);
+        while (iter.next(out))
+        {
+            // Lines from the text format have no timestamp.
+            times.push_back(lock.is_log() ? iter.get_record_time() : now);
+
+            auto_free_str line(out.get_pointer(), out.length());
+            if (uniq)
             {
-                // Reuse the old entry so the map stays valid.
-                line = std::move(lines_to_keep[lookup->second]);
-                if (_dups)
-                    ++(*_dups);
+                auto const lookup = seen.find(line.get());
+                if (lookup != seen.end())
+                {
+                    // Reuse the old entry so the map stays valid.
+                    line = std::move(lines_to_keep[lookup->second]);
+                    if (_dups)
+                        ++(*_dups);
+                }
+                seen.insert_or_assign(line.get(), lines_to_keep.size());
             }
-            seen.insert_or_assign(line.get(), lines_to_keep.size());
+            lines_to_keep.emplace_back(std::move(line));
         }
-        lines_to_keep.emplace_back(std::move(line));
+
+        if (_deleted)
+            *_deleted = iter.get_deleted_count();
     }
 
     if (_kept)
         *_kept = lines_to_keep.size();
-    if (_deleted)
-        *_deleted = iter.get_deleted_count();
 
     // Clear and write new tag.
     concurrency_tag tag;
     tag.generate_new_tag();
-    lock.clear();
-    lock.add(tag.get());
+    lock.clear(log);
+    lock.add_ctag(tag.get());
 
     // Write lines from vector.
-    for (auto const& line : lines_to_keep)
+    if (log)
+    {
+        std::vector<char> records;
+        for (size_t i = 0; i < lines_to_keep.size(); ++i)
+        {
+            const char* line = lines_to_keep[i].get();
+            if (line)
+                append_log_record(records, log_line, times[i], line, unsigned(strlen(line)));
+        }
+        lock.append_records(records);
+    }
+    else
+    {
+        for (auto const& line : lines_to_keep)
+        {
+            if (line.get())
+                lock.add(line.get());
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+struct log_line_copy
+{
+                        log_line_copy(unsigned int offset, long long time, const char* text, int len)
+                        : offset(offset), time(time), text(text, len) {}
+    unsigned int        offset;
+    long long           time;
+    auto_free_str       text;
+    bool                keep = true;
+};
+
+//------------------------------------------------------------------------------
+static bool compact_log_bank(const bank_handles& handles, bool uniq, size_t& kept, size_t& deleted, size_t& dups)
+{
+    // Compacting the log format avoids holding the exclusive lock while reading
+    // and deduplicating lines.  First the active lines are copied under a
+    // shared lock.  Then duplicates are found without holding any lock.
+    // Finally the exclusive lock is taken just long enough to fold in records
+    // appended in the meantime and write the new log in a single write.
+    //
+    // Returns false if the bank isn't in the log format.
+
+    kept = deleted = dups = 0;
+
+    concurrency_tag snapshot_tag;
+    unsigned int snapshot_size = 0;
+    log_tombstones tombstones;
+    std::vector<log_line_copy> lines;
+    {
+        read_lock lock(handles);
+        if (!lock || !lock.is_log())
+            return false;
+        if (!extract_ctag(lock, snapshot_tag))
+            return false;
+
+        scan_tombstones(lock, snapshot_tag, tombstones);
+
+        history_read_buffer buffer;
+        read_lock::line_iter iter(lock, buffer.data(), buffer.size(), true/*map*/, &tombstones);
+
+        str_iter out;
+        while (line_id_impl id = iter.next(out))
+            lines.emplace_back(unsigned(id.offset), iter.get_record_time(), out.get_pointer(), out.length());
+
+        deleted = iter.get_deleted_count();
+        snapshot_size = tombstones.get_scanned_size();
+    }
+
+    if (uniq)
+    {
+        // Keep only the most recent of each line.
+        str_map_case<size_t>::type seen;
+        for (size_t i = 0; i < lines.size(); ++i)
+        {
+            auto const lookup = seen.find(lines[i].text.get());
+            if (lookup != seen.end())
+            {
+                lines[lookup->second].keep = false;
+                ++dups;
+            }
+            seen.insert_or_assign(lines[i].text.get(), i);
+        }
+    }
+
+    write_lock lock(handles);
+    concurrency_tag tag;
+    if (!lock || !lock.is_log() || !extract_ctag(lock, tag) ||
+        strcmp(tag.get(), snapshot_tag.get()) != 0 ||
+        lock.get_file_size() < snapshot_size)
+    {
+        LOG("history was compacted by another instance; skipped compacting");
+        kept = lines.size();
+        deleted = dups = 0;
+        return true;
+    }
+
+    // Fold in records appended since the snapshot.  The iterator is scoped so
+    // the mapped view is released before the bank is rewritten.
+    {
+        // Tombstones for lines in the snapshot.  Lines in the snapshot weren't
+        // tombstoned when it was taken, so any that are now were deleted since.
+        scan_tombstones(lock, tag, tombstones);
+        for (auto& line : lines)
+        {
+            if (tombstones.contains(line.offset))
+            {
+                line.keep = false;
+                ++deleted;
+            }
+        }
+
+        history_read_buffer buffer;
+        read_lock::line_iter iter(lock, buffer.data(), buffer.size(), true/*map*/, &tombstones);
+
+        // Lines added since the snapshot (tombstoned ones are skipped).
+        str_iter out;
+        iter.set_file_offset(snapshot_size);
+        while (line_id_impl id = iter.next(out))
+            lines.emplace_back(unsigned(id.offset), iter.get_record_time(), out.get_pointer(), out.length());
+        deleted += iter.get_deleted_count();
+    }
+
+    std::vector<char> records;
+    for (auto const& line : lines)
+    {
+        if (!line.keep)
+            continue;
+
+        const char* text = line.text.get();
+        append_log_record(records, log_line, line.time, text, unsigned(strlen(text)));
+        ++kept;
+    }
+
+    concurrency_tag new_tag;
+    new_tag.generate_new_tag();
+    lock.clear(true/*log*/);
+    lock.add_ctag(new_tag.get());
+    lock.append_records(records);
+    return true;
+}
+
+//------------------------------------------------------------------------------
+struct compact_thread_args
+{
+    str<280>            path;
+    bool                uniq;
+};
+
+//------------------------------------------------------------------------------
+static unsigned __stdcall compact_threadproc(void* arg)
+{
+    // The thread opens its own handle to the bank, so compacting here is the
+    // same as another instance compacting:  the history_db sees the new
+    // concurrency tag the next time it syncs, and reloads.
+    std::unique_ptr<compact_thread_args> args(static_cast<compact_thread_args*>(arg));
+
+    bank_handles handles;
+    handles.m_handle_lines = open_file(args->path.c_str(), true/*if_exists*/);
+    if (handles)
     {
-        if (line.get())
-            lock.add(line.get());
+        size_t kept, deleted, dups;
+        compact_log_bank(handles, args->uniq, kept, deleted, dups);
     }
+    handles.close();
+    return 0;
 }
 
 //------------------------------------------------------------------------------
@@ -1003,6 +1757,8 @@ history_db::history_db(bool use_master_bank)
 //------------------------------------------------------------------------------
 history_db::~history_db()
 {
+    wait_for_compact();
+
     // Close alive handle
     CloseHandle(m_alive_file);
 
@@ -1117,7 +1873,26 @@ void history_db::initialise()
             write_lock lock(get_bank(bank_master));
             if (!extract_ctag(lock, m_master_ctag))
             {
-                rewrite_master_bank(lock);
+                rewrite_master_bank(lock, lock.is_log());
+                extract_ctag(lock, m_master_ctag);
+            }
+        }
+
+        // Convert the master bank if the history.format setting has changed.
+        bool log = (g_history_format.get() == 1);
+        bool convert;
+        {
+            read_lock lock(get_bank(bank_master));
+            convert = (lock && lock.is_log() != log);
+        }
+        if (convert)
+        {
+            write_lock lock(get_bank(bank_master));
+            if (lock.is_log() != log)
+            {
+                DIAG("... convert master file to %s format\n", log ? "log" : "text");
+                rewrite_master_bank(lock, log);
+                m_master_ctag.clear();
                 extract_ctag(lock, m_master_ctag);
             }
         }
@@ -1200,6 +1975,27 @@ template <typename T> void history_db::for_each_bank(T&& callback) const
     }
 }
 
+//------------------------------------------------------------------------------
+static const char* terminate_line(const read_lock::line_iter& iter, const str_iter& out, history_read_buffer& buffer, str_moveable& mapped_line)
+{
+    // Subtract 1 from the size to accommodate the forced NUL termination
+    // prior to calling add_history.  When the bank is mapped the lines
+    // point into the read-only view and are NUL terminated in a copy.  In
+    // the log format the byte after a line is the next record's header, so
+    // those lines are also copied.
+    const char* line = out.get_pointer();
+    if (iter.is_mapped() || iter.is_log())
+    {
+        mapped_line.clear();
+        mapped_line.concat(line, out.length());
+        return mapped_line.c_str();
+    }
+
+    int buffer_offset = int(line - buffer.data());
+    buffer.data()[buffer_offset + out.length()] = '\0';
+    return line;
+}
+
 //------------------------------------------------------------------------------
 void history_db::load_internal()
 {
@@ -1207,8 +2003,11 @@ void history_db::load_internal()
     m_index_map.clear();
     m_master_len = 0;
     m_master_deleted_count = 0;
+    memset(m_bank_sizes, 0, sizeof(m_bank_sizes));
+    m_loaded = false;
 
     history_read_buffer buffer;
+    str_moveable mapped_line;
 
     DIAG("... loading history\n");
 
@@ -1223,19 +2022,20 @@ void history_db::load_internal()
             extract_ctag(lock, m_master_ctag);
         }
 
-        // Subtract 1 from the size to accommodate the forced NUL termination
-        // prior to calling add_history.
-        read_lock::line_iter iter(lock, buffer.data(), buffer.size() - 1);
+        bank_line_index& index = m_bank_indices[bank_index];
+        index.clear();
+
+        const log_tombstones* tombstones = update_tombstones(lock);
+        read_lock::line_iter iter(lock, buffer.data(), buffer.size() - 1, true/*map*/, tombstones);
 
         str_iter out;
         line_id_impl id;
         unsigned int num_lines = 0;
         while (id = iter.next(out))
         {
-            const char* line = out.get_pointer();
-            int buffer_offset = int(line - buffer.data());
-            buffer.data()[buffer_offset + out.length()] = '\0';
+            const char* line = terminate_line(iter, out, buffer, mapped_line);
             add_history(line);
+            index.insert(str_hash(line, out.length()), id.offset);
 
             num_lines++;
 
@@ -1251,25 +2051,164 @@ void history_db::load_internal()
         if (bank_index == bank_master)
             m_master_deleted_count = iter.get_deleted_count();
 
+        concurrency_tag empty_tag;
+        m_bank_sizes[bank_index] = lock.get_file_size();
+        index.set_valid((bank_index == bank_master) ? m_master_ctag : empty_tag, m_bank_sizes[bank_index]);
+
         DIAG(":  lines active %u / deleted %u\n", num_lines, iter.get_deleted_count());
 
         return true;
     });
 
+    m_loaded = true;
+
+    DIAG("... total lines active %zu\n", m_index_map.size());
+}
+
+//------------------------------------------------------------------------------
+bool history_db::sync_internal()
+{
+    // Other instances only ever append to the banks, except when compacting,
+    // which changes the master bank's concurrency tag.  So unless the tag has
+    // changed, only the lines appended since the last load and any lines
+    // deleted since then need to be applied to Readline's history.
+    //
+    // Readline's history must still mirror the index map; if lines were added
+    // or removed behind history_db's back then only a reload can resync them.
+    if (!m_loaded || size_t(history_length) != m_index_map.size())
+        return false;
+
+    history_read_buffer buffer;
+    str_moveable mapped_line;
+    bool synced = true;
+
+    DIAG("... syncing history\n");
+
+    const history_db& const_this = *this;
+    const_this.for_each_bank([&] (unsigned int bank_index, const read_lock& lock)
+    {
+        DIAG("... ... %s bank", bank_index == bank_master ? "master" : "session");
+
+        unsigned int file_size = lock.get_file_size();
+        if (file_size < m_bank_sizes[bank_index])
+        {
+            DIAG(":  truncated\n");
+            return (synced = false);
+        }
+
+        if (bank_index == bank_master)
+        {
+            concurrency_tag tag;
+            extract_ctag(lock, tag);
+            if (strcmp(tag.get(), m_master_ctag.get()) != 0)
+            {
+                DIAG(":  ctag changed\n");
+                return (synced = false);
+            }
+        }
+
+        const log_tombstones* tombstones = update_tombstones(lock);
+        read_lock::line_iter iter(lock, buffer.data(), buffer.size() - 1, true/*map*/, tombstones);
+
+        // Drop lines deleted since the last sync.  In the text format that
+        // needs the mapped view to test each line in place.
+        size_t first = (bank_index == bank_master) ? 0 : m_master_len;
+        size_t last = (bank_index == bank_master) ? m_master_len : m_index_map.size();
+        if (first < last && !lock.is_log() && !iter.is_mapped())
+        {
+            DIAG(":  not mapped\n");
+            return (synced = false);
+        }
+
+        unsigned int num_removed = 0;
+        for (size_t i = last; i-- > first;)
+        {
+            line_id_impl id;
+            id.outer = m_index_map[i];
+            if (!iter.is_removed(id.offset))
+                continue;
+
+            free_history_entry(remove_history(int(i)));
+            m_index_map.erase(m_index_map.begin() + i);
+            num_removed++;
+        }
+
+        if (bank_index == bank_master)
+        {
+            m_master_len -= num_removed;
+            m_master_deleted_count += num_removed;
+        }
+
+        // Append lines added since the last sync.  Master lines precede the
+        // session lines, so the session lines are detached while inserting
+        // new master lines.
+        std::vector<line_id> session_ids;
+        HIST_ENTRY** detached = nullptr;
+
+        str_iter out;
+        line_id_impl id;
+        unsigned int num_lines = 0;
+        iter.set_file_offset(m_bank_sizes[bank_index]);
+        while (id = iter.next(out))
+        {
+            if (!detached && bank_index == bank_master && m_master_len < m_index_map.size())
+            {
+                detached = remove_history_range(int(m_master_len), history_length - 1);
+                session_ids.assign(m_index_map.begin() + m_master_len, m_index_map.end());
+                m_index_map.resize(m_master_len);
+            }
+
+            add_history(terminate_line(iter, out, buffer, mapped_line));
+
+            num_lines++;
+
+            id.bank_index = bank_index;
+            m_index_map.push_back(id.outer);
+            if (bank_index == bank_master)
+                m_master_len = m_index_map.size();
+        }
+
+        if (detached)
+        {
+            for (HIST_ENTRY** entry = detached; *entry; ++entry)
+            {
+                add_history((*entry)->line);
+                free_history_entry(*entry);
+            }
+            free(detached);
+            m_index_map.insert(m_index_map.end(), session_ids.begin(), session_ids.end());
+        }
+
+        if (bank_index == bank_master)
+            m_master_deleted_count += iter.get_deleted_count();
+
+        m_bank_sizes[bank_index] = file_size;
+
+        DIAG(":  lines added %u / removed %u\n", num_lines, num_removed);
+
+        return true;
+    });
+
+    if (!synced)
+        return false;
+
     DIAG("... total lines active %zu\n", m_index_map.size());
+    return true;
 }
 
 //------------------------------------------------------------------------------
 void history_db::load_rl_history(bool can_clean)
 {
-    load_internal();
+    if (!sync_internal())
+        load_internal();
 
     // The `clink history` command needs to be able to avoid cleaning the master
     // history file.
     if (can_clean && m_use_master_bank)
     {
         compact();
-        load_internal();
+        if (!sync_internal())
+            load_internal();
     }
 }
 
@@ -1278,6 +2217,8 @@ void history_db::clear()
 {
     DIAG("... clearing history\n");
 
+    wait_for_compact();
+
     for_each_bank([&] (unsigned int bank_index, write_lock& lock)
     {
         DIAG("... ... %s bank\n", bank_index == bank_master ? "master" : "session");
@@ -1287,14 +2228,19 @@ void history_db::clear()
         {
             m_master_ctag.clear();
             m_master_ctag.generate_new_tag();
-            lock.add(m_master_ctag.get());
+            lock.add_ctag(m_master_ctag.get());
         }
         return true;
     });
 
+    for (auto& index : m_bank_indices)
+        index.clear();
+    m_master_tombstones.clear();
+
     m_index_map.clear();
     m_master_len = 0;
     m_master_deleted_count = 0;
+    m_loaded = false;
 }
 
 //------------------------------------------------------------------------------
@@ -1318,6 +2264,10 @@ void history_db::compact(bool force, bool uniq)
         // deleted; compacting is a separate operation.
         if (m_master_len > limit)
         {
+            // Keep Readline's history in step, so the next load can sync
+            // instead of reloading.
+            bool rl_in_sync = (size_t(history_length) == m_index_map.size());
+
             unsigned int removed = 0;
             while (m_master_len > limit)
             {
@@ -1335,6 +2285,8 @@ void history_db::compact(bool force, bool uniq)
                     DIAG("... ... failed to remove line at offset %u\n", id.offset);
                     break;
                 }
+                if (rl_in_sync)
+                    free_history_entry(remove_history(0));
                 removed++;
             }
             LOG("History:  removed %u", removed);
@@ -1347,11 +2299,36 @@ void history_db::compact(bool force, bool uniq)
     size_t threshold = (limit ? max(limit, m_min_compact_threshold) : 2500);
     if (force || m_master_deleted_count > threshold)
     {
+        // Compacting the log format doesn't need to hold the exclusive lock
+        // while reading, so unless compacting was explicitly requested it runs
+        // on a thread, to keep it out of loading history at startup.
+        if (!force)
+        {
+            bool log;
+            {
+                read_lock lock(get_bank(bank_master));
+                log = (lock && lock.is_log());
+            }
+            if (log)
+            {
+                DIAG("... compact:  rewrite master bank in the background\n");
+                start_compact_thread(uniq);
+                return;
+            }
+        }
+
         DIAG("... compact:  rewrite master bank\n");
 
+        wait_for_compact();
+
         size_t kept, deleted, dups;
-        write_lock lock(get_bank(bank_master));
-        rewrite_master_bank(lock, &kept, &deleted, uniq, &dups);
+        if (!compact_log_bank(get_bank(bank_master), uniq, kept, deleted, dups))
+        {
+            write_lock lock(get_bank(bank_master));
+            rewrite_master_bank(lock, lock.is_log(), &kept, &deleted, uniq, &dups);
+        }
+        m_bank_indices[bank_master].clear();
+        m_master_tombstones.clear();
         if (uniq)
         {
             LOG("Compacted history:  %zu active, %zu deleted, %zu duplicates removed", kept, deleted, dups);
@@ -1369,6 +2346,45 @@ void history_db::compact(bool force, bool uniq)
     }
 }
 
+//------------------------------------------------------------------------------
+void history_db::start_compact_thread(bool uniq)
+{
+    if (m_compact_thread)
+    {
+        if (WaitForSingleObject(m_compact_thread, 0) != WAIT_OBJECT_0)
+        {
+            DIAG("... ... already compacting\n");
+            return;
+        }
+        wait_for_compact();
+    }
+
+    compact_thread_args* args = new compact_thread_args;
+    args->path = m_bank_filenames[bank_master].c_str();
+    args->uniq = uniq;
+
+    m_compact_thread = reinterpret_cast<void*>(_beginthreadex(nullptr, 0, &compact_threadproc, args, 0, nullptr));
+    if (!m_compact_thread)
+    {
+        delete args;
+        LOG("History:  failed to start compacting");
+        return;
+    }
+
+    LOG("History:  compacting in the background");
+}
+
+//------------------------------------------------------------------------------
+void history_db::wait_for_compact()
+{
+    if (!m_compact_thread)
+        return;
+
+    WaitForSingleObject(m_compact_thread, INFINITE);
+    CloseHandle(m_compact_thread);
+    m_compact_thread = nullptr;
+}
+
 //------------------------------------------------------------------------------
 bool history_db::add(const char* line)
 {
@@ -1404,12 +2420,16 @@ bool history_db::add(const char* line)
 int history_db::remove(const char* line)
 {
     int count = 0;
-    for_each_bank([line, &count] (unsigned int index, write_lock& lock)
+    for_each_bank([this, line, &count] (unsigned int index, write_lock& lock)
     {
-        lock.find(line, [&] (line_id_impl id) {
+        update_index(index, lock);
+
+        bank_line_index& bank_index = m_bank_indices[index];
+        lock.find(line, bank_index, [&] (line_id_impl id) {
             // The line id was retrieved inside this lock scope, so it's still
             // valid; no need to guard the ctag.
             lock.remove(id);
+            bank_index.erase(id.offset);
             count++;
             return true;
         });
@@ -1455,6 +2475,7 @@ bool history_db::remove_internal(line_id id, bool guard_ctag)
     }
 
     lock.remove(id_impl);
+    m_bank_indices[id_impl.bank_index].erase(id_impl.offset);
 
     if (id_impl.bank_index == bank_master)
     {
@@ -1518,9 +2539,10 @@ history_db::line_id history_db::find(const char* line) const
 {
     line_id_impl ret;
 
-    for_each_bank([line, &ret] (unsigned int index, const read_lock& lock)
+    for_each_bank([this, line, &ret] (unsigned int index, const read_lock& lock)
     {
-        if (ret = lock.find(line))
+        update_index(index, lock);
+        if (ret = lock.find(line, m_bank_indices[index]))
             ret.bank_index = index;
         return !ret;
     });
@@ -1528,6 +2550,68 @@ history_db::line_id history_db::find(const char* line) const
     return ret.outer;
 }
 
+//------------------------------------------------------------------------------
+void history_db::update_index(unsigned int bank, const read_lock& lock) const
+{
+    concurrency_tag tag;
+    if (bank == bank_master)
+        extract_ctag(lock, tag);
+
+    bank_line_index& index = m_bank_indices[bank];
+    unsigned int file_size = lock.get_file_size();
+    if (!index.is_valid(tag, file_size))
+    {
+        DIAG("... rebuild %s bank index\n", bank == bank_master ? "master" : "session");
+        index.clear();
+    }
+
+    // Only index lines appended since the index was last updated.
+    if (file_size > index.get_indexed_size())
+    {
+        const log_tombstones* tombstones = update_tombstones(lock);
+
+        history_read_buffer buffer;
+        read_lock::line_iter iter(lock, buffer.data(), buffer.size(), true/*map*/, tombstones);
+
+        // In the log format, lines aren't marked in place when deleted; any
+        // tombstones appended since the last update must be applied.
+        if (lock.is_log())
+        {
+            unsigned int offset;
+            log_record record;
+            str_iter payload;
+            iter.set_file_offset(index.get_indexed_size());
+            while (iter.next_record(offset, record, payload))
+                if (record.type == log_tombstone)
+                    index.erase(get_tombstone_offset(payload));
+        }
+
+        str_iter out;
+        iter.set_file_offset(index.get_indexed_size());
+        while (line_id_impl id = iter.next(out))
+            index.insert(str_hash(out.get_pointer(), out.length()), id.offset);
+    }
+
+    index.set_valid(tag, file_size);
+}
+
+//------------------------------------------------------------------------------
+const log_tombstones* history_db::update_tombstones(const read_lock& lock) const
+{
+    // Only the master bank can be in the log format.
+    if (!lock.is_log())
+        return nullptr;
+
+    concurrency_tag tag;
+    extract_ctag(lock, tag);
+
+    if (!m_master_tombstones.is_valid(tag, lock.get_file_size()))
+        m_master_tombstones.clear();
+
+    scan_tombstones(lock, tag, m_master_tombstones);
+    return &m_master_tombstones;
+}
+
 //------------------------------------------------------------------------------
 history_db::expand_result history_db::expand(const char* line, str_base& out)
 {
@@ -5,8 +5,12 @@
 
 #include <core/str_iter.h>
 
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+class read_lock;
+
 //------------------------------------------------------------------------------
 class concurrency_tag
 {
@@ -43,6 +47,66 @@ struct bank_handles
     void*           m_handle_removals = nullptr;
 };
 
+//------------------------------------------------------------------------------
+class bank_line_index
+{
+    // Maps the hash of each active line in a bank to the line's offset, so
+    // finding duplicates doesn't need to scan the whole bank.  The index is
+    // only valid for the bank content up to m_indexed_size, and (for the
+    // master bank) only while the bank's concurrency tag matches m_ctag.
+    // Anything appended after m_indexed_size is indexed lazily.
+
+public:
+    typedef std::unordered_multimap<unsigned int, unsigned int> offset_map;
+    typedef std::unordered_map<unsigned int, unsigned int> hash_map;
+
+    void            clear();
+    bool            is_valid(const concurrency_tag& tag, unsigned int file_size) const;
+    void            set_valid(const concurrency_tag& tag, unsigned int file_size);
+    unsigned int    get_indexed_size() const { return m_indexed_size; }
+    void            insert(unsigned int hash, unsigned int offset);
+    void            erase(unsigned int offset);
+    template <typename T> void for_each_candidate(unsigned int hash, T&& callback) const;
+
+private:
+    concurrency_tag m_ctag;
+    unsigned int    m_indexed_size = 0;
+    offset_map      m_offsets;      // Line hash -> line offset.
+    hash_map        m_hashes;       // Line offset -> line hash.
+};
+
+//------------------------------------------------------------------------------
+template <typename T> void bank_line_index::for_each_candidate(unsigned int hash, T&& callback) const
+{
+    auto range = m_offsets.equal_range(hash);
+    for (auto iter = range.first; iter != range.second; ++iter)
+        callback(iter->second);
+}
+
+//------------------------------------------------------------------------------
+class log_tombstones
+{
+    // The offsets of the lines deleted by tombstone records in a bank in the
+    // 'log' format.  Tombstones follow the lines they delete, so they must be
+    // known before any lines are read.  The set is only valid for the bank
+    // content up to m_scanned_size, and only while the bank's concurrency tag
+    // matches m_ctag.  Anything appended after m_scanned_size is scanned
+    // lazily.
+
+public:
+    void            clear();
+    bool            is_valid(const concurrency_tag& tag, unsigned int file_size) const;
+    void            set_valid(const concurrency_tag& tag, unsigned int scanned_size);
+    unsigned int    get_scanned_size() const { return m_scanned_size; }
+    void            insert(unsigned int offset) { m_offsets.insert(offset); }
+    bool            contains(unsigned int offset) const { return m_offsets.find(offset) != m_offsets.end(); }
+
+private:
+    concurrency_tag m_ctag;
+    unsigned int    m_scanned_size = 0;
+    std::unordered_set<unsigned int> m_offsets;
+};
+
 //------------------------------------------------------------------------------
 class history_read_buffer
 {
@@ -135,19 +199,29 @@ public:
 private:
     friend                      class read_line_iter;
     void                        load_internal();
+    bool                        sync_internal();
     void                        reap();
     template <typename T> void  for_each_bank(T&& callback);
     template <typename T> void  for_each_bank(T&& callback) const;
     unsigned int                get_active_bank() const;
     bank_handles                get_bank(unsigned int index) const;
     bool                        remove_internal(line_id id, bool guard_ctag);
+    void                        start_compact_thread(bool uniq);
+    void                        wait_for_compact();
+    void                        update_index(unsigned int bank, const read_lock& lock) const;
+    const log_tombstones*       update_tombstones(const read_lock& lock) const;
     void*                       m_alive_file;
+    void*                       m_compact_thread = nullptr;
     bank_handles                m_bank_handles[bank_count];
+    mutable bank_line_index     m_bank_indices[bank_count];
+    mutable log_tombstones      m_master_tombstones;
     str<32>                     m_bank_filenames[bank_count];
     concurrency_tag             m_master_ctag;
     std::vector<line_id>        m_index_map;
     size_t                      m_master_len;
     size_t                      m_master_deleted_count;
+    unsigned int                m_bank_sizes[bank_count] = {};
+    bool                        m_loaded = false;
 
     size_t                      m_min_compact_threshold = 200;
 
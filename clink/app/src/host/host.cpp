@@ -546,10 +546,10 @@ void host::filter_transient_prompt(bool final)
 }
 
 //------------------------------------------------------------------------------
-void host::filter_matches(char** matches)
+void host::filter_matches(char** matches, const match_extras* extras)
 {
     if (m_lua)
-        m_lua->call_lua_filter_matches(matches, rl_completion_type, rl_filename_completion_desired);
+        m_lua->call_lua_filter_matches(matches, extras, rl_completion_type, rl_filename_completion_desired);
 }
 
 //------------------------------------------------------------------------------
@@ -36,7 +36,7 @@ public:
     void            remove_history(int rl_history_index, const char* line) override;
     void            filter_prompt() override;
     void            filter_transient_prompt(bool final) override;
-    void            filter_matches(char** matches) override;
+    void            filter_matches(char** matches, const match_extras* extras) override;
     bool            call_lua_rl_global_function(const char* func_name) override;
     const char**    copy_dir_history(int* total) override;
     void            get_app_context(int& id, str_base& binaries, str_base& profile, str_base& scripts) override;
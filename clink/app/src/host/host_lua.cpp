@@ -211,7 +211,7 @@ bool host_lua::call_lua_rl_global_function(const char* func_name)
 }
 
 //------------------------------------------------------------------------------
-void host_lua::call_lua_filter_matches(char** matches, int completion_type, int filename_completion_desired)
+void host_lua::call_lua_filter_matches(char** matches, const match_extras* extras, int completion_type, int filename_completion_desired)
 {
-    m_generator.filter_matches(matches, char(completion_type), !!filename_completion_desired);
+    m_generator.filter_matches(matches, extras, char(completion_type), !!filename_completion_desired);
 }
@@ -29,6 +29,22 @@ static void set_prompt_async(bool state)
     setting->set(state ? "true" : "false");
 }
 
+//------------------------------------------------------------------------------
+static void set_prompt_async_limit(int limit)
+{
+    setting* setting = settings::find("prompt.async_limit");
+    if (limit > 0)
+    {
+        str<16> value;
+        value.format("%d", limit);
+        setting->set(value.c_str());
+    }
+    else
+    {
+        setting->set();
+    }
+}
+
 //------------------------------------------------------------------------------
 static bool verify_ret_true(lua_state& lua, const char* func_name)
 {
@@ -94,10 +110,14 @@ TEST_CASE("Lua coroutines.")
             function yieldguard:command()\
                 return self._command\
             end\
+            local file = {}\
+            function file:_setwaiter(waiter)\
+                self._waiter = waiter\
+            end\
             _yieldguard = yieldguard\
             _ran = _ran..'|'..command\
             _command = command\
-            return 'fake_file', yieldguard\
+            return file, yieldguard\
         end\
         \
         function io.popen(command, mode)\
@@ -224,6 +244,7 @@ TEST_CASE("Lua coroutines.")
         SECTION("Enabled")
         {
             set_prompt_async(true);
+            set_prompt_async_limit(1);
 
             str<> out;
             REQUIRE(verify_ret_true(lua, "reset_coroutine_test"));
@@ -317,5 +338,287 @@ TEST_CASE("Lua coroutines.")
         }
     }
 
+    SECTION("Concurrent")
+    {
+        const char* script = "\
+        _guards = {}\
+        _ran = {}\
+        _done = {}\
+        \
+        function io.popenyield_internal(command, mode)\
+            local yieldguard = { _ready=false, _command=command }\
+            function yieldguard:ready()\
+                return self._ready\
+            end\
+            function yieldguard:command()\
+                return self._command\
+            end\
+            local file = { _guard=yieldguard }\
+            function file:_setwaiter(waiter)\
+                self._waiter = waiter\
+            end\
+            function file:read()\
+                while not self._guard._ready do\
+                    self._waiter()\
+                end\
+                return self._guard._command\
+            end\
+            _guards[command] = yieldguard\
+            _ran[command] = true\
+            return file, yieldguard\
+        end\
+        \
+        function start_coroutines()\
+            for _,command in ipairs({ 'aaa', 'bbb', 'ccc' }) do\
+                local c = coroutine.create(function ()\
+                    local f = io.popenyield(command)\
+                    if f:read() == command then\
+                        _done[command] = true\
+                    end\
+                end)\
+                clink.addcoroutine(c)\
+            end\
+            return true\
+        end\
+        \
+        function resume_coroutines()\
+            clink._wait_duration()\
+            clink._resume_coroutines()\
+            return true\
+        end\
+        \
+        local function count(t)\
+            local n = 0\
+            for _ in pairs(t) do\
+                n = n + 1\
+            end\
+            return n\
+        end\
+        \
+        function verify_running_2()\
+            return count(_ran) == 2 and count(_done) == 0\
+        end\
+        \
+        function verify_running_3()\
+            return count(_ran) == 3\
+        end\
+        \
+        function set_first_ready()\
+            for command,yg in pairs(_guards) do\
+                yg._ready = true\
+                _guards[command] = nil\
+                return true\
+            end\
+        end\
+        \
+        function set_all_ready()\
+            for _,yg in pairs(_guards) do\
+                yg._ready = true\
+            end\
+            return true\
+        end\
+        \
+        function verify_all_done()\
+            return count(_done) == 3 and clink._has_coroutines() ~= true\
+        end\
+        ";
+
+        REQUIRE(lua.do_string(script));
+
+        set_prompt_async(true);
+        set_prompt_async_limit(2);
+
+        lua.send_event("onbeginedit");
+        REQUIRE(verify_ret_true(lua, "start_coroutines"));
+
+        // Two commands run concurrently; the third waits for a free slot.
+        REQUIRE(verify_ret_true(lua, "resume_coroutines"));
+        REQUIRE(verify_ret_true(lua, "verify_running_2"));
+        REQUIRE(verify_ret_true(lua, "resume_coroutines"));
+        REQUIRE(verify_ret_true(lua, "verify_running_2"));
+
+        // Whichever finishes first frees a slot for the third.
+        REQUIRE(verify_ret_true(lua, "set_first_ready"));
+        REQUIRE(verify_ret_true(lua, "resume_coroutines"));
+        REQUIRE(verify_ret_true(lua, "resume_coroutines"));
+        REQUIRE(verify_ret_true(lua, "verify_running_3"));
+
+        REQUIRE(verify_ret_true(lua, "set_all_ready"));
+        REQUIRE(verify_ret_true(lua, "resume_coroutines"));
+        REQUIRE(verify_ret_true(lua, "resume_coroutines"));
+        REQUIRE(verify_ret_true(lua, "verify_all_done"));
+    }
+
+    set_prompt_async_limit(0);
+    set_prompt_async_default();
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("Lua popenyield streams.")
+{
+    lua_state lua;
+    prompt_filter prompt_filter(lua);
+    lua_load_script(lua, app, prompt);
+
+    const char* script = "\
+    local function check(value, expected, what)\
+        if value ~= expected then\
+            error(what..': expected '..tostring(expected)..', got '..tostring(value))\
+        end\
+    end\
+    \
+    local function check_lines(lines, prefix, count)\
+        check(#lines, count, prefix..' line count')\
+        for i = 1, count do\
+            check(lines[i], prefix..i, prefix..' line '..i)\
+        end\
+    end\
+    \
+    local function loop_command(prefix, count)\
+        return 'for /l %i in (1,1,'..count..') do @echo '..prefix..'%i'\
+    end\
+    \
+    function test_file_handle()\
+        local f = io.popenyield('echo hello')\
+        check(type(f), 'userdata', 'type')\
+        check(io.type(f), 'file', 'io.type')\
+        check(tostring(f):sub(1, 6), 'file (', 'tostring')\
+        check(f:setvbuf('no'), true, 'setvbuf')\
+        check(f:flush(), true, 'flush')\
+        check(f:seek('set', 0), nil, 'seek')\
+        check(f:write('x'), nil, 'write')\
+        check(f:read('a'), 'hello\\n', 'read all')\
+        check(f:close(), true, 'close')\
+        check(io.type(f), 'closed file', 'io.type closed')\
+        check(tostring(f), 'file (closed)', 'tostring closed')\
+        check(pcall(f.read, f), false, 'read closed')\
+        check(io.type(io.stdout), 'file', 'io.type stdout')\
+        check(io.type(42), nil, 'io.type number')\
+        return true\
+    end\
+    \
+    function test_partial_reads()\
+        local f = io.popenyield('echo abcdefghij')\
+        check(f:read(0), '', 'read 0')\
+        check(f:read(3), 'abc', 'read 3')\
+        local a, b = f:read(4, 1)\
+        check(a, 'defg', 'read 4')\
+        check(b, 'h', 'read 1')\
+        check(f:read('L'), 'ij\\n', 'read L')\
+        check(f:read(0), nil, 'read 0 at eof')\
+        check(f:read(5), nil, 'read 5 at eof')\
+        check(f:read('l'), nil, 'read l at eof')\
+        check(f:read('a'), '', 'read a at eof')\
+        f:close()\
+        return true\
+    end\
+    \
+    function test_multi_chunk()\
+        local f = io.popenyield(loop_command('line', 3000))\
+        local lines = {}\
+        for line in f:lines() do\
+            table.insert(lines, line)\
+        end\
+        check(f:read(0), nil, 'read 0 at eof')\
+        f:close()\
+        check_lines(lines, 'line', 3000)\
+        return true\
+    end\
+    \
+    function test_binary()\
+        local f = io.popenyield('echo abc', 'rb')\
+        check(f:read('a'), 'abc\\r\\n', 'read binary')\
+        f:close()\
+        return true\
+    end\
+    \
+    function start_coroutines(prefixes, count)\
+        _results = {}\
+        for _,prefix in ipairs(prefixes) do\
+            local c = coroutine.create(function ()\
+                local f = io.popenyield(loop_command(prefix, count))\
+                local lines = {}\
+                for line in f:lines() do\
+                    table.insert(lines, line)\
+                end\
+                f:close()\
+                _results[prefix] = lines\
+            end)\
+            clink.addcoroutine(c)\
+        end\
+        return true\
+    end\
+    \
+    function run_coroutines()\
+        local start = os.clock()\
+        while clink._has_coroutines() do\
+            clink._wait_duration()\
+            clink._resume_coroutines()\
+            if os.clock() - start > 30 then\
+                error('timed out waiting for coroutines')\
+            end\
+        end\
+        return true\
+    end\
+    \
+    function verify_results(prefixes, count)\
+        for _,prefix in ipairs(prefixes) do\
+            check(type(_results[prefix]), 'table', prefix..' results')\
+            check_lines(_results[prefix], prefix, count)\
+        end\
+        return true\
+    end\
+    \
+    function test_one_coroutine()\
+        start_coroutines({ 'one' }, 2000)\
+        run_coroutines()\
+        return verify_results({ 'one' }, 2000)\
+    end\
+    \
+    function test_concurrent_coroutines()\
+        local prefixes = { 'aaa', 'bbb', 'ccc', 'ddd' }\
+        start_coroutines(prefixes, 1000)\
+        run_coroutines()\
+        return verify_results(prefixes, 1000)\
+    end\
+    ";
+
+    REQUIRE(lua.do_string(script));
+
+    set_prompt_async(true);
+    set_prompt_async_limit(3);
+    lua.send_event("onbeginedit");
+
+    SECTION("File handle")
+    {
+        REQUIRE(verify_ret_true(lua, "test_file_handle"));
+    }
+
+    SECTION("Partial reads")
+    {
+        REQUIRE(verify_ret_true(lua, "test_partial_reads"));
+    }
+
+    SECTION("Multiple chunks")
+    {
+        REQUIRE(verify_ret_true(lua, "test_multi_chunk"));
+    }
+
+    SECTION("Binary")
+    {
+        REQUIRE(verify_ret_true(lua, "test_binary"));
+    }
+
+    SECTION("Coroutine")
+    {
+        REQUIRE(verify_ret_true(lua, "test_one_coroutine"));
+    }
+
+    SECTION("Concurrent")
+    {
+        REQUIRE(verify_ret_true(lua, "test_concurrent_coroutines"));
+    }
+
+    set_prompt_async_limit(0);
     set_prompt_async_default();
 }
@@ -6,6 +6,7 @@
 #include "env_fixture.h"
 #include "line_editor_tester.h"
 
+#include <core/os.h>
 #include <core/path.h>
 #include <core/settings.h>
 #include <core/str_compare.h>
@@ -90,6 +91,89 @@ TEST_CASE("Executable match generation.")
         tester.run();
     }
 
+    SECTION("PATH index")
+    {
+        SECTION("All")
+        {
+            const char* script = "\
+                local names = {}\
+                for _, f in ipairs(os.getexecutables()) do\
+                    names[f.name] = f.type\
+                end\
+                assert(names['spa ce.exe'] == 'file')\
+                assert(names['one_path.exe'] == 'file')\
+                assert(names['one_two.py'] == 'file')\
+                assert(not names['one_three.txt'])\
+            ";
+
+            REQUIRE(lua.do_string(script));
+        }
+
+        SECTION("Relative")
+        {
+            REQUIRE(SetEnvironmentVariable("path", ".") != FALSE);
+            REQUIRE(lua.do_string("assert(#os.getexecutables() == 2)"));
+
+            // "." is resolved again after the current directory changes.
+            REQUIRE(os::set_current_dir("one_dir"));
+
+            tester.set_input("two_");
+            tester.set_expected_matches("two_dir_local.exe");
+            tester.run();
+        }
+
+        SECTION("PATH changed")
+        {
+            // Index the original %PATH% first, so the change invalidates it.
+            REQUIRE(lua.do_string("assert(#os.getexecutables() == 3)"));
+
+            str<260> dir_path(exec_fs.get_root());
+            path::append(dir_path, "one_dir");
+
+            SECTION("Replaced")
+            {
+                REQUIRE(SetEnvironmentVariable("path", dir_path.c_str()) != FALSE);
+
+                REQUIRE(lua.do_string("assert(#os.getexecutables() == 2)"));
+
+                tester.set_input("two_");
+                tester.set_expected_matches("two_dir_local.exe");
+                tester.run();
+            }
+
+            SECTION("Added")
+            {
+                str<> both;
+                both << path_env_var.c_str() << ";" << dir_path.c_str();
+                REQUIRE(SetEnvironmentVariable("path", both.c_str()) != FALSE);
+
+                tester.set_input("spa");
+                tester.set_expected_matches("spa ce.exe");
+                tester.run();
+            }
+
+            SECTION("Removed")
+            {
+                REQUIRE(SetEnvironmentVariable("path", "") != FALSE);
+
+                // With no executables, directories are matched instead.
+                tester.set_input("one_");
+                tester.set_expected_matches("one_dir\\");
+                tester.run();
+            }
+        }
+
+        SECTION("PATHEXT changed")
+        {
+            REQUIRE(lua.do_string("assert(#os.getexecutables() == 3)"));
+            REQUIRE(SetEnvironmentVariable("pathext", ".py;.txt") != FALSE);
+
+            tester.set_input("one_");
+            tester.set_expected_matches("one_two.py", "one_three.txt");
+            tester.run();
+        }
+    }
+
     SECTION("Relative path")
     {
         tester.set_input(".\\");
@@ -15,6 +15,7 @@
 #include <utils/app_context.h>
 
 #include <initializer_list>
+#include <vector>
 
 extern "C" {
 #include <readline/history.h>
@@ -66,6 +67,11 @@ struct test_history_db
     {
         m_min_compact_threshold = threshold;
     }
+
+    void wait_for_compact()
+    {
+        history_db::wait_for_compact();
+    }
 };
 
 //------------------------------------------------------------------------------
@@ -97,6 +103,40 @@ void expect_files(const std::initializer_list<T>& names, bool exclusive=true)
 
 
 
+//------------------------------------------------------------------------------
+// Restores settings when it goes out of scope, so that a section that changes
+// them (or fails partway through) doesn't leak them into later sections.
+struct setting_restorer
+{
+    setting_restorer(std::initializer_list<const char*> names)
+    {
+        for (const char* name : names)
+        {
+            entry e;
+            e.target = settings::find(name);
+            e.target->get(e.value);
+            m_entries.push_back(std::move(e));
+        }
+    }
+
+    ~setting_restorer()
+    {
+        for (entry& e : m_entries)
+            e.target->set(e.value.c_str());
+    }
+
+private:
+    struct entry
+    {
+        setting*        target;
+        str_moveable    value;
+    };
+
+    std::vector<entry>  m_entries;
+};
+
+
+
 //------------------------------------------------------------------------------
 TEST_CASE("history db")
 {
@@ -131,6 +171,8 @@ TEST_CASE("history db")
     str_base(context_desc.state_dir).copy(fs.get_root());
     app_context context(context_desc);
 
+    setting_restorer restorer({ "history.shared", "history.dupe_mode" });
+
     SECTION("Alive file")
     {
         // Shared
@@ -254,6 +296,34 @@ TEST_CASE("history db")
 
     }
 
+    SECTION("Index")
+    {
+        settings::find("history.shared")->set("true");
+        settings::find("history.dupe_mode")->set("erase_prev");
+
+        test_history_db history;
+        for (const char* line : line_set0)
+            REQUIRE(history.add(line));
+        REQUIRE(history.add(line_set0[1]));
+
+        REQUIRE(history.find(line_set0[1]));
+        REQUIRE(!history.find("line_set0_"));
+        REQUIRE(!history.find("line_set0_11"));
+
+        // Another instance compacts the master bank, which changes the ctag and
+        // line offsets, so the index must be rebuilt.
+        {
+            test_history_db other;
+            other.compact(true/*force*/);
+        }
+
+        REQUIRE(history.remove(line_set0[2]) == 1);
+        REQUIRE(!history.find(line_set0[2]));
+        REQUIRE(history.find(line_set0[3]));
+        REQUIRE(history.remove(line_set0[1]) == 1);
+        REQUIRE(history.remove(line_set0[1]) == 0);
+    }
+
     SECTION("line iter")
     {
         str<> lines;
@@ -288,6 +358,83 @@ TEST_CASE("history db")
             }
         }
     }
+
+    SECTION("Long lines")
+    {
+        // Lines longer than the vectorized line scanner's stride, with mixed
+        // line endings.
+        settings::find("history.shared")->set("false");
+
+        str<> lines;
+        for (int i = 0; i < 40; ++i)
+        {
+            for (int j = 0; j <= i; ++j)
+                lines.concat("abcdefghijklmnopqrstuvwxyz" + (j % 26), 1);
+            lines << ((i & 1) ? "\r\n" : "\n");
+        }
+
+        FILE* out = fopen(session_path, "wb");
+        fwrite(lines.c_str(), lines.length(), 1, out);
+        fclose(out);
+
+        test_history_db history;
+
+        char buffer[512];
+        str_iter line;
+        int i = 0;
+        history_db::iter iter = history.read_lines(buffer);
+        while (iter.next(line))
+        {
+            REQUIRE(line.length() == i + 1);
+            REQUIRE(line.get_pointer()[i] == "abcdefghijklmnopqrstuvwxyz"[i % 26]);
+            ++i;
+        }
+        REQUIRE(i == 40);
+    }
+
+    SECTION("Sync")
+    {
+        settings::find("history.shared")->set("true");
+        settings::find("history.dupe_mode")->set("add");
+
+        test_history_db history;
+        for (const char* line : line_set0)
+            history.add(line);
+        history.load_rl_history(false/*can_clean*/);
+        REQUIRE(history_length == sizeof_array(line_set0));
+
+        // Another instance appends and deletes lines; only those changes are
+        // applied to Readline's history.
+        {
+            test_history_db other;
+            for (const char* line : line_set1)
+                other.add(line);
+            REQUIRE(other.remove(line_set0[2]) == 1);
+        }
+
+        const int expected = int(sizeof_array(line_set0) + sizeof_array(line_set1) - 1);
+        history.load_rl_history(false/*can_clean*/);
+        REQUIRE(history_length == expected);
+        REQUIRE(history.get_master_length() == expected);
+        REQUIRE(history.get_master_deleted_count() == 1);
+        REQUIRE(strcmp(history_get(history_base + 2)->line, line_set0[3]) == 0);
+        REQUIRE(strcmp(history_get(history_base + expected - 1)->line, line_set1[3]) == 0);
+
+        // Compacting changes the ctag, which forces a full reload.
+        concurrency_tag ctag;
+        ctag.set(history.get_master_tag());
+        {
+            test_history_db other;
+            other.compact(true/*force*/);
+        }
+
+        history.load_rl_history(false/*can_clean*/);
+        REQUIRE(history_length == expected);
+        REQUIRE(history.get_master_deleted_count() == 0);
+        REQUIRE(strcmp(ctag.get(), history.get_master_tag()) != 0);
+
+        settings::find("history.shared")->set("false");
+    }
 }
 
 //------------------------------------------------------------------------------
@@ -701,3 +848,309 @@ TEST_CASE("history unique")
         REQUIRE(strcmp(history_get(3)->line, "bbb") == 0);
     }
 }
+
+//------------------------------------------------------------------------------
+static void verify_history(test_history_db& history, std::initializer_list<const char*> expected)
+{
+    history.load_rl_history(false/*can_clean*/);
+    REQUIRE(history_length == int(expected.size()), [&] () {
+        printf("history_length %d, expected %d\n", history_length, int(expected.size()));
+    });
+
+    int i = 0;
+    for (const char* line : expected)
+    {
+        const HIST_ENTRY* entry = history_get(history_base + i++);
+        REQUIRE(entry);
+        REQUIRE(strcmp(entry->line, line) == 0, [&] () {
+            printf("line %d is '%s', expected '%s'\n", i - 1, entry->line, line);
+        });
+    }
+}
+
+//------------------------------------------------------------------------------
+static bool starts_with_file(const char* path, const char* prefix)
+{
+    char buffer[16] = {};
+    const int len = int(strlen(prefix));
+    FILE* in = fopen(path, "rb");
+    if (!in)
+        return false;
+    const int read = int(fread(buffer, 1, min<int>(len, sizeof(buffer)), in));
+    fclose(in);
+    return (read == len && memcmp(buffer, prefix, len) == 0);
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("history log")
+{
+    const char* lines[] = {
+        "log_line_0", "log_line_1", "log_line_2", "log_line_3",
+    };
+
+    const char* master_path = "clink_history";
+    const char* log_magic = "\x7f" "CLOG01\n";
+    const unsigned int record_header_size = 16;
+    const unsigned int tombstone_size = record_header_size + sizeof(unsigned int);
+
+    // Start with an empty state dir.
+    const char* empty_fs[] = { nullptr };
+    fs_fixture fs(empty_fs);
+
+    // This sets the state id to something explicit.
+    static const char* env_desc[] = {
+        "=clink.id", "493",
+        nullptr
+    };
+    env_fixture env(env_desc);
+
+    app_context::desc context_desc;
+    context_desc.inherit_id = true;
+    str_base(context_desc.state_dir).copy(fs.get_root());
+    app_context context(context_desc);
+
+    setting_restorer restorer({ "history.shared", "history.dupe_mode", "history.format", "history.max_lines" });
+    settings::find("history.shared")->set("true");
+    settings::find("history.dupe_mode")->set("add");
+    settings::find("history.format")->set("log");
+    settings::find("history.max_lines")->set();
+
+    SECTION("Migrate")
+    {
+        // Start with the text format.
+        settings::find("history.format")->set("text");
+        {
+            test_history_db history;
+            for (const char* line : lines)
+                REQUIRE(history.add(line));
+            REQUIRE(history.remove(lines[1]) == 1);
+        }
+        REQUIRE(starts_with_file(master_path, "|CTAG_"));
+
+        // Converting drops the deleted line and keeps the order.
+        settings::find("history.format")->set("log");
+        {
+            test_history_db history;
+            REQUIRE(starts_with_file(master_path, log_magic));
+            verify_history(history, { lines[0], lines[2], lines[3] });
+            REQUIRE(history.get_master_deleted_count() == 0);
+            REQUIRE(history.find(lines[2]));
+            REQUIRE(!history.find(lines[1]));
+        }
+
+        // And back again.
+        settings::find("history.format")->set("text");
+        {
+            test_history_db history;
+            REQUIRE(starts_with_file(master_path, "|CTAG_"));
+            verify_history(history, { lines[0], lines[2], lines[3] });
+        }
+    }
+
+    SECTION("Tombstones")
+    {
+        test_history_db history;
+        for (const char* line : lines)
+            REQUIRE(history.add(line));
+        verify_history(history, { lines[0], lines[1], lines[2], lines[3] });
+
+        // Removing a line appends a tombstone; nothing else changes.
+        const int size = os::get_file_size(master_path);
+        REQUIRE(history.remove(lines[2]) == 1);
+        REQUIRE(os::get_file_size(master_path) == size + tombstone_size);
+        REQUIRE(history.remove(lines[2]) == 0);
+
+        REQUIRE(!history.find(lines[2]));
+        REQUIRE(history.find(lines[3]));
+        verify_history(history, { lines[0], lines[1], lines[3] });
+        REQUIRE(history.get_master_deleted_count() == 1);
+
+        // Another instance sees the tombstone, and its tombstones are seen
+        // here without reloading.
+        {
+            test_history_db other;
+            REQUIRE(!other.find(lines[2]));
+            REQUIRE(other.remove(lines[0]) == 1);
+        }
+        REQUIRE(!history.find(lines[0]));
+        REQUIRE(history.find(lines[1]));
+        verify_history(history, { lines[1], lines[3] });
+        REQUIRE(history.get_master_deleted_count() == 2);
+
+        // A fresh instance loads the same lines.
+        test_history_db fresh;
+        verify_history(fresh, { lines[1], lines[3] });
+        REQUIRE(fresh.get_master_deleted_count() == 2);
+    }
+
+    SECTION("Torn tail")
+    {
+        {
+            test_history_db history;
+            for (const char* line : lines)
+                REQUIRE(history.add(line));
+        }
+
+        int expected = sizeof_array(lines);
+
+        SECTION("Partial record")
+        {
+            // A writer was interrupted partway through appending a record.
+            unsigned char header[record_header_size] = { 64, 0, 0, 0, 2 };
+            FILE* out = fopen(master_path, "ab");
+            fwrite(header, sizeof(header), 1, out);
+            fwrite("torn", 4, 1, out);
+            fclose(out);
+        }
+
+        SECTION("Partial header")
+        {
+            FILE* out = fopen(master_path, "ab");
+            fwrite("\x10\x00\x00", 3, 1, out);
+            fclose(out);
+        }
+
+        SECTION("Truncated line")
+        {
+            // Drop the last byte of the last line.
+            const int size = os::get_file_size(master_path);
+            std::vector<char> content(size);
+            FILE* in = fopen(master_path, "rb");
+            REQUIRE(fread(content.data(), 1, size, in) == size_t(size));
+            fclose(in);
+
+            FILE* out = fopen(master_path, "wb");
+            fwrite(content.data(), size - 1, 1, out);
+            fclose(out);
+
+            --expected;
+        }
+
+        // The lines before the torn record are intact.
+        test_history_db history;
+        history.load_rl_history(false/*can_clean*/);
+        REQUIRE(history_length == expected);
+        REQUIRE(history.find(lines[expected - 1]));
+        REQUIRE(!history.find("torn"));
+        if (expected < sizeof_array(lines))
+            REQUIRE(!history.find(lines[expected]));
+
+        str_iter line;
+        char buffer[1024];
+        int count = 0;
+        history_db::iter iter = history.read_lines(buffer);
+        while (iter.next(line))
+        {
+            REQUIRE(line.length() == strlen(lines[count]));
+            REQUIRE(memcmp(line.get_pointer(), lines[count], line.length()) == 0);
+            ++count;
+        }
+        REQUIRE(count == expected);
+    }
+
+    SECTION("Compact")
+    {
+        concurrency_tag ctag;
+        {
+            test_history_db history;
+            for (int i = 0; i < 3; ++i)
+                for (const char* line : lines)
+                    REQUIRE(history.add(line));
+            REQUIRE(history.remove(lines[0]) == 3);
+            verify_history(history, { lines[1], lines[2], lines[3],
+                                      lines[1], lines[2], lines[3],
+                                      lines[1], lines[2], lines[3] });
+            REQUIRE(history.get_master_deleted_count() == 3);
+            ctag.set(history.get_master_tag());
+        }
+
+        SECTION("Purge")
+        {
+            test_history_db history;
+            history.compact(true/*force*/);
+            REQUIRE(starts_with_file(master_path, log_magic));
+            verify_history(history, { lines[1], lines[2], lines[3],
+                                      lines[1], lines[2], lines[3],
+                                      lines[1], lines[2], lines[3] });
+            REQUIRE(history.get_master_deleted_count() == 0);
+            REQUIRE(strcmp(ctag.get(), history.get_master_tag()) != 0);
+        }
+
+        SECTION("Unique")
+        {
+            test_history_db history;
+            history.add(lines[2]);
+            history.compact(true/*force*/, true/*uniq*/);
+            verify_history(history, { lines[1], lines[3], lines[2] });
+            REQUIRE(history.get_master_deleted_count() == 0);
+
+            // Compacting again finds nothing more to remove.
+            history.compact(true/*force*/, true/*uniq*/);
+            verify_history(history, { lines[1], lines[3], lines[2] });
+            REQUIRE(history.get_master_deleted_count() == 0);
+
+            // The compacted log is still usable.
+            REQUIRE(history.remove(lines[3]) == 1);
+            REQUIRE(history.add(lines[0]));
+            verify_history(history, { lines[1], lines[2], lines[0] });
+        }
+
+        SECTION("Background")
+        {
+            // Going over the limit when loading history compacts the bank on
+            // a thread, and the next load picks up the compacted bank.
+            settings::find("history.max_lines")->set("3");
+
+            test_history_db history;
+            history.set_min_compact_threshold(3);
+            history.load_rl_history();
+            history.wait_for_compact();
+
+            verify_history(history, { lines[1], lines[2], lines[3] });
+            REQUIRE(history.get_master_deleted_count() == 0);
+            REQUIRE(strcmp(ctag.get(), history.get_master_tag()) != 0);
+        }
+    }
+
+    SECTION("Dupe mode")
+    {
+        SECTION("erase_prev")
+        {
+            settings::find("history.dupe_mode")->set("erase_prev");
+
+            test_history_db history;
+            for (const char* line : lines)
+                REQUIRE(history.add(line));
+            REQUIRE(history.add(lines[1]));
+            REQUIRE(history.add(lines[0]));
+            verify_history(history, { lines[2], lines[3], lines[1], lines[0] });
+            REQUIRE(history.get_master_deleted_count() == 2);
+
+            // Lines added by another instance are deduped too.
+            {
+                test_history_db other;
+                REQUIRE(other.add(lines[2]));
+            }
+            REQUIRE(history.add(lines[2]));
+            verify_history(history, { lines[3], lines[1], lines[0], lines[2] });
+        }
+
+        SECTION("ignore")
+        {
+            settings::find("history.dupe_mode")->set("ignore");
+
+            test_history_db history;
+            for (const char* line : lines)
+                REQUIRE(history.add(line));
+            const int size = os::get_file_size(master_path);
+            REQUIRE(history.add(lines[1]));
+            REQUIRE(os::get_file_size(master_path) == size);
+            verify_history(history, { lines[0], lines[1], lines[2], lines[3] });
+
+            // A tombstoned line is no longer a duplicate.
+            REQUIRE(history.remove(lines[1]) == 1);
+            REQUIRE(history.add(lines[1]));
+            verify_history(history, { lines[0], lines[2], lines[3], lines[1] });
+        }
+    }
+}
@@ -0,0 +1,38 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#pragma once
+
+#include "str.h"
+
+#include <memory>
+#include <vector>
+
+//------------------------------------------------------------------------------
+namespace dir_cache
+{
+
+// A short-lived cache of directory listings, shared by all globbers that opt
+// in via globber::cached().  It only exists between begin_session() and
+// end_session(), so that several generators and pattern variants (e.g. `*`,
+// `*.exe`, `*.cmd`) completing the same word only enumerate the directory
+// once.  A listing is trusted for ttl milliseconds, after that it's reused
+// only if the directory's last write time hasn't changed.
+
+struct entry
+{
+    wstr_moveable       name;
+    unsigned int        attr;
+    unsigned long long  size;
+    unsigned long long  write_time;
+};
+
+typedef std::vector<entry> listing;
+
+void                    begin_session(unsigned int ttl);
+void                    end_session();
+bool                    is_active();
+std::shared_ptr<const listing> get(const wchar_t* dir);
+void                    get_counters(unsigned int& hits, unsigned int& misses);
+
+}; // namespace dir_cache
@@ -4,6 +4,7 @@
 #pragma once
 
 #include "str.h"
+#include "dir_cache.h"
 
 #include <Windows.h>
 
@@ -19,16 +20,25 @@ public:
     void                hidden(bool state)      { m_hidden = state; }
     void                system(bool state)      { m_system = state; }
     void                dots(bool state)        { m_dots = state; }
+    void                cached(bool state)      { m_cached = state; }
     bool                older_than(int seconds);
-    bool                next(str_base& out, bool rooted=true, int* st_mode=nullptr, int* pattr=nullptr);
+    bool                next(str_base& out, bool rooted=true, int* st_mode=nullptr, int* pattr=nullptr, unsigned long long* psize=nullptr, unsigned long long* pwrite_time=nullptr);
 
 private:
                         globber(const globber&) = delete;
     void                operator = (const globber&) = delete;
+    void                start();
+    bool                get_file(const wchar_t*& name, int& attr, unsigned long long& size, FILETIME& write_time);
     void                next_file();
     WIN32_FIND_DATAW    m_data;
     HANDLE              m_handle;
+    std::shared_ptr<const dir_cache::listing> m_listing;
+    unsigned int        m_index;
+    wstr<280>           m_pattern;
+    wstr<32>            m_mask;
     str<280>            m_root;
+    bool                m_started;
+    bool                m_cached;
     bool                m_files;
     bool                m_directories;
     bool                m_dir_suffix;
@@ -37,5 +47,4 @@ private:
     bool                m_dots;
     bool                m_onlyolder;
     FILETIME            m_olderthan;
-
 };
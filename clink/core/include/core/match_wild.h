@@ -16,32 +16,7 @@ namespace path
 template <class T, int MODE, bool fuzzy_accents>
 bool match_char_impl(int pc, int fc)
 {
-    if (MODE > 0)
-    {
-        pc = (pc > 0xffff) ? pc : int(uintptr_t(CharLowerW(LPWSTR(uintptr_t(pc)))));
-        fc = (fc > 0xffff) ? fc : int(uintptr_t(CharLowerW(LPWSTR(uintptr_t(fc)))));
-    }
-
-    if (MODE > 1)
-    {
-        pc = (pc == '-') ? '_' : pc;
-        fc = (fc == '-') ? '_' : fc;
-    }
-
-    if (pc == '\\') pc = '/';
-    if (fc == '\\') fc = '/';
-
-    if (pc != fc)
-    {
-        if (!fuzzy_accents)
-            return false;
-        pc = normalize_accent(pc);
-        fc = normalize_accent(fc);
-        if (pc != fc)
-            return false;
-    }
-
-    return true;
+    return fold_char<MODE, fuzzy_accents>(pc) == fold_char<MODE, fuzzy_accents>(fc);
 }
 
 //------------------------------------------------------------------------------
@@ -0,0 +1,27 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#pragma once
+
+//------------------------------------------------------------------------------
+class ring_buffer
+{
+    // Growable ring buffer; the capacity doubles when full, so appending never
+    // discards unread data.
+
+public:
+                    ring_buffer() = default;
+                    ~ring_buffer() { free(m_data); }
+    unsigned int    size() const { return m_size; }
+    bool            append(const char* data, unsigned int len);
+    int             find(char c) const;
+    void            read(char* out, unsigned int len);
+
+private:
+                    ring_buffer(const ring_buffer&) = delete;
+    void            operator = (const ring_buffer&) = delete;
+    char*           m_data = nullptr;
+    unsigned int    m_capacity = 0;
+    unsigned int    m_head = 0;
+    unsigned int    m_size = 0;
+};
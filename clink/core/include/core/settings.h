@@ -101,6 +101,7 @@ protected:
     };
 
     static const char* get_loaded_value(const char* name);
+    static void     note_changed();
 };
 
 //------------------------------------------------------------------------------
@@ -158,6 +159,7 @@ template <typename T> setting_impl<T>::setting_impl(
 template <typename T> void setting_impl<T>::set()
 {
     m_store.value = T(m_default);
+    note_changed();
 }
 
 //------------------------------------------------------------------------------
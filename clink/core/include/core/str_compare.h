@@ -12,6 +12,11 @@
 
 #include <map>
 
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define USE_SSE2_STR_COMPARE
+#include <emmintrin.h>
+#endif
+
 //------------------------------------------------------------------------------
 class str_compare_scope
 {
@@ -41,48 +46,168 @@ private:
 //------------------------------------------------------------------------------
 int normalize_accent(int c);
 
+//------------------------------------------------------------------------------
+// Returns a table that maps each BMP code point to the value it compares as
+// in the given mode:  lower case (caseless and relaxed), '_' for '-' (relaxed),
+// '/' for '\\', and with accents removed (fuzzy_accents).  Tables are built on
+// first use.
+const wchar_t* get_fold_table(int mode, bool fuzzy_accents);
+
+//------------------------------------------------------------------------------
+template <int MODE, bool fuzzy_accents>
+inline int fold_char(int c)
+{
+    if (!MODE && !fuzzy_accents)
+        return (c == '\\') ? '/' : c;
+
+    static const wchar_t* const s_table = get_fold_table(MODE, fuzzy_accents);
+    return (c > 0xffff) ? c : s_table[c];
+}
+
+//------------------------------------------------------------------------------
+// Returns whether the fold table for the mode folds ASCII the same way as
+// str_compare_ascii_run does.
+bool is_simple_ascii_fold(int mode, bool fuzzy_accents);
+
+//------------------------------------------------------------------------------
+// Returns how many leading characters of lhs and rhs are ASCII and compare
+// equal in the given mode, checking in blocks of 16.  Stops before any block
+// that contains a path separator, so the caller can collapse runs of them.
+// Only valid when is_simple_ascii_fold() is true for the mode.
+template <int MODE>
+inline unsigned int str_compare_ascii_run(const wchar_t*, const wchar_t*, unsigned int)
+{
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+template <int MODE>
+inline unsigned int str_compare_ascii_run(const char* lhs, const char* rhs, unsigned int limit)
+{
+#ifdef USE_SSE2_STR_COMPARE
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i slash = _mm_set1_epi8('/');
+
+    // Unaligned loads are only used when they can't cross into the next page,
+    // because the strings may only be bounded by their NUL terminators.
+    auto can_load = [] (const char* p) {
+        return (uintptr_t(p) & 4095) <= 4096 - 16;
+    };
+
+    unsigned int n = 0;
+    while (limit - n >= 16 && can_load(lhs + n) && can_load(rhs + n))
+    {
+        const __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lhs + n));
+        const __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rhs + n));
+
+        // Stop at non-ASCII, NUL, path separators, and differences; the
+        // caller handles those one character at a time.  Checking lhs for NUL
+        // and separators is enough, because where rhs differs from lhs the
+        // characters can't fold equal.
+        __m128i stop = _mm_or_si128(l, r);
+        stop = _mm_or_si128(stop, _mm_cmpeq_epi8(l, zero));
+        stop = _mm_or_si128(stop, _mm_or_si128(_mm_cmpeq_epi8(l, backslash), _mm_cmpeq_epi8(l, slash)));
+
+        // Characters are the same if they're equal, or (caseless) if they
+        // differ only in the 0x20 bit and are letters, or (relaxed) if one is
+        // '-' and the other is '_'.
+        const __m128i diff = _mm_xor_si128(l, r);
+        __m128i same_chars = _mm_cmpeq_epi8(diff, zero);
+        if (MODE > 0)
+        {
+            // (c|0x20) - 'a' is below 26 for letters; the bias of 0x80 makes
+            // the unsigned comparison work as a signed one.
+            const __m128i lower = _mm_or_si128(l, _mm_set1_epi8(0x20));
+            const __m128i biased = _mm_sub_epi8(lower, _mm_set1_epi8(char('a' + 0x80)));
+            const __m128i letter = _mm_cmplt_epi8(biased, _mm_set1_epi8(char(26 - 0x80)));
+            const __m128i case_bit = _mm_cmpeq_epi8(diff, _mm_set1_epi8(0x20));
+            same_chars = _mm_or_si128(same_chars, _mm_and_si128(letter, case_bit));
+        }
+        if (MODE > 1)
+        {
+            const __m128i dash_or_underscore = _mm_or_si128(_mm_cmpeq_epi8(l, _mm_set1_epi8('-')), _mm_cmpeq_epi8(l, _mm_set1_epi8('_')));
+            const __m128i dash_bits = _mm_cmpeq_epi8(diff, _mm_set1_epi8('-' ^ '_'));
+            same_chars = _mm_or_si128(same_chars, _mm_and_si128(dash_or_underscore, dash_bits));
+        }
+
+        const unsigned int same = _mm_movemask_epi8(same_chars);
+        if (unsigned int mask = _mm_movemask_epi8(stop) | (~same & 0xffff))
+        {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            n += index;
+#else
+            n += __builtin_ctz(mask);
+#endif
+            break;
+        }
+
+        n += 16;
+    }
+    return n;
+#else
+    return 0;
+#endif
+}
+
 //------------------------------------------------------------------------------
 // Returns how many characters match at the beginning of the strings, or -1 if
 // the entire strings match.
 template <class T, int MODE, bool fuzzy_accents>
 int str_compare_impl(str_iter_impl<T>& lhs, str_iter_impl<T>& rhs)
 {
+    static const bool s_ascii_runs = (!MODE && !fuzzy_accents) || is_simple_ascii_fold(MODE, fuzzy_accents);
+
     const T* start = lhs.get_pointer();
 
     while (1)
     {
-        int c = lhs.peek();
-        int d = rhs.peek();
-        if (!c || !d)
-            break;
-
-        if (MODE > 0)
+        // Skip runs of matching ASCII characters in bulk.
+        if (s_ascii_runs)
         {
-            c = (c > 0xffff) ? c : int(uintptr_t(CharLowerW(LPWSTR(uintptr_t(c)))));
-            d = (d > 0xffff) ? d : int(uintptr_t(CharLowerW(LPWSTR(uintptr_t(d)))));
+            const T* l = lhs.get_pointer();
+            const T* r = rhs.get_pointer();
+            const T* l_end = lhs.get_end_pointer();
+            const T* r_end = rhs.get_end_pointer();
+            unsigned int limit = ~0u;
+            if (l_end) limit = min<unsigned int>(limit, (unsigned int)(l_end - l));
+            if (r_end) limit = min<unsigned int>(limit, (unsigned int)(r_end - r));
+            if (unsigned int n = str_compare_ascii_run<MODE>(l, r, limit))
+            {
+                lhs.advance_pointer(l + n);
+                rhs.advance_pointer(r + n);
+            }
         }
 
-        if (MODE > 1)
-        {
-            c = (c == '-') ? '_' : c;
-            d = (d == '-') ? '_' : d;
-        }
+        if (!lhs.more() || !rhs.more())
+            break;
 
-        if (c == '\\') c = '/';
-        if (d == '\\') d = '/';
+        // ASCII characters don't need to be decoded.
+        const T* l = lhs.get_pointer();
+        const T* r = rhs.get_pointer();
+        const bool ascii = ((unsigned int)*l < 0x80 && (unsigned int)*r < 0x80);
+        int c = ascii ? *l : lhs.peek();
+        int d = ascii ? *r : rhs.peek();
+        if (!c || !d)
+            break;
 
+        c = fold_char<MODE, fuzzy_accents>(c);
+        d = fold_char<MODE, fuzzy_accents>(d);
         if (c != d)
+            break;
+
+        if (ascii)
         {
-            if (!fuzzy_accents)
-                break;
-            c = normalize_accent(c);
-            d = normalize_accent(d);
-            if (c != d)
-                break;
+            lhs.advance_pointer(l + 1);
+            rhs.advance_pointer(r + 1);
+        }
+        else
+        {
+            lhs.next();
+            rhs.next();
         }
-
-        lhs.next();
-        rhs.next();
 
         // Advance past path separators (consider "\\\\" and "\" equal).
         assert((c == '/') == (d == '/'));
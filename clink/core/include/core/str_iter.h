@@ -15,7 +15,9 @@ public:
                     str_iter_impl(const str_iter_impl<T>& i);
     const T*        get_pointer() const;
     const T*        get_next_pointer();
+    const T*        get_end_pointer() const;
     void            reset_pointer(const T* ptr);
+    void            advance_pointer(const T* ptr);
     int             peek();
     int             next();
     bool            more() const;
@@ -63,6 +65,13 @@ template <typename T> const T* str_iter_impl<T>::get_next_pointer()
     return ret;
 };
 
+//------------------------------------------------------------------------------
+template <typename T> const T* str_iter_impl<T>::get_end_pointer() const
+{
+    // Returns nullptr when the iterator is only bounded by a NUL terminator.
+    return (m_ptr <= m_end) ? m_end : nullptr;
+}
+
 //------------------------------------------------------------------------------
 template <typename T> void str_iter_impl<T>::reset_pointer(const T* ptr)
 {
@@ -71,6 +80,14 @@ template <typename T> void str_iter_impl<T>::reset_pointer(const T* ptr)
     m_ptr = ptr;
 }
 
+//------------------------------------------------------------------------------
+template <typename T> void str_iter_impl<T>::advance_pointer(const T* ptr)
+{
+    assert(ptr >= m_ptr);
+    assert(m_ptr > m_end || ptr <= m_end);
+    m_ptr = ptr;
+}
+
 //------------------------------------------------------------------------------
 template <typename T> int str_iter_impl<T>::peek()
 {
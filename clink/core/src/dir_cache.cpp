@@ -0,0 +1,171 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "dir_cache.h"
+#include "log.h"
+#include "path.h"
+
+#include <map>
+#include <string>
+#include <wctype.h>
+
+namespace dir_cache
+{
+
+//------------------------------------------------------------------------------
+struct record
+{
+    std::shared_ptr<const listing> files;
+    unsigned long long  write_time;
+    DWORD               tick;
+};
+
+//------------------------------------------------------------------------------
+static bool s_active = false;
+static unsigned int s_ttl = 0;
+static unsigned int s_hits = 0;
+static unsigned int s_misses = 0;
+static std::map<std::wstring, record> s_records;
+
+//------------------------------------------------------------------------------
+static unsigned long long to_ull(const FILETIME& ft)
+{
+    return (unsigned long long)ft.dwHighDateTime << 32 | ft.dwLowDateTime;
+}
+
+//------------------------------------------------------------------------------
+static unsigned long long get_write_time(const wchar_t* dir)
+{
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExW(dir, GetFileExInfoStandard, &data))
+        return 0;
+    return to_ull(data.ftLastWriteTime);
+}
+
+//------------------------------------------------------------------------------
+static std::shared_ptr<const listing> enumerate(const wchar_t* dir)
+{
+    wstr<280> pattern;
+    pattern << dir;
+    if (pattern.length() && !path::is_separator(pattern[pattern.length() - 1]))
+        pattern << L"\\";
+    pattern << L"*";
+
+    WIN32_FIND_DATAW fd;
+    HANDLE h = FindFirstFileExW(pattern.c_str(), FindExInfoBasic, &fd, FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+    if (h == INVALID_HANDLE_VALUE)
+        return nullptr;
+
+    auto files = std::make_shared<listing>();
+    do
+    {
+        entry e;
+        e.name = fd.cFileName;
+        e.attr = fd.dwFileAttributes;
+        e.size = (unsigned long long)fd.nFileSizeHigh << 32 | fd.nFileSizeLow;
+        e.write_time = to_ull(fd.ftLastWriteTime);
+        files->emplace_back(std::move(e));
+    }
+    while (FindNextFileW(h, &fd));
+
+    FindClose(h);
+    return files;
+}
+
+
+
+//------------------------------------------------------------------------------
+void begin_session(unsigned int ttl)
+{
+    s_records.clear();
+    s_active = (ttl > 0);
+    s_ttl = ttl;
+    s_hits = 0;
+    s_misses = 0;
+}
+
+//------------------------------------------------------------------------------
+void end_session()
+{
+    if (s_hits || s_misses)
+        LOG("Directory cache:  %u hits, %u misses", s_hits, s_misses);
+
+    s_records.clear();
+    s_active = false;
+    s_hits = 0;
+    s_misses = 0;
+}
+
+//------------------------------------------------------------------------------
+bool is_active()
+{
+    return s_active;
+}
+
+//------------------------------------------------------------------------------
+std::shared_ptr<const listing> get(const wchar_t* dir)
+{
+    if (!s_active)
+        return nullptr;
+
+    // Key the cache by the full path, so different spellings of the same
+    // directory (and the cwd) share a listing.
+    wstr<280> full;
+    DWORD len = GetFullPathNameW(*dir ? dir : L".", full.size(), full.data(), nullptr);
+    if (!len || len >= full.size())
+        return nullptr;
+
+    std::wstring key(full.c_str(), len);
+    while (key.length() > 3 && path::is_separator(key.back()))
+        key.pop_back();
+    for (auto& c : key)
+        c = towlower(c);
+
+    const DWORD now = GetTickCount();
+    auto iter = s_records.find(key);
+    if (iter != s_records.end())
+    {
+        record& r = iter->second;
+        if (now - r.tick < s_ttl)
+        {
+            ++s_hits;
+            return r.files;
+        }
+
+        // Past the TTL the listing is still good if the directory hasn't
+        // changed, which only costs one attribute query.
+        unsigned long long write_time = get_write_time(full.c_str());
+        if (write_time && write_time == r.write_time)
+        {
+            r.tick = now;
+            ++s_hits;
+            return r.files;
+        }
+
+        s_records.erase(iter);
+    }
+
+    ++s_misses;
+
+    // Get the write time before enumerating, so a change made during the
+    // enumeration invalidates the listing.
+    record r;
+    r.write_time = get_write_time(full.c_str());
+    r.tick = now;
+    r.files = enumerate(full.c_str());
+    if (!r.files)
+        return nullptr;
+
+    s_records.emplace(std::move(key), r);
+    return r.files;
+}
+
+//------------------------------------------------------------------------------
+void get_counters(unsigned int& hits, unsigned int& misses)
+{
+    hits = s_hits;
+    misses = s_misses;
+}
+
+}; // namespace dir_cache
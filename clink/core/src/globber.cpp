@@ -8,10 +8,86 @@
 #include "str.h"
 
 #include <sys/stat.h>
+#include <wctype.h>
+
+//------------------------------------------------------------------------------
+static bool is_cacheable_mask(const wchar_t* mask)
+{
+    // Only simple `*` and `?` masks are evaluated against cached listings.
+    // DOS wildcards, trailing dots, and `~` (which can match 8.3 short names)
+    // need FindFirstFileW's own semantics.
+    if (!*mask)
+        return false;
+
+    for (const wchar_t* p = mask; *p; ++p)
+    {
+        switch (*p)
+        {
+        case '<':
+        case '>':
+        case '"':
+        case '~':
+            return false;
+        }
+    }
+
+    return mask[wcslen(mask) - 1] != '.';
+}
+
+//------------------------------------------------------------------------------
+static bool match_mask(const wchar_t* mask, const wchar_t* name)
+{
+    const wchar_t* star = nullptr;
+    const wchar_t* resume = nullptr;
+
+    while (*name)
+    {
+        if (*mask == '*')
+        {
+            star = ++mask;
+            resume = name;
+        }
+        else if (*mask == '?' || (*mask && towlower(*mask) == towlower(*name)))
+        {
+            ++mask;
+            ++name;
+        }
+        else if (star)
+        {
+            mask = star;
+            name = ++resume;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    while (*mask == '*')
+        ++mask;
+
+    // Like FindFirstFile, a trailing ".*" also matches a name with no
+    // extension (e.g. "foo.*" matches "foo").
+    if (*mask == '.')
+    {
+        ++mask;
+        while (*mask == '*')
+            ++mask;
+    }
+
+    return !*mask;
+}
+
+
+
 
 //------------------------------------------------------------------------------
 globber::globber(const char* pattern)
-: m_files(true)
+: m_handle(nullptr)
+, m_index(0)
+, m_started(false)
+, m_cached(false)
+, m_files(true)
 , m_directories(true)
 , m_dir_suffix(true)
 , m_hidden(false)
@@ -27,7 +103,7 @@ globber::globber(const char* pattern)
     // both a server and share component.
     if (path::is_incomplete_unc(pattern))
     {
-        m_handle = nullptr;
+        m_started = true;
         return;
     }
 
@@ -62,10 +138,9 @@ globber::globber(const char* pattern)
         }
     }
 
-    wstr<280> wglob(pattern);
-    m_handle = FindFirstFileW(wglob.c_str(), &m_data);
-    if (m_handle == INVALID_HANDLE_VALUE)
-        m_handle = nullptr;
+    // Enumeration starts on the first call to next(), after the options
+    // have been set.
+    m_pattern = pattern;
 
     path::get_directory(pattern, m_root);
     path::normalise_separators(m_root.data());
@@ -88,6 +163,8 @@ bool globber::older_than(int seconds)
         if (m_handle != nullptr)
             FindClose(m_handle);
         m_handle = nullptr;
+        m_listing.reset();
+        m_started = true;
         return false;
     }
 
@@ -105,25 +182,23 @@ bool globber::older_than(int seconds)
 }
 
 //------------------------------------------------------------------------------
-bool globber::next(str_base& out, bool rooted, int* st_mode, int* pattr)
+bool globber::next(str_base& out, bool rooted, int* st_mode, int* pattr, unsigned long long* psize, unsigned long long* pwrite_time)
 {
-    if (m_handle == nullptr)
-        return false;
-
     str<280> file_name;
     int attr;
+    unsigned long long size;
+    FILETIME write_time;
 
     while (true)
     {
-        if (m_handle == nullptr)
+        const wchar_t* c;
+        if (!get_file(c, attr, size, write_time))
             return false;
 
-        file_name = m_data.cFileName;
-        attr = m_data.dwFileAttributes;
+        file_name = c;
 
         bool again = false;
 
-        const wchar_t* c = m_data.cFileName;
         again |= (c[0] == '.' && (!c[1] || (c[1] == '.' && !c[2])) && !m_dots);
 
         again |= (attr & FILE_ATTRIBUTE_SYSTEM) && !m_system;
@@ -132,7 +207,7 @@ bool globber::next(str_base& out, bool rooted, int* st_mode, int* pattr)
         again |= !(attr & FILE_ATTRIBUTE_DIRECTORY) && !m_files;
 
         if (m_onlyolder)
-            again |= !(CompareFileTime(&m_data.ftLastWriteTime, &m_olderthan) < 0);
+            again |= !(CompareFileTime(&write_time, &m_olderthan) < 0);
 
         next_file();
 
@@ -166,12 +241,88 @@ bool globber::next(str_base& out, bool rooted, int* st_mode, int* pattr)
     if (pattr)
         *pattr = attr;
 
+    if (psize)
+        *psize = size;
+
+    if (pwrite_time)
+        *pwrite_time = (unsigned long long)write_time.dwHighDateTime << 32 | write_time.dwLowDateTime;
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void globber::start()
+{
+    m_started = true;
+
+    // Split the pattern into its directory and its name mask.
+    const wchar_t* name = m_pattern.c_str();
+    for (const wchar_t* p = name; *p; ++p)
+        if (path::is_separator(*p) || *p == ':')
+            name = p + 1;
+
+    if (m_cached && dir_cache::is_active() && is_cacheable_mask(name))
+    {
+        wstr<280> dir;
+        dir.concat(m_pattern.c_str(), int(name - m_pattern.c_str()));
+        m_listing = dir_cache::get(dir.c_str());
+        if (m_listing)
+        {
+            // `*.*` matches names without an extension too.
+            m_mask = (wcscmp(name, L"*.*") == 0) ? L"*" : name;
+            m_index = 0;
+            return;
+        }
+    }
+
+    m_handle = FindFirstFileW(m_pattern.c_str(), &m_data);
+    if (m_handle == INVALID_HANDLE_VALUE)
+        m_handle = nullptr;
+}
+
+//------------------------------------------------------------------------------
+bool globber::get_file(const wchar_t*& name, int& attr, unsigned long long& size, FILETIME& write_time)
+{
+    if (!m_started)
+        start();
+
+    if (m_listing)
+    {
+        for (; m_index < m_listing->size(); ++m_index)
+        {
+            const dir_cache::entry& e = (*m_listing)[m_index];
+            if (match_mask(m_mask.c_str(), e.name.c_str()))
+            {
+                name = e.name.c_str();
+                attr = e.attr;
+                size = e.size;
+                write_time.dwLowDateTime = DWORD(e.write_time);
+                write_time.dwHighDateTime = DWORD(e.write_time >> 32);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    if (m_handle == nullptr)
+        return false;
+
+    name = m_data.cFileName;
+    attr = m_data.dwFileAttributes;
+    size = (unsigned long long)m_data.nFileSizeHigh << 32 | m_data.nFileSizeLow;
+    write_time = m_data.ftLastWriteTime;
     return true;
 }
 
 //------------------------------------------------------------------------------
 void globber::next_file()
 {
+    if (m_listing)
+    {
+        ++m_index;
+        return;
+    }
+
     if (FindNextFileW(m_handle, &m_data))
         return;
 
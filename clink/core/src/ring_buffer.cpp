@@ -0,0 +1,63 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "ring_buffer.h"
+#include "base.h"
+
+#include <assert.h>
+
+//------------------------------------------------------------------------------
+bool ring_buffer::append(const char* data, unsigned int len)
+{
+    if (m_size + len > m_capacity)
+    {
+        unsigned int capacity = m_capacity ? m_capacity : 4096;
+        while (capacity < m_size + len)
+            capacity *= 2;
+
+        char* grown = static_cast<char*>(malloc(capacity));
+        if (!grown)
+            return false;
+
+        unsigned int size = m_size;
+        read(grown, size);
+        free(m_data);
+        m_data = grown;
+        m_capacity = capacity;
+        m_head = 0;
+        m_size = size;
+    }
+
+    unsigned int tail = (m_head + m_size) % m_capacity;
+    unsigned int first = min(len, m_capacity - tail);
+    memcpy(m_data + tail, data, first);
+    memcpy(m_data, data + first, len - first);
+    m_size += len;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+int ring_buffer::find(char c) const
+{
+    unsigned int first = min(m_size, m_capacity - m_head);
+    if (const char* p = static_cast<const char*>(memchr(m_data + m_head, c, first)))
+        return int(p - (m_data + m_head));
+    if (const char* p = static_cast<const char*>(memchr(m_data, c, m_size - first)))
+        return int(first + (p - m_data));
+    return -1;
+}
+
+//------------------------------------------------------------------------------
+void ring_buffer::read(char* out, unsigned int len)
+{
+    assert(len <= m_size);
+    if (!len)
+        return;
+
+    unsigned int first = min(len, m_capacity - m_head);
+    memcpy(out, m_data + m_head, first);
+    memcpy(out + first, m_data, len - first);
+    m_head = (m_head + len) % m_capacity;
+    m_size -= len;
+}
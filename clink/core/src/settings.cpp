@@ -4,12 +4,14 @@
 #include "pch.h"
 #include "settings.h"
 #include "str.h"
+#include "str_hash.h"
 #include "str_tokeniser.h"
 #include "path.h"
 
 #include <assert.h>
 #include <string>
 #include <map>
+#include <unordered_map>
 
 //------------------------------------------------------------------------------
 struct loaded_setting
@@ -21,9 +23,53 @@ struct loaded_setting
     bool            saved;
 };
 
+//------------------------------------------------------------------------------
+// Lookups by name use a hash index.  The setting_map is still kept because it
+// lists the settings in name order for iterating and saving.
+struct setting_name_hasher
+{
+    size_t operator()(const char* name) const
+    {
+        unsigned int hash = 5381;
+        while (unsigned char c = *(name++))
+            hash = ((hash << 5) + hash) ^ ((c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c);
+        return hash;
+    }
+};
+
+//------------------------------------------------------------------------------
+struct setting_name_comparator
+{
+    bool operator()(const char* a, const char* b) const
+    {
+        return stricmp(a, b) == 0;
+    }
+};
+
+//------------------------------------------------------------------------------
+typedef std::unordered_map<const char*, setting*, setting_name_hasher, setting_name_comparator> setting_index;
+typedef std::map<std::string, loaded_setting> loaded_settings;
+
+//------------------------------------------------------------------------------
+// Identifies the most recently loaded settings file, so that loading it again
+// can be skipped when neither the file nor any setting has changed since.
+struct loaded_file
+{
+    str_moveable        name;
+    unsigned long long  size = 0;
+    unsigned long long  time = 0;
+    unsigned int        hash = 0;
+    unsigned int        change_count = 0;
+    bool                valid = false;
+    std::map<std::string, std::string> applied;
+};
+
 //------------------------------------------------------------------------------
 static setting_map* g_setting_map = nullptr;
-static std::map<std::string, loaded_setting> g_loaded_settings;
+static setting_index* g_setting_index = nullptr;
+static loaded_settings g_loaded_settings;
+static loaded_file s_loaded_file;
+static unsigned int s_change_count = 0;
 
 #ifdef DEBUG
 static bool s_ever_loaded = false;
@@ -37,6 +83,27 @@ static auto& get_map()
     return *g_setting_map;
 }
 
+//------------------------------------------------------------------------------
+static auto& get_index()
+{
+    if (!g_setting_index)
+        g_setting_index = new setting_index;
+    return *g_setting_index;
+}
+
+//------------------------------------------------------------------------------
+static bool get_file_identity(const char* file, unsigned long long& size, unsigned long long& time)
+{
+    wstr<288> wfile(file);
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExW(wfile.c_str(), GetFileExInfoStandard, &data))
+        return false;
+
+    size = (unsigned long long)data.nFileSizeHigh << 32 | data.nFileSizeLow;
+    time = (unsigned long long)data.ftLastWriteTime.dwHighDateTime << 32 | data.ftLastWriteTime.dwLowDateTime;
+    return true;
+}
+
 
 
 //------------------------------------------------------------------------------
@@ -71,8 +138,8 @@ setting_iter first()
 //------------------------------------------------------------------------------
 setting* find(const char* name)
 {
-    auto i = get_map().find(name);
-    if (i != get_map().end())
+    auto i = get_index().find(name);
+    if (i != get_index().end())
         return i->second;
 
     size_t len = strlen(name);
@@ -87,21 +154,15 @@ setting* find(const char* name)
 }
 
 //------------------------------------------------------------------------------
-static bool set_setting(const char* name, const char* value, const char* comment=nullptr)
+static void add_loaded_setting(loaded_settings& out, std::vector<setting_name_value>& order, const char* name, const char* value, const char* comment=nullptr)
 {
-    // Find the setting.
-    setting* s = settings::find(name);
-
-    // Remember the original text from the file, so that saving won't lose
-    // them in case the scripts that declared them aren't loaded.
     loaded_setting loaded;
     if (comment)
         loaded.comment = comment;
     loaded.value = value;
-    g_loaded_settings.emplace(name, std::move(loaded));
+    out.emplace(name, std::move(loaded));
 
-    // Set its value.
-    return s && s->set(value);
+    order.emplace_back(name, value);
 }
 
 //------------------------------------------------------------------------------
@@ -229,7 +290,20 @@ bool load(const char* file)
     s_ever_loaded = true;
 #endif
 
-    g_loaded_settings.clear();
+    // Skip loading entirely when the file and the in-memory settings are both
+    // unchanged since the last load.  Any setting changed in memory (e.g. by a
+    // script) forces a full load, so that it reverts to the file's value.
+    unsigned long long file_size = 0;
+    unsigned long long file_time = 0;
+    const bool have_identity = get_file_identity(file, file_size, file_time);
+    const bool same_file = (have_identity &&
+                            s_loaded_file.valid &&
+                            s_loaded_file.change_count == s_change_count &&
+                            s_loaded_file.name.iequals(file));
+    if (same_file && s_loaded_file.size == file_size && s_loaded_file.time == file_time)
+        return true;
+
+    s_loaded_file.valid = false;
 
     // Maybe migrate settings.
     str<> old_file;
@@ -245,7 +319,10 @@ bool load(const char* file)
         path::append(old_file, "settings");
         in = fopen(old_file.c_str(), "rb");
         if (in == nullptr)
+        {
+            g_loaded_settings.clear();
             return false;
+        }
         migrating = true;
     }
 
@@ -257,6 +334,7 @@ bool load(const char* file)
     if (size == 0)
     {
         fclose(in);
+        g_loaded_settings.clear();
         return false;
     }
 
@@ -268,11 +346,20 @@ bool load(const char* file)
     fclose(in);
     data[size] = '\0';
 
-    // Reset settings to default.
-    for (auto iter = settings::first(); auto* next = iter.next();)
-        next->set();
+    // The file was touched but its content is the same, so there's nothing
+    // to apply.
+    const unsigned int hash = str_hash(data, size);
+    if (same_file && s_loaded_file.hash == hash)
+    {
+        s_loaded_file.size = file_size;
+        s_loaded_file.time = file_time;
+        s_loaded_file.valid = true;
+        return true;
+    }
 
     // Split at new lines.
+    loaded_settings loaded;
+    std::vector<setting_name_value> values;
     bool was_comment = false;
     str<> comment;
     str<256> line;
@@ -322,20 +409,73 @@ bool load(const char* file)
             if (migrate_setting(line_data, value, migrated_settings))
             {
                 for (const auto& pair : migrated_settings)
-                    set_setting(pair.name.c_str(), pair.value.c_str());
+                    add_loaded_setting(loaded, values, pair.name.c_str(), pair.value.c_str());
             }
             continue;
         }
 
-        // Find the setting and set its value.
-        set_setting(line_data, value, comment.c_str());
+        add_loaded_setting(loaded, values, line_data, value, comment.c_str());
     }
 
+    // The last occurrence of a setting in the file wins.
+    std::map<std::string, std::string> applied;
+    for (const auto& pair : values)
+        applied[pair.name.c_str()] = pair.value.c_str();
+
+    if (same_file)
+    {
+        // Only apply the settings whose values changed.  Settings that were
+        // removed from the file revert to their defaults.
+        for (const auto& old : s_loaded_file.applied)
+        {
+            if (applied.find(old.first) == applied.end())
+                if (setting* s = settings::find(old.first.c_str()))
+                    s->set();
+        }
+
+        for (const auto& pair : applied)
+        {
+            auto old = s_loaded_file.applied.find(pair.first);
+            if (old != s_loaded_file.applied.end() && old->second == pair.second)
+                continue;
+            if (setting* s = settings::find(pair.first.c_str()))
+                if (!s->set(pair.second.c_str()))
+                    s->set();
+        }
+    }
+    else
+    {
+        // Reset settings to default.
+        for (auto iter = settings::first(); auto* next = iter.next();)
+            next->set();
+
+        // Find each setting and set its value.
+        for (const auto& pair : values)
+            if (setting* s = settings::find(pair.name.c_str()))
+                s->set(pair.value.c_str());
+    }
+
+    // Remember the original text from the file, so that saving won't lose
+    // them in case the scripts that declared them aren't loaded.
+    g_loaded_settings = std::move(loaded);
+
     // When migrating, ensure the new settings file is created so that the old
     // settings file can be deleted.  Some users or distributions may naturally
     // clean up the old settings file, so don't rely on it staying around.
     if (migrating)
+    {
         save_internal(file, migrating);
+    }
+    else
+    {
+        s_loaded_file.name = file;
+        s_loaded_file.size = file_size;
+        s_loaded_file.time = file_time;
+        s_loaded_file.hash = hash;
+        s_loaded_file.applied = std::move(applied);
+        s_loaded_file.valid = have_identity;
+        s_loaded_file.change_count = s_change_count;
+    }
 
     return true;
 }
@@ -452,6 +592,8 @@ setting::setting(
     assert(!settings::find(m_name.c_str()));
 
     get_map()[m_name.c_str()] = this;
+    get_index()[m_name.c_str()] = this;
+    note_changed();
 }
 
 //------------------------------------------------------------------------------
@@ -460,7 +602,10 @@ setting::~setting()
     auto i = settings::find(m_name.c_str());
 
     if (i && i == this)
+    {
         get_map().erase(m_name.c_str());
+        get_index().erase(m_name.c_str());
+    }
 }
 
 //------------------------------------------------------------------------------
@@ -496,27 +641,37 @@ const char* setting::get_loaded_value(const char* name)
     return loaded->second.value.c_str();
 }
 
+//------------------------------------------------------------------------------
+void setting::note_changed()
+{
+    s_change_count++;
+}
+
 
 
 //------------------------------------------------------------------------------
 template <> bool setting_impl<bool>::set(const char* value)
 {
-    if (stricmp(value, "true") == 0)  { m_store.value = 1; return true; }
-    if (stricmp(value, "false") == 0) { m_store.value = 0; return true; }
+    int parsed;
 
-    if (stricmp(value, "on") == 0)    { m_store.value = 1; return true; }
-    if (stricmp(value, "off") == 0)   { m_store.value = 0; return true; }
+    if (stricmp(value, "true") == 0)        parsed = 1;
+    else if (stricmp(value, "false") == 0)  parsed = 0;
 
-    if (stricmp(value, "yes") == 0)   { m_store.value = 1; return true; }
-    if (stricmp(value, "no") == 0)    { m_store.value = 0; return true; }
+    else if (stricmp(value, "on") == 0)     parsed = 1;
+    else if (stricmp(value, "off") == 0)    parsed = 0;
 
-    if (*value >= '0' && *value <= '9')
-    {
-        m_store.value = !!atoi(value);
-        return true;
-    }
+    else if (stricmp(value, "yes") == 0)    parsed = 1;
+    else if (stricmp(value, "no") == 0)     parsed = 0;
 
-    return false;
+    else if (*value >= '0' && *value <= '9')
+        parsed = !!atoi(value);
+
+    else
+        return false;
+
+    m_store.value = parsed;
+    note_changed();
+    return true;
 }
 
 //------------------------------------------------------------------------------
@@ -526,6 +681,7 @@ template <> bool setting_impl<int>::set(const char* value)
         return false;
 
     m_store.value = atoi(value);
+    note_changed();
     return true;
 }
 
@@ -533,6 +689,7 @@ template <> bool setting_impl<int>::set(const char* value)
 template <> bool setting_impl<const char*>::set(const char* value)
 {
     m_store.value = value;
+    note_changed();
     return true;
 }
 
@@ -609,6 +766,7 @@ bool setting_enum::set(const char* value)
             (by_int < 0 && _strnicmp(option, value, option_len) == 0))
         {
             m_store.value = i;
+            note_changed();
             return true;
         }
 
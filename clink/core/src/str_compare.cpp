@@ -4,6 +4,8 @@
 #include "pch.h"
 #include "str_compare.h"
 
+#include <memory>
+
 threadlocal int str_compare_scope::ts_mode = str_compare_scope::exact;
 threadlocal bool str_compare_scope::ts_fuzzy_accents = false;
 
@@ -395,3 +397,92 @@ int normalize_accent(int c)
 
     return c;
 }
+
+
+//------------------------------------------------------------------------------
+struct fold_table
+{
+                                fold_table(int mode, bool fuzzy_accents);
+    std::unique_ptr<wchar_t[]>  map;
+    bool                        simple_ascii;   // ASCII folds the same as in str_compare_ascii_run.
+};
+
+//------------------------------------------------------------------------------
+static int simple_ascii_fold(int c, int mode)
+{
+    if (mode > 0 && c >= 'A' && c <= 'Z')
+        return c + ('a' - 'A');
+    if (mode > 1 && c == '-')
+        return '_';
+    if (c == '\\')
+        return '/';
+    return c;
+}
+
+//------------------------------------------------------------------------------
+fold_table::fold_table(int mode, bool fuzzy_accents)
+: map(new wchar_t[0x10000])
+{
+    for (int c = 0; c < 0x10000; ++c)
+        map[c] = wchar_t(c);
+
+    // Lowercase everything except the surrogate range in two calls, rather
+    // than calling CharLowerW per code point.
+    if (mode > 0)
+    {
+        CharLowerBuffW(map.get(), 0xd800);
+        CharLowerBuffW(map.get() + 0xe000, 0x10000 - 0xe000);
+    }
+
+    if (mode > 1)
+        map['-'] = '_';
+    map['\\'] = '/';
+
+    if (fuzzy_accents)
+    {
+        for (int c = 0; c < 0x10000; ++c)
+            map[c] = wchar_t(normalize_accent(map[c]));
+    }
+
+    simple_ascii = true;
+    for (int c = 0; c < 0x80; ++c)
+        if (map[c] != simple_ascii_fold(c, mode))
+            simple_ascii = false;
+}
+
+//------------------------------------------------------------------------------
+template <int MODE, bool fuzzy_accents>
+static const fold_table& get_fold_table_impl()
+{
+    static const fold_table s_table(MODE, fuzzy_accents);
+    return s_table;
+}
+
+//------------------------------------------------------------------------------
+static const fold_table& get_fold_table_impl(int mode, bool fuzzy_accents)
+{
+    switch (mode)
+    {
+    case str_compare_scope::relaxed:
+        if (fuzzy_accents)  return get_fold_table_impl<2, true>();
+        else                return get_fold_table_impl<2, false>();
+    case str_compare_scope::caseless:
+        if (fuzzy_accents)  return get_fold_table_impl<1, true>();
+        else                return get_fold_table_impl<1, false>();
+    default:
+        if (fuzzy_accents)  return get_fold_table_impl<0, true>();
+        else                return get_fold_table_impl<0, false>();
+    }
+}
+
+//------------------------------------------------------------------------------
+const wchar_t* get_fold_table(int mode, bool fuzzy_accents)
+{
+    return get_fold_table_impl(mode, fuzzy_accents).map.get();
+}
+
+//------------------------------------------------------------------------------
+bool is_simple_ascii_fold(int mode, bool fuzzy_accents)
+{
+    return get_fold_table_impl(mode, fuzzy_accents).simple_ascii;
+}
@@ -9,6 +9,85 @@
 #include <assert.h>
 #endif
 
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define USE_SSE2_UTF_CONVERSION
+#include <emmintrin.h>
+#endif
+
+//------------------------------------------------------------------------------
+// Copies the run of ASCII characters at the start of `in` to `out` (if not
+// null), stopping at the first non-ASCII or NUL character or after `limit`
+// characters.  Returns the number of characters copied.
+//
+// The vector path only uses 16 byte aligned loads, which cannot cross a page
+// boundary, so it is safe even when `in` is only bounded by a NUL terminator.
+static unsigned int copy_ascii(wchar_t* out, const char* in, unsigned int limit)
+{
+    unsigned int n = 0;
+    while (n < limit)
+    {
+#ifdef USE_SSE2_UTF_CONVERSION
+        if (!(uintptr_t(in + n) & 15) && limit - n >= 16)
+        {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i bytes = _mm_load_si128(reinterpret_cast<const __m128i*>(in + n));
+            if (!_mm_movemask_epi8(_mm_or_si128(bytes, _mm_cmpeq_epi8(bytes, zero))))
+            {
+                if (out)
+                {
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + n), _mm_unpacklo_epi8(bytes, zero));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + n + 8), _mm_unpackhi_epi8(bytes, zero));
+                }
+                n += 16;
+                continue;
+            }
+        }
+#endif
+
+        const unsigned char c = in[n];
+        if (!c || c >= 0x80)
+            break;
+        if (out)
+            out[n] = c;
+        ++n;
+    }
+    return n;
+}
+
+//------------------------------------------------------------------------------
+static unsigned int copy_ascii(char* out, const wchar_t* in, unsigned int limit)
+{
+    unsigned int n = 0;
+    while (n < limit)
+    {
+#ifdef USE_SSE2_UTF_CONVERSION
+        if (!(uintptr_t(in + n) & 15) && limit - n >= 16)
+        {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i lo = _mm_load_si128(reinterpret_cast<const __m128i*>(in + n));
+            const __m128i hi = _mm_load_si128(reinterpret_cast<const __m128i*>(in + n + 8));
+            const __m128i non_ascii = _mm_and_si128(_mm_or_si128(lo, hi), _mm_set1_epi16(short(0xff80)));
+            const __m128i nul = _mm_or_si128(_mm_cmpeq_epi16(lo, zero), _mm_cmpeq_epi16(hi, zero));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi16(non_ascii, zero)) == 0xffff && !_mm_movemask_epi8(nul))
+            {
+                if (out)
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + n), _mm_packus_epi16(lo, hi));
+                n += 16;
+                continue;
+            }
+        }
+#endif
+
+        const wchar_t c = in[n];
+        if (!c || c >= 0x80)
+            break;
+        if (out)
+            out[n] = char(c);
+        ++n;
+    }
+    return n;
+}
+
 //------------------------------------------------------------------------------
 template <typename TYPE>
 struct builder
@@ -18,6 +97,8 @@ struct builder
     bool        truncated() const                     { return (start && write >= end); }
     int         get_written() const                   { return int(write - start); }
     builder&    operator << (int value);
+    template <typename FROM>
+    void        append_ascii(str_iter_impl<FROM>& iter);
     TYPE*       write;
     const TYPE* start;
     const TYPE* end;
@@ -60,6 +141,22 @@ builder<char>& builder<char>::operator << (int value)
     return *this;
 }
 
+//------------------------------------------------------------------------------
+template <typename TYPE>
+template <typename FROM>
+void builder<TYPE>::append_ascii(str_iter_impl<FROM>& iter)
+{
+    unsigned int limit = start ? (unsigned int)(end - write) : ~0u;
+
+    const FROM* in = iter.get_pointer();
+    if (const FROM* in_end = iter.get_end_pointer())
+        limit = min<unsigned int>(limit, (unsigned int)(in_end - in));
+
+    const unsigned int n = copy_ascii(start ? write : nullptr, in, limit);
+    write += n;
+    iter.advance_pointer(in + n);
+}
+
 
 
 //------------------------------------------------------------------------------
@@ -98,8 +195,13 @@ int to_utf8(char* out, int max_count, wstr_iter& iter)
     builder<char> builder(out, max_count);
 
     int c;
-    while (!builder.truncated() && (c = iter.next()))
+    while (!builder.truncated())
     {
+        // Copy runs of ASCII characters in bulk.
+        builder.append_ascii(iter);
+        if (builder.truncated() || !(c = iter.next()))
+            break;
+
         if (c < 0x80)
         {
             builder << c;
@@ -199,8 +301,15 @@ int to_utf16(wchar_t* out, int max_count, str_iter& iter)
     builder<wchar_t> builder(out, max_count);
 
     int c;
-    while (!builder.truncated() && (c = iter.next()))
+    while (!builder.truncated())
+    {
+        // Copy runs of ASCII characters in bulk.
+        builder.append_ascii(iter);
+        if (builder.truncated() || !(c = iter.next()))
+            break;
+
         builder << c;
+    }
 
     return builder.get_written();
 }
@@ -0,0 +1,107 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "fs_fixture.h"
+
+#include <core/dir_cache.h>
+#include <core/globber.h>
+#include <core/str.h>
+
+#include <vector>
+
+//------------------------------------------------------------------------------
+static void glob(const char* pattern, bool cached, std::vector<str_moveable>& out)
+{
+    out.clear();
+
+    globber globber(pattern);
+    globber.hidden(true);
+    globber.cached(cached);
+
+    str<> file;
+    while (globber.next(file, false))
+        out.emplace_back(file.c_str());
+}
+
+//------------------------------------------------------------------------------
+static void verify_same(const char* pattern)
+{
+    std::vector<str_moveable> direct;
+    std::vector<str_moveable> cached;
+    glob(pattern, false, direct);
+    glob(pattern, true, cached);
+
+    REQUIRE(direct.size() == cached.size(), [&] () {
+        printf("pattern '%s':  %u direct, %u cached\n", pattern, unsigned(direct.size()), unsigned(cached.size()));
+    });
+    for (size_t i = 0; i < direct.size(); ++i)
+        REQUIRE(direct[i].equals(cached[i].c_str()));
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("Directory cache")
+{
+    fs_fixture fs;
+
+    SECTION("Inactive")
+    {
+        // A session with no TTL is inactive, and also resets the counters
+        // left over from any earlier session.
+        dir_cache::begin_session(0);
+        REQUIRE(!dir_cache::is_active());
+        verify_same("*");
+
+        unsigned int hits, misses;
+        dir_cache::get_counters(hits, misses);
+        REQUIRE(hits == 0);
+        REQUIRE(misses == 0);
+    }
+
+    SECTION("Patterns")
+    {
+        dir_cache::begin_session(60 * 1000);
+
+        verify_same("*");
+        verify_same("*.*");
+        verify_same("file1.*");
+        verify_same("file*.*");
+        verify_same("file*");
+        verify_same("FILE?");
+        verify_same("case_map*2");
+        verify_same("dir1");
+        verify_same("dir1\\*");
+        verify_same("dir1\\f*1");
+        verify_same("nothing*");
+
+        unsigned int hits, misses;
+        dir_cache::get_counters(hits, misses);
+        REQUIRE(misses == 2);
+        REQUIRE(hits == 9);
+
+        dir_cache::end_session();
+    }
+
+    SECTION("Shared listing")
+    {
+        dir_cache::begin_session(60 * 1000);
+
+        std::vector<str_moveable> files;
+        glob("file*", true, files);
+        REQUIRE(files.size() == 2);
+
+        // Within the TTL the listing is reused without checking the directory.
+        if (FILE* f = fopen("file3", "wt"))
+            fclose(f);
+        glob("file*", true, files);
+        REQUIRE(files.size() == 2);
+
+        // A new session enumerates again.
+        dir_cache::end_session();
+        dir_cache::begin_session(60 * 1000);
+        glob("file*", true, files);
+        REQUIRE(files.size() == 3);
+
+        dir_cache::end_session();
+    }
+}
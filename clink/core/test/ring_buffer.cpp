@@ -0,0 +1,100 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include <core/ring_buffer.h>
+#include <core/str.h>
+
+//------------------------------------------------------------------------------
+static void read_str(ring_buffer& ring, unsigned int len, str_base& out)
+{
+    str<> tmp;
+    tmp.reserve(len + 1);
+    ring.read(tmp.data(), len);
+    tmp.data()[len] = '\0';
+    out = tmp.c_str();
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("Ring buffer")
+{
+    ring_buffer ring;
+    str<> out;
+
+    SECTION("Empty")
+    {
+        REQUIRE(ring.size() == 0);
+        REQUIRE(ring.find('\n') < 0);
+        read_str(ring, 0, out);
+        REQUIRE(out.empty());
+    }
+
+    SECTION("Append and read")
+    {
+        REQUIRE(ring.append("abc\ndef", 7));
+        REQUIRE(ring.size() == 7);
+        REQUIRE(ring.find('\n') == 3);
+        REQUIRE(ring.find('x') < 0);
+
+        read_str(ring, 4, out);
+        REQUIRE(out.equals("abc\n"));
+        REQUIRE(ring.size() == 3);
+        REQUIRE(ring.find('\n') < 0);
+
+        REQUIRE(ring.append("\n", 1));
+        REQUIRE(ring.find('\n') == 3);
+        read_str(ring, 4, out);
+        REQUIRE(out.equals("def\n"));
+        REQUIRE(ring.size() == 0);
+    }
+
+    SECTION("Wrap")
+    {
+        // Fill most of the initial capacity, consume it, then append across
+        // the end of the storage.
+        char chunk[1000];
+        memset(chunk, 'x', sizeof(chunk));
+        for (int i = 0; i < 4; ++i)
+            REQUIRE(ring.append(chunk, sizeof(chunk)));
+        for (int i = 0; i < 4; ++i)
+            read_str(ring, sizeof(chunk), out);
+        REQUIRE(ring.size() == 0);
+
+        REQUIRE(ring.append("0123456789\n0123456789", 21));
+        REQUIRE(ring.find('\n') == 10);
+        read_str(ring, 11, out);
+        REQUIRE(out.equals("0123456789\n"));
+        read_str(ring, 10, out);
+        REQUIRE(out.equals("0123456789"));
+    }
+
+    SECTION("Grow")
+    {
+        // Growing while the content wraps keeps it in order.
+        char chunk[3000];
+        memset(chunk, 'a', sizeof(chunk));
+        REQUIRE(ring.append(chunk, sizeof(chunk)));
+        read_str(ring, 2000, out);
+        memset(chunk, 'b', sizeof(chunk));
+        REQUIRE(ring.append(chunk, sizeof(chunk)));
+        REQUIRE(ring.append("\n", 1));
+        memset(chunk, 'c', sizeof(chunk));
+        for (int i = 0; i < 10; ++i)
+            REQUIRE(ring.append(chunk, sizeof(chunk)));
+
+        REQUIRE(ring.size() == 1000 + 3000 + 1 + 30000);
+        REQUIRE(ring.find('\n') == 4000);
+
+        read_str(ring, 1000, out);
+        REQUIRE(out.length() == 1000);
+        REQUIRE(out.c_str()[0] == 'a' && out.c_str()[999] == 'a');
+        read_str(ring, 3001, out);
+        REQUIRE(out.c_str()[0] == 'b' && out.c_str()[2999] == 'b' && out.c_str()[3000] == '\n');
+        REQUIRE(ring.find('\n') < 0);
+        read_str(ring, 30000, out);
+        REQUIRE(out.length() == 30000);
+        REQUIRE(out.c_str()[0] == 'c' && out.c_str()[29999] == 'c');
+        REQUIRE(ring.size() == 0);
+    }
+}
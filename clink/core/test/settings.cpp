@@ -2,9 +2,12 @@
 // License: http://opensource.org/licenses/MIT
 
 #include "pch.h"
+#include "fs_fixture.h"
 
 #include <core/base.h>
+#include <core/path.h>
 #include <core/settings.h>
+#include <core/str.h>
 
 //------------------------------------------------------------------------------
 TEST_CASE("settings : basic")
@@ -204,3 +207,139 @@ TEST_CASE("settings : color")
     test.get_descriptive(tmp);
     REQUIRE(tmp.equals("bright yellow"));
 }
+
+//------------------------------------------------------------------------------
+class counted_setting
+    : public setting_int
+{
+public:
+                    counted_setting(const char* name, int default_value) : setting_int(name, "", default_value) {}
+    virtual void    set() override { ++m_resets; setting_int::set(); }
+    virtual bool    set(const char* value) override { ++m_sets; return setting_int::set(value); }
+    void            reset_counts() { m_resets = m_sets = 0; }
+    int             m_resets = 0;
+    int             m_sets = 0;
+};
+
+//------------------------------------------------------------------------------
+static void write_file(const char* file, const char* content)
+{
+    FILE* out = fopen(file, "wb");
+    REQUIRE(out != nullptr);
+    fwrite(content, strlen(content), 1, out);
+    fclose(out);
+}
+
+//------------------------------------------------------------------------------
+static unsigned long long get_write_time(const char* file)
+{
+    wstr<> wfile(file);
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    REQUIRE(GetFileAttributesExW(wfile.c_str(), GetFileExInfoStandard, &data));
+    return (unsigned long long)data.ftLastWriteTime.dwHighDateTime << 32 | data.ftLastWriteTime.dwLowDateTime;
+}
+
+//------------------------------------------------------------------------------
+static void set_write_time(const char* file, unsigned long long time)
+{
+    wstr<> wfile(file);
+    HANDLE h = CreateFileW(wfile.c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ|FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, 0, nullptr);
+    REQUIRE(h != INVALID_HANDLE_VALUE);
+
+    FILETIME ft;
+    ft.dwLowDateTime = DWORD(time);
+    ft.dwHighDateTime = DWORD(time >> 32);
+    REQUIRE(SetFileTime(h, nullptr, nullptr, &ft));
+    CloseHandle(h);
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("settings : load")
+{
+    fs_fixture fs;
+
+    str<> file(fs.get_root());
+    path::append(file, "test_settings");
+
+    counted_setting one("test_load.one", 1);
+    counted_setting two("test_load.two", 2);
+
+    write_file(file.c_str(), "test_load.one = 10\ntest_load.two = 20\n");
+    REQUIRE(settings::load(file.c_str()));
+    REQUIRE(one.get() == 10);
+    REQUIRE(two.get() == 20);
+
+    const unsigned long long time = get_write_time(file.c_str());
+    one.reset_counts();
+    two.reset_counts();
+
+    SECTION("Unchanged")
+    {
+        // The size and time are the same, so the file isn't even read.
+        write_file(file.c_str(), "test_load.one = 11\ntest_load.two = 20\n");
+        set_write_time(file.c_str(), time);
+
+        REQUIRE(settings::load(file.c_str()));
+        REQUIRE(one.get() == 10);
+        REQUIRE(one.m_sets + one.m_resets + two.m_sets + two.m_resets == 0);
+    }
+
+    SECTION("Touched")
+    {
+        // The content is the same, so nothing is applied.
+        set_write_time(file.c_str(), time + 10000000);
+
+        REQUIRE(settings::load(file.c_str()));
+        REQUIRE(one.get() == 10);
+        REQUIRE(one.m_sets + one.m_resets + two.m_sets + two.m_resets == 0);
+    }
+
+    SECTION("Time changed")
+    {
+        write_file(file.c_str(), "test_load.one = 11\ntest_load.two = 20\n");
+        set_write_time(file.c_str(), time + 10000000);
+
+        REQUIRE(settings::load(file.c_str()));
+        REQUIRE(one.get() == 11);
+        REQUIRE(two.get() == 20);
+        REQUIRE(one.m_sets == 1);
+        REQUIRE(one.m_resets + two.m_sets + two.m_resets == 0);
+    }
+
+    SECTION("Size changed")
+    {
+        write_file(file.c_str(), "test_load.one = 10\ntest_load.two = 200\n");
+        set_write_time(file.c_str(), time);
+
+        REQUIRE(settings::load(file.c_str()));
+        REQUIRE(one.get() == 10);
+        REQUIRE(two.get() == 200);
+        REQUIRE(two.m_sets == 1);
+        REQUIRE(one.m_sets + one.m_resets + two.m_resets == 0);
+    }
+
+    SECTION("Removed")
+    {
+        write_file(file.c_str(), "test_load.two = 20\n");
+
+        REQUIRE(settings::load(file.c_str()));
+        REQUIRE(one.get() == 1);
+        REQUIRE(two.get() == 20);
+        REQUIRE(one.m_resets == 1);
+        REQUIRE(one.m_sets + two.m_sets + two.m_resets == 0);
+    }
+
+    SECTION("Changed in memory")
+    {
+        // A setting changed in memory reverts to the file's value, which
+        // needs a full load even though the file is unchanged.
+        REQUIRE(one.set("5"));
+        one.reset_counts();
+
+        REQUIRE(settings::load(file.c_str()));
+        REQUIRE(one.get() == 10);
+        REQUIRE(two.get() == 20);
+        REQUIRE(one.m_sets == 1);
+        REQUIRE(two.m_sets == 1);
+    }
+}
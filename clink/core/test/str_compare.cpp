@@ -118,4 +118,36 @@ TEST_CASE("String compare")
         REQUIRE(str_compare(L"abc123", L"abc123") == -1);
         REQUIRE(str_compare(L"\xd800\xdc00" L"abc", L"\xd800\xdc00") == 2);
     }
+
+    SECTION("Long strings")
+    {
+        // Long enough to compare ASCII in blocks.
+        const char* lower = "abcdefghijklmnopqrstuvwxyz_0123456789_abcdefghijklmnopqrstuvwxyz";
+        const char* upper = "ABCDEFGHIJKLMNOPQRSTUVWXYZ-0123456789-ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+        {
+            str_compare_scope _(str_compare_scope::exact, false);
+            REQUIRE(str_compare(lower, lower) == -1);
+            REQUIRE(str_compare(lower, upper) == 0);
+            REQUIRE(str_compare("abcdefghijklmnopqrstuvwxyz_012", "abcdefghijklmnopqrstuvwxyz_0123456789") == 30);
+        }
+
+        {
+            str_compare_scope _(str_compare_scope::caseless, false);
+            REQUIRE(str_compare(lower, upper) == 26);
+            REQUIRE(str_compare("abcdefghijklmnopqrstuvwxyz_0123456789_@", "ABCDEFGHIJKLMNOPQRSTUVWXYZ_0123456789_`") == 38);
+        }
+
+        {
+            str_compare_scope _(str_compare_scope::relaxed, false);
+            REQUIRE(str_compare(lower, upper) == -1);
+            REQUIRE(str_compare("abcdefghijklmnopqrstuvwxyz[", "ABCDEFGHIJKLMNOPQRSTUVWXYZ{") == 26);
+        }
+
+        {
+            str_compare_scope _(str_compare_scope::relaxed, true);
+            REQUIRE(str_compare("abcdefghijklmnopqrstuvwxyz\\\\abcdefghijklmnop\xc3\xa9",
+                                "ABCDEFGHIJKLMNOPQRSTUVWXYZ/ABCDEFGHIJKLMNOPE") == -1);
+        }
+    }
 }
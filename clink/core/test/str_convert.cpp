@@ -168,3 +168,130 @@ TEST_CASE("Wide character/UTF-8 conversion")
         }
     }
 }
+
+//------------------------------------------------------------------------------
+TEST_CASE("Wide character/UTF-8 conversion fast path")
+{
+    // Mixes long runs of ASCII with multi-byte sequences and compares the
+    // results against the code point at a time decoding done by str_iter, at
+    // every alignment and for every buffer size.
+
+    unsigned int seed = 1;
+    auto rand = [&seed] () { seed = seed * 1103515245 + 12345; return (seed >> 8) & 0xffff; };
+
+    const char* const utf8_pieces[] = { "\xc2\x80", "\xdf\xbf", "\xe0\xa0\x80", "\xef\xbf\xbf", "\xf0\x90\x80\x80", "\xbf" };
+    const wchar_t* const utf16_pieces[] = { L"\x0080", L"\x07ff", L"\x0800", L"\xffff", L"\xd800\xdc00", L"\xdc00" };
+
+    for (int pass = 0; pass < 200; ++pass)
+    {
+        const int offset = pass % 16;
+        char in8[128] = {};
+        wchar_t in16[128] = {};
+        int len8 = offset;
+        int len16 = offset;
+        while (len8 < 96)
+        {
+            const unsigned int r = rand();
+            if (r % 4)
+            {
+                for (int run = r % 40; run-- && len8 < 96;)
+                {
+                    in8[len8++] = char(0x20 + (run % 0x5f));
+                    in16[len16++] = wchar_t(0x20 + (run % 0x5f));
+                }
+            }
+            else
+            {
+                for (const char* p = utf8_pieces[r % sizeof_array(utf8_pieces)]; *p;)
+                    in8[len8++] = *(p++);
+                for (const wchar_t* p = utf16_pieces[r % sizeof_array(utf16_pieces)]; *p;)
+                    in16[len16++] = *(p++);
+            }
+        }
+
+        const char* const s8 = in8 + offset;
+        const wchar_t* const s16 = in16 + offset;
+
+        // Reference results.
+        wchar_t expect16[256];
+        int expect16_len = 0;
+        {
+            str_iter iter(s8);
+            while (int c = iter.next())
+            {
+                if (c > 0xffff)
+                {
+                    expect16[expect16_len++] = wchar_t((c >> 10) + 0xd7c0);
+                    c = (c & 0x3ff) + 0xdc00;
+                }
+                expect16[expect16_len++] = wchar_t(c);
+            }
+        }
+
+        str<> expect8;
+        {
+            wstr_iter iter(s16);
+            while (int c = iter.next())
+            {
+                wchar_t one[3] = { wchar_t(c) };
+                if (c > 0xffff)
+                {
+                    one[0] = wchar_t((c >> 10) + 0xd7c0);
+                    one[1] = wchar_t((c & 0x3ff) + 0xdc00);
+                }
+                str<> tmp;
+                tmp.from_utf16(one);
+                expect8.concat(tmp.c_str(), tmp.length());
+            }
+        }
+
+        // Counting.
+        {
+            str_iter iter(s8);
+            REQUIRE(to_utf16(nullptr, 0, iter) == expect16_len);
+            wstr_iter witer(s16);
+            REQUIRE(to_utf8(nullptr, 0, witer) == expect8.length());
+        }
+
+        // Every buffer size, including truncation in the middle of a run.
+        for (int max_count = 1; max_count < 140; max_count += 1 + (pass % 5))
+        {
+            wchar_t out16[256];
+            str_iter iter(s8);
+            const int n16 = to_utf16(out16, max_count, iter);
+            REQUIRE(n16 == min(expect16_len, max_count - 1));
+            REQUIRE(memcmp(out16, expect16, n16 * sizeof(*out16)) == 0);
+            REQUIRE(out16[n16] == '\0');
+
+            char out8[256];
+            wstr_iter witer(s16);
+            const int n8 = to_utf8(out8, max_count, witer);
+            REQUIRE(n8 == min<int>(expect8.length(), max_count - 1));
+            REQUIRE(memcmp(out8, expect8.c_str(), n8) == 0);
+            REQUIRE(out8[n8] == '\0');
+        }
+
+        // Bounded iterators stop at their end, even inside a run.
+        {
+            const int bound = int(rand() % 64);
+            wstr<> bounded;
+            str_iter iter(s8, bound);
+            to_utf16(bounded, iter);
+            wstr<> expect;
+            str_iter ref(s8, bound);
+            while (int c = ref.next())
+            {
+                wchar_t one[3] = { wchar_t(c) };
+                if (c > 0xffff)
+                {
+                    one[0] = wchar_t((c >> 10) + 0xd7c0);
+                    one[1] = wchar_t((c & 0x3ff) + 0xdc00);
+                }
+                expect.concat(one, int(wcslen(one)));
+            }
+            REQUIRE(bounded.length() == expect.length());
+            REQUIRE(memcmp(bounded.c_str(), expect.c_str(), bounded.length() * sizeof(wchar_t)) == 0);
+            REQUIRE(iter.get_pointer() == ref.get_pointer());
+        }
+    }
+}
@@ -6,6 +6,8 @@
 #include <core/str_iter.h>
 #include <assert.h>
 
+#include <unordered_map>
+
 class str_base;
 
 //------------------------------------------------------------------------------
@@ -80,6 +82,29 @@ private:
 
 
 
+//------------------------------------------------------------------------------
+// File metadata captured while enumerating files, so that displaying a file
+// match never needs to query the file system again.  Whether a link's target
+// exists is recorded in the match_type (match_type::orphaned).
+struct match_file_info
+{
+    unsigned int            attr;           // FILE_ATTRIBUTE_* flags.
+    unsigned long long      size;           // Size in bytes.
+    unsigned long long      write_time;     // Last write time, as a FILETIME.
+};
+
+//------------------------------------------------------------------------------
+// Visible widths of a match, measured once when the match is added so that
+// laying out the match list never needs to decode the match text again.
+// Control characters count as two cells, the same as when displayed.
+struct match_width
+{
+    unsigned int            width;          // Cells for the whole match.
+    unsigned int            name_width;     // Cells for the part shown when displaying filenames.
+};
+
+
+
 //------------------------------------------------------------------------------
 class matches;
 
@@ -91,7 +116,10 @@ public:
                             ~matches_iter();
     bool                    next();
     const char*             get_match() const;
+    unsigned int            get_match_length() const;
     match_type              get_match_type() const;
+    const match_file_info*  get_match_file_info() const;
+    match_width             get_match_width() const;
     shadow_bool             is_filename_completion_desired() const;
     shadow_bool             is_filename_display_desired() const;
 
@@ -111,6 +139,7 @@ private:
 };
 
 //------------------------------------------------------------------------------
+class match_extras;
 struct match_display_filter_entry;
 
 //------------------------------------------------------------------------------
@@ -120,19 +149,26 @@ public:
     virtual matches_iter    get_iter(const char* pattern = nullptr) const = 0;
     virtual unsigned int    get_match_count() const = 0;
     virtual const char*     get_match(unsigned int index) const = 0;
+    virtual unsigned int    get_match_length(unsigned int index) const = 0;
     virtual match_type      get_match_type(unsigned int index) const = 0;
+    virtual const match_file_info* get_match_file_info(unsigned int index) const = 0;
+    virtual match_width     get_match_width(unsigned int index) const = 0;
     virtual bool            is_suppress_append() const = 0;
+    virtual bool            is_partial() const = 0;
     virtual shadow_bool     is_filename_completion_desired() const = 0;
     virtual shadow_bool     is_filename_display_desired() const = 0;
     virtual char            get_append_character() const = 0;
     virtual int             get_suppress_quoting() const = 0;
     virtual int             get_word_break_position() const = 0;
-    virtual bool            match_display_filter(char** matches, match_display_filter_entry*** filtered_matches, bool popup) const = 0;
+    virtual bool            match_display_filter(char** matches, const match_extras* extras, match_display_filter_entry*** filtered_matches, bool popup) const = 0;
 
 private:
     friend class matches_iter;
     virtual const char*     get_unfiltered_match(unsigned int index) const { return nullptr; }
+    virtual unsigned int    get_unfiltered_match_length(unsigned int index) const { return 0; }
     virtual match_type      get_unfiltered_match_type(unsigned int index) const { return match_type::none; }
+    virtual const match_file_info* get_unfiltered_match_file_info(unsigned int index) const { return nullptr; }
+    virtual match_width     get_unfiltered_match_width(unsigned int index) const { return match_width(); }
 };
 
 
@@ -142,11 +178,43 @@ match_type to_match_type(int mode, int attr, const char* path);
 match_type to_match_type(const char* type_name);
 void match_type_to_string(match_type type, str_base& out);
 
+//------------------------------------------------------------------------------
+// File metadata and visible widths for the match strings in a char** array
+// handed to Readline or to a match filter, keyed by the address of each
+// string.  Whoever allocates the strings owns the table, passes it along with
+// the array, and clears it when the strings are freed.
+class match_extras
+{
+public:
+    void                    clear() { m_extras.clear(); }
+    void                    reserve(unsigned int count) { m_extras.reserve(count); }
+    void                    add(const char* match, const match_file_info* file_info, match_width width);
+    const match_file_info*  get_file_info(const char* match) const;
+    bool                    get_width(const char* match, match_width& out) const;
+
+private:
+    struct extra
+    {
+        match_file_info     file_info;      // Zero attributes means no file info.
+        match_width         width;
+    };
+    std::unordered_map<const char*, extra> m_extras;
+};
+
 //------------------------------------------------------------------------------
 struct match_desc
 {
     const char*             match;          // Match text.
     match_type              type;           // Match type.
+    const match_file_info*  file_info;      // File metadata, if known.
+};
+
+//------------------------------------------------------------------------------
+struct match_add_rules
+{
+    match_type              type;           // Resolved match type.
+    int                     translate;      // Separator to translate to (0 is the system separator), or -1 for no translation.
+    bool                    append_sep;     // Append a trailing path separator.
 };
 
 //------------------------------------------------------------------------------
@@ -159,9 +227,28 @@ public:
     void                    set_append_character(char append);
     void                    set_suppress_append(bool suppress=true);
     void                    set_suppress_quoting(int suppress=1); //0=no, 1=yes, 2=suppress end quote
+    void                    set_partial(bool partial=true); // Matches are still being collected; list them but don't insert them.
 
     void                    set_matches_are_files(bool files=true);
 
+private:
+    friend class            match_batch;
+    matches&                m_matches;
+};
+
+//------------------------------------------------------------------------------
+class match_batch
+{
+    // Adds many matches of the same type.  The type and slash translation are
+    // resolved once for the whole batch instead of once per match, and matches
+    // are added from (pointer, length) pairs so they needn't be nul terminated.
+
+public:
+                            match_batch(match_builder& builder, match_type type, bool already_normalised=false);
+    bool                    add(const char* match, unsigned int len);
+    unsigned int            add_from_string(const char* text, unsigned int len, const char* separators, unsigned int* total=nullptr);
+
 private:
     matches&                m_matches;
+    match_add_rules         m_rules[2];     // Indexed by whether the match ends with a path separator.
 };
@@ -49,6 +49,7 @@ public:
     void            clear();
     void            init(size_t line_length);
     unsigned int    add_command(const line_state& line);
+    void            copy_command(const word_classifications& from, unsigned int index, unsigned int count, unsigned int start, unsigned int end, int delta);
     void            set_word_has_argmatcher(unsigned int index);
     void            finish(bool show_argmatchers);
 
@@ -0,0 +1,264 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "async_file_enum.h"
+
+#include <core/base.h>
+#include <core/globber.h>
+#include <core/os.h>
+#include <core/path.h>
+
+#include <process.h>
+#include <assert.h>
+
+//------------------------------------------------------------------------------
+static std::shared_ptr<async_file_enum> s_current;
+
+//------------------------------------------------------------------------------
+static const unsigned int c_batch_size = 64;
+
+//------------------------------------------------------------------------------
+static void* s_test_gate = nullptr;
+
+
+
+//------------------------------------------------------------------------------
+async_file_enum::async_file_enum(const char* pattern, bool hidden, bool system)
+: m_pattern(pattern)
+, m_hidden(hidden)
+, m_system(system)
+, m_gate(s_test_gate)
+{
+    InitializeCriticalSection(&m_lock);
+
+    // Construct the globber here rather than on the worker thread, since it
+    // reads the environment for drive relative paths.
+    m_globber = std::make_unique<globber>(pattern);
+    m_globber->hidden(hidden);
+    m_globber->system(system);
+}
+
+//------------------------------------------------------------------------------
+async_file_enum::~async_file_enum()
+{
+    if (m_thread_handle)
+        CloseHandle(m_thread_handle);
+    if (m_ready_event)
+        CloseHandle(m_ready_event);
+    DeleteCriticalSection(&m_lock);
+}
+
+//------------------------------------------------------------------------------
+std::shared_ptr<async_file_enum> async_file_enum::start(const char* pattern, bool hidden, bool system)
+{
+    if (s_current &&
+        s_current->m_hidden == hidden &&
+        s_current->m_system == system &&
+        s_current->m_pattern.iequals(pattern))
+        return s_current;
+
+    cancel_current();
+
+    std::shared_ptr<async_file_enum> e(new async_file_enum(pattern, hidden, system));
+    if (!e->create_thread())
+        return nullptr;
+
+    s_current = e;
+    return e;
+}
+
+//------------------------------------------------------------------------------
+std::shared_ptr<async_file_enum> async_file_enum::get_current()
+{
+    return s_current;
+}
+
+//------------------------------------------------------------------------------
+void async_file_enum::cancel_current()
+{
+    if (s_current)
+    {
+        s_current->cancel();
+        s_current = nullptr;
+    }
+}
+
+//------------------------------------------------------------------------------
+bool async_file_enum::is_slow_path(const char* path)
+{
+    // UNC paths and mapped network drives can take a long time to enumerate.
+    str<280> full;
+    if (!path::is_rooted(path))
+    {
+        os::get_current_dir(full);
+        path::append(full, path);
+        path = full.c_str();
+    }
+
+    if (path::is_separator(path[0]) && path::is_separator(path[1]))
+        return true;
+
+    if (!path[0] || path[1] != ':')
+        return false;
+
+    wchar_t root[4] = { wchar_t((unsigned char)path[0]), ':', '\\', 0 };
+    return GetDriveTypeW(root) == DRIVE_REMOTE;
+}
+
+//------------------------------------------------------------------------------
+void async_file_enum::cancel()
+{
+    InterlockedExchange(&m_cancelled, true);
+}
+
+//------------------------------------------------------------------------------
+bool async_file_enum::wait(unsigned int timeout)
+{
+    return WaitForSingleObject(m_ready_event, timeout) == WAIT_OBJECT_0;
+}
+
+//------------------------------------------------------------------------------
+bool async_file_enum::is_complete() const
+{
+    return WaitForSingleObject(m_ready_event, 0) == WAIT_OBJECT_0;
+}
+
+//------------------------------------------------------------------------------
+void async_file_enum::TEST_set_gate(void* semaphore)
+{
+    s_test_gate = semaphore;
+}
+
+//------------------------------------------------------------------------------
+bool async_file_enum::create_thread()
+{
+    assert(!m_thread_handle);
+    assert(!m_ready_event);
+
+    m_ready_event = CreateEvent(nullptr, true, false, nullptr);
+    if (!m_ready_event)
+        return false;
+
+    m_holder = shared_from_this(); // Now threadproc holds a strong ref.
+    m_thread_handle = reinterpret_cast<HANDLE>(_beginthreadex(nullptr, 0, &threadproc, this, 0, nullptr));
+    if (!m_thread_handle)
+    {
+        m_holder = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void async_file_enum::publish(std::vector<entry>& batch)
+{
+    EnterCriticalSection(&m_lock);
+    for (auto& e : batch)
+        m_entries.emplace_back(std::move(e));
+    LeaveCriticalSection(&m_lock);
+
+    batch.clear();
+}
+
+//------------------------------------------------------------------------------
+unsigned __stdcall async_file_enum::threadproc(void* arg)
+{
+    async_file_enum* _this = static_cast<async_file_enum*>(arg);
+
+    std::vector<entry> batch;
+    batch.reserve(c_batch_size);
+
+    str<288> file;
+    int st_mode = 0;
+    int attr = 0;
+    unsigned long long size = 0;
+    unsigned long long write_time = 0;
+    while (!_this->m_cancelled)
+    {
+        if (_this->m_gate)
+            WaitForSingleObject(_this->m_gate, INFINITE);
+        if (_this->m_cancelled || !_this->m_globber->next(file, false, &st_mode, &attr, &size, &write_time))
+            break;
+
+        entry e;
+        e.name = file.c_str();
+        e.st_mode = st_mode;
+        e.attr = attr;
+        e.size = size;
+        e.write_time = write_time;
+        batch.emplace_back(std::move(e));
+
+        if (batch.size() >= c_batch_size)
+            _this->publish(batch);
+    }
+
+    _this->publish(batch);
+    _this->m_globber.reset();
+
+    // Signal completion.
+    SetEvent(_this->m_ready_event);
+
+    // Release threadproc's strong ref.
+    _this->m_holder = nullptr;
+
+    _endthreadex(0);
+    return 0;
+}
+
+
+
+//------------------------------------------------------------------------------
+async_file_idle::async_file_idle(input_idle* inner, const std::shared_ptr<async_file_enum>& async)
+: m_inner(inner)
+, m_async(async)
+{
+}
+
+//------------------------------------------------------------------------------
+void async_file_idle::reset()
+{
+    if (m_inner)
+        m_inner->reset();
+}
+
+//------------------------------------------------------------------------------
+bool async_file_idle::is_enabled()
+{
+    m_inner_enabled = m_inner && m_inner->is_enabled();
+    return m_inner_enabled || is_pending();
+}
+
+//------------------------------------------------------------------------------
+unsigned async_file_idle::get_timeout()
+{
+    if (!m_inner_enabled)
+        return INFINITE;
+
+    // Only one wait event is supported, so poll the host's callback while
+    // waiting for the enumeration.
+    unsigned timeout = m_inner->get_timeout();
+    return is_pending() ? min<unsigned>(timeout, 50) : timeout;
+}
+
+//------------------------------------------------------------------------------
+void* async_file_idle::get_waitevent()
+{
+    if (is_pending())
+        return m_async->get_ready_event();
+    return m_inner_enabled ? m_inner->get_waitevent() : nullptr;
+}
+
+//------------------------------------------------------------------------------
+void async_file_idle::on_idle()
+{
+    if (is_pending() && m_async->is_complete())
+    {
+        m_async->set_partial(false);
+        m_completed = true;
+    }
+
+    if (m_inner_enabled)
+        m_inner->on_idle();
+}
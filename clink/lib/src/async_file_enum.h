@@ -0,0 +1,103 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <core/str.h>
+#include <terminal/input_idle.h>
+
+#include <memory>
+#include <vector>
+
+class globber;
+
+//------------------------------------------------------------------------------
+class async_file_enum : public std::enable_shared_from_this<async_file_enum>
+{
+    // Enumerates files on a worker thread, so that completing in a slow
+    // directory (e.g. a network share) doesn't freeze the input loop.  Results
+    // are published in batches, so a generator can use whatever has arrived so
+    // far.  Only one enumeration is current at a time; starting an enumeration
+    // for a different pattern cancels the previous one.
+
+public:
+    struct entry
+    {
+        str_moveable    name;
+        int             st_mode;
+        int             attr;
+        unsigned long long size;
+        unsigned long long write_time;
+    };
+
+                        ~async_file_enum();
+    static std::shared_ptr<async_file_enum> start(const char* pattern, bool hidden, bool system);
+    static std::shared_ptr<async_file_enum> get_current();
+    static void         cancel_current();
+    static bool         is_slow_path(const char* path);
+
+    void                cancel();
+    bool                wait(unsigned int timeout);
+    bool                is_complete() const;
+    void*               get_ready_event() const { return m_ready_event; }
+    const char*         get_pattern() const { return m_pattern.c_str(); }
+    void                set_partial(bool partial) { m_partial = partial; }
+    bool                is_partial() const { return m_partial; }
+    template <typename T> void for_each(T&& callback);
+
+    // Makes workers started afterwards wait on the semaphore before reading
+    // each file, so tests can control how far an enumeration gets.
+    static void         TEST_set_gate(void* semaphore);
+
+private:
+                        async_file_enum(const char* pattern, bool hidden, bool system);
+    bool                create_thread();
+    void                publish(std::vector<entry>& batch);
+    static unsigned __stdcall threadproc(void* arg);
+    str_moveable        m_pattern;
+    bool                m_hidden;
+    bool                m_system;
+    std::unique_ptr<globber> m_globber;
+    std::vector<entry>  m_entries;
+    CRITICAL_SECTION    m_lock;
+    void*               m_thread_handle = nullptr;
+    void*               m_ready_event = nullptr;
+    void*               m_gate = nullptr;
+    bool                m_partial = false;
+    volatile long       m_cancelled = false;
+    std::shared_ptr<async_file_enum> m_holder;
+};
+
+//------------------------------------------------------------------------------
+template <typename T> void async_file_enum::for_each(T&& callback)
+{
+    EnterCriticalSection(&m_lock);
+    for (const auto& e : m_entries)
+        callback(e);
+    LeaveCriticalSection(&m_lock);
+}
+
+
+
+//------------------------------------------------------------------------------
+class async_file_idle : public input_idle
+{
+    // Wakes the input loop when a background file enumeration that produced
+    // partial matches finishes, and otherwise defers to the host's callback.
+
+public:
+                        async_file_idle(input_idle* inner, const std::shared_ptr<async_file_enum>& async);
+    bool                is_completed() const { return m_completed; }
+    void                reset() override;
+    bool                is_enabled() override;
+    unsigned            get_timeout() override;
+    void*               get_waitevent() override;
+    void                on_idle() override;
+
+private:
+    bool                is_pending() const { return m_async->is_partial(); }
+    input_idle*         m_inner;
+    std::shared_ptr<async_file_enum> m_async;
+    bool                m_inner_enabled = false;
+    bool                m_completed = false;
+};
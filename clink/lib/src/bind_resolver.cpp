@@ -12,16 +12,15 @@
 #include <new>
 
 //------------------------------------------------------------------------------
-bind_resolver::binding::binding(bind_resolver* resolver, int node_index)
+bind_resolver::binding::binding(bind_resolver* resolver, unsigned int depth, unsigned int bind)
 : m_outer(resolver)
-, m_node_index(node_index)
 {
     const binder& binder = m_outer->m_binder;
-    const auto& node = binder.get_node(m_node_index);
+    const auto& entry = binder.get_bind(bind);
 
-    m_module = node.module;
-    m_depth = max<unsigned char>(1, node.depth);
-    m_id = node.id;
+    m_module = entry.module;
+    m_depth = max<unsigned char>(1, depth);
+    m_id = entry.id;
 }
 
 //------------------------------------------------------------------------------
@@ -77,14 +76,12 @@ bind_resolver::bind_resolver(const binder& binder)
 //------------------------------------------------------------------------------
 void bind_resolver::set_group(int group)
 {
-    if (unsigned(group) - 1 >= sizeof_array(m_binder.m_nodes) - 1)
-        return;
-
-    if (m_group == group || !m_binder.get_node(group - 1).is_group)
+    if (m_group == unsigned(group) || !m_binder.is_group(group))
         return;
 
     m_group = group;
     m_node_index = group;
+    m_bind = 0;
     m_pending_input = true;
 }
 
@@ -103,6 +100,7 @@ void bind_resolver::reset()
 
     m_group = group;
     m_node_index = m_group;
+    m_bind = 0;
 }
 
 //------------------------------------------------------------------------------
@@ -123,12 +121,13 @@ bool bind_resolver::step(unsigned char key)
 //------------------------------------------------------------------------------
 bool bind_resolver::step_impl(unsigned char key)
 {
-    int next = m_binder.find_child(m_node_index, key);
+    unsigned int next = m_binder.find_child(m_node_index, key);
     if (!next)
         return true;
 
     m_node_index = next;
-    return (m_binder.get_node(next).child == 0);
+    m_bind = 0;
+    return (m_binder.get_node(next).child_count == 0);
 }
 
 //------------------------------------------------------------------------------
@@ -151,20 +150,21 @@ bind_resolver::binding bind_resolver::next()
                 break;
     }
 
-    // Go along this depth's nodes looking for valid binds.
+    // Go through the binds of the node reached, then of each shorter chord
+    // back up to the group's root.
     while (m_node_index)
     {
         const binder::node& node = m_binder.get_node(m_node_index);
 
-        // Move iteration along to the next node.
-        int node_index = m_node_index;
-        m_node_index = node.next;
+        unsigned int bind = m_bind ? m_binder.get_bind(m_bind).next : node.bind;
+        if (bind)
+        {
+            m_bind = bind;
+            return binding(this, node.depth, bind);
+        }
 
-        // Check to see if where we're currently at a node in the tree that is
-        // a valid bind (at the point of call).
-        int key_index = m_tail + node.depth - 1;
-        if (node.bound && (!node.key || node.key == m_keys[key_index]))
-            return binding(this, node_index);
+        m_node_index = node.parent;
+        m_bind = 0;
     }
 
     // We can't get any further traversing the tree with the input provided.
@@ -185,6 +185,7 @@ void bind_resolver::claim(binding& binding)
     {
         m_tail += binding.m_depth;
         m_node_index = m_group;
+        m_bind = 0;
         m_pending_input = true;
 
         binding.m_outer = nullptr;
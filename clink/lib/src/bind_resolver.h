@@ -23,10 +23,9 @@ public:
     private:
         friend class    bind_resolver;
                         binding() = default;
-                        binding(bind_resolver* resolver, int node_index);
+                        binding(bind_resolver* resolver, unsigned int depth, unsigned int bind);
         bind_resolver*  m_outer = nullptr;
-        unsigned short  m_node_index;
-        unsigned char   m_module;
+        unsigned int    m_module;
         unsigned char   m_depth;
         unsigned char   m_id;
     };
@@ -44,8 +43,9 @@ private:
     void                claim(binding& binding);
     bool                step_impl(unsigned char key);
     const binder&       m_binder;
-    unsigned short      m_node_index = 1;
-    unsigned short      m_group = 1;
+    unsigned int        m_node_index = 1;
+    unsigned int        m_bind = 0;         // Last bind returned from m_node_index.
+    unsigned int        m_group = 1;
     bool                m_pending_input = false;
     unsigned char       m_tail = 0;
     unsigned char       m_key_count = 0;
@@ -105,12 +105,10 @@ template <int SIZE> static bool translate_chord(const char* chord, char (&out)[S
 //------------------------------------------------------------------------------
 binder::binder()
 {
-    // Initialise the default group.
-    m_nodes[0] = { 1 };
-    m_nodes[1] = { 0 };
-    m_next_node = 2;
-
-    static_assert(sizeof(node) == sizeof(group_node), "Size assumption");
+    // Node 0 is never used, so that 0 can mean "no node".  Node 1 is the
+    // default group's root.
+    add_node(0, 0, false);
+    add_node(0, 0, true);
 }
 
 //------------------------------------------------------------------------------
@@ -121,15 +119,10 @@ int binder::get_group(const char* name)
 
     unsigned int hash = str_hash(name);
 
-    int index = get_group_node(0)->next;
-    while (index)
-    {
-        const group_node* node = get_group_node(index);
-        if (*(int*)(node->hash) == hash)
-            return index + 1;
-
-        index = node->next;
-    }
+    // Most recently created groups take precedence.
+    for (auto it = m_groups.rbegin(); it != m_groups.rend(); ++it)
+        if (it->hash == hash)
+            return it->root;
 
     return -1;
 }
@@ -140,24 +133,9 @@ int binder::create_group(const char* name)
     if (name == nullptr || name[0] == '\0')
         return -1;
 
-    int index = alloc_nodes(2);
-    if (index < 0)
-        return -1;
-
-    // Create a new group node;
-    group_node* group = get_group_node(index);
-    *(int*)(group->hash) = str_hash(name);
-    group->is_group = 1;
-
-    // Link the new node into the front of the list.
-    group_node* master = get_group_node(0);
-    group->next = master->next;
-    master->next = index;
-
-    // Next node along is the group's root.
-    ++index;
-    m_nodes[index] = {};
-    return index;
+    unsigned int root = add_node(0, 0, true);
+    m_groups.push_back({ str_hash(name), root });
+    return root;
 }
 
 //------------------------------------------------------------------------------
@@ -168,7 +146,7 @@ bool binder::bind(
     unsigned char id)
 {
     // Validate input
-    if (group >= sizeof_array(m_nodes))
+    if (!is_group(group))
         return false;
 
     // Translate from ASCII representation to actual keys.
@@ -184,41 +162,28 @@ bool binder::bind(
     if (module_index < 0)
         return false;
 
-    // Add the chord of keys into the node graph.
-    int depth = 0;
-    int head = group;
-    for (; len; ++chord, ++depth, --len)
-        if (!(head = insert_child(head, *chord)))
-            return false;
-
-    --chord;
+    // Add the chord of keys into the trie.
+    unsigned int head = group;
+    for (; len; ++chord, --len)
+        head = insert_child(head, *chord);
 
-    // If the insert point is already bound we'll duplicate the node at the end
-    // of the list. Also check if this is a duplicate of the existing bind.
-    node* bindee = m_nodes + head;
-    if (bindee->bound)
+    // If the node is already bound, the new bind goes at the end of its list.
+    // Also check if this is a duplicate of an existing bind.
+    unsigned int tail = 0;
+    for (unsigned int check = m_nodes[head].bind; check; check = m_binds[check - 1].next)
     {
-        int check = head;
-        while (check > head)
-        {
-            if (bindee->key == *chord && bindee->module == module_index && bindee->id == id)
-                return true;
-
-            check = bindee->next;
-            bindee = m_nodes + check;
-        }
-
-        head = append(head, *chord);
+        const bind_entry& entry = m_binds[check - 1];
+        if (entry.module == unsigned(module_index) && entry.id == id)
+            return true;
+        tail = check;
     }
 
-    if (!head)
-        return false;
-
-    bindee = m_nodes + head;
-    bindee->module = module_index;
-    bindee->bound = 1;
-    bindee->depth = depth;
-    bindee->id = id;
+    m_binds.push_back({ 0, unsigned(module_index), id });
+    const unsigned int index = unsigned(m_binds.size());
+    if (tail)
+        m_binds[tail - 1].next = index;
+    else
+        m_nodes[head].bind = index;
 
     return true;
 }
@@ -226,104 +191,118 @@ bool binder::bind(
 //------------------------------------------------------------------------------
 bool binder::is_bound(unsigned int group, const char* seq, int len) const
 {
+    if (!is_group(group))
+        return false;
+
     unsigned int node_index = group;
 
     while (len--)
     {
-        int next = find_child(node_index, *(seq++));
+        unsigned int next = find_child(node_index, *(seq++));
         if (!next)
             return false;
         node_index = next;
         if (!len)
-            return (get_node(next).child == 0);
+            return (get_node(next).child_count == 0);
     }
 
     return false;
 }
 
 //------------------------------------------------------------------------------
-int binder::insert_child(int parent, unsigned char key)
+unsigned int binder::insert_child(unsigned int parent, unsigned char key)
 {
-    if (int child = find_child(parent, key))
+    if (unsigned int child = find_child(parent, key))
         return child;
 
     return add_child(parent, key);
 }
 
 //------------------------------------------------------------------------------
-int binder::find_child(int parent, unsigned char key) const
+unsigned int binder::find_child(unsigned int parent, unsigned char key) const
 {
-    const node* node = m_nodes + parent;
+    const node& node = get_node(parent);
 
-    int index = node->child;
-    for (; index > parent; index = node->next)
-    {
-        node = m_nodes + index;
-        if (node->key == key)
-            return index;
-    }
+    if (!node.child_capacity)
+        return node.child_count ? m_tables[node.children + key] : 0;
+
+    const child* children = m_children.data() + node.children;
+    for (unsigned int i = 0; i < node.child_count; ++i)
+        if (children[i].key == key)
+            return children[i].index;
 
     return 0;
 }
 
 //------------------------------------------------------------------------------
-int binder::add_child(int parent, unsigned char key)
+unsigned int binder::add_child(unsigned int parent, unsigned char key)
 {
-    int child = alloc_nodes();
-    if (child < 0)
-        return 0;
-
-    node addee = {};
-    addee.key = key;
+    const unsigned int index = add_node(parent, key, false);
 
-    int current_child = m_nodes[parent].child;
-    if (current_child < parent)
+    node& node = m_nodes[parent];
+    if (node.child_count && !node.child_capacity)
     {
-        addee.next = parent;
-        m_nodes[parent].child = child;
+        m_tables[node.children + key] = index;
+    }
+    else if (node.child_count >= dense_threshold)
+    {
+        // Switch to a table indexed by key.
+        const unsigned int table = unsigned(m_tables.size());
+        m_tables.resize(table + 256);
+        for (unsigned int i = 0; i < node.child_count; ++i)
+        {
+            const child& c = m_children[node.children + i];
+            m_tables[table + c.key] = c.index;
+        }
+        m_tables[table + key] = index;
+        node.children = table;
+        node.child_capacity = 0;
     }
     else
     {
-        int tail = find_tail(current_child);
-        addee.next = parent;
-        m_nodes[tail].next = child;
+        // Grow the list by moving it to the end of m_children.  The space it
+        // used is abandoned, but lists only grow while binding.
+        if (node.child_count >= node.child_capacity)
+        {
+            const unsigned int capacity = node.child_capacity ? node.child_capacity * 2 : 2;
+            const unsigned int moved = unsigned(m_children.size());
+            m_children.resize(moved + capacity);
+            for (unsigned int i = 0; i < node.child_count; ++i)
+                m_children[moved + i] = m_children[node.children + i];
+            node.children = moved;
+            node.child_capacity = capacity;
+        }
+
+        m_children[node.children + node.child_count] = { index, key };
     }
 
-    m_nodes[child] = addee;
-    return child;
+    ++node.child_count;
+    return index;
 }
 
 //------------------------------------------------------------------------------
-int binder::find_tail(int head)
+unsigned int binder::add_node(unsigned int parent, unsigned char key, bool is_group)
 {
-    while (m_nodes[head].next > head)
-        head = m_nodes[head].next;
+    node addee = {};
+    addee.parent = parent;
+    addee.key = key;
+    addee.depth = parent ? m_nodes[parent].depth + 1 : 0;
+    addee.is_group = is_group;
 
-    return head;
+    m_nodes.push_back(addee);
+    return unsigned(m_nodes.size() - 1);
 }
 
 //------------------------------------------------------------------------------
-int binder::append(int head, unsigned char key)
+bool binder::is_group(unsigned int index) const
 {
-    int index = alloc_nodes();
-    if (index < 0)
-        return 0;
-
-    int tail = find_tail(head);
-
-    node addee = {};
-    addee.key = key;
-    addee.next = m_nodes[tail].next;
-    m_nodes[tail].next = index;
-
-    m_nodes[index] = addee;
-    return index;
+    return index < m_nodes.size() && m_nodes[index].is_group;
 }
 
 //------------------------------------------------------------------------------
 const binder::node& binder::get_node(unsigned int index) const
 {
-    if (index < sizeof_array(m_nodes))
+    if (index < m_nodes.size())
         return m_nodes[index];
 
     static const node zero = {};
@@ -331,44 +310,28 @@ const binder::node& binder::get_node(unsigned int index) const
 }
 
 //------------------------------------------------------------------------------
-binder::group_node* binder::get_group_node(unsigned int index)
+const binder::bind_entry& binder::get_bind(unsigned int index) const
 {
-    if (index < sizeof_array(m_nodes))
-        return (group_node*)(m_nodes + index);
-
-    return nullptr;
-}
+    if (index - 1 < m_binds.size())
+        return m_binds[index - 1];
 
-//------------------------------------------------------------------------------
-int binder::alloc_nodes(unsigned int count)
-{
-    int next = m_next_node + count;
-    if (next > sizeof_array(m_nodes))
-        return -1;
-
-    m_next_node = next;
-    return m_next_node - count;
+    static const bind_entry zero = {};
+    return zero;
 }
 
 //------------------------------------------------------------------------------
 int binder::add_module(editor_module& module)
 {
-    for (int i = 0, n = m_modules.size(); i < n; ++i)
-        if (*(m_modules[i]) == &module)
+    for (int i = 0, n = int(m_modules.size()); i < n; ++i)
+        if (m_modules[i] == &module)
             return i;
 
-    if (editor_module** slot = m_modules.push_back())
-    {
-        *slot = &module;
-        return int(slot - m_modules.front());
-    }
-
-    return -1;
+    m_modules.push_back(&module);
+    return int(m_modules.size() - 1);
 }
 
 //------------------------------------------------------------------------------
 editor_module* binder::get_module(unsigned int index) const
 {
-    auto b = m_modules[index];
-    return b ? *b : nullptr;
+    return (index < m_modules.size()) ? m_modules[index] : nullptr;
 }
@@ -3,13 +3,18 @@
 
 #pragma once
 
-#include <core/array.h>
+#include <vector>
 
 class editor_module;
 
 //------------------------------------------------------------------------------
 class binder
 {
+    // Each group is the root of a trie of chords, one node per key.  Nodes
+    // with few children keep them in a short list; nodes with many children
+    // (e.g. a group's root, or after ESC or CSI) switch to a table indexed by
+    // key.  Nodes, groups, and modules are all allocated as needed.
+
 public:
                         binder();
     int                 get_group(const char* name=nullptr);
@@ -18,46 +23,53 @@ public:
     bool                is_bound(unsigned int group, const char* seq, int len) const;
 
 private:
-    static const int    link_bits = 9;
-    static const int    module_bits = 6;
+    static const unsigned int dense_threshold = 8;
 
     struct node
     {
-        unsigned short  is_group    : 1;
-        unsigned short  next        : link_bits;
-        unsigned short  module      : module_bits;
-
-        unsigned short  child       : link_bits;
-        unsigned short  depth       : 4;
-        unsigned short  bound       : 1;
-        unsigned short              : 2;
+        unsigned int    parent;         // 0 for a group's root.
+        unsigned int    bind;           // Index + 1 of the first bind, or 0.
+        unsigned int    children;       // Offset into m_children or m_tables.
+        unsigned short  child_count;
+        unsigned short  child_capacity; // 0 when the children are in m_tables.
+        unsigned char   key;
+        unsigned char   depth;
+        bool            is_group;
+    };
 
+    struct child
+    {
+        unsigned int    index;
         unsigned char   key;
-        unsigned char   id;
     };
 
-    struct group_node
+    struct bind_entry
     {
-        unsigned short  is_group    : 1;
-        unsigned short  next        : link_bits;
-        unsigned short              : 6;
-        unsigned short  hash[2];
+        unsigned int    next;           // Index + 1 of the next bind, or 0.
+        unsigned int    module;
+        unsigned char   id;
     };
 
-    typedef fixed_array<editor_module*, (1 << module_bits)> modules;
+    struct group_entry
+    {
+        unsigned int    hash;
+        unsigned int    root;
+    };
 
     friend class        bind_resolver;
-    int                 insert_child(int parent, unsigned char key);
-    int                 find_child(int parent, unsigned char key) const;
-    int                 add_child(int parent, unsigned char key);
-    int                 find_tail(int head);
-    int                 append(int head, unsigned char key);
+    unsigned int        insert_child(unsigned int parent, unsigned char key);
+    unsigned int        find_child(unsigned int parent, unsigned char key) const;
+    unsigned int        add_child(unsigned int parent, unsigned char key);
+    unsigned int        add_node(unsigned int parent, unsigned char key, bool is_group);
+    bool                is_group(unsigned int index) const;
     const node&         get_node(unsigned int index) const;
-    group_node*         get_group_node(unsigned int index);
-    int                 alloc_nodes(unsigned int count=1);
+    const bind_entry&   get_bind(unsigned int index) const;
     int                 add_module(editor_module& module);
     editor_module*      get_module(unsigned int index) const;
-    modules             m_modules;
-    node                m_nodes[1 << link_bits];
-    unsigned int        m_next_node;
+    std::vector<node>   m_nodes;
+    std::vector<child>  m_children;
+    std::vector<unsigned int> m_tables;
+    std::vector<bind_entry> m_binds;
+    std::vector<group_entry> m_groups;
+    std::vector<editor_module*> m_modules;
 };
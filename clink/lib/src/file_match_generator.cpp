@@ -5,6 +5,7 @@
 #include "match_generator.h"
 #include "line_state.h"
 #include "matches.h"
+#include "async_file_enum.h"
 
 #include <core/base.h>
 #include <core/globber.h>
@@ -26,6 +27,30 @@ setting_bool g_glob_system(
     "file lists.",
     false);
 
+setting_int g_glob_cache_ttl(
+    "files.cache_ttl",
+    "Directory cache lifetime",
+    "While editing a line, directory listings are cached so that completing the\n"
+    "same directory several times doesn't enumerate it again.  A listing is\n"
+    "reused for this many milliseconds, and after that only while the\n"
+    "directory's last write time is unchanged.  0 disables the cache.",
+    1000);
+
+setting_bool g_glob_async(
+    "files.async",
+    "Enumerate slow directories in the background",
+    "When completing in a network directory, the files are enumerated on a\n"
+    "background thread so the editor stays responsive.  Until the enumeration\n"
+    "finishes, completion only lists the files found so far and doesn't insert\n"
+    "anything.  Typing more cancels the enumeration, and the next completion\n"
+    "starts it again.",
+    true);
+
+//------------------------------------------------------------------------------
+// How long completion waits for a background enumeration before using partial
+// results.
+static const unsigned int c_async_wait = 100;
+
 
 
 //------------------------------------------------------------------------------
@@ -57,11 +82,20 @@ static class : public match_generator
 
         root << "*";
 
+        // Slow directories are enumerated on a worker thread.  Starting an
+        // enumeration for a different directory cancels the previous one.
+        std::shared_ptr<async_file_enum> async;
+        if (g_glob_async.get() && async_file_enum::is_slow_path(root.c_str()))
+            async = async_file_enum::start(root.c_str(), g_glob_hidden.get(), g_glob_system.get());
+        else
+            async_file_enum::cancel_current();
+
         int st_mode = 0;
         int attr = 0;
         globber globber(root.c_str());
         globber.hidden(g_glob_hidden.get());
         globber.system(g_glob_system.get());
+        globber.cached(true);
 
         path::get_directory(root);
         unsigned int root_len = root.length();
@@ -74,12 +108,35 @@ static class : public match_generator
                 root = collapsed.c_str();
         }
 
+        if (async)
+        {
+            // Use what has arrived so far if the enumeration doesn't finish
+            // quickly.  Partial matches are only listed, and the editor
+            // regenerates matches when the enumeration completes.
+            const bool partial = !async->wait(c_async_wait);
+            async->set_partial(partial);
+            builder.set_partial(partial);
+            async->for_each([&] (const async_file_enum::entry& e) {
+                root.truncate(root_len);
+                path::append(root, e.name.c_str());
+                match_file_info info = { unsigned(e.attr), e.size, e.write_time };
+                match_desc desc = { root.c_str(), to_match_type(e.st_mode, e.attr, root.c_str()), &info };
+                builder.add_match(desc, true/*already_normalised*/);
+            });
+            return true;
+        }
+
+        // Keep the metadata from the enumeration with each match, so that
+        // displaying the matches doesn't need to query the files again.
         str<288> buffer;
-        while (globber.next(buffer, false, &st_mode, &attr))
+        match_file_info info;
+        while (globber.next(buffer, false, &st_mode, &attr, &info.size, &info.write_time))
         {
             root.truncate(root_len);
             path::append(root, buffer.c_str());
-            builder.add_match(root.c_str(), to_match_type(st_mode, attr, root.c_str()), true/*already_normalised*/);
+            info.attr = attr;
+            match_desc desc = { root.c_str(), to_match_type(st_mode, attr, root.c_str()), &info };
+            builder.add_match(desc, true/*already_normalised*/);
         }
 
         return true;
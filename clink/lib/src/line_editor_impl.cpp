@@ -9,8 +9,10 @@
 #include "match_pipeline.h"
 #include "pager.h"
 #include "host_callbacks.h"
+#include "async_file_enum.h"
 
 #include <core/base.h>
+#include <core/dir_cache.h>
 #include <core/os.h>
 #include <core/path.h>
 #include <core/str_iter.h>
@@ -33,6 +35,7 @@ const int simple_input_states = (RL_STATE_MOREINPUT |
                                  RL_STATE_CHARSEARCH);
 
 extern setting_bool g_classify_words;
+extern setting_int g_glob_cache_ttl;
 
 extern bool is_showing_argmatchers();
 
@@ -168,6 +171,15 @@ void set_prompt(const char* prompt, const char* rprompt, bool redisplay)
     s_editor->set_prompt(prompt, rprompt, redisplay);
 }
 
+//------------------------------------------------------------------------------
+void force_reclassify_line()
+{
+    if (!s_editor)
+        return;
+
+    s_editor->force_reclassify();
+}
+
 
 
 //------------------------------------------------------------------------------
@@ -207,10 +219,10 @@ extern "C" void host_filter_transient_prompt(int crlf)
 }
 
 //------------------------------------------------------------------------------
-int host_filter_matches(char** matches)
+int host_filter_matches(char** matches, const match_extras* extras)
 {
     if (s_callbacks)
-        s_callbacks->filter_matches(matches);
+        s_callbacks->filter_matches(matches, extras);
     return 0;
 }
 
@@ -356,6 +368,10 @@ void line_editor_impl::begin_line()
     m_buffer.begin_line();
     m_prev_generate.clear();
     m_prev_classify.clear();
+    m_classified_commands.clear();
+    m_reclassify = false;
+
+    dir_cache::begin_session(max(g_glob_cache_ttl.get(), 0));
 
     rl_before_display_function = before_display;
 
@@ -372,6 +388,9 @@ void line_editor_impl::end_line()
 
     rl_before_display_function = nullptr;
 
+    dir_cache::end_session();
+    async_file_enum::cancel_current();
+
     m_buffer.end_line();
     m_desc.output->end();
     m_desc.input->end();
@@ -444,7 +463,21 @@ bool line_editor_impl::edit(str_base& out)
         if (callback && !callback->is_enabled())
             callback = nullptr;
 
-        m_desc.input->select(callback);
+        // While completion is using partial results from a background file
+        // enumeration, also wait for the enumeration to finish so the matches
+        // can be regenerated with the full results.
+        std::shared_ptr<async_file_enum> async = async_file_enum::get_current();
+        if (async && async->is_partial())
+        {
+            async_file_idle idle(callback, async);
+            m_desc.input->select(&idle);
+            if (idle.is_completed())
+                reset_generate_matches();
+        }
+        else
+        {
+            m_desc.input->select(callback);
+        }
     }
 
     return get_line(out);
@@ -760,7 +793,7 @@ bool line_editor_impl::update_input()
         virtual void    done(bool eof) override                   { flags |= flag_done|(eof ? flag_eof : 0); }
         virtual void    redraw() override                         { flags |= flag_redraw; }
         virtual int     set_bind_group(int id) override           { int t = group; group = id; return t; }
-        unsigned short  group;  //        <! MSVC bugs; see connect
+        int             group;  //        <! MSVC bugs; see connect
         unsigned char   flags;  // = 0;   <! issues about C2905
     };
 
@@ -955,13 +988,23 @@ void line_editor_impl::classify()
     if (m_prev_classify.equals(m_buffer.get_buffer(), m_buffer.get_length()))
         return;
 
+    // A forced reclassify discards the cached commands, so every command is
+    // passed to the classifiers.
+    if (m_reclassify)
+    {
+        m_reclassify = false;
+        m_classified_commands.clear();
+    }
+
     // Use the full line; don't stop at the cursor.
     collect_words(true/*for_classify*/);
     line_state line = get_linestate(true/*for_classify*/);
 
-    // Hang on to the old classifications so it's possible to detect changes.
+    // Hang on to the old classifications so it's possible to detect changes,
+    // and so commands whose text hasn't changed can reuse them.
+    const unsigned int line_length = unsigned(strlen(line.get_line()));
     word_classifications old_classifications(std::move(m_classifications));
-    m_classifications.init(strlen(line.get_line()));
+    m_classifications.init(line_length);
 
     // Count number of commands so we can pre-allocate words_storage so that
     // emplace_back() doesn't invalidate pointers (references) stored in
@@ -978,7 +1021,9 @@ void line_editor_impl::classify()
     std::vector<word> words;
     std::vector<std::vector<word>> words_storage;
     std::vector<line_state> linestates;
+    std::vector<classified_command> commands;
     words_storage.reserve(num_commands);
+    commands.reserve(num_commands);
     while (true)
     {
         if (!words.empty() && (i >= m_classify_words.size() || m_classify_words[i].command_word))
@@ -1003,6 +1048,10 @@ void line_editor_impl::classify()
                 command_char_offset,
                 words_storage.back()
             );
+
+            commands.emplace_back();
+            commands.back().start = command_char_offset;
+            commands.back().info_count = unsigned(words_storage.back().size());
         }
 
         if (i >= m_classify_words.size())
@@ -1012,7 +1061,66 @@ void line_editor_impl::classify()
         i++;
     }
 
-    m_classifier->classify(linestates, m_classifications);
+    // Each command's text runs up to the start of the next command.  Commands
+    // whose text is the same as in the previous classification (even if they
+    // moved) reuse their previous classifications; only the rest are passed to
+    // the classifiers.
+    std::vector<int> reuse;
+    std::vector<line_state> changed;
+    reuse.reserve(commands.size());
+    for (size_t k = 0; k < commands.size(); ++k)
+    {
+        classified_command& command = commands[k];
+        const unsigned int end = (k + 1 < commands.size()) ? commands[k + 1].start : line_length;
+        command.text.concat(m_buffer.get_buffer() + command.start, end - command.start);
+
+        int found = -1;
+        for (size_t j = 0; j < m_classified_commands.size(); ++j)
+        {
+            const classified_command& prev = m_classified_commands[j];
+            if (prev.info_count == command.info_count &&
+                prev.text.length() == command.text.length() &&
+                prev.text.equals(command.text.c_str()))
+            {
+                found = int(j);
+                break;
+            }
+        }
+
+        reuse.push_back(found);
+        if (found < 0)
+            changed.push_back(linestates[k]);
+    }
+
+    word_classifications fresh_classifications;
+    if (!changed.empty())
+    {
+        fresh_classifications.init(line_length);
+        m_classifier->classify(changed, fresh_classifications);
+    }
+
+    // Splice the reused and fresh classifications together in command order.
+    unsigned int fresh_index = 0;
+    for (size_t k = 0; k < commands.size(); ++k)
+    {
+        classified_command& command = commands[k];
+        command.info_index = m_classifications.size();
+        if (reuse[k] >= 0)
+        {
+            const classified_command& prev = m_classified_commands[reuse[k]];
+            m_classifications.copy_command(old_classifications, prev.info_index, prev.info_count,
+                                           prev.start, prev.start + prev.text.length(),
+                                           int(command.start) - int(prev.start));
+        }
+        else
+        {
+            m_classifications.copy_command(fresh_classifications, fresh_index, command.info_count,
+                                           command.start, command.start + command.text.length(), 0);
+            fresh_index += command.info_count;
+        }
+    }
+    m_classified_commands = std::move(commands);
+
     m_classifications.finish(is_showing_argmatchers());
 
 #ifdef DEBUG
@@ -1030,12 +1138,24 @@ void line_editor_impl::classify()
     }
 #endif
 
-    m_prev_classify.set(m_buffer.get_buffer(), m_buffer.get_length());
+    // If a classifier forced a reclassify (e.g. by modifying an argmatcher)
+    // then leave the line marked as needing classification.
+    if (!m_reclassify)
+        m_prev_classify.set(m_buffer.get_buffer(), m_buffer.get_length());
 
     if (!old_classifications.equals(m_classifications))
         m_buffer.set_need_draw();
 }
 
+//------------------------------------------------------------------------------
+void line_editor_impl::force_reclassify()
+{
+    // This can be called from inside a classifier, so the cached commands are
+    // only discarded when the next classify() begins.
+    m_prev_classify.clear();
+    m_reclassify = true;
+}
+
 //------------------------------------------------------------------------------
 line_state line_editor_impl::get_linestate(bool for_classify) const
 {
@@ -1190,6 +1310,7 @@ void line_editor_impl::update_internal()
     // Since the end word is empty, don't compare the cursor position, so the
     // matches are only collected once for the word position.
     int update_prev_generate = -1;
+    bool key_changed = false;
     if (!is_key_same(prev_key, m_prev_generate.get(), m_prev_generate.length(),
                      next_key, m_buffer.get_buffer(), m_buffer.get_length(),
                      false/*compare_cursor*/))
@@ -1239,6 +1360,7 @@ void line_editor_impl::update_internal()
         set_flag(flag_select);          // Defer selecting until update_matches().
 
         m_prev_key = next_key;
+        key_changed = true;
     }
 
     // Must defer updating m_prev_generate since the old value is still needed
@@ -1248,6 +1370,14 @@ void line_editor_impl::update_internal()
 
     if (is_endword_tilde(get_linestate()))
         reset_generate_matches();
+
+    // Further typing cancels a background file enumeration that is still
+    // collecting matches, and the next completion starts it over.
+    if (key_changed && m_matches.is_partial())
+    {
+        async_file_enum::cancel_current();
+        reset_generate_matches();
+    }
 }
 
 //------------------------------------------------------------------------------
@@ -1266,7 +1396,7 @@ matches* maybe_regenerate_matches(const char* needle, bool popup, bool sort)
 
     // Check if a match display filter is active.
     matches_impl& regen = s_editor->m_regen_matches;
-    if (!regen.match_display_filter(nullptr, nullptr, popup))
+    if (!regen.match_display_filter(nullptr, nullptr, nullptr, popup))
         return nullptr;
 
 #ifdef DEBUG
@@ -40,6 +40,15 @@ private:
     unsigned int    m_len = 0;
 };
 
+//------------------------------------------------------------------------------
+struct classified_command
+{
+    str_moveable    text;           // Buffer text from the command up to the next command.
+    unsigned int    start;          // Offset of the text in the buffer.
+    unsigned int    info_index;     // Index of the command's first word in the word_classifications.
+    unsigned int    info_count;     // Number of words in the command.
+};
+
 //------------------------------------------------------------------------------
 class line_editor_impl
     : public line_editor
@@ -77,6 +86,7 @@ private:
     typedef fixed_array<match_generator*, 32>   generators;
     typedef std::vector<word>                   words;
     friend void update_matches();
+    friend void force_reclassify_line();
     friend matches* get_mutable_matches(bool nosort);
     friend matches* maybe_regenerate_matches(const char* needle, bool popup, bool sort);
 
@@ -107,6 +117,7 @@ private:
     void                collect_words(bool for_classify=false);
     unsigned int        collect_words(words& words, matches_impl* matches, collect_words_mode mode);
     void                classify();
+    void                force_reclassify();
     matches*            get_mutable_matches(bool nosort=false);
     void                update_internal();
     bool                update_input();
@@ -149,6 +160,8 @@ private:
     prev_buffer         m_prev_classify;
     words               m_classify_words;
     unsigned short      m_classify_command_offset = 0;
+    std::vector<classified_command> m_classified_commands;
+    bool                m_reclassify = false;
 
     const char*         m_insert_on_begin = nullptr;
 
@@ -6,6 +6,7 @@
 #include "line_state.h"
 #include "match_generator.h"
 #include "match_pipeline.h"
+#include "match_sort_keys.h"
 #include "matches_impl.h"
 
 #include <core/array.h>
@@ -32,6 +33,16 @@ static setting_enum g_sort_dirs(
     "before,with,after",
     1);
 
+static setting_enum g_sort_collation(
+    "match.sort_collation",
+    "How to collate matches when sorting",
+    "The default is 'locale' to sort matches according to the user's locale, the\n"
+    "same way CMD does.  Use 'simple' for a faster built in ordering that ignores\n"
+    "case and compares digits as numbers, which can help when completing in very\n"
+    "large directories.",
+    "locale,simple",
+    0);
+
 
 
 //------------------------------------------------------------------------------
@@ -40,16 +51,17 @@ static bool s_nosort = false;
 //------------------------------------------------------------------------------
 static unsigned int normal_selector(
     const char* needle,
-    match_info* infos,
+    match_infos& infos,
     int count)
 {
     int select_count = 0;
     for (int i = 0; i < count; ++i)
     {
-        const char* name = infos[i].match;
+        const char* name = infos.get_match(i);
         int j = str_compare(needle, name);
-        infos[i].select = (j < 0 || !needle[j]);
-        ++select_count;
+        bool select = (j < 0 || !needle[j]);
+        infos.set_selected(i, select);
+        select_count += select;
     }
 
     return select_count;
@@ -58,7 +70,7 @@ static unsigned int normal_selector(
 //------------------------------------------------------------------------------
 static unsigned int restrict_selector(
     const char* needle,
-    match_info* infos,
+    match_infos& infos,
     int count)
 {
     int needle_len = strlen(needle);
@@ -66,11 +78,11 @@ static unsigned int restrict_selector(
     int select_count = 0;
     for (int i = 0; i < count; ++i)
     {
-        const char* match = infos[i].match;
-        int match_len = int(strlen(match));
+        const char* match = infos.get_match(i);
+        int match_len = int(infos.get_length(i));
         while (match_len && path::is_separator((unsigned char)match[match_len - 1]))
             match_len--;
-        infos[i].select = path::match_wild(str_iter(needle, needle_len), str_iter(match, match_len), !is_pathish(infos[i].type));
+        infos.set_selected(i, path::match_wild(str_iter(needle, needle_len), str_iter(match, match_len), !is_pathish(infos.get_type(i))));
         ++select_count;
     }
 
@@ -78,79 +90,16 @@ static unsigned int restrict_selector(
 }
 
 //------------------------------------------------------------------------------
-static bool is_dir_match(const wstr_base& match, match_type type)
-{
-    if (is_match_type(type, match_type::dir))
-        return true;
-    if (!is_match_type(type, match_type::none))
-        return false;
-    if (match.empty())
-        return false;
-    return path::is_separator(match.c_str()[match.length() - 1]);
-}
-
-//------------------------------------------------------------------------------
-inline bool sort_worker(wstr_base& l, match_type l_type,
-                        wstr_base& r, match_type r_type,
-                        int order)
+static void alpha_sorter(match_infos& infos, int count)
 {
-    bool l_dir = is_dir_match(l, l_type);
-    bool r_dir = is_dir_match(r, r_type);
-
-    if (order != 1 && l_dir != r_dir)
-        return (order == 0) ? l_dir : r_dir;
-
-    if (l_dir)
-        path::maybe_strip_last_separator(l);
-    if (r_dir)
-        path::maybe_strip_last_separator(r);
-
-    DWORD flags = SORT_DIGITSASNUMBERS|NORM_LINGUISTIC_CASING;
-    if (true/*casefold*/)
-        flags |= LINGUISTIC_IGNORECASE;
-    int cmp = CompareStringW(LOCALE_USER_DEFAULT, flags,
-                            l.c_str(), l.length(),
-                            r.c_str(), r.length());
-    cmp -= CSTR_EQUAL;
-    if (cmp) return (cmp < 0);
-
-    unsigned char t1 = ((unsigned char)l_type) & MATCH_TYPE_MASK;
-    unsigned char t2 = ((unsigned char)r_type) & MATCH_TYPE_MASK;
-
-    cmp = int(t1 == MATCH_TYPE_DIR) - int(t2 == MATCH_TYPE_DIR);
-    if (cmp) return (cmp < 0);
-
-    cmp = int(t1 == MATCH_TYPE_ALIAS) - int(t2 == MATCH_TYPE_ALIAS);
-    if (cmp) return (cmp < 0);
-
-    cmp = int(t1 == MATCH_TYPE_WORD) - int(t2 == MATCH_TYPE_WORD);
-    if (cmp) return (cmp < 0);
-
-    cmp = int(t1 == MATCH_TYPE_ARG) - int(t2 == MATCH_TYPE_ARG);
-    if (cmp) return (cmp < 0);
-
-    cmp = int(t1 == MATCH_TYPE_FILE) - int(t2 == MATCH_TYPE_FILE);
-    if (cmp) return (cmp < 0);
+    match_sort_keys keys(g_sort_dirs.get(), sort_collation(g_sort_collation.get()));
+    keys.reserve(count);
+    for (int i = 0; i < count; ++i)
+        keys.add(infos.get_match(i), infos.get_length(i), infos.get_type(i));
 
-    return (cmp < 0);
-}
-
-//------------------------------------------------------------------------------
-static void alpha_sorter(match_info* infos, int count)
-{
-    int order = g_sort_dirs.get();
-    wstr<> ltmp;
-    wstr<> rtmp;
-
-    auto predicate = [&] (const match_info& lhs, const match_info& rhs) {
-        ltmp.clear();
-        rtmp.clear();
-        to_utf16(ltmp, lhs.match);
-        to_utf16(rtmp, rhs.match);
-        return sort_worker(ltmp, lhs.type, rtmp, rhs.type, order);
-    };
-
-    std::sort(infos, infos + count, predicate);
+    std::vector<unsigned int> order;
+    keys.sort(order);
+    infos.reorder(order);
 }
 
 //------------------------------------------------------------------------------
@@ -173,23 +122,15 @@ void sort_match_list(char** matches, int len)
         return;
     }
 
-    int order = g_sort_dirs.get();
-    wstr<> ltmp;
-    wstr<> rtmp;
-
-    auto predicate = [&] (const char* l, const char* r) {
-        match_type l_type = match_type(*(l++));
-        match_type r_type = match_type(*(r++));
-
-        ltmp.clear();
-        rtmp.clear();
-        to_utf16(ltmp, l);
-        to_utf16(rtmp, r);
+    // Each match is prefixed with its match type.
+    match_sort_keys keys(g_sort_dirs.get(), sort_collation(g_sort_collation.get()));
+    keys.reserve(len);
+    for (int i = 0; i < len; ++i)
+        keys.add(matches[i] + 1, match_type(*matches[i]));
 
-        return sort_worker(ltmp, l_type, rtmp, r_type, order);
-    };
-
-    std::sort(matches, matches + len, predicate);
+    std::vector<unsigned int> order;
+    keys.sort(order);
+    apply_sort_order(matches, order);
 }
 
 
@@ -294,19 +235,29 @@ void match_pipeline::select(const char* needle) const
             needle = expanded;
     }
 
+    // When the needle extends the previous needle, only the previously
+    // selected matches can still be selected.  They are at the front of the
+    // infos, and coalescing keeps their relative order, so a sorted selection
+    // stays sorted.
+    const bool narrow = m_matches.can_narrow_selection(needle);
+    if (narrow)
+        count = m_matches.get_match_count();
+
     if (count)
         selected_count = normal_selector(needle, m_matches.get_infos(), count);
 
     m_matches.coalesce(selected_count);
+    m_matches.set_selection_needle(needle, narrow);
 
 #ifdef DEBUG
     if (dbg_get_env_int("DEBUG_PIPELINE"))
     {
-        printf("COALESCED, file_comp %u %s -- needle '%s' selected %u matches\n",
+        printf("COALESCED, file_comp %u %s -- needle '%s' selected %u matches%s\n",
                m_matches.is_filename_completion_desired().get(),
                m_matches.is_filename_completion_desired().is_explicit() ? "(exp)" : "(imp)",
                needle,
-               m_matches.get_match_count());
+               m_matches.get_match_count(),
+               narrow ? " (narrowed)" : "");
     }
 #endif
 
@@ -324,9 +275,12 @@ void match_pipeline::sort() const
     if (s_nosort)
         return;
 
-    int count = m_matches.get_match_count();
-    if (!count)
+    if (m_matches.is_selection_sorted())
         return;
 
-    alpha_sorter(m_matches.get_infos(), count);
+    int count = m_matches.get_match_count();
+    if (count)
+        alpha_sorter(m_matches.get_infos(), count);
+
+    m_matches.set_selection_sorted();
 }
@@ -0,0 +1,222 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "match_sort_keys.h"
+
+#include <core/base.h>
+#include <core/path.h>
+#include <core/str.h>
+#include <core/str_iter.h>
+
+#include <string.h>
+#include <wctype.h>
+
+//------------------------------------------------------------------------------
+static bool is_dir_match(const char* match, unsigned int len, match_type type)
+{
+    if (is_match_type(type, match_type::dir))
+        return true;
+    if (!is_match_type(type, match_type::none))
+        return false;
+    return len && path::is_separator((unsigned char)match[len - 1]);
+}
+
+//------------------------------------------------------------------------------
+static unsigned char get_type_rank(match_type type)
+{
+    // Otherwise equal matches are ordered: others, files, args, words,
+    // aliases, dirs.
+    type &= match_type::mask;
+    switch (type)
+    {
+    case match_type::dir:   return 5;
+    case match_type::alias: return 4;
+    case match_type::word:  return 3;
+    case match_type::arg:   return 2;
+    case match_type::file:  return 1;
+    default:                return 0;
+    }
+}
+
+//------------------------------------------------------------------------------
+static void append_utf8(int c, std::vector<char>& out)
+{
+    // UTF8 byte sequences sort in the same order as the codepoints.
+    if (c < 0x80)
+    {
+        out.push_back(char(c));
+    }
+    else if (c < 0x800)
+    {
+        out.push_back(char(0xc0 | (c >> 6)));
+        out.push_back(char(0x80 | (c & 0x3f)));
+    }
+    else if (c < 0x10000)
+    {
+        out.push_back(char(0xe0 | (c >> 12)));
+        out.push_back(char(0x80 | ((c >> 6) & 0x3f)));
+        out.push_back(char(0x80 | (c & 0x3f)));
+    }
+    else
+    {
+        out.push_back(char(0xf0 | (c >> 18)));
+        out.push_back(char(0x80 | ((c >> 12) & 0x3f)));
+        out.push_back(char(0x80 | ((c >> 6) & 0x3f)));
+        out.push_back(char(0x80 | (c & 0x3f)));
+    }
+}
+
+
+
+//------------------------------------------------------------------------------
+match_sort_keys::match_sort_keys(int dir_order, sort_collation collation)
+: m_dir_order(dir_order)
+, m_collation(collation)
+{
+}
+
+//------------------------------------------------------------------------------
+void match_sort_keys::reserve(unsigned int count)
+{
+    m_offsets.reserve(count);
+    m_keys.reserve(count * 24);
+}
+
+//------------------------------------------------------------------------------
+void match_sort_keys::add(const char* match, match_type type)
+{
+    add(match, unsigned(strlen(match)), type);
+}
+
+//------------------------------------------------------------------------------
+void match_sort_keys::add(const char* match, unsigned int len, match_type type)
+{
+    m_offsets.push_back(unsigned(m_keys.size()));
+
+    bool dir = is_dir_match(match, len, type);
+
+    // Directory bucket; 0 when dirs are sorted with files.
+    char bucket = 0;
+    if (m_dir_order == 0)
+        bucket = dir ? 0 : 1;
+    else if (m_dir_order == 2)
+        bucket = dir ? 1 : 0;
+    m_keys.push_back(bucket);
+
+    if (dir)
+    {
+        while (len && path::is_separator((unsigned char)match[len - 1]))
+            --len;
+    }
+
+    if (m_collation != sort_collation::locale || !append_locale_key(match, len))
+        append_simple_key(match, len, m_keys);
+    m_keys.push_back(0);
+
+    m_keys.push_back(char(get_type_rank(type)));
+}
+
+//------------------------------------------------------------------------------
+int match_sort_keys::compare(unsigned int a, unsigned int b) const
+{
+    unsigned int a_end = (a + 1 < size()) ? m_offsets[a + 1] : unsigned(m_keys.size());
+    unsigned int b_end = (b + 1 < size()) ? m_offsets[b + 1] : unsigned(m_keys.size());
+    unsigned int a_len = a_end - m_offsets[a];
+    unsigned int b_len = b_end - m_offsets[b];
+
+    int cmp = memcmp(m_keys.data() + m_offsets[a], m_keys.data() + m_offsets[b], min(a_len, b_len));
+    if (cmp)
+        return cmp;
+    return int(a_len) - int(b_len);
+}
+
+//------------------------------------------------------------------------------
+void match_sort_keys::sort(std::vector<unsigned int>& order) const
+{
+    order.resize(size());
+    for (unsigned int i = 0; i < size(); ++i)
+        order[i] = i;
+
+    // Equal keys keep their original order, so the result is deterministic.
+    std::sort(order.begin(), order.end(), [this] (unsigned int a, unsigned int b) {
+        int cmp = compare(a, b);
+        return cmp ? (cmp < 0) : (a < b);
+    });
+}
+
+//------------------------------------------------------------------------------
+bool match_sort_keys::append_locale_key(const char* match, unsigned int len)
+{
+    wstr<> tmp;
+    str_iter iter(match, len);
+    to_utf16(tmp, iter);
+
+    // LCMapStringW produces the same ordering as CompareStringW with the same
+    // flags, and its sort keys never contain 0 bytes except the terminator.
+    const DWORD flags = LCMAP_SORTKEY|SORT_DIGITSASNUMBERS|NORM_LINGUISTIC_CASING|LINGUISTIC_IGNORECASE;
+    int bytes = LCMapStringW(LOCALE_USER_DEFAULT, flags, tmp.c_str(), tmp.length(), nullptr, 0);
+    if (bytes <= 0)
+        return false;
+
+    size_t offset = m_keys.size();
+    m_keys.resize(offset + bytes);
+    bytes = LCMapStringW(LOCALE_USER_DEFAULT, flags, tmp.c_str(), tmp.length(), LPWSTR(m_keys.data() + offset), bytes);
+    if (bytes <= 0)
+    {
+        m_keys.resize(offset);
+        return false;
+    }
+
+    // Drop the terminator; add() appends one for every collation.
+    m_keys.resize(offset + bytes);
+    while (m_keys.size() > offset && !m_keys.back())
+        m_keys.pop_back();
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void match_sort_keys::append_simple_key(const char* match, unsigned int len, std::vector<char>& out)
+{
+    // The simple collation is independent of the OS so that it orders matches
+    // identically everywhere.  It folds case, treats path separators as equal
+    // and sorting before other characters, and compares runs of digits as
+    // numbers.  The output never contains 0 bytes.
+    str_iter iter(match, len);
+    while (iter.more())
+    {
+        const char* ptr = iter.get_pointer();
+        int c = iter.next();
+        if (!c)
+            break;
+
+        if (c >= '0' && c <= '9')
+        {
+            // Encode a digit run as a marker, its significant length, and the
+            // significant digits, so longer numbers sort after shorter ones.
+            const char* end = iter.get_pointer();
+            while (iter.more() && *end >= '0' && *end <= '9')
+            {
+                iter.next();
+                end = iter.get_pointer();
+            }
+            while (ptr + 1 < end && *ptr == '0')
+                ++ptr;
+
+            unsigned int digits = unsigned(end - ptr);
+            out.push_back('0');
+            out.push_back(char(min<unsigned int>('0' + digits, 0xff)));
+            out.insert(out.end(), ptr, end);
+            continue;
+        }
+
+        if (path::is_separator(c))
+            c = 0x01;
+        else if (c < 0x80)
+            c = (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+        else if (c <= 0xffff)
+            c = int(towlower(wint_t(c)));
+
+        append_utf8(c, out);
+    }
+}
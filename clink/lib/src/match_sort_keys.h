@@ -0,0 +1,58 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#pragma once
+
+#include "matches.h"
+
+#include <algorithm>
+#include <vector>
+
+//------------------------------------------------------------------------------
+enum class sort_collation : unsigned char
+{
+    locale,         // Collate using the user's locale (like CompareStringW).
+    simple,         // Portable collation; folds case and compares digits as numbers.
+};
+
+//------------------------------------------------------------------------------
+class match_sort_keys
+{
+    // Builds one normalized sort key per match up front, so sorting only needs
+    // to memcmp the keys instead of converting and collating both operands in
+    // every comparison.
+    //
+    // Each key is laid out as:
+    //  - A directory bucket byte (for match.sort_dirs).
+    //  - The collation bytes, terminated by a 0 byte.
+    //  - A type rank byte, to order otherwise equal matches by type.
+
+public:
+                        match_sort_keys(int dir_order, sort_collation collation);
+    void                reserve(unsigned int count);
+    void                add(const char* match, match_type type);
+    void                add(const char* match, unsigned int len, match_type type);
+    unsigned int        size() const { return unsigned(m_offsets.size()); }
+    void                sort(std::vector<unsigned int>& order) const;
+    int                 compare(unsigned int a, unsigned int b) const;
+
+    static void         append_simple_key(const char* match, unsigned int len, std::vector<char>& out);
+
+private:
+    bool                append_locale_key(const char* match, unsigned int len);
+    std::vector<char>   m_keys;
+    std::vector<unsigned int> m_offsets;
+    int                 m_dir_order;
+    sort_collation      m_collation;
+};
+
+//------------------------------------------------------------------------------
+template <typename T>
+void apply_sort_order(T* items, const std::vector<unsigned int>& order)
+{
+    std::vector<T> sorted;
+    sorted.reserve(order.size());
+    for (unsigned int index : order)
+        sorted.push_back(items[index]);
+    std::copy(sorted.begin(), sorted.end(), items);
+}
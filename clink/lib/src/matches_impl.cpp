@@ -12,6 +12,7 @@
 #include <core/str_tokeniser.h>
 #include <core/match_wild.h>
 #include <core/path.h>
+#include <terminal/ecma48_iter.h>
 #include <sys/stat.h>
 
 extern "C" {
@@ -175,6 +176,37 @@ void match_type_to_string(match_type type, str_base& out)
         out.concat(",readonly");
 }
 
+
+
+//------------------------------------------------------------------------------
+void match_extras::add(const char* match, const match_file_info* file_info, match_width width)
+{
+    extra& e = m_extras[match];
+    e.file_info = file_info ? *file_info : match_file_info();
+    e.width = width;
+}
+
+//------------------------------------------------------------------------------
+const match_file_info* match_extras::get_file_info(const char* match) const
+{
+    // Enumerated files always have at least one attribute bit set, so zero
+    // attributes means no file info.
+    auto it = m_extras.find(match);
+    if (it == m_extras.end() || !it->second.file_info.attr)
+        return nullptr;
+    return &it->second.file_info;
+}
+
+//------------------------------------------------------------------------------
+bool match_extras::get_width(const char* match, match_width& out) const
+{
+    auto it = m_extras.find(match);
+    if (it == m_extras.end())
+        return false;
+    out = it->second.width;
+    return true;
+}
+
 //------------------------------------------------------------------------------
 match_builder::match_builder(matches& matches)
 : m_matches(matches)
@@ -198,6 +230,56 @@ bool match_builder::add_match(const match_desc& desc, bool already_normalized)
     return ((matches_impl&)m_matches).add_match(desc, already_normalized);
 }
 
+//------------------------------------------------------------------------------
+match_batch::match_batch(match_builder& builder, match_type type, bool already_normalised)
+: m_matches(builder.m_matches)
+{
+    ((const matches_impl&)m_matches).get_add_rules(type, already_normalised, m_rules);
+}
+
+//------------------------------------------------------------------------------
+bool match_batch::add(const char* match, unsigned int len)
+{
+    return ((matches_impl&)m_matches).add_match(match, len, m_rules);
+}
+
+//------------------------------------------------------------------------------
+unsigned int match_batch::add_from_string(const char* text, unsigned int len, const char* separators, unsigned int* total)
+{
+    // Separators are ASCII, so a byte lookup can't split a UTF8 sequence.
+    bool seps[128] = {};
+    for (const char* walk = separators; *walk; ++walk)
+        if ((unsigned char)*walk < sizeof_array(seps))
+            seps[*walk] = true;
+
+    auto is_sep = [&seps] (char c) {
+        return (unsigned char)c < sizeof_array(seps) && seps[c];
+    };
+
+    unsigned int count = 0;
+    unsigned int tokens = 0;
+    const char* end = text + len;
+    while (text < end)
+    {
+        while (text < end && is_sep(*text))
+            ++text;
+
+        const char* start = text;
+        while (text < end && !is_sep(*text))
+            ++text;
+
+        if (text > start)
+        {
+            ++tokens;
+            count += !!add(start, unsigned(text - start));
+        }
+    }
+
+    if (total)
+        *total = tokens;
+    return count;
+}
+
 //------------------------------------------------------------------------------
 void match_builder::set_append_character(char append)
 {
@@ -216,6 +298,12 @@ void match_builder::set_suppress_quoting(int suppress)
     return ((matches_impl&)m_matches).set_suppress_quoting(suppress);
 }
 
+//------------------------------------------------------------------------------
+void match_builder::set_partial(bool partial)
+{
+    return ((matches_impl&)m_matches).set_partial(partial);
+}
+
 //------------------------------------------------------------------------------
 void match_builder::set_matches_are_files(bool files)
 {
@@ -259,7 +347,7 @@ bool matches_iter::next()
                 return false;
             }
 
-            int match_len = int(strlen(match));
+            int match_len = int(m_matches.get_unfiltered_match_length(m_index));
             while (match_len && path::is_separator((unsigned char)match[match_len - 1]))
                 match_len--;
             if (path::match_wild(m_pattern, str_iter(match, match_len), !is_pathish(get_match_type())))
@@ -288,6 +376,14 @@ const char* matches_iter::get_match() const
     return has_match() ? m_matches.get_match(m_index) : nullptr;
 }
 
+//------------------------------------------------------------------------------
+unsigned int matches_iter::get_match_length() const
+{
+    if (m_has_pattern)
+        return has_match() ? m_matches.get_unfiltered_match_length(m_index) : 0;
+    return has_match() ? m_matches.get_match_length(m_index) : 0;
+}
+
 //------------------------------------------------------------------------------
 match_type matches_iter::get_match_type() const
 {
@@ -296,6 +392,22 @@ match_type matches_iter::get_match_type() const
     return has_match() ? m_matches.get_match_type(m_index) : match_type::none;
 }
 
+//------------------------------------------------------------------------------
+const match_file_info* matches_iter::get_match_file_info() const
+{
+    if (m_has_pattern)
+        return has_match() ? m_matches.get_unfiltered_match_file_info(m_index) : nullptr;
+    return has_match() ? m_matches.get_match_file_info(m_index) : nullptr;
+}
+
+//------------------------------------------------------------------------------
+match_width matches_iter::get_match_width() const
+{
+    if (m_has_pattern)
+        return has_match() ? m_matches.get_unfiltered_match_width(m_index) : match_width();
+    return has_match() ? m_matches.get_match_width(m_index) : match_width();
+}
+
 //------------------------------------------------------------------------------
 shadow_bool matches_iter::is_filename_completion_desired() const
 {
@@ -315,75 +427,269 @@ shadow_bool matches_iter::is_filename_display_desired() const
 
 
 //------------------------------------------------------------------------------
-matches_impl::store_impl::store_impl(unsigned int size)
+static unsigned int measure_width(const char* text, unsigned int len)
 {
-    m_size = max((unsigned int)4096, size);
-    m_ptr = nullptr;
-    new_page();
+    // Same as Readline's fnwidth(), which is how the match is displayed.
+    unsigned int width = 0;
+    str_iter iter(text, len);
+    while (int c = iter.next())
+    {
+        if (c < ' ' || c == 0x7f)
+            width += 2;
+        else
+        {
+            const int w = clink_wcwidth(c);
+            width += (w >= 0) ? w : 1;
+        }
+    }
+    return width;
 }
 
 //------------------------------------------------------------------------------
-matches_impl::store_impl::~store_impl()
+static unsigned int get_name_offset(const char* match, unsigned int len)
 {
-    free_chain(false/*keep_one*/);
+    // Same as Readline's printable_part(), which picks the part of the match
+    // that's displayed when displaying filenames.
+    const char* sep = nullptr;
+    for (const char* walk = match + len; walk-- > match;)
+        if (path::is_separator(*walk))
+        {
+            sep = walk;
+            break;
+        }
+
+    if (!sep && len >= 2 && isalpha((unsigned char)match[0]) && match[1] == ':')
+        sep = match + 1;
+
+    if (!sep || (sep[1] == '\0' && sep == match))
+        return 0;
+
+    if (sep[1] == '\0')
+    {
+        const char* walk = sep - 1;
+        for (; walk > match; --walk)
+            if (path::is_separator(*walk))
+                break;
+        return path::is_separator(*walk) ? unsigned(walk + 1 - match) : 0;
+    }
+
+    return unsigned(sep + 1 - match);
 }
 
 //------------------------------------------------------------------------------
-void matches_impl::store_impl::reset()
+static match_width measure_match(const char* match, unsigned int len)
 {
-    free_chain(true/*keep_one*/);
-    m_back = m_size;
-    m_front = sizeof(m_ptr);
+    const unsigned int offset = get_name_offset(match, len);
+
+    match_width width;
+    width.name_width = measure_width(match + offset, len - offset);
+    width.width = measure_width(match, offset) + width.name_width;
+    return width;
 }
 
 //------------------------------------------------------------------------------
-const char* matches_impl::store_impl::store_front(const char* str)
+const match_file_info* match_infos::get_file_info(unsigned int index) const
 {
-    unsigned int size = get_size(str);
-    unsigned int next = m_front + size;
-    if (next > m_back && !new_page())
+    if (index >= m_file_infos.size())
         return nullptr;
 
-    str_base(m_ptr + m_front, size).copy(str);
+    // Enumerated files always have at least one attribute bit set (e.g.
+    // FILE_ATTRIBUTE_NORMAL), so zero attributes means no file info.
+    const match_file_info& info = m_file_infos[index];
+    return info.attr ? &info : nullptr;
+}
 
-    const char* ret = m_ptr + m_front;
-    m_front = next;
-    return ret;
+//------------------------------------------------------------------------------
+void match_infos::set_selected(unsigned int index, bool select)
+{
+    unsigned int bit = 1u << (index & 31);
+    if (select)
+        m_selected[index >> 5] |= bit;
+    else
+        m_selected[index >> 5] &= ~bit;
 }
 
 //------------------------------------------------------------------------------
-const char* matches_impl::store_impl::store_back(const char* str)
+void match_infos::reserve(unsigned int count)
 {
-    unsigned int size = get_size(str);
-    unsigned int next = m_back - size;
-    if (next < m_front && !new_page())
-        return nullptr;
+    m_matches.reserve(count);
+    m_lengths.reserve(count);
+    m_types.reserve(count);
+    m_widths.reserve(count);
+    m_selected.reserve((count + 31) / 32);
+}
 
-    m_back = next;
-    str_base(m_ptr + m_back, size).copy(str);
+//------------------------------------------------------------------------------
+void match_infos::push_back(const char* match, unsigned int length, match_type type, const match_file_info* file_info)
+{
+    unsigned int index = size();
+    m_matches.push_back(match);
+    m_lengths.push_back(length);
+    m_types.push_back(type);
+    m_widths.push_back(measure_match(match, length));
+    if ((index & 31) == 0)
+        m_selected.push_back(0);
+
+    // The file info column is only populated once some match has file info,
+    // so matches that aren't files don't pay for it.
+    if (file_info || !m_file_infos.empty())
+    {
+        m_file_infos.resize(index);
+        m_file_infos.push_back(file_info ? *file_info : match_file_info());
+    }
+}
+
+//------------------------------------------------------------------------------
+void match_infos::swap(unsigned int a, unsigned int b)
+{
+    std::swap(m_matches[a], m_matches[b]);
+    std::swap(m_lengths[a], m_lengths[b]);
+    std::swap(m_types[a], m_types[b]);
+    std::swap(m_widths[a], m_widths[b]);
+    if (!m_file_infos.empty())
+        std::swap(m_file_infos[a], m_file_infos[b]);
+
+    bool select_a = is_selected(a);
+    set_selected(a, is_selected(b));
+    set_selected(b, select_a);
+}
+
+//------------------------------------------------------------------------------
+void match_infos::reorder(const std::vector<unsigned int>& order)
+{
+    // Reorders the first order.size() entries; order[i] is the index of the
+    // entry that moves to index i.
+    unsigned int count = unsigned(order.size());
+    assert(count <= size());
+
+    std::vector<const char*> matches(count);
+    std::vector<unsigned int> lengths(count);
+    std::vector<match_type> types(count);
+    std::vector<match_width> widths(count);
+    std::vector<match_file_info> file_infos(m_file_infos.empty() ? 0 : count);
+    std::vector<unsigned int> selected(m_selected.begin(), m_selected.begin() + (count + 31) / 32);
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        unsigned int from = order[i];
+        matches[i] = m_matches[from];
+        lengths[i] = m_lengths[from];
+        types[i] = m_types[from];
+        widths[i] = m_widths[from];
+        if (!file_infos.empty())
+            file_infos[i] = m_file_infos[from];
+        unsigned int bit = 1u << (i & 31);
+        if (is_selected(from))
+            selected[i >> 5] |= bit;
+        else
+            selected[i >> 5] &= ~bit;
+    }
 
-    return m_ptr + m_back;
+    std::copy(matches.begin(), matches.end(), m_matches.begin());
+    std::copy(lengths.begin(), lengths.end(), m_lengths.begin());
+    std::copy(types.begin(), types.end(), m_types.begin());
+    std::copy(widths.begin(), widths.end(), m_widths.begin());
+    std::copy(file_infos.begin(), file_infos.end(), m_file_infos.begin());
+    std::copy(selected.begin(), selected.end(), m_selected.begin());
 }
 
 //------------------------------------------------------------------------------
-unsigned int matches_impl::store_impl::get_size(const char* str) const
+void match_infos::resize(unsigned int count)
 {
-    if (str == nullptr)
-        return 1;
+    assert(count <= size());
+    m_matches.resize(count);
+    m_lengths.resize(count);
+    m_types.resize(count);
+    m_widths.resize(count);
+    if (!m_file_infos.empty())
+        m_file_infos.resize(count);
+    m_selected.resize((count + 31) / 32);
+}
+
+//------------------------------------------------------------------------------
+void match_infos::clear()
+{
+    m_matches.clear();
+    m_lengths.clear();
+    m_types.clear();
+    m_widths.clear();
+    m_selected.clear();
+    m_file_infos.clear();
+}
+
+
 
-    return int(strlen(str) + 1);
+//------------------------------------------------------------------------------
+matches_impl::store_impl::store_impl(unsigned int size)
+{
+    m_initial_size = max((unsigned int)4096, size);
+    m_size = m_initial_size;
+    m_ptr = nullptr;
+    new_page(0);
 }
 
 //------------------------------------------------------------------------------
-bool matches_impl::store_impl::new_page()
+matches_impl::store_impl::~store_impl()
 {
-    char* temp = (char*)malloc(m_size);
+    free_chain(false/*keep_one*/);
+}
+
+//------------------------------------------------------------------------------
+void matches_impl::store_impl::reset()
+{
+    // Keeps the most recent page, which is the largest, unless it grew too
+    // large to be worth holding on to until the next completion.  Then start
+    // over with a page of the initial size.
+    if (m_size > max(m_initial_size, max_kept_page_size))
+    {
+        free_chain(false/*keep_one*/);
+        m_size = m_initial_size;
+        new_page(0);
+    }
+    else
+    {
+        free_chain(true/*keep_one*/);
+    }
+    m_front = sizeof(m_ptr);
+}
+
+//------------------------------------------------------------------------------
+const char* matches_impl::store_impl::store_front(const char* str, unsigned int len)
+{
+    unsigned int size = len + 1;
+    unsigned int next = m_front + size;
+    if (next > m_size || next < m_front)
+    {
+        if (!new_page(size))
+            return nullptr;
+        next = m_front + size;
+    }
+
+    char* ret = m_ptr + m_front;
+    memcpy(ret, str, len);
+    ret[len] = '\0';
+
+    m_front = next;
+    return ret;
+}
+
+//------------------------------------------------------------------------------
+bool matches_impl::store_impl::new_page(unsigned int min_size)
+{
+    // Grow geometrically up to a limit, but always fit the requested size.
+    const unsigned int max_page_size = 4 << 20;
+    unsigned int size = m_size;
+    if (m_ptr && size < max_page_size)
+        size = min(size * 2, max_page_size);
+    if (min_size > size - sizeof(m_ptr))
+        size = min_size + sizeof(m_ptr);
+
+    char* temp = (char*)malloc(size);
     if (temp == nullptr)
         return false;
 
     *reinterpret_cast<char**>(temp) = m_ptr;
     m_front = sizeof(m_ptr);
-    m_back = m_size;
+    m_size = size;
     m_ptr = temp;
     return true;
 }
@@ -397,7 +703,6 @@ void matches_impl::store_impl::free_chain(bool keep_one)
     {
         m_ptr = nullptr;
         m_front = sizeof(m_ptr);
-        m_back = m_size;
     }
 
     while (ptr)
@@ -418,7 +723,7 @@ void matches_impl::store_impl::free_chain(bool keep_one)
 
 //------------------------------------------------------------------------------
 matches_impl::matches_impl(generators* generators, unsigned int store_size)
-: m_store(min(store_size, 0x10000u))
+: m_store(store_size)
 , m_generators(generators)
 , m_filename_completion_desired(false)
 , m_filename_display_desired(false)
@@ -441,43 +746,58 @@ matches_iter matches_impl::get_iter(const char* pattern) const
 //------------------------------------------------------------------------------
 unsigned int matches_impl::get_info_count() const
 {
-    return int(m_infos.size());
+    return m_infos.size();
 }
 
 //------------------------------------------------------------------------------
-const match_info* matches_impl::get_infos() const
+unsigned int matches_impl::get_match_count() const
 {
-    return m_infos.size() ? &(m_infos[0]) : nullptr;
+    return m_count;
 }
 
 //------------------------------------------------------------------------------
-match_info* matches_impl::get_infos()
+const char* matches_impl::get_match(unsigned int index) const
 {
-    return m_infos.size() ? &(m_infos[0]) : nullptr;
+    if (index >= get_match_count())
+        return nullptr;
+
+    return m_infos.get_match(index);
 }
 
 //------------------------------------------------------------------------------
-unsigned int matches_impl::get_match_count() const
+unsigned int matches_impl::get_match_length(unsigned int index) const
 {
-    return m_count;
+    if (index >= get_match_count())
+        return 0;
+
+    return m_infos.get_length(index);
 }
 
 //------------------------------------------------------------------------------
-const char* matches_impl::get_match(unsigned int index) const
+match_type matches_impl::get_match_type(unsigned int index) const
+{
+    if (index >= get_match_count())
+        return match_type::none;
+
+    return m_infos.get_type(index);
+}
+
+//------------------------------------------------------------------------------
+const match_file_info* matches_impl::get_match_file_info(unsigned int index) const
 {
     if (index >= get_match_count())
         return nullptr;
 
-    return m_infos[index].match;
+    return m_infos.get_file_info(index);
 }
 
 //------------------------------------------------------------------------------
-match_type matches_impl::get_match_type(unsigned int index) const
+match_width matches_impl::get_match_width(unsigned int index) const
 {
     if (index >= get_match_count())
-        return match_type::none;
+        return match_width();
 
-    return m_infos[index].type;
+    return m_infos.get_width(index);
 }
 
 //------------------------------------------------------------------------------
@@ -486,7 +806,16 @@ const char* matches_impl::get_unfiltered_match(unsigned int index) const
     if (index >= get_info_count())
         return nullptr;
 
-    return m_infos[index].match;
+    return m_infos.get_match(index);
+}
+
+//------------------------------------------------------------------------------
+unsigned int matches_impl::get_unfiltered_match_length(unsigned int index) const
+{
+    if (index >= get_info_count())
+        return 0;
+
+    return m_infos.get_length(index);
 }
 
 //------------------------------------------------------------------------------
@@ -495,7 +824,25 @@ match_type matches_impl::get_unfiltered_match_type(unsigned int index) const
     if (index >= get_info_count())
         return match_type::none;
 
-    return m_infos[index].type;
+    return m_infos.get_type(index);
+}
+
+//------------------------------------------------------------------------------
+const match_file_info* matches_impl::get_unfiltered_match_file_info(unsigned int index) const
+{
+    if (index >= get_info_count())
+        return nullptr;
+
+    return m_infos.get_file_info(index);
+}
+
+//------------------------------------------------------------------------------
+match_width matches_impl::get_unfiltered_match_width(unsigned int index) const
+{
+    if (index >= get_info_count())
+        return match_width();
+
+    return m_infos.get_width(index);
 }
 
 //------------------------------------------------------------------------------
@@ -504,6 +851,12 @@ bool matches_impl::is_suppress_append() const
     return m_suppress_append;
 }
 
+//------------------------------------------------------------------------------
+bool matches_impl::is_partial() const
+{
+    return m_partial;
+}
+
 //------------------------------------------------------------------------------
 shadow_bool matches_impl::is_filename_completion_desired() const
 {
@@ -541,7 +894,7 @@ int matches_impl::get_word_break_position() const
 }
 
 //------------------------------------------------------------------------------
-bool matches_impl::match_display_filter(char** matches, match_display_filter_entry*** filtered_matches, bool popup) const
+bool matches_impl::match_display_filter(char** matches, const match_extras* extras, match_display_filter_entry*** filtered_matches, bool popup) const
 {
     // TODO:  This doesn't really belong here.  But it's a convenient point to
     // cobble together Lua (via the generators) and the matches.  It's strange
@@ -554,7 +907,7 @@ bool matches_impl::match_display_filter(char** matches, match_display_filter_ent
         return false;
 
     for (auto *generator : *m_generators)
-        if (generator->match_display_filter(matches, filtered_matches, popup))
+        if (generator->match_display_filter(matches, extras, filtered_matches, popup))
             return true;
 
     return false;
@@ -570,10 +923,14 @@ void matches_impl::reset()
     m_append_character = '\0';
     m_regen_blocked = false;
     m_suppress_append = false;
+    m_partial = false;
     m_suppress_quoting = 0;
     m_word_break_position = -1;
     m_filename_completion_desired.reset();
     m_filename_display_desired.reset();
+    m_selection_needle.clear();
+    m_selection_mode = -1;
+    m_selection_sorted = false;
 
     s_slash_translation = g_translate_slashes.get();
 }
@@ -590,6 +947,12 @@ void matches_impl::set_suppress_append(bool suppress)
     m_suppress_append = suppress;
 }
 
+//------------------------------------------------------------------------------
+void matches_impl::set_partial(bool partial)
+{
+    m_partial = partial;
+}
+
 //------------------------------------------------------------------------------
 void matches_impl::set_suppress_quoting(int suppress)
 {
@@ -618,62 +981,79 @@ void matches_impl::set_matches_are_files(bool files)
 //------------------------------------------------------------------------------
 bool matches_impl::add_match(const match_desc& desc, bool already_normalized)
 {
-    const char* match = desc.match;
-    match_type type = desc.type;
-
-    if (m_coalesced || match == nullptr || !*match)
+    if (m_coalesced || desc.match == nullptr || !*desc.match)
         return false;
 
-    char* sep = rl_last_path_separator(match);
-    bool ends_with_sep = (sep && !sep[1]);
-
-    if (is_match_type(desc.type, match_type::none) && ends_with_sep)
-        type |= match_type::dir;
-
-    // Slash translation happens only for dir, file, and none match types.  And
-    // only when `clink.slash_translation` is enabled.  already_normalized means
-    // desc has already been normalized to system format, and a performance
-    // optimization can skip translation if system format is configured.
-    int mode = (s_slash_translation &&
-                (is_match_type(type, match_type::dir) ||
-                 is_match_type(type, match_type::file) ||
-                 (is_match_type(type, match_type::none) &&
-                  m_filename_completion_desired.get()))) ? s_slash_translation : 0;
-    bool translate = (mode > 0 && (mode > 1 || !already_normalized));
+    match_add_rules rules[2];
+    get_add_rules(desc.type, already_normalized, rules);
+    return add_match(desc.match, unsigned(strlen(desc.match)), rules, desc.file_info);
+}
 
-    str<280> tmp;
-    if (is_match_type(type, match_type::dir) && !ends_with_sep)
+//------------------------------------------------------------------------------
+void matches_impl::get_add_rules(match_type type, bool already_normalized, match_add_rules (&rules)[2]) const
+{
+    for (int ends_with_sep = 0; ends_with_sep < 2; ++ends_with_sep)
     {
+        match_type resolved = type;
+        if (is_match_type(type, match_type::none) && ends_with_sep)
+            resolved |= match_type::dir;
+
+        // Slash translation happens only for dir, file, and none match types.
+        // And only when `clink.slash_translation` is enabled.
+        // already_normalized means the match has already been normalized to
+        // system format, and a performance optimization can skip translation
+        // if system format is configured.
+        int mode = (s_slash_translation &&
+                    (is_match_type(resolved, match_type::dir) ||
+                     is_match_type(resolved, match_type::file) ||
+                     (is_match_type(resolved, match_type::none) &&
+                      m_filename_completion_desired.get()))) ? s_slash_translation : 0;
+        bool translate = (mode > 0 && (mode > 1 || !already_normalized));
+
+        match_add_rules& rule = rules[ends_with_sep];
+        rule.type = resolved;
+        rule.translate = -1;
+        if (translate)
+        {
+            switch (mode)
+            {
+            default:    rule.translate = 0; break;
+            case 2:     rule.translate = '/'; break;
+            case 3:     rule.translate = '\\'; break;
+            }
+        }
+
         // insert_match() relies on Clink always including a trailing path
         // separator on directory matches, so add one if the caller omitted it.
-        tmp = match;
-        path::append(tmp, "");
-        match = tmp.c_str();
-    }
-    else if (translate)
-    {
-        tmp = match;
+        rule.append_sep = (is_match_type(resolved, match_type::dir) && !ends_with_sep);
     }
+}
+
+//------------------------------------------------------------------------------
+bool matches_impl::add_match(const char* match, unsigned int len, const match_add_rules (&rules)[2], const match_file_info* file_info)
+{
+    if (m_coalesced || !len)
+        return false;
 
-    if (translate)
+    const match_add_rules& rule = rules[rl_is_path_separator(match[len - 1]) ? 1 : 0];
+
+    str<280> tmp;
+    if (rule.append_sep || rule.translate >= 0)
     {
-        assert(mode > 0);
-        int sep;
-        switch (mode)
-        {
-        default:    sep = 0; break;
-        case 2:     sep = '/'; break;
-        case 3:     sep = '\\'; break;
-        }
-        path::normalise_separators(tmp, sep);
+        tmp.concat(match, len);
+        if (rule.append_sep)
+            path::append(tmp, "");
+        if (rule.translate >= 0)
+            path::normalise_separators(tmp, rule.translate);
         match = tmp.c_str();
+        len = tmp.length();
     }
 
-    const char* store_match = m_store.store_front(match);
+    const char* store_match = m_store.store_front(match, len);
     if (!store_match)
         return false;
 
-    m_infos.push_back({ store_match, type, false });
+    m_infos.push_back(store_match, len, rule.type, file_info);
     ++m_count;
     return true;
 }
@@ -681,28 +1061,24 @@ bool matches_impl::add_match(const match_desc& desc, bool already_normalized)
 //------------------------------------------------------------------------------
 void matches_impl::coalesce(unsigned int count_hint, bool restrict)
 {
-    match_info* infos = get_infos();
+    match_infos& infos = m_infos;
 
     bool any_pathish = false;
     bool all_pathish = true;
 
     unsigned int j = 0;
-    for (unsigned int i = 0, n = m_infos.size(); i < n && j < count_hint; ++i)
+    for (unsigned int i = 0, n = infos.size(); i < n && j < count_hint; ++i)
     {
-        if (!infos[i].select)
+        if (!infos.is_selected(i))
             continue;
 
-        if (is_pathish(infos[i].type))
+        if (is_pathish(infos.get_type(i)))
             any_pathish = true;
         else
             all_pathish = false;
 
         if (i != j)
-        {
-            match_info temp = infos[j];
-            infos[j] = infos[i];
-            infos[i] = temp;
-        }
+            infos.swap(i, j);
         ++j;
     }
 
@@ -713,5 +1089,35 @@ void matches_impl::coalesce(unsigned int count_hint, bool restrict)
     m_coalesced = true;
 
     if (restrict)
-        m_infos.resize(j);
+    {
+        infos.resize(j);
+        m_selection_mode = -1;
+        m_selection_sorted = false;
+    }
+}
+
+//------------------------------------------------------------------------------
+bool matches_impl::can_narrow_selection(const char* needle) const
+{
+    if (!m_coalesced || m_selection_mode < 0)
+        return false;
+
+    if (m_selection_mode != str_compare_scope::current() ||
+        m_selection_fuzzy != str_compare_scope::current_fuzzy_accents())
+        return false;
+
+    // The new needle must extend the previous one at a character boundary.
+    unsigned int len = m_selection_needle.length();
+    if (strncmp(needle, m_selection_needle.c_str(), len) != 0)
+        return false;
+    return (((unsigned char)needle[len] & 0xc0) != 0x80);
+}
+
+//------------------------------------------------------------------------------
+void matches_impl::set_selection_needle(const char* needle, bool narrowed)
+{
+    m_selection_needle = needle;
+    m_selection_mode = str_compare_scope::current();
+    m_selection_fuzzy = str_compare_scope::current_fuzzy_accents();
+    m_selection_sorted = narrowed && m_selection_sorted;
 }
@@ -9,11 +9,36 @@
 #include <vector>
 
 //------------------------------------------------------------------------------
-struct match_info
+class match_infos
 {
-    const char*     match;
-    match_type      type;
-    bool            select;
+    // Match metadata is stored column-wise, so passes over the matches (e.g.
+    // selecting, coalescing, and sorting) only touch the columns they need.
+    // Lengths and visible widths are cached so the match strings never need
+    // strlen or decoding again.
+
+public:
+    unsigned int            size() const { return unsigned(m_matches.size()); }
+    const char*             get_match(unsigned int index) const { return m_matches[index]; }
+    unsigned int            get_length(unsigned int index) const { return m_lengths[index]; }
+    match_type              get_type(unsigned int index) const { return m_types[index]; }
+    const match_width&      get_width(unsigned int index) const { return m_widths[index]; }
+    const match_file_info*  get_file_info(unsigned int index) const;
+    bool                    is_selected(unsigned int index) const { return !!(m_selected[index >> 5] & (1u << (index & 31))); }
+    void                    set_selected(unsigned int index, bool select);
+    void                    reserve(unsigned int count);
+    void                    push_back(const char* match, unsigned int length, match_type type, const match_file_info* file_info=nullptr);
+    void                    swap(unsigned int a, unsigned int b);
+    void                    reorder(const std::vector<unsigned int>& order);
+    void                    resize(unsigned int count);
+    void                    clear();
+
+private:
+    std::vector<const char*>    m_matches;
+    std::vector<unsigned int>   m_lengths;
+    std::vector<match_type>     m_types;
+    std::vector<match_width>    m_widths;
+    std::vector<unsigned int>   m_selected;     // Bitmap.
+    std::vector<match_file_info> m_file_infos;  // Empty until a match has file info.
 };
 
 
@@ -44,14 +69,18 @@ public:
 
     virtual unsigned int    get_match_count() const override;
     virtual const char*     get_match(unsigned int index) const override;
+    virtual unsigned int    get_match_length(unsigned int index) const override;
     virtual match_type      get_match_type(unsigned int index) const override;
+    virtual const match_file_info* get_match_file_info(unsigned int index) const override;
+    virtual match_width     get_match_width(unsigned int index) const override;
     virtual bool            is_suppress_append() const override;
+    virtual bool            is_partial() const override;
     virtual shadow_bool     is_filename_completion_desired() const override;
     virtual shadow_bool     is_filename_display_desired() const override;
     virtual char            get_append_character() const override;
     virtual int             get_suppress_quoting() const override;
     virtual int             get_word_break_position() const override;
-    virtual bool            match_display_filter(char** matches, match_display_filter_entry*** filtered_matches, bool popup) const override;
+    virtual bool            match_display_filter(char** matches, const match_extras* extras, match_display_filter_entry*** filtered_matches, bool popup) const override;
 
     void                    set_word_break_position(int position);
     void                    set_regen_blocked();
@@ -59,53 +88,73 @@ public:
 
 private:
     virtual const char*     get_unfiltered_match(unsigned int index) const override;
+    virtual unsigned int    get_unfiltered_match_length(unsigned int index) const override;
     virtual match_type      get_unfiltered_match_type(unsigned int index) const override;
+    virtual const match_file_info* get_unfiltered_match_file_info(unsigned int index) const override;
+    virtual match_width     get_unfiltered_match_width(unsigned int index) const override;
 
     friend class            match_pipeline;
     friend class            match_builder;
+    friend class            match_batch;
     friend class            matches_iter;
     void                    set_append_character(char append);
     void                    set_suppress_append(bool suppress);
     void                    set_suppress_quoting(int suppress);
+    void                    set_partial(bool partial);
     void                    set_matches_are_files(bool files);
     bool                    add_match(const match_desc& desc, bool already_normalised=false);
+    bool                    add_match(const char* match, unsigned int len, const match_add_rules (&rules)[2], const match_file_info* file_info=nullptr);
+    void                    get_add_rules(match_type type, bool already_normalised, match_add_rules (&rules)[2]) const;
     unsigned int            get_info_count() const;
-    const match_info*       get_infos() const;
-    match_info*             get_infos();
+    const match_infos&      get_infos() const { return m_infos; }
+    match_infos&            get_infos() { return m_infos; }
     void                    reset();
     void                    coalesce(unsigned int count_hint, bool restrict=false);
+    bool                    can_narrow_selection(const char* needle) const;
+    void                    set_selection_needle(const char* needle, bool narrowed);
+    bool                    is_selection_sorted() const { return m_selection_sorted; }
+    void                    set_selection_sorted() { m_selection_sorted = true; }
 
 private:
     class store_impl
         : public match_store
     {
+        // A growable arena.  Pages are chained and never move, so stored
+        // strings stay put while more are added.  Each new page is larger than
+        // the last, so large match sets need few allocations.
     public:
                             store_impl(unsigned int size);
                             ~store_impl();
         void                reset();
-        const char*         store_front(const char* str);
-        const char*         store_back(const char* str);
+        const char*         store_front(const char* str, unsigned int len);
 
     private:
-        unsigned int        get_size(const char* str) const;
-        bool                new_page();
+        static const unsigned int max_kept_page_size = 256 << 10;
+        bool                new_page(unsigned int min_size);
         void                free_chain(bool keep_one);
         unsigned int        m_front;
-        unsigned int        m_back;
+        unsigned int        m_initial_size;
     };
 
-    typedef std::vector<match_info> infos;
-
     store_impl              m_store;
     generators*             m_generators;
-    infos                   m_infos;
-    unsigned short          m_count = 0;
+    match_infos             m_infos;
+    unsigned int            m_count = 0;
     bool                    m_coalesced = false;
     char                    m_append_character = '\0';
     bool                    m_suppress_append = false;
+    bool                    m_partial = false;
     bool                    m_regen_blocked = false;
     int                     m_suppress_quoting = 0;
     int                     m_word_break_position = -1;
     shadow_bool             m_filename_completion_desired;
     shadow_bool             m_filename_display_desired;
+
+    // The needle and compare scope of the most recent selection.  A needle
+    // that extends it can only narrow the selection, so the next selection
+    // only needs to filter the current survivors.
+    str_moveable            m_selection_needle;
+    int                     m_selection_mode = -1;
+    bool                    m_selection_fuzzy = false;
+    bool                    m_selection_sorted = false;
 };
@@ -77,7 +77,7 @@ extern void host_add_history(int rl_history_index, const char* line);
 extern void host_remove_history(int rl_history_index, const char* line);
 extern void sort_match_list(char** matches, int len);
 extern int macro_hook_func(const char* macro);
-extern int host_filter_matches(char** matches);
+extern int host_filter_matches(char** matches, const match_extras* extras);
 extern void update_matches();
 extern void reset_generate_matches();
 extern void force_update_internal(bool restrict, bool sort);
@@ -102,6 +102,11 @@ static rl_command_func_t* s_override_rl_last_func = nullptr;
 static int          s_init_history_pos = -1;    // Sticky history position from previous edit line.
 static int          s_history_search_pos = -1;  // Most recent history search position during current edit line.
 
+// File metadata and visible widths for the match strings given to readline,
+// keyed by the address of each string (which includes the leading match type
+// byte).  Cleared when readline frees the match list.
+static match_extras s_match_extras;
+
 //------------------------------------------------------------------------------
 setting_bool g_classify_words(
     "clink.colorize_input",
@@ -244,6 +249,14 @@ setting_bool g_prompt_async(
     "Enables asynchronous prompt refresh",
     true);
 
+static setting_int g_prompt_async_limit(
+    "prompt.async_limit",
+    "Max concurrent io.popenyield commands",
+    "Limits how many commands started by io.popenyield() can run at the same\n"
+    "time.  Additional commands wait until one of the running commands\n"
+    "finishes.",
+    4);
+
 static setting_bool g_rl_hide_stderr(
     "readline.hide_stderr",
     "Suppress stderr from the Readline library",
@@ -866,6 +879,7 @@ void update_rl_modes_from_matches(const matches* matches, const matches_iter& it
     }
 
     rl_completion_suppress_append = matches->is_suppress_append();
+    rl_completion_display_only = matches->is_partial();
     if (matches->get_append_character())
         rl_completion_append_character = matches->get_append_character();
 
@@ -879,12 +893,32 @@ void update_rl_modes_from_matches(const matches* matches, const matches_iter& it
         printf("filename completion desired = %d (%s)\n", rl_filename_completion_desired, iter.is_filename_completion_desired().is_explicit() ? "explicit" : "implicit");
         printf("filename display desired = %d (%s)\n", rl_filename_display_desired, iter.is_filename_display_desired().is_explicit() ? "explicit" : "implicit");
         printf("is suppress append = %d\n", matches->is_suppress_append());
+        printf("is partial = %d\n", matches->is_partial());
         printf("get append character = %u\n", (unsigned char)matches->get_append_character());
         printf("get suppress quoting = %d\n", matches->get_suppress_quoting());
     }
 #endif
 }
 
+//------------------------------------------------------------------------------
+static int match_width_callback(const char* match)
+{
+    if (!match || !rl_completion_matches_include_type)
+        return -1;
+
+    match_width width;
+    if (!s_match_extras.get_width(match, width))
+        return -1;
+
+    return rl_filename_display_desired ? width.name_width : width.width;
+}
+
+//------------------------------------------------------------------------------
+static void free_match_list_hook(char** matches)
+{
+    s_match_extras.clear();
+}
+
 //------------------------------------------------------------------------------
 static bool is_complete_with_wild()
 {
@@ -938,6 +972,8 @@ static char** alternative_matches(const char* text, int start, int end)
         return nullptr;
 
     rl_completion_matches_include_type = 1;
+    s_match_extras.clear();
+    s_match_extras.reserve(s_matches->get_match_count());
 
 #ifdef DEBUG
     const int debug_matches = dbg_get_env_int("DEBUG_MATCHES");
@@ -978,12 +1014,15 @@ static char** alternative_matches(const char* text, int start, int end)
         }
 
         const char* match = iter.get_match();
-        int match_len = strlen(match);
+        int match_len = iter.get_match_length();
         int match_size = past_flag + match_len + 1;
         matches[count] = (char*)malloc(match_size);
 
         if (past_flag)
+        {
             matches[count][0] = (char)type;
+            s_match_extras.add(matches[count], iter.get_match_file_info(), iter.get_match_width());
+        }
 
         str_base str(matches[count] + past_flag, match_size - past_flag);
         str.clear();
@@ -1009,12 +1048,18 @@ static match_display_filter_entry** match_display_filter(char** matches, bool po
         return nullptr;
 
     match_display_filter_entry** filtered_matches = nullptr;
-    if (!s_matches->match_display_filter(matches, &filtered_matches, popup))
+    if (!s_matches->match_display_filter(matches, &s_match_extras, &filtered_matches, popup))
         return nullptr;
 
     return filtered_matches;
 }
 
+//------------------------------------------------------------------------------
+static int filter_matches_callback(char** matches)
+{
+    return host_filter_matches(matches, &s_match_extras);
+}
+
 //------------------------------------------------------------------------------
 static match_display_filter_entry** match_display_filter_callback(char** matches)
 {
@@ -1070,6 +1115,17 @@ int clink_popup_complete(int count, int invoking_key)
         return 0;
     int past_flag = rl_completion_matches_include_type ? 1 : 0;
 
+    // Incomplete matches are only listed, since choosing one could pick a
+    // match that the full list wouldn't offer.
+    if (rl_completion_display_only)
+    {
+        display_matches(matches);
+        _rl_reset_completion_state();
+        free(orig_text);
+        _rl_free_match_list(matches);
+        return 0;
+    }
+
     // Identify common prefix.
     char* end_prefix = rl_last_path_separator(orig_text);
     if (end_prefix)
@@ -1404,7 +1460,7 @@ rl_module::rl_module(const char* shell_name, terminal_in* input, const char* sta
     rl_completer_word_break_characters = " \t\n\"'`@><=;|&{("; /* }) */
 
     // Completion and match display.
-    rl_ignore_some_completions_function = host_filter_matches;
+    rl_ignore_some_completions_function = filter_matches_callback;
     rl_attempted_completion_function = alternative_matches;
     rl_menu_completion_entry_function = filename_menu_completion_function;
     rl_adjust_completion_defaults = adjust_completion_defaults;
@@ -1412,6 +1468,8 @@ rl_module::rl_module(const char* shell_name, terminal_in* input, const char* sta
     rl_completion_display_matches_func = display_matches;
     rl_qsort_match_list_func = sort_match_list;
     rl_match_display_filter_func = match_display_filter_callback;
+    rl_match_width_func = match_width_callback;
+    rl_free_match_list_hook = free_match_list_hook;
     rl_is_exec_func = is_exec_ext;
     rl_postprocess_lcd_func = postprocess_lcd;
     rl_read_key_hook = read_key_hook;
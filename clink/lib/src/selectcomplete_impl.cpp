@@ -218,8 +218,8 @@ unsigned int match_adapter::get_match_visible_display(unsigned int index) const
         return m_filtered_matches[index + 1]->visible_display;
     if (m_matches)
     {
-        const char* display = printable_part(const_cast<char*>(m_matches->get_match(index)));
-        return printable_len(display);
+        const match_width width = get_match_width(index);
+        return rl_filename_display_desired ? width.name_width : width.width;
     }
     return 0;
 }
@@ -250,6 +250,26 @@ match_type match_adapter::get_match_type(unsigned int index) const
     return match_type::none;
 }
 
+//------------------------------------------------------------------------------
+const match_file_info* match_adapter::get_match_file_info(unsigned int index) const
+{
+    if (m_filtered_matches)
+        return nullptr;
+    if (m_matches)
+        return m_matches->get_match_file_info(index);
+    return nullptr;
+}
+
+//------------------------------------------------------------------------------
+match_width match_adapter::get_match_width(unsigned int index) const
+{
+    if (m_filtered_matches)
+        return match_width();
+    if (m_matches)
+        return m_matches->get_match_width(index);
+    return match_width();
+}
+
 //------------------------------------------------------------------------------
 bool match_adapter::is_custom_display(unsigned int index) const
 {
@@ -318,6 +338,14 @@ cant_activate:
         return false;
     }
 
+    // Incomplete matches are only listed until the rest have arrived.
+    if (m_matches.get_matches()->is_partial())
+    {
+        m_anchor = -1;
+        rl_possible_completions(0, 0);
+        return true;
+    }
+
     // Make sure there's room.
     update_layout();
     if (m_visible_rows <= 0)
@@ -379,7 +407,7 @@ cant_activate:
     m_point = m_buffer->get_cursor();
     m_top = 0;
     m_index = 0;
-    m_prev_displayed = -1;
+    m_grid.clear();
     insert_match(only_one/*final*/);
 
     // If there's only one match, then we're done.
@@ -691,7 +719,6 @@ append_to_needle:
 update_needle:
             m_top = 0;
             m_index = 0;
-            m_prev_displayed = -1;
             insert_needle();
             update_matches(false/*restrict*/, sort);
             if (m_matches.get_match_count())
@@ -708,7 +735,6 @@ void selectcomplete_impl::on_matches_changed(const context& context, const line_
 {
     m_top = 0;
     m_index = 0;
-    m_prev_displayed = -1;
     m_anchor = line.get_end_word_offset();
 
     // Update the needle regardless whether active.  This is so update_matches()
@@ -724,6 +750,7 @@ void selectcomplete_impl::on_terminal_resize(int columns, int rows, const contex
 {
     m_screen_cols = columns;
     m_screen_rows = rows;
+    m_grid.clear();
 
     if (is_active())
     {
@@ -794,17 +821,20 @@ void selectcomplete_impl::update_matches(bool restrict, bool sort)
     // Perform match display filtering.
     const bool popup = false;
     bool filtered = false;
-    if (m_matches.get_matches()->match_display_filter(nullptr, nullptr, popup))
+    if (m_matches.get_matches()->match_display_filter(nullptr, nullptr, nullptr, popup))
     {
         assert(rl_completion_matches_include_type);
         if (matches* regen = maybe_regenerate_matches(m_needle.c_str(), popup))
         {
             m_matches.set_regen_matches(regen);
 
-            // Build char** array for filtering.
+            // Build char** array for filtering, with the file info for its
+            // strings alongside.
             std::vector<autoptr<char>> matches;
+            match_extras extras;
             const unsigned int count = m_matches.get_match_count();
             matches.emplace_back(nullptr); // Placeholder for lcd.
+            extras.reserve(count);
             for (unsigned int i = 0; i < count; i++)
             {
                 const char* text = m_matches.get_match(i);
@@ -813,12 +843,13 @@ void selectcomplete_impl::update_matches(bool restrict, bool sort)
                 match[0] = static_cast<char>(m_matches.get_match_type(i));
                 memcpy(match + 1, text, len + 1);
                 matches.emplace_back(match);
+                extras.add(match, m_matches.get_match_file_info(i), m_matches.get_match_width(i));
             }
             matches.emplace_back(nullptr);
 
             // Get filtered matches.
             match_display_filter_entry** filtered_matches = nullptr;
-            m_matches.get_matches()->match_display_filter(&*matches.begin(), &filtered_matches, popup);
+            m_matches.get_matches()->match_display_filter(&*matches.begin(), &extras, &filtered_matches, popup);
 
             // Filter the, uh, filtered matches.
             {
@@ -907,12 +938,8 @@ void selectcomplete_impl::update_matches(bool restrict, bool sort)
     // Determine the longest match.
     if (restrict || filtered)
     {
-        // Using m_matches directly means match types are separate from matches.
-        // When not filtered, get_match_visible_display() has to synthesize the
-        // visible length by using functions that are influenced by
-        // rl_completion_matches_include_type.
-        rollback<int> rb(rl_completion_matches_include_type, 0);
-
+        // When not filtered, get_match_visible_display() uses the widths
+        // measured when the matches were added.
         if (restrict)
             m_match_longest = 0;
 
@@ -998,19 +1025,32 @@ void selectcomplete_impl::update_display()
         static char s_chGen = '0';
 #endif
 
+        // The rows are only where they were last displayed if the prompt and
+        // input line still end on the same lines, and nothing else has printed
+        // or redrawn the display since then.
+        const int prompt_botlin = _rl_get_prompt_last_screen_line();
+        if (m_grid_botlin != _rl_vis_botlin ||
+            m_grid_prompt_botlin != prompt_botlin ||
+            m_grid_new_line_count != _rl_new_line_count)
+        {
+            m_grid.clear();
+            m_grid_botlin = _rl_vis_botlin;
+            m_grid_prompt_botlin = prompt_botlin;
+            m_grid_new_line_count = _rl_new_line_count;
+        }
+
         // Display matches.
         int up = 0;
-        bool move_to_end = true;
         const int count = m_matches.get_match_count();
         if (is_active() && count > 0)
         {
             update_top();
-m_prev_displayed = -1;
 
             const int rows = min<int>(m_match_rows, m_visible_rows);
             const int major_stride = _rl_print_completions_horizontally ? m_match_cols : 1;
             const int minor_stride = _rl_print_completions_horizontally ? 1 : m_match_rows;
             const int col_width = min<int>(m_match_longest, max<int>(m_screen_cols - between_cols, 1));
+            str<> out;
             for (int row = 0; row < rows; row++)
             {
                 int i = (m_top + row) * major_stride;
@@ -1020,106 +1060,102 @@ m_prev_displayed = -1;
                 rl_crlf();
                 up++;
 
-                move_to_end = true;
-                if (m_prev_displayed < 0 ||
-                    row == get_match_row(m_index) ||
-                    row == get_match_row(m_prev_displayed))
-                {
-                    // Print matches on the row.
-                    str<> truncated;
-                    str<> tmp;
-                    reset_tmpbuf();
+                // Print matches on the row.
+                str<> truncated;
+                str<> tmp;
+                reset_tmpbuf();
 #ifdef SHOW_DISPLAY_GENERATION
-                    append_tmpbuf_char(s_chGen);
+                append_tmpbuf_char(s_chGen);
 #endif
-                    for (int col = 0; col < m_match_cols; col++)
+                for (int col = 0; col < m_match_cols; col++)
+                {
+                    if (i >= count)
+                        break;
+
+                    const int selected = (i == m_index);
+                    const char* const display = m_matches.get_match_display(i);
+                    char* temp = m_matches.is_display_filtered() ? const_cast<char*>(display) : printable_part(const_cast<char*>(display));
+                    const match_type match_type = m_matches.get_match_type(i);
+                    const unsigned char type = static_cast<unsigned char>(match_type);
+
+                    mark_tmpbuf();
+                    int printed_len;
+                    if (m_matches.is_display_filtered() &&
+                        (is_match_type(match_type, match_type::none) ||
+                         m_matches.is_custom_display(i)))
                     {
-                        if (i >= count)
-                            break;
-
-                        const int selected = (i == m_index);
-                        const char* const display = m_matches.get_match_display(i);
-                        char* temp = m_matches.is_display_filtered() ? const_cast<char*>(display) : printable_part(const_cast<char*>(display));
-                        const match_type match_type = m_matches.get_match_type(i);
-                        const unsigned char type = static_cast<unsigned char>(match_type);
-
-                        mark_tmpbuf();
-                        int printed_len;
-                        if (m_matches.is_display_filtered() &&
-                            (is_match_type(match_type, match_type::none) ||
-                             m_matches.is_custom_display(i)))
+                        printed_len = m_matches.get_match_visible_display(i);
+                        if (printed_len > col_width)
                         {
-                            printed_len = m_matches.get_match_visible_display(i);
-                            if (printed_len > col_width)
-                            {
-                                ellipsify(temp, col_width, truncated, false/*expand_ctrl*/);
-                                temp = truncated.data();
-                                printed_len = cell_count(temp);
-                            }
-                            if (selected)
-                            {
-                                ecma48_processor(temp, &tmp, nullptr, ecma48_processor_flags::plaintext);
-                                temp = tmp.data();
-                            }
-                            append_display(temp, selected);
+                            ellipsify(temp, col_width, truncated, false/*expand_ctrl*/);
+                            temp = truncated.data();
+                            printed_len = cell_count(temp);
                         }
-                        else
+                        if (selected)
                         {
+                            ecma48_processor(temp, &tmp, nullptr, ecma48_processor_flags::plaintext);
+                            temp = tmp.data();
+                        }
+                        append_display(temp, selected);
+                    }
+                    else
+                    {
+                        printed_len = append_filename(temp, display, 0, type, selected);
+                        if (printed_len > col_width)
+                        {
+                            rollback_tmpbuf();
+                            ellipsify(temp, col_width, truncated, true/*expand_ctrl*/);
+                            temp = truncated.data();
                             printed_len = append_filename(temp, display, 0, type, selected);
-                            if (printed_len > col_width)
-                            {
-                                rollback_tmpbuf();
-                                ellipsify(temp, col_width, truncated, true/*expand_ctrl*/);
-                                temp = truncated.data();
-                                printed_len = append_filename(temp, display, 0, type, selected);
-                            }
                         }
+                    }
 
-                        const int next = i + minor_stride;
+                    const int next = i + minor_stride;
 
-                        const char* desc = m_matches.get_match_description(i);
-                        const bool last_col = (col + 1 >= m_match_cols || next >= count);
-                        if (selected || !last_col || desc)
-                            pad_filename(printed_len, col_width + (selected ? 0 : between_cols), selected);
+                    const char* desc = m_matches.get_match_description(i);
+                    const bool last_col = (col + 1 >= m_match_cols || next >= count);
+                    if (selected || !last_col || desc)
+                        pad_filename(printed_len, col_width + (selected ? 0 : between_cols), selected);
 
-                        if (desc)
+                    if (desc)
+                    {
+                        // Leave between_cols at end of line, otherwise "\x1b[K" can erase part
+                        // of the intended output.
+                        const int remaining = m_screen_cols - col_width - before_desc - between_cols;
+                        if (remaining > 0)
                         {
-                            // Leave between_cols at end of line, otherwise "\x1b[K" can erase part
-                            // of the intended output.
-                            const int remaining = m_screen_cols - col_width - before_desc - between_cols;
-                            if (remaining > 0)
+                            printed_len = m_matches.get_match_visible_description(i);
+                            if (printed_len > remaining)
                             {
-                                printed_len = m_matches.get_match_visible_description(i);
-                                if (printed_len > remaining)
-                                {
-                                    ellipsify(desc, remaining, truncated, false/*expand_ctrl*/);
-                                    desc = truncated.data();
-                                    printed_len = cell_count(desc);
-                                }
-                                pad_filename(0, before_desc - (selected ? 0 : between_cols), 0);
-                                append_tmpbuf_string(desc, -1);
+                                ellipsify(desc, remaining, truncated, false/*expand_ctrl*/);
+                                desc = truncated.data();
+                                printed_len = cell_count(desc);
                             }
+                            pad_filename(0, before_desc - (selected ? 0 : between_cols), 0);
+                            append_tmpbuf_string(desc, -1);
                         }
-
-                        if (selected && !last_col)
-                            pad_filename(0, between_cols, 0);
-
-                        i = next;
                     }
-                    flush_tmpbuf();
 
-                    // Clear to end of line.
-                    m_printer->print("\x1b[m\x1b[K");
-                    move_to_end = false;
+                    if (selected && !last_col)
+                        pad_filename(0, between_cols, 0);
+
+                    i = next;
                 }
+
+                // Only print what changed since the row was last displayed.
+                int len;
+                const char* text = get_tmpbuf(&len);
+                out.clear();
+                m_grid.update_row(row, text, len, out);
+                m_printer->print(out.c_str(), out.length());
+                reset_tmpbuf();
             }
 
-            m_prev_displayed = m_index;
+            m_grid.truncate(up);
         }
         else
         {
-            assert(move_to_end);
-            m_prev_displayed = -1;
+            m_grid.clear();
         }
 
 #ifdef SHOW_DISPLAY_GENERATION
@@ -1128,8 +1164,8 @@ m_prev_displayed = -1;
             s_chGen = '0';
 #endif
 
-        // Move cursor to end of last input line.
-        if (move_to_end)
+        // Move cursor to end of last row; rows are only partially updated, so
+        // the cursor could be anywhere on the row.
         {
             str<16> s;
             s.format("\x1b[%dG", m_screen_cols + 1);
@@ -1348,6 +1384,7 @@ void selectcomplete_impl::insert_match(int final)
         m_buffer->draw();
         // Clear to end of screen.
         m_printer->print("\x1b[J");
+        m_grid.clear();
         // Restore cursor position.
         m_buffer->set_cursor(cursor);
         m_buffer->set_need_draw();
@@ -7,9 +7,12 @@
 #include "input_dispatcher.h"
 
 #include <core/str.h>
+#include <terminal/cell_grid.h>
 
 class printer;
 struct match_display_filter_entry;
+struct match_file_info;
+struct match_width;
 class matches_iter;
 enum class match_type : unsigned char;
 
@@ -31,6 +34,8 @@ public:
     const char*     get_match_description(unsigned int index) const;
     unsigned int    get_match_visible_description(unsigned int index) const;
     match_type      get_match_type(unsigned int index) const;
+    const match_file_info* get_match_file_info(unsigned int index) const;
+    match_width     get_match_width(unsigned int index) const;
     bool            is_custom_display(unsigned int index) const;
 
     bool            is_display_filtered() const { return !!m_filtered_matches; }
@@ -106,7 +111,13 @@ private:
     // Current match index.
     int             m_top = 0;
     int             m_index = 0;
-    int             m_prev_displayed = -1;
+
+    // Rows displayed below the input line, and where the input line was when
+    // they were displayed.
+    cell_grid       m_grid;
+    int             m_grid_botlin = -1;
+    int             m_grid_prompt_botlin = -1;
+    int             m_grid_new_line_count = -1;
 
     // Current input.
     str<>           m_needle;
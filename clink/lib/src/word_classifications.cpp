@@ -77,6 +77,49 @@ unsigned int word_classifications::add_command(const line_state& line)
     return index;
 }
 
+//------------------------------------------------------------------------------
+// Copies the classifications for one command from another set of
+// classifications:  the word infos [index, index + count) and the faces for
+// the buffer range [start, end).  Everything is shifted by delta, for when the
+// command has moved within the line.
+void word_classifications::copy_command(const word_classifications& from, unsigned int index, unsigned int count, unsigned int start, unsigned int end, int delta)
+{
+    for (unsigned int i = index; i < index + count && i < from.m_info.size(); ++i)
+    {
+        m_info.emplace_back(from.m_info[i]);
+        auto& info = m_info.back();
+        info.start += delta;
+        info.end += delta;
+    }
+
+    // Custom faces are indices into the face definitions, so they must be
+    // remapped into this set of face definitions.
+    char remap[128] = {};
+
+    end = min(end, from.m_length);
+    for (unsigned int pos = start; pos < end; ++pos)
+    {
+        const unsigned int to = pos + delta;
+        if (to >= m_length)
+            break;
+
+        char face = from.m_faces[pos];
+        if (static_cast<unsigned char>(face) >= 128)
+        {
+            char& mapped = remap[static_cast<unsigned char>(face) - 128];
+            if (!mapped)
+            {
+                const char* sgr = from.get_face_output(face);
+                mapped = sgr ? ensure_face(sgr) : ' ';
+                if (!mapped)
+                    mapped = ' ';
+            }
+            face = mapped;
+        }
+        m_faces[to] = face;
+    }
+}
+
 //------------------------------------------------------------------------------
 void word_classifications::set_word_has_argmatcher(unsigned int index)
 {
@@ -0,0 +1,137 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "fs_fixture.h"
+
+#include <async_file_enum.h>
+#include <match_pipeline.h>
+#include <matches_impl.h>
+
+#include <core/str.h>
+
+//------------------------------------------------------------------------------
+static unsigned int count_entries(async_file_enum& e)
+{
+    unsigned int count = 0;
+    e.for_each([&] (const async_file_enum::entry&) { ++count; });
+    return count;
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("Async file enum")
+{
+    fs_fixture fs;
+
+    // Enough files for more than one batch of results; the default fixture
+    // also has four files and two directories.
+    str<> name;
+    for (int i = 0; i < 70; ++i)
+    {
+        name.format("many%02d", i);
+        if (FILE* f = fopen(name.c_str(), "wt"))
+            fclose(f);
+    }
+    const unsigned int total = 70 + 6;
+
+    HANDLE gate = CreateSemaphore(nullptr, 0, 1000, nullptr);
+    REQUIRE(gate != nullptr);
+
+    SECTION("Complete")
+    {
+        auto e = async_file_enum::start("*", false, false);
+        REQUIRE(e != nullptr);
+        REQUIRE(e->wait(INFINITE));
+        REQUIRE(e->is_complete());
+        REQUIRE(count_entries(*e) == total);
+
+        // Starting the same enumeration again reuses it.
+        REQUIRE(async_file_enum::start("*", false, false) == e);
+        REQUIRE(async_file_enum::get_current() == e);
+    }
+
+    SECTION("Partial")
+    {
+        async_file_enum::TEST_set_gate(gate);
+        auto e = async_file_enum::start("*", false, false);
+        async_file_enum::TEST_set_gate(nullptr);
+        REQUIRE(e != nullptr);
+
+        // Let the worker read exactly one batch.
+        ReleaseSemaphore(gate, 64, nullptr);
+        for (int i = 0; i < 500 && count_entries(*e) < 64; ++i)
+            Sleep(10);
+        REQUIRE(count_entries(*e) == 64);
+        REQUIRE(!e->wait(0));
+        REQUIRE(!e->is_complete());
+
+        // Then let it finish.
+        ReleaseSemaphore(gate, total + 1 - 64, nullptr);
+        REQUIRE(e->wait(INFINITE));
+        REQUIRE(count_entries(*e) == total);
+    }
+
+    SECTION("Cancel")
+    {
+        async_file_enum::TEST_set_gate(gate);
+        auto e = async_file_enum::start("*", false, false);
+        async_file_enum::TEST_set_gate(nullptr);
+        REQUIRE(e != nullptr);
+
+        // The worker is stopped before its first file, so cancelling means it
+        // finishes without reading any.
+        async_file_enum::cancel_current();
+        REQUIRE(async_file_enum::get_current() == nullptr);
+        ReleaseSemaphore(gate, 1, nullptr);
+        REQUIRE(e->wait(INFINITE));
+        REQUIRE(count_entries(*e) == 0);
+
+        // Starting again begins a new enumeration.
+        auto again = async_file_enum::start("*", false, false);
+        REQUIRE(again != nullptr);
+        REQUIRE(again != e);
+        REQUIRE(again->wait(INFINITE));
+        REQUIRE(count_entries(*again) == total);
+    }
+
+    SECTION("Idle wake")
+    {
+        async_file_enum::TEST_set_gate(gate);
+        auto e = async_file_enum::start("*", false, false);
+        async_file_enum::TEST_set_gate(nullptr);
+        REQUIRE(e != nullptr);
+        e->set_partial(true);
+
+        // While the enumeration is running, the input loop waits on it.
+        async_file_idle idle(nullptr, e);
+        REQUIRE(idle.is_enabled());
+        REQUIRE(idle.get_waitevent() == e->get_ready_event());
+        idle.on_idle();
+        REQUIRE(!idle.is_completed());
+
+        // Once it finishes, the idle callback reports completion and stops
+        // waiting.
+        ReleaseSemaphore(gate, total + 1, nullptr);
+        REQUIRE(WaitForSingleObject(idle.get_waitevent(), INFINITE) == WAIT_OBJECT_0);
+        idle.on_idle();
+        REQUIRE(idle.is_completed());
+        REQUIRE(!e->is_partial());
+        REQUIRE(!idle.is_enabled());
+    }
+
+    SECTION("Partial matches")
+    {
+        matches_impl matches;
+        match_builder builder(matches);
+        REQUIRE(!matches.is_partial());
+        builder.set_partial();
+        REQUIRE(matches.is_partial());
+
+        match_pipeline pipeline(matches);
+        pipeline.reset();
+        REQUIRE(!matches.is_partial());
+    }
+
+    async_file_enum::cancel_current();
+    CloseHandle(gate);
+}
@@ -6,6 +6,12 @@
 #include "binder.h"
 #include "editor_module.h"
 
+#include <core/base.h>
+#include <core/str.h>
+
+#include <string>
+#include <vector>
+
 //------------------------------------------------------------------------------
 TEST_CASE("Binder")
 {
@@ -30,36 +36,89 @@ TEST_CASE("Binder")
         REQUIRE(binder.get_group("group2") == groups[1]);
     }
 
-    SECTION("Overflow : group")
+    SECTION("Many groups")
     {
-        for (int i = 1; i < 256; ++i)
-            REQUIRE(binder.create_group("group") == (i * 2) + 1);
+        int groups[1024];
+        for (int i = 0; i < sizeof_array(groups); ++i)
+        {
+            str<16> name;
+            name.format("group%d", i);
+            groups[i] = binder.create_group(name.c_str());
+            REQUIRE(groups[i] > 1);
+        }
 
-        REQUIRE(binder.create_group("group") == -1);
+        for (int i = 0; i < sizeof_array(groups); ++i)
+        {
+            str<16> name;
+            name.format("group%d", i);
+            REQUIRE(binder.get_group(name.c_str()) == groups[i]);
+        }
+
+        int again = binder.create_group("group0");
+        REQUIRE(again != groups[0]);
+        REQUIRE(binder.get_group("group0") == again);
     }
 
-    SECTION("Overflow : module")
+    SECTION("Many modules")
     {
         int group = binder.get_group();
-        for (int i = 0; i < 64; ++i)
+        for (int i = 0; i < 300; ++i)
             REQUIRE(binder.bind(group, "", ((editor_module*)0)[i], char(i)));
 
-        auto& module = ((editor_module*)0)[0xff];
-        REQUIRE(!binder.bind(group, "", module, 0xff));
+        bind_resolver resolver(binder);
+        REQUIRE(resolver.step('z'));
+        for (int i = 0; i < 300; ++i)
+        {
+            auto binding = resolver.next();
+            REQUIRE(binding);
+            REQUIRE(binding.get_module() == &((editor_module*)0)[i]);
+            REQUIRE(binding.get_id() == (unsigned char)i);
+        }
+        REQUIRE(!resolver.next());
     }
 
-    SECTION("Overflow : bind")
+    SECTION("Many binds")
     {
         auto& null_module = *(editor_module*)0;
         int default_group = binder.get_group();
 
-        for (int i = 0; i < 508; ++i)
+        for (int i = 0; i < 4096; ++i)
+        {
+            char chord[] = { char((i >> 7) + 1), char((i & 0x7f) | 0x80), 'x', 0 };
+            REQUIRE(binder.bind(default_group, chord, null_module, (unsigned char)i));
+        }
+
+        for (int i = 0; i < 4096; i += 7)
         {
-            char chord[] = { char((i > 0xff) + 1), char((i % 0xfe) + 1), 0 };
-            REQUIRE(binder.bind(default_group, chord, null_module, 0x12));
+            char chord[] = { char((i >> 7) + 1), char((i & 0x7f) | 0x80), 'x', 0 };
+
+            bind_resolver resolver(binder);
+            for (const char* c = chord; *c; ++c)
+                if (resolver.step(*c))
+                    break;
+
+            auto binding = resolver.next();
+            REQUIRE(binding);
+            REQUIRE(binding.get_id() == (unsigned char)i);
         }
 
-        REQUIRE(!binder.bind(default_group, "\x01\x02\x03", null_module, 0x12));
+        REQUIRE(binder.bind(default_group, "\x01\x02\x03", null_module, 0x12));
+    }
+
+    SECTION("Duplicate bind")
+    {
+        auto& module = *(editor_module*)&binder;
+        int group = binder.get_group();
+        REQUIRE(binder.bind(group, "ab", module, 1));
+        REQUIRE(binder.bind(group, "ab", module, 1));
+        REQUIRE(binder.bind(group, "ab", module, 2));
+
+        bind_resolver resolver(binder);
+        REQUIRE(!resolver.step('a'));
+        REQUIRE(resolver.step('b'));
+        REQUIRE(resolver.next().get_id() == 1);
+        REQUIRE(resolver.next().get_id() == 2);
+        REQUIRE(!resolver.next());
     }
 
     SECTION("Valid chords")
@@ -117,3 +176,127 @@ TEST_CASE("Binder")
         }
     }
 }
+
+//------------------------------------------------------------------------------
+// Resolves a long synthetic stream of typed text, control keys, and terminal
+// key sequences through a realistic set of bindings.  Run it on its own with
+// `clink_test -t "binder benchmark"` to time it.
+TEST_CASE("Binder benchmark")
+{
+    binder binder;
+    auto& module = *(editor_module*)&binder;
+    const int group = binder.get_group();
+
+    // Keep the group count and bind count beyond what a fixed pool allows.
+    for (int i = 0; i < 300; ++i)
+    {
+        str<16> name;
+        name.format("group%d", i);
+        const int other = binder.create_group(name.c_str());
+        REQUIRE(binder.bind(other, "", module, 0));
+        REQUIRE(binder.bind(other, "\\e[A", module, 1));
+    }
+
+    std::vector<std::string> seqs;
+    auto add_seq = [&] (const char* chord, const char* keys) {
+        REQUIRE(binder.bind(group, chord, module, (unsigned char)(seqs.size() + 1)));
+        seqs.emplace_back(keys);
+    };
+
+    // id 0 is the catch-all for typed text.
+    REQUIRE(binder.bind(group, "", module, 0));
+
+    // Ctrl and Meta letters.
+    for (char c = 'a'; c <= 'z'; ++c)
+    {
+        char chord[] = "\\C-?";
+        char keys[] = { char(c & 0x1f), 0 };
+        chord[3] = c;
+        add_seq(chord, keys);
+    }
+    for (char c = 'a'; c <= 'z'; ++c)
+    {
+        char chord[] = "\\M-?";
+        char keys[] = { '\x1b', c, 0 };
+        chord[3] = c;
+        add_seq(chord, keys);
+    }
+
+    // Cursor keys, with and without modifiers, as sent by the terminal.
+    static const char c_finals[] = "ABCDHF";
+    for (const char* f = c_finals; *f; ++f)
+    {
+        str<16> chord, keys;
+        chord.format("\\e[%c", *f);
+        keys.format("\x1b[%c", *f);
+        add_seq(chord.c_str(), keys.c_str());
+        for (int mod = 2; mod <= 8; ++mod)
+        {
+            chord.format("\\e[1;%d%c", mod, *f);
+            keys.format("\x1b[1;%d%c", mod, *f);
+            add_seq(chord.c_str(), keys.c_str());
+        }
+    }
+
+    // Editing and function keys.
+    static const int c_tildes[] = { 2, 3, 5, 6, 15, 17, 18, 19, 20, 21, 23, 24 };
+    for (int n : c_tildes)
+    {
+        str<16> chord, keys;
+        chord.format("\\e[%d~", n);
+        keys.format("\x1b[%d~", n);
+        add_seq(chord.c_str(), keys.c_str());
+        for (int mod = 2; mod <= 8; ++mod)
+        {
+            chord.format("\\e[%d;%d~", n, mod);
+            keys.format("\x1b[%d;%d~", n, mod);
+            add_seq(chord.c_str(), keys.c_str());
+        }
+    }
+    for (char c = 'P'; c <= 'S'; ++c)
+    {
+        str<16> chord, keys;
+        chord.format("\\eO%c", c);
+        keys.format("\x1bO%c", c);
+        add_seq(chord.c_str(), keys.c_str());
+    }
+
+    // Build the key stream, counting the binding each input should resolve to.
+    std::string stream;
+    std::vector<unsigned int> expected(seqs.size() + 1);
+    unsigned int seed = 0x2545f491;
+    for (int i = 0; i < 200000; ++i)
+    {
+        seed = seed * 1103515245 + 12345;
+        const unsigned int r = (seed >> 16) & 0x7fff;
+        if (r % 10 < 7)
+        {
+            stream.push_back(" abcdefghijklmnopqrstuvwxyz.-\\"[r % 30]);
+            ++expected[0];
+        }
+        else
+        {
+            const unsigned int s = r % seqs.size();
+            stream.append(seqs[s]);
+            ++expected[s + 1];
+        }
+    }
+
+    // Resolve the stream the same way line_editor_impl does.
+    std::vector<unsigned int> resolved(seqs.size() + 1);
+    bind_resolver resolver(binder);
+    for (const char* c = stream.c_str(); *c; ++c)
+    {
+        if (!resolver.step(*c))
+            continue;
+
+        while (auto binding = resolver.next())
+        {
+            REQUIRE(binding.get_module() == &module);
+            ++resolved[binding.get_id()];
+            binding.claim();
+        }
+    }
+
+    REQUIRE(resolved == expected);
+}
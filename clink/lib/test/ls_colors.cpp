@@ -0,0 +1,91 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "env_fixture.h"
+
+#include <core/str.h>
+
+extern "C" {
+#include <compat/config.h>
+#include <readline/readline.h>
+#include <readline/colors.h>
+void _rl_parse_colors(void);
+};
+
+//------------------------------------------------------------------------------
+static void parse_ls_colors(const char* value)
+{
+    const char* env_desc[] = {
+        "LS_COLORS", value,
+        nullptr
+    };
+    env_fixture env(env_desc);
+
+    _rl_parse_colors();
+}
+
+//------------------------------------------------------------------------------
+static const char* find_color(const char* name)
+{
+    static str<> seq;
+    seq.clear();
+
+    COLOR_EXT_TYPE* ext = _rl_find_color_ext(name, strlen(name));
+    if (ext)
+        seq.concat(ext->seq.string, int(ext->seq.len));
+    return seq.c_str();
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("LS_COLORS extensions")
+{
+    SECTION("Overlapping")
+    {
+        // Later LS_COLORS entries override earlier ones, whether an entry is
+        // found by its extension or by a suffix without a '.'.
+        parse_ls_colors("*.gz=01:*z=02");
+        REQUIRE(strcmp(find_color("a.gz"), "02") == 0);
+        REQUIRE(strcmp(find_color("a.tgz"), "02") == 0);
+
+        parse_ls_colors("*z=02:*.gz=01");
+        REQUIRE(strcmp(find_color("a.gz"), "01") == 0);
+        REQUIRE(strcmp(find_color("a.tgz"), "02") == 0);
+        REQUIRE(strcmp(find_color("abc"), "") == 0);
+    }
+
+    SECTION("Multiple dots")
+    {
+        parse_ls_colors("*.gz=01:*.tar.gz=03");
+        REQUIRE(strcmp(find_color("a.tar.gz"), "03") == 0);
+        REQUIRE(strcmp(find_color("a.gz"), "01") == 0);
+        REQUIRE(strcmp(find_color("atar.gz"), "01") == 0);
+        REQUIRE(strcmp(find_color("a.tar"), "") == 0);
+
+        // '.gz' is listed later, so it overrides '.tar.gz'.
+        parse_ls_colors("*.tar.gz=03:*.gz=01");
+        REQUIRE(strcmp(find_color("a.tar.gz"), "01") == 0);
+    }
+
+    SECTION("Case insensitive")
+    {
+        parse_ls_colors("*.TXT=04:*README=05:*.tar.gz=03");
+        REQUIRE(strcmp(find_color("a.txt"), "04") == 0);
+        REQUIRE(strcmp(find_color("a.Txt"), "04") == 0);
+        REQUIRE(strcmp(find_color("readme"), "05") == 0);
+        REQUIRE(strcmp(find_color("MY_ReadMe"), "05") == 0);
+        REQUIRE(strcmp(find_color("A.Tar.GZ"), "03") == 0);
+        REQUIRE(strcmp(find_color("a.tx"), "") == 0);
+    }
+
+    SECTION("Case variants")
+    {
+        // Entries that differ only in case each match only their own case.
+        parse_ls_colors("*.md=08:*.c=06:*.C=07");
+        REQUIRE(strcmp(find_color("a.c"), "06") == 0);
+        REQUIRE(strcmp(find_color("a.C"), "07") == 0);
+        REQUIRE(strcmp(find_color("a.MD"), "08") == 0);
+    }
+
+    parse_ls_colors("");
+}
@@ -0,0 +1,64 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include <matches_impl.h>
+
+//------------------------------------------------------------------------------
+TEST_CASE("Match batch")
+{
+    matches_impl matches;
+    match_builder builder(matches);
+
+    SECTION("From string")
+    {
+        static const char text[] = "alpha\r\nbeta\n\n\r\ngamma\r\n";
+
+        match_batch batch(builder, match_type::word);
+        unsigned int total;
+        REQUIRE(batch.add_from_string(text, sizeof(text) - 1, "\r\n", &total) == 3);
+        REQUIRE(total == 3);
+
+        REQUIRE(matches.get_match_count() == 3);
+        REQUIRE(strcmp(matches.get_match(0), "alpha") == 0);
+        REQUIRE(strcmp(matches.get_match(1), "beta") == 0);
+        REQUIRE(strcmp(matches.get_match(2), "gamma") == 0);
+        REQUIRE(matches.get_match_length(2) == 5);
+        REQUIRE(matches.get_match_type(0) == match_type::word);
+    }
+
+    SECTION("Length bounded")
+    {
+        static const char text[] = "one two three";
+
+        match_batch batch(builder, match_type::word);
+        REQUIRE(batch.add_from_string(text, 7, " ") == 2);
+        REQUIRE(batch.add(text + 8, 3));
+
+        REQUIRE(matches.get_match_count() == 3);
+        REQUIRE(strcmp(matches.get_match(1), "two") == 0);
+        REQUIRE(strcmp(matches.get_match(2), "thr") == 0);
+    }
+
+    SECTION("Type per match")
+    {
+        static const char text[] = "file dir\\";
+
+        match_batch batch(builder, match_type::none);
+        REQUIRE(batch.add_from_string(text, sizeof(text) - 1, " ") == 2);
+
+        REQUIRE(is_match_type(matches.get_match_type(0), match_type::none));
+        REQUIRE(is_match_type(matches.get_match_type(1), match_type::dir));
+    }
+
+    SECTION("Empty")
+    {
+        match_batch batch(builder, match_type::word);
+        unsigned int total;
+        REQUIRE(batch.add_from_string("\n\n", 2, "\n", &total) == 0);
+        REQUIRE(total == 0);
+        REQUIRE(!batch.add("x", 0));
+        REQUIRE(matches.get_match_count() == 0);
+    }
+}
@@ -0,0 +1,231 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include <match_pipeline.h>
+#include <matches_impl.h>
+
+#include <core/str_compare.h>
+
+#include <initializer_list>
+
+//------------------------------------------------------------------------------
+static void verify_selection(const matches_impl& matches, const std::initializer_list<const char*>& expected)
+{
+    REQUIRE(matches.get_match_count() == expected.size());
+
+    unsigned int i = 0;
+    for (const char* name : expected)
+    {
+        REQUIRE(strcmp(matches.get_match(i), name) == 0, [&] () {
+            printf("index %u:  expected '%s', got '%s'\n", i, name, matches.get_match(i));
+        });
+        ++i;
+    }
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("Match selection")
+{
+    matches_impl matches;
+    match_pipeline pipeline(matches);
+    pipeline.reset();
+
+    {
+        match_builder builder(matches);
+        for (const char* name : { "bard", "foo-bar", "Baz", "apple", "banana", "foo_baz", "bar" })
+            builder.add_match(name, match_type::word);
+    }
+
+    str_compare_scope _(str_compare_scope::caseless, false);
+
+    SECTION("Narrowing")
+    {
+        pipeline.select("b");
+        pipeline.sort();
+        verify_selection(matches, { "banana", "bar", "bard", "Baz" });
+
+        pipeline.select("ba");
+        pipeline.sort();
+        verify_selection(matches, { "banana", "bar", "bard", "Baz" });
+
+        pipeline.select("bar");
+        pipeline.sort();
+        verify_selection(matches, { "bar", "bard" });
+
+        pipeline.select("bard");
+        pipeline.sort();
+        verify_selection(matches, { "bard" });
+
+        pipeline.select("bardx");
+        verify_selection(matches, {});
+    }
+
+    SECTION("Widening")
+    {
+        pipeline.select("bar");
+        pipeline.sort();
+        verify_selection(matches, { "bar", "bard" });
+
+        pipeline.select("b");
+        pipeline.sort();
+        verify_selection(matches, { "banana", "bar", "bard", "Baz" });
+
+        pipeline.select("x");
+        verify_selection(matches, {});
+
+        pipeline.select("ap");
+        pipeline.sort();
+        verify_selection(matches, { "apple" });
+    }
+
+    SECTION("Compare mode")
+    {
+        pipeline.select("foo_");
+        verify_selection(matches, { "foo_baz" });
+
+        str_compare_scope relaxed(str_compare_scope::relaxed, false);
+        pipeline.select("foo_b");
+        pipeline.sort();
+        REQUIRE(matches.get_match_count() == 2);
+    }
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("Match file info")
+{
+    matches_impl matches;
+    match_pipeline pipeline(matches);
+    pipeline.reset();
+
+    {
+        match_builder builder(matches);
+        builder.add_match("zeta", match_type::word);
+        for (unsigned int i = 0; i < 3; ++i)
+        {
+            static const char* const names[] = { "gamma", "alpha", "beta" };
+            match_file_info info = { FILE_ATTRIBUTE_ARCHIVE, 100 + i, 200 + i };
+            match_desc desc = { names[i], match_type::file, &info };
+            builder.add_match(desc);
+        }
+    }
+
+    str_compare_scope _(str_compare_scope::caseless, false);
+
+    pipeline.select("");
+    pipeline.sort();
+    verify_selection(matches, { "alpha", "beta", "gamma", "zeta" });
+
+    REQUIRE(matches.get_match_file_info(0)->size == 101);
+    REQUIRE(matches.get_match_file_info(1)->size == 102);
+    REQUIRE(matches.get_match_file_info(2)->write_time == 200);
+    REQUIRE(matches.get_match_file_info(3) == nullptr);
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("Match width")
+{
+    matches_impl matches;
+    match_pipeline pipeline(matches);
+    pipeline.reset();
+
+    {
+        match_builder builder(matches);
+        builder.add_match("plain", match_type::word);
+        builder.add_match("abc\\de", match_type::word);
+        builder.add_match("abc\\de\\", match_type::word);
+        builder.add_match("c:de", match_type::word);
+        builder.add_match("x\x01y", match_type::word);
+        builder.add_match("\xe4\xb8\xad\\\xe6\x96\x87", match_type::word);
+    }
+
+    str_compare_scope _(str_compare_scope::caseless, false);
+
+    pipeline.select("");
+    pipeline.sort();
+
+    auto find = [&matches] (const char* match) {
+        for (unsigned int i = 0; i < matches.get_match_count(); ++i)
+            if (strcmp(matches.get_match(i), match) == 0)
+                return matches.get_match_width(i);
+        REQUIRE(false);
+        return match_width();
+    };
+
+    SECTION("Plain")
+    {
+        const match_width width = find("plain");
+        REQUIRE(width.width == 5);
+        REQUIRE(width.name_width == 5);
+    }
+
+    SECTION("Path")
+    {
+        const match_width width = find("abc\\de");
+        REQUIRE(width.width == 6);
+        REQUIRE(width.name_width == 2);
+    }
+
+    SECTION("Trailing separator")
+    {
+        const match_width width = find("abc\\de\\");
+        REQUIRE(width.width == 7);
+        REQUIRE(width.name_width == 3);
+    }
+
+    SECTION("Drive")
+    {
+        const match_width width = find("c:de");
+        REQUIRE(width.width == 4);
+        REQUIRE(width.name_width == 2);
+    }
+
+    SECTION("Control character")
+    {
+        const match_width width = find("x\x01y");
+        REQUIRE(width.width == 4);
+        REQUIRE(width.name_width == 4);
+    }
+
+    SECTION("Wide characters")
+    {
+        const match_width width = find("\xe4\xb8\xad\\\xe6\x96\x87");
+        REQUIRE(width.width == 5);
+        REQUIRE(width.name_width == 2);
+    }
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("Match extras")
+{
+    char dir[] = "\x07" "dir";
+    char file[] = "\x06" "file";
+    char copy[] = "\x06" "file";
+
+    match_file_info info = { 0x20, 100, 200 };
+    match_width width = { 8, 4 };
+
+    match_extras extras;
+    extras.add(dir, nullptr, { 3, 3 });
+    extras.add(file, &info, width);
+
+    match_width out;
+    REQUIRE(extras.get_file_info(dir) == nullptr);
+    REQUIRE(extras.get_width(dir, out));
+    REQUIRE(out.width == 3);
+
+    REQUIRE(extras.get_file_info(file) != nullptr);
+    REQUIRE(extras.get_file_info(file)->size == 100);
+    REQUIRE(extras.get_width(file, out));
+    REQUIRE(out.width == 8);
+    REQUIRE(out.name_width == 4);
+
+    // Lookups are by string, not by content.
+    REQUIRE(extras.get_file_info(copy) == nullptr);
+    REQUIRE(!extras.get_width(copy, out));
+
+    extras.clear();
+    REQUIRE(extras.get_file_info(file) == nullptr);
+    REQUIRE(!extras.get_width(file, out));
+}
@@ -0,0 +1,110 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include <match_sort_keys.h>
+
+#include <initializer_list>
+
+//------------------------------------------------------------------------------
+struct sort_test_match
+{
+    const char*     match;
+    match_type      type;
+};
+
+//------------------------------------------------------------------------------
+static void verify_sort(int dir_order, const std::initializer_list<sort_test_match>& in, const std::initializer_list<const char*>& expected)
+{
+    match_sort_keys keys(dir_order, sort_collation::simple);
+    for (const auto& m : in)
+        keys.add(m.match, m.type);
+
+    std::vector<unsigned int> order;
+    keys.sort(order);
+    REQUIRE(order.size() == expected.size());
+
+    const sort_test_match* matches = in.begin();
+    const char* const* names = expected.begin();
+    for (unsigned int i = 0; i < order.size(); ++i)
+    {
+        REQUIRE(strcmp(matches[order[i]].match, names[i]) == 0, [&] () {
+            printf("index %u:  expected '%s', got '%s'\n", i, names[i], matches[order[i]].match);
+        });
+    }
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("Match sort keys")
+{
+    SECTION("Case folding")
+    {
+        verify_sort(1, {
+            { "Beta", match_type::word },
+            { "alpha", match_type::word },
+            { "ALPHA2", match_type::word },
+            { "gamma", match_type::word },
+        }, { "alpha", "ALPHA2", "Beta", "gamma" });
+    }
+
+    SECTION("Digits as numbers")
+    {
+        verify_sort(1, {
+            { "file10", match_type::file },
+            { "file9", match_type::file },
+            { "file010x", match_type::file },
+            { "file100", match_type::file },
+            { "file1", match_type::file },
+        }, { "file1", "file9", "file10", "file010x", "file100" });
+    }
+
+    SECTION("Directories")
+    {
+        const std::initializer_list<sort_test_match> in = {
+            { "zeta", match_type::file },
+            { "beta\\", match_type::dir },
+            { "alpha", match_type::file },
+            { "gamma\\", match_type::none },
+        };
+
+        verify_sort(0, in, { "beta\\", "gamma\\", "alpha", "zeta" });
+        verify_sort(1, in, { "alpha", "beta\\", "gamma\\", "zeta" });
+        verify_sort(2, in, { "alpha", "zeta", "beta\\", "gamma\\" });
+    }
+
+    SECTION("Type rank")
+    {
+        verify_sort(1, {
+            { "same\\", match_type::dir },
+            { "same", match_type::alias },
+            { "same", match_type::file },
+            { "same", match_type::word },
+            { "same", match_type::cmd },
+        }, { "same", "same", "same", "same", "same\\" });
+
+        // Equal names are ordered by type; cmd, file, word, alias, dir.
+        match_sort_keys keys(1, sort_collation::simple);
+        keys.add("same", match_type::alias);
+        keys.add("same", match_type::cmd);
+        keys.add("same\\", match_type::dir);
+        keys.add("same", match_type::file);
+
+        std::vector<unsigned int> order;
+        keys.sort(order);
+        REQUIRE(order[0] == 1);
+        REQUIRE(order[1] == 3);
+        REQUIRE(order[2] == 0);
+        REQUIRE(order[3] == 2);
+    }
+
+    SECTION("Separators")
+    {
+        verify_sort(1, {
+            { "foo_bar", match_type::word },
+            { "foo/baz", match_type::word },
+            { "foo\\bar", match_type::word },
+            { "foo-bar", match_type::word },
+        }, { "foo\\bar", "foo/baz", "foo-bar", "foo_bar" });
+    }
+}
@@ -0,0 +1,94 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include <match_pipeline.h>
+#include <matches_impl.h>
+
+#include <core/str.h>
+#include <core/str_compare.h>
+
+#include <string>
+
+//------------------------------------------------------------------------------
+TEST_CASE("Match store")
+{
+    matches_impl matches;
+    match_pipeline pipeline(matches);
+    pipeline.reset();
+
+    str_compare_scope _(str_compare_scope::exact, false);
+
+    SECTION("Many matches")
+    {
+        // More than fit in 16 bits.
+        const unsigned int count = 70000;
+        {
+            match_builder builder(matches);
+            str<16> name;
+            for (unsigned int i = 0; i < count; ++i)
+            {
+                name.format("m%05u", i);
+                REQUIRE(builder.add_match(name.c_str(), match_type::word));
+            }
+        }
+
+        pipeline.select("");
+        REQUIRE(matches.get_match_count() == count);
+
+        pipeline.sort();
+        REQUIRE(strcmp(matches.get_match(0), "m00000") == 0);
+        REQUIRE(strcmp(matches.get_match(65535), "m65535") == 0);
+        REQUIRE(strcmp(matches.get_match(65536), "m65536") == 0);
+        REQUIRE(strcmp(matches.get_match(count - 1), "m69999") == 0);
+        REQUIRE(matches.get_match_length(count - 1) == 6);
+
+        // Selecting matches past the first 65536.
+        pipeline.select("m6999");
+        pipeline.sort();
+        REQUIRE(matches.get_match_count() == 10);
+        REQUIRE(strcmp(matches.get_match(0), "m69990") == 0);
+        REQUIRE(strcmp(matches.get_match(9), "m69999") == 0);
+    }
+
+    SECTION("Long matches")
+    {
+        // Longer than a store page, and longer than 64K.
+        std::string long_a(100000, 'a');
+        std::string long_b(300000, 'b');
+        long_a.back() = 'x';
+        long_b.back() = 'y';
+        {
+            match_builder builder(matches);
+            REQUIRE(builder.add_match("short", match_type::word));
+            REQUIRE(builder.add_match(long_a.c_str(), match_type::word));
+            REQUIRE(builder.add_match("shorter", match_type::word));
+            REQUIRE(builder.add_match(long_b.c_str(), match_type::word));
+        }
+
+        pipeline.select("");
+        pipeline.sort();
+        REQUIRE(matches.get_match_count() == 4);
+        REQUIRE(matches.get_match_length(0) == long_a.length());
+        REQUIRE(long_a == matches.get_match(0));
+        REQUIRE(matches.get_match_length(1) == long_b.length());
+        REQUIRE(long_b == matches.get_match(1));
+        REQUIRE(strcmp(matches.get_match(2), "short") == 0);
+        REQUIRE(strcmp(matches.get_match(3), "shorter") == 0);
+
+        // Resetting releases the oversized pages; the store is still usable.
+        pipeline.reset();
+        {
+            match_builder builder(matches);
+            REQUIRE(builder.add_match("after", match_type::word));
+            REQUIRE(builder.add_match(long_a.c_str(), match_type::word));
+        }
+
+        pipeline.select("");
+        pipeline.sort();
+        REQUIRE(matches.get_match_count() == 2);
+        REQUIRE(long_a == matches.get_match(0));
+        REQUIRE(strcmp(matches.get_match(1), "after") == 0);
+    }
+}
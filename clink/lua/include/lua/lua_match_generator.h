@@ -15,11 +15,11 @@ public:
                     lua_match_generator(lua_state& state);
     virtual         ~lua_match_generator();
 
-    void            filter_matches(char** matches, char completion_type, bool filename_completion_desired);
+    void            filter_matches(char** matches, const match_extras* extras, char completion_type, bool filename_completion_desired);
 
 private:
     virtual bool    generate(const line_state& line, match_builder& builder) override;
     virtual void    get_word_break_info(const line_state& line, word_break_info& info) const override;
-    virtual bool    match_display_filter(char** matches, match_display_filter_entry*** filtered_matches, bool popup) override;
+    virtual bool    match_display_filter(char** matches, const match_extras* extras, match_display_filter_entry*** filtered_matches, bool popup) override;
     lua_state&      m_state;
 };
@@ -42,6 +42,46 @@ local function make_dummy_builder()
     return dummy
 end
 
+--------------------------------------------------------------------------------
+-- Counts modifications to argmatchers.  Anything derived from argmatchers (the
+-- compiled arg lists and the memoized reader states) records the count it was
+-- built from, and is rebuilt when the count changes.
+local _modifications = 0
+
+--------------------------------------------------------------------------------
+local function _argmatcher_modified()
+    _modifications = _modifications + 1
+    clink.reclassifyline()
+end
+
+--------------------------------------------------------------------------------
+-- Compiles an arg list into lookup tables the first time it's used, so words
+-- can be looked up by hash instead of by scanning the list.  The compiled form
+-- is rebuilt after any argmatcher is modified.
+local function _get_compiled_arg(arg)
+    local compiled = arg._compiled
+    if compiled and compiled.modifications == _modifications then
+        return compiled
+    end
+
+    local words = {}
+    local has_function = false
+    for _, i in ipairs(arg) do
+        local t = type(i)
+        if t == "function" then
+            has_function = true
+        elseif t == "string" then
+            words[i] = true
+        end
+    end
+
+    compiled = { modifications=_modifications, words=words, has_function=has_function }
+    arg._compiled = compiled
+    return compiled
+end
+
+
+
 --------------------------------------------------------------------------------
 local _argreader = {}
 _argreader.__index = _argreader
@@ -99,9 +139,9 @@ function _argreader:update(word, word_index)
     if not arg then
         if self._word_classifier and word_index >= 0 then
             if matcher._no_file_generation then
-                self._word_classifier:classifyword(word_index, "n", false)  --none
+                self:_classify(word_index, "n")  --none
             else
-                self._word_classifier:classifyword(word_index, "o", false)  --other
+                self:_classify(word_index, "o")  --other
             end
         end
         return
@@ -109,6 +149,11 @@ function _argreader:update(word, word_index)
 
     -- Parse the word type.
     if self._word_classifier and word_index >= 0 then
+        if matcher._classify_func then
+            -- A classifier function can classify any words, and can depend on
+            -- anything, so what it does can't be replayed later.
+            self._record = nil
+        end
         if matcher._classify_func and matcher._classify_func(arg_index, word, word_index, line_state, self._word_classifier) then
             -- The classifier function says it handled the word.
         else
@@ -132,51 +177,62 @@ function _argreader:update(word, word_index)
                             local this_info = line_state:getwordinfo(word_index)
                             local next_info = line_state:getwordinfo(word_index + 1)
                             if this_info and next_info and this_info.offset + this_info.length == next_info.offset then
+                                -- The result depends on the next word.
+                                self:_reach(word_index + 1)
                                 local combined_word = word..line_state:getword(word_index + 1)
-                                for _, i in ipairs(arg) do
-                                    if type(i) ~= "function" and i == combined_word then
-                                        t = arg_match_type
-                                        self._word_classifier:classifyword(word_index + 1, t, false)
-                                        matched = true
-                                        break
-                                    end
+                                if _get_compiled_arg(arg).words[combined_word] then
+                                    t = arg_match_type
+                                    self:_classify(word_index + 1, t)
+                                    matched = true
                                 end
                             end
                         end
                     end
                 end
-                if not matched then
-                    for _, i in ipairs(arg) do
-                        if type(i) == "function" then
-                            t = 'o' --other (placeholder; superseded by :classifyword).
-                        elseif i == word then
-                            t = arg_match_type
-                            break
-                        end
-                    end
+                if not matched and _get_compiled_arg(arg).words[word] then
+                    t = arg_match_type
                 end
             end
-            self._word_classifier:classifyword(word_index, t, false)
+            self:_classify(word_index, t)
         end
     end
 
     -- Does the word lead to another matcher?
-    for key, linked in pairs(arg._links) do
-        if key == word then
-            if is_flag and word:match("[:=]$") and word_index >= 0 then
-                local info = line_state:getwordinfo(word_index)
-                if info and
-                        line_state:getcursor() ~= info.offset + info.length and
-                        line_state:getline():sub(info.offset + info.length, info.offset + info.length) == " " then
-                    -- Don't follow linked parser on `--foo=` flag if there's a
-                    -- space after the `:` or `=` unless the cursor is on the
-                    -- space.
-                    break
-                end
+    local linked = arg._links and arg._links[word]
+    if linked then
+        if is_flag and word:match("[:=]$") and word_index >= 0 then
+            local info = line_state:getwordinfo(word_index)
+            if info and
+                    line_state:getcursor() ~= info.offset + info.length and
+                    line_state:getline():sub(info.offset + info.length, info.offset + info.length) == " " then
+                -- Don't follow linked parser on `--foo=` flag if there's a
+                -- space after the `:` or `=` unless the cursor is on the
+                -- space.
+                return
             end
-            self:_push(linked)
-            break
         end
+        self:_push(linked)
+    end
+end
+
+--------------------------------------------------------------------------------
+-- Classifies a word, and records it so it can be replayed when the reader state
+-- is restored from the memo (see _get_argreader).
+function _argreader:_classify(word_index, word_class)
+    self._word_classifier:classifyword(word_index, word_class, false)
+    local record = self._record
+    if record then
+        table.insert(record, { word_index, word_class })
+        self:_reach(word_index)
+    end
+end
+
+--------------------------------------------------------------------------------
+-- Notes that the recorded classifications depend on the word at word_index.
+function _argreader:_reach(word_index)
+    local record = self._record
+    if record and record.reach < word_index then
+        record.reach = word_index
     end
 end
 
@@ -197,6 +253,183 @@ function _argreader:_pop()
     return false
 end
 
+--------------------------------------------------------------------------------
+-- Stack entries are never modified once pushed, so a shallow copy of the stack
+-- is enough to capture the reader's state.
+function _argreader:_snapshot()
+    local stack = {}
+    for i = 1, #self._stack do
+        stack[i] = self._stack[i]
+    end
+    return { matcher=self._matcher, arg_index=self._arg_index, stack=stack }
+end
+
+--------------------------------------------------------------------------------
+function _argreader:_restore(state)
+    local stack = {}
+    for i = 1, #state.stack do
+        stack[i] = state.stack[i]
+    end
+    self._matcher = state.matcher
+    self._arg_index = state.arg_index
+    self._stack = stack
+end
+
+
+
+--------------------------------------------------------------------------------
+-- The reader states after each word of a command are memoized per argmatcher,
+-- keyed by the words that led to them.  Typing at the end of a line then only
+-- needs to advance the reader by the new word, and getting word break info,
+-- generating matches, and classifying words can share one parse.
+--
+-- The classifications made while reading each word are memoized as well, as
+-- offsets relative to the command word, along with `reach`, the furthest word
+-- they depend on.  They're false when they can't be replayed (the word was
+-- read without classifying, or an argmatcher's classifier function ran).
+local _reader_memos = setmetatable({}, { __mode = "k" })
+
+--------------------------------------------------------------------------------
+local function _reader_onbeginedit()
+    _reader_memos = setmetatable({}, { __mode = "k" })
+end
+
+clink.onbeginedit(_reader_onbeginedit)
+
+--------------------------------------------------------------------------------
+-- Returns a key for everything about the word that can affect the reader.
+local function _get_word_key(line_state, word_index)
+    local info = line_state:getwordinfo(word_index)
+    if info.redir then
+        return "\0redir"
+    end
+
+    local word = line_state:getword(word_index)
+    if word:find("[:=]$") then
+        -- Whether a linked parser is followed after `--foo=` depends on the
+        -- text and cursor after the word.
+        local e = info.offset + info.length
+        word = word.."\0"..line_state:getline():sub(e, e)..((line_state:getcursor() == e) and "|" or "")
+    end
+    return word
+end
+
+--------------------------------------------------------------------------------
+-- Returns an _argreader that has consumed the words of the command through
+-- last_word_index.  When word_classifier is set, the memoized classifications
+-- are replayed for the words the reader resumes after, and the rest of the
+-- words are classified as they're read.
+local function _get_argreader(argmatcher, line_state, extra_words, last_word_index, word_classifier)
+    local reader = _argreader(argmatcher, line_state)
+    reader._word_classifier = word_classifier
+
+    local extra_key = extra_words and table.concat(extra_words, " ") or ""
+    local translate = clink.translateslashes()
+    local memo = _reader_memos[argmatcher]
+    if not memo or
+            memo.modifications ~= _modifications or
+            memo.extra_key ~= extra_key or
+            memo.translate ~= translate then
+        memo = {
+            modifications = _modifications,
+            extra_key = extra_key,
+            translate = translate,
+            keys = {},
+            states = {},
+            classes = {},
+        }
+        _reader_memos[argmatcher] = memo
+    end
+
+    -- Consume extra words from expanded doskey alias.
+    if memo.states[0] then
+        reader:_restore(memo.states[0])
+    else
+        if extra_words then
+            for word_index = 2, #extra_words do
+                reader:update(extra_words[word_index], -1)
+            end
+        end
+        memo.states[0] = reader:_snapshot()
+    end
+
+    -- Resume after the longest memoized prefix of the words.
+    local command_word_index = line_state:getcommandwordindex()
+    local last = last_word_index - command_word_index
+    local keys = {}
+    for pos = 1, last do
+        keys[pos] = _get_word_key(line_state, command_word_index + pos)
+    end
+
+    local memo_keys = memo.keys
+    local memo_states = memo.states
+    local memo_classes = memo.classes
+
+    local resume = 0
+    while resume < last and memo_keys[resume + 1] == keys[resume + 1] do
+        resume = resume + 1
+    end
+
+    -- Classifying can only resume after words whose classifications can be
+    -- replayed and don't depend on any words past the resume point.
+    if word_classifier then
+        local replay = 0
+        while replay < resume do
+            local classes = memo_classes[replay + 1]
+            if not classes or classes.reach > resume then
+                break
+            end
+            replay = replay + 1
+        end
+        resume = replay
+
+        for pos = 1, resume do
+            for _, c in ipairs(memo_classes[pos]) do
+                word_classifier:classifyword(command_word_index + c[1], c[2], false)
+            end
+        end
+    end
+
+    if resume > 0 then
+        reader:_restore(memo_states[resume])
+    end
+
+    -- Consume words and use them to move through matchers' arguments.
+    for pos = resume + 1, last do
+        local word_index = command_word_index + pos
+        local info = line_state:getwordinfo(word_index)
+        reader._record = word_classifier and { reach=word_index } or nil
+        if not info.redir then
+            local word = line_state:getword(word_index)
+            reader:update(word, word_index)
+        end
+
+        -- Store the recorded classifications relative to the command word.
+        local classes = false
+        local record = reader._record
+        if record then
+            classes = { reach=record.reach - command_word_index }
+            for i, c in ipairs(record) do
+                classes[i] = { c[1] - command_word_index, c[2] }
+            end
+        end
+        reader._record = nil
+
+        if memo_keys[pos] ~= keys[pos] then
+            for i = #memo_keys, pos + 1, -1 do
+                memo_keys[i] = nil
+                memo_states[i] = nil
+                memo_classes[i] = nil
+            end
+            memo_keys[pos] = keys[pos]
+        end
+        memo_states[pos] = reader:_snapshot()
+        memo_classes[pos] = classes
+    end
+
+    return reader
+end
+
 
 
 --------------------------------------------------------------------------------
@@ -225,6 +458,7 @@ end
 --- function that returns a table of arguments.  See
 --- <a href="#argumentcompletion">Argument Completion</a> for more information.
 function _argmatcher:addarg(...)
+    _argmatcher_modified()
     local list = self._args[self._nextargindex]
     if not list then
         list = { _links = {} }
@@ -250,6 +484,7 @@ end
 --- flags, then only flags are listed.  See
 --- <a href="#argumentcompletion">Argument Completion</a> for more information.
 function _argmatcher:addflags(...)
+    _argmatcher_modified()
     local flag_matcher = self._flags or _argmatcher()
     local list = flag_matcher._args[1] or { _links = {} }
     local prefixes = self._flagprefix or {}
@@ -279,6 +514,7 @@ end
 --- arguments (if <span class="arg">index</span> is omitted it loops back to
 --- argument position 1).
 function _argmatcher:loop(index)
+    _argmatcher_modified()
     self._loop = index or -1
     return self
 end
@@ -301,6 +537,7 @@ end
 --- This is no longer needed because <code>:addflags()</code> does it
 --- automatically.
 function _argmatcher:setflagprefix(...)
+    _argmatcher_modified()
     if self._deprecated then
         local old = self._flagprefix
         self._flagprefix = {}
@@ -321,6 +558,7 @@ end
 --- generators</a>.  You can use it to "dead end" a parser and suggest no
 --- completions.
 function _argmatcher:nofiles()
+    _argmatcher_modified()
     self._no_file_generation = true
     return self
 end
@@ -333,6 +571,7 @@ end
 --- handles, to classify the word as part of coloring the input text.  See
 --- <a href="#classifywords">Coloring The Input Text</a> for more information.
 function _argmatcher:setclassifier(func)
+    _argmatcher_modified()
     self._classify_func = func
     return self
 end
@@ -408,13 +647,7 @@ function _argmatcher:_is_flag(word)
         return false
     end
 
-    for i, _ in pairs(self._flagprefix) do
-        if first_char == i then
-            return true
-        end
-    end
-
-    return false
+    return self._flagprefix[first_char] ~= nil
 end
 
 --------------------------------------------------------------------------------
@@ -487,25 +720,8 @@ end
 
 --------------------------------------------------------------------------------
 function _argmatcher:_generate(line_state, match_builder, extra_words)
-    local reader = _argreader(self, line_state)
-
-    -- Consume extra words from expanded doskey alias.
-    if extra_words then
-        for word_index = 2, #extra_words do
-            reader:update(extra_words[word_index], -1)
-        end
-    end
-
-    -- Consume words and use them to move through matchers' arguments.
     local word_count = line_state:getwordcount()
-    local command_word_index = line_state:getcommandwordindex()
-    for word_index = command_word_index + 1, (word_count - 1) do
-        local info = line_state:getwordinfo(word_index)
-        if not info.redir then
-            local word = line_state:getword(word_index)
-            reader:update(word, word_index)
-        end
-    end
+    local reader = _get_argreader(self, line_state, extra_words, word_count - 1)
 
     -- There should always be a matcher left on the stack, but the arg_index
     -- could be well out of range.
@@ -519,6 +735,12 @@ function _argmatcher:_generate(line_state, match_builder, extra_words)
             match_builder:addmatch(key, match_type)
         end
 
+        -- Without functions the whole list can be added in one call.
+        if not _get_compiled_arg(arg).has_function then
+            match_builder:addmatches(arg, match_type)
+            return true
+        end
+
         for _, i in ipairs(arg) do
             if type(i) == "function" then
                 local j = i(line_state:getendword(), word_count, line_state, match_builder)
@@ -625,6 +847,7 @@ end
 --------------------------------------------------------------------------------
 -- Deprecated.
 function _argmatcher:set_arguments(...)
+    _argmatcher_modified()
     self._args = { _links = {} }
     self:addarg(...)
     return self
@@ -633,6 +856,7 @@ end
 --------------------------------------------------------------------------------
 -- Deprecated.
 function _argmatcher:set_flags(...)
+    _argmatcher_modified()
     self._flags = nil
     self:addflags(...)
     return self
@@ -689,6 +913,7 @@ function clink.argmatcher(...)
         matcher._nextargindex = 1 -- so the next :addarg() affects position 1
     else
         -- No existing matcher; create a new matcher and set the priority.
+        _argmatcher_modified()
         matcher = _argmatcher()
         matcher._priority = priority
         for _, i in ipairs(input) do
@@ -849,25 +1074,7 @@ end
 function argmatcher_generator:getwordbreakinfo(line_state)
     local argmatcher, has_argmatcher, extra_words = _find_argmatcher(line_state)
     if argmatcher then
-        local reader = _argreader(argmatcher, line_state)
-
-        -- Consume extra words from expanded doskey alias.
-        if extra_words then
-            for word_index = 2, #extra_words do
-                reader:update(extra_words[word_index], -1)
-            end
-        end
-
-        -- Consume words and use them to move through matchers' arguments.
-        local word_count = line_state:getwordcount()
-        local command_word_index = line_state:getcommandwordindex()
-        for word_index = command_word_index + 1, (word_count - 1) do
-            local info = line_state:getwordinfo(word_index)
-            if not info.redir then
-                local word = line_state:getword(word_index)
-                reader:update(word, word_index)
-            end
-        end
+        local reader = _get_argreader(argmatcher, line_state, extra_words, line_state:getwordcount() - 1)
 
         -- There should always be a matcher left on the stack, but the arg_index
         -- could be well out of range.
@@ -913,24 +1120,7 @@ function argmatcher_classifier:classify(commands)
         end
 
         if argmatcher then
-            local reader = _argreader(argmatcher, line_state)
-            reader._word_classifier = word_classifier
-
-            -- Consume extra words from expanded doskey alias.
-            if extra_words then
-                for word_index = 2, #extra_words do
-                    reader:update(extra_words[word_index], -1)
-                end
-            end
-
-            -- Consume words and use them to move through matchers' arguments.
-            for word_index = command_word_index + 1, word_count do
-                local info = line_state:getwordinfo(word_index)
-                if not info.redir then
-                    local word = line_state:getword(word_index)
-                    reader:update(word, word_index)
-                end
-            end
+            _get_argreader(argmatcher, line_state, extra_words, word_count, word_classifier)
         end
     end
 
@@ -1044,6 +1234,7 @@ function clink.arg.register_parser(cmd, parser)
     end
 
     -- Register the parser.
+    _argmatcher_modified()
     _argmatchers[cmd] = parser
     return matcher
 end
@@ -81,5 +81,6 @@ function clink.classifier(priority)
     table.insert(_classifiers, ret)
 
     _classifiers_unsorted = true
+    clink.reclassifyline()
     return ret
 end
@@ -7,7 +7,7 @@ local _coroutines = {}
 local _coroutines_created = {}          -- Remembers creation info for each coroutine, for use by clink.addcoroutine.
 local _after_coroutines = {}            -- Funcs to run after a pass resuming coroutines.
 local _coroutines_resumable = false     -- When false, coroutines will no longer run.
-local _coroutine_yieldguard = nil       -- Which coroutine is yielding inside popenyield.
+local _coroutine_yieldguards = {}       -- Which io.popenyield commands are running.
 local _coroutine_context = nil          -- Context for queuing io.popenyield calls from a same source.
 local _coroutine_canceled = false       -- Becomes true if an orphaned io.popenyield cancels the coroutine.
 local _coroutine_generation = 0         -- ID for current generation of coroutines.
@@ -31,49 +31,77 @@ local print = clink.print
 --      firstclock:     The os.clock() from the beginning of the first resume.
 --      throttleclock:  The os.clock() from the end of the most recent yieldguard.
 --      lastclock:      The os.clock() from the end of the last resume.
---      infinite:       Use INFINITE wait for this coroutine; it's actively inside popenyield.
+--      yieldguard:     Use INFINITE wait for this coroutine; it's waiting for output from popenyield.
 --      queued:         Use INFINITE wait for this coroutine; it's queued inside popenyield.
+--
+-- Scheme for entries in _coroutine_yieldguards (keyed by yieldguard):
+--      coroutine:      The coroutine that started the command.
+--      yieldguard:     The yieldguard returned by io.popenyield_internal.
 
 --------------------------------------------------------------------------------
 local function clear_coroutines()
-    local preserve
-    if _coroutine_yieldguard then
-        -- Preserve the active popenyield entry so the system can tell when to
-        -- dequeue the next one.
-        preserve = _coroutines[_coroutine_yieldguard.coroutine]
+    -- Preserve the active popenyield entries so the system can tell when to
+    -- dequeue the next ones.
+    local preserve = {}
+    for _,yg in pairs(_coroutine_yieldguards) do
+        table.insert(preserve, _coroutines[yg.coroutine])
     end
 
     _coroutines = {}
     _coroutines_created = {}
     _after_coroutines = {}
     _coroutines_resumable = false
-    -- Don't touch _coroutine_yieldguard; it only gets cleared when the thread finishes.
+    -- Don't touch _coroutine_yieldguards; they only get cleared when the threads finish.
     _coroutine_context = nil
     _coroutine_canceled = false
     _coroutine_generation = _coroutine_generation + 1
 
     _dead = (settings.get("lua.debug") or clink.DEBUG) and {} or nil
 
-    if preserve then
-        _coroutines[preserve.coroutine] = preserve
+    for _,entry in ipairs(preserve) do
+        _coroutines[entry.coroutine] = entry
     end
 end
 clink.onbeginedit(clear_coroutines)
 
+--------------------------------------------------------------------------------
+local function get_yieldguard_limit()
+    local limit = settings.get("prompt.async_limit") or 1
+    return (limit > 0) and limit or 1
+end
+
+--------------------------------------------------------------------------------
+local function count_coroutine_yieldguards()
+    local count = 0
+    for _ in pairs(_coroutine_yieldguards) do
+        count = count + 1
+    end
+    return count
+end
+
 --------------------------------------------------------------------------------
 local function release_coroutine_yieldguard()
-    if _coroutine_yieldguard and _coroutine_yieldguard.yieldguard:ready() then
-        local entry = _coroutines[_coroutine_yieldguard.coroutine]
-        if entry and entry.yieldguard == _coroutine_yieldguard.yieldguard then
-            entry.throttleclock = os.clock()
-            entry.yieldguard = nil
-            _coroutine_yieldguard = nil
-            for _,entry in pairs(_coroutines) do
-                if entry.queued then
-                    entry.queued = nil
-                    break
+    local released
+    for yieldguard,yg in pairs(_coroutine_yieldguards) do
+        if yieldguard:ready() then
+            local entry = _coroutines[yg.coroutine]
+            if entry then
+                entry.throttleclock = os.clock()
+                if entry.yieldguard == yieldguard then
+                    entry.yieldguard = nil
                 end
             end
+            _coroutine_yieldguards[yieldguard] = nil
+            released = true
+        end
+    end
+
+    -- Wake all queued entries when there are free slots.  Entries that don't
+    -- get a slot queue themselves again, and waking them all ensures an
+    -- orphaned entry can't strand the others.
+    if released and count_coroutine_yieldguards() < get_yieldguard_limit() then
+        for _,entry in pairs(_coroutines) do
+            entry.queued = nil
         end
     end
 end
@@ -87,15 +115,24 @@ local function get_coroutine_generation()
 end
 
 --------------------------------------------------------------------------------
-local function set_coroutine_yieldguard(yieldguard)
+local function add_coroutine_yieldguard(yieldguard)
+    local t = coroutine.running()
+    _coroutine_yieldguards[yieldguard] = { coroutine=t, yieldguard=yieldguard }
+end
+
+--------------------------------------------------------------------------------
+local function wait_coroutine_yieldguard(yieldguard, stream)
     local t = coroutine.running()
-    if yieldguard then
-        _coroutine_yieldguard = { coroutine=t, yieldguard=yieldguard }
+    local entry = t and _coroutines[t]
+    if entry then
+        -- Yield until more output arrives; the popen thread signals the wake
+        -- event whenever it receives output.
+        entry.yieldguard = yieldguard
+        coroutine.yield()
+        entry.yieldguard = nil
     else
-        release_coroutine_yieldguard()
-    end
-    if t and _coroutines[t] then
-        _coroutines[t].yieldguard = yieldguard
+        -- Not inside a scheduled coroutine, so block until the command finishes.
+        stream:_wait()
     end
 end
 
@@ -330,15 +367,15 @@ function clink._diag_coroutines()
     end
 
     -- Only list coroutines if there are any, or if there's unfinished state.
-    if table_has_elements(threads) or _coroutines_resumable or _coroutine_yieldguard then
+    if table_has_elements(threads) or _coroutines_resumable or table_has_elements(_coroutine_yieldguards) then
         clink.print(bold.."coroutines:"..norm)
         if show_gen then
             print("  generation", (mixed_gen and yellow or norm).."gen ".._coroutine_generation..norm)
         end
         print("  resumable", _coroutines_resumable)
         print("  wait_duration", clink._wait_duration())
-        if _coroutine_yieldguard then
-            local yg = _coroutine_yieldguard.yieldguard
+        print("  yieldlimit", get_yieldguard_limit())
+        for yg in pairs(_coroutine_yieldguards) do
             print("  yieldguard", (yg:ready() and green.."ready"..norm or yellow.."yield"..norm))
             print("  yieldcommand", '"'..yg:command()..'"')
         end
@@ -409,12 +446,25 @@ end
 --- -show:  file:close()
 --- This is the same as
 --- <code><span class="hljs-built_in">io</span>.<span class="hljs-built_in">popen</span>(<span class="arg">command</span>, <span class="arg">mode</span>)</code>
---- except that it only supports read mode and it yields until the command has
---- finished:
+--- except that it only supports read mode and it yields while waiting for
+--- output from the command:
 ---
 --- Runs <span class="arg">command</span> and returns a read file handle for
---- reading output from the command.  It yields until the command has finished
---- and the complete output is ready to be read without blocking.
+--- reading output from the command.  The output is collected in memory as the
+--- command produces it, and reading from the file handle yields until the
+--- requested output is available, so <code>file:lines()</code> can process
+--- lines as they arrive.
+---
+--- The file handle supports the same methods as a read mode file handle from
+--- <code><span class="hljs-built_in">io</span>.<span class="hljs-built_in">popen</span>()</code>,
+--- and <code>io.type()</code> reports it as a file.  However, it is not a C
+--- runtime file, so it can't be passed to <code>io.input()</code> or
+--- <code>io.output()</code>, reading numbers via <code>read("n")</code> is not
+--- supported, and <code>seek()</code> fails the same as for any pipe.
+---
+--- Up to <code>prompt.async_limit</code> commands can run concurrently (from
+--- different coroutines); additional calls wait until one of the running
+--- commands finishes.
 ---
 --- The <span class="arg">mode</span> can contain "r" (read mode) and/or either
 --- "t" for text mode (the default if omitted) or "b" for binary mode.  Write
@@ -428,27 +478,33 @@ end
 function io.popenyield(command, mode)
     -- This outer wrapper is implemented in Lua so that it can yield.
     if settings.get("prompt.async") and not clink.istransientpromptfilter() then
-        -- Yield to ensure only one popenyield active at a time.
-        if _coroutine_yieldguard then
+        -- Cancel if not from the current prompt filter generation.
+        local function check_orphaned()
+            if get_coroutine_generation() ~= _coroutine_generation then
+                local message = (type(command) == string) and command..": " or ""
+                cancel_coroutine(message.."canceling popenyield; coroutine is orphaned")
+            end
+        end
+        check_orphaned()
+        -- Yield to limit how many popenyield are active at a time.
+        if count_coroutine_yieldguards() >= get_yieldguard_limit() then
             set_coroutine_queued(true)
-            while _coroutine_yieldguard do
+            while count_coroutine_yieldguards() >= get_yieldguard_limit() do
                 coroutine.yield()
+                set_coroutine_queued(true)
             end
             set_coroutine_queued(false)
-        end
-        -- Cancel if not from the current prompt filter generation.
-        if get_coroutine_generation() ~= _coroutine_generation then
-            local message = (type(command) == string) and command..": " or ""
-            cancel_coroutine(message.."canceling popenyield; coroutine is orphaned")
+            check_orphaned()
         end
         -- Start the popenyield.
         local file, yieldguard = io.popenyield_internal(command, mode)
         if file and yieldguard then
-            set_coroutine_yieldguard(yieldguard)
-            while not yieldguard:ready() do
-                coroutine.yield()
-            end
-            set_coroutine_yieldguard(nil)
+            add_coroutine_yieldguard(yieldguard)
+            -- Reading from the file calls this to yield until more output
+            -- arrives.
+            file:_setwaiter(function ()
+                wait_coroutine_yieldguard(yieldguard, file)
+            end)
         end
         return file
     else
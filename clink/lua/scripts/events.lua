@@ -80,6 +80,26 @@ local function _add_event_callback(event, func)
     end
 end
 
+--------------------------------------------------------------------------------
+-- Match event handlers that opted in to receiving the matches view.  Weak keys
+-- so that ondisplaymatches handlers don't accumulate.
+local _match_view_funcs = setmetatable({}, { __mode = "k" })
+
+--------------------------------------------------------------------------------
+local function _set_match_view(func, view)
+    _match_view_funcs[func] = view and true or nil
+end
+
+--------------------------------------------------------------------------------
+-- Handlers that didn't opt in receive a plain table, the same as before the
+-- matches view existed.
+local function _matches_to_table(matches)
+    if type(matches) == "userdata" then
+        return matches:totable()
+    end
+    return matches
+end
+
 --------------------------------------------------------------------------------
 --- -name:  clink.oninject
 --- -arg:   func:function
@@ -134,6 +154,7 @@ end
 --------------------------------------------------------------------------------
 --- -name:  clink.ondisplaymatches
 --- -arg:   func:function
+--- -arg:   [view:boolean]
 --- -show:  local function my_filter(matches, popup)
 --- -show:  &nbsp; local new_matches = {}
 --- -show:  &nbsp; for _,m in ipairs(matches) do
@@ -157,7 +178,11 @@ end
 --- Registers <span class="arg">func</span> to be called when Clink is about to
 --- display matches.  See <a href="#filteringthematchdisplay">Filtering the
 --- Match Display</a> for more information.
-function clink.ondisplaymatches(func)
+---
+--- If <span class="arg">view</span> is true, then <span class="arg">func</span>
+--- receives a read-only matches object instead of a table; see
+--- <a href="#matchesview">Matches Objects</a>.
+function clink.ondisplaymatches(func, view)
     -- For now, only one handler at a time.  I wanted it to be a chain of
     -- handlers, but that implies the output from one handler will be input to
     -- the next.  It got messy trying to keep it simple and flexible without
@@ -165,6 +190,7 @@ function clink.ondisplaymatches(func)
     -- wedged in amongst the real events.
     clink._event_callbacks["ondisplaymatches"] = {}
     _add_event_callback("ondisplaymatches", func)
+    _set_match_view(func, view)
 end
 
 --------------------------------------------------------------------------------
@@ -173,6 +199,9 @@ function clink._send_ondisplaymatches_event(matches, popup)
     if callbacks ~= nil then
         local func = callbacks[1]
         if func then
+            if not _match_view_funcs[func] then
+                matches = _matches_to_table(matches)
+            end
             return func(matches, popup)
         end
     end
@@ -182,11 +211,17 @@ end
 --------------------------------------------------------------------------------
 --- -name:  clink.onfiltermatches
 --- -arg:   func:function
+--- -arg:   [view:boolean]
 --- Registers <span class="arg">func</span> to be called after Clink generates
 --- matches for completion.  See <a href="#filteringmatchcompletions">
 --- Filtering Match Completions</a> for more information.
-function clink.onfiltermatches(func)
+---
+--- If <span class="arg">view</span> is true, then <span class="arg">func</span>
+--- receives a read-only matches object instead of a table; see
+--- <a href="#matchesview">Matches Objects</a>.
+function clink.onfiltermatches(func, view)
     _add_event_callback("onfiltermatches", func)
+    _set_match_view(func, view)
 end
 
 --------------------------------------------------------------------------------
@@ -196,7 +231,14 @@ function clink._send_onfiltermatches_event(matches, completion_type, filename_co
     if callbacks ~= nil then
         local _, func
         for _, func in ipairs(callbacks) do
-            local m = func(matches, completion_type, filename_completion_desired)
+            local arg = matches
+            if not _match_view_funcs[func] then
+                -- Convert the view once, and share the table with the other
+                -- handlers that didn't opt in to the view.
+                matches = _matches_to_table(matches)
+                arg = matches
+            end
+            local m = func(arg, completion_type, filename_completion_desired)
             if m ~= nil then
                 matches = m
                 ret = matches
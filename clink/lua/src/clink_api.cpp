@@ -592,6 +592,22 @@ static int translate_slashes(lua_State* state)
     return 0;
 }
 
+//------------------------------------------------------------------------------
+/// -name:  clink.reclassifyline
+/// Makes Clink classify all words in the input line again the next time it
+/// is redrawn.  Clink only passes a command to the word classifiers when the
+/// command's text changes, so a classifier that depends on other state (such
+/// as the current directory or environment variables) should call this when
+/// that state changes.
+///
+/// Adding or modifying argmatchers or classifiers does this automatically.
+static int reclassify_line(lua_State* state)
+{
+    extern void force_reclassify_line();
+    force_reclassify_line();
+    return 0;
+}
+
 //------------------------------------------------------------------------------
 /// -name:  clink.slash_translation
 /// -arg:   type:integer
@@ -675,6 +691,7 @@ void clink_lua_initialise(lua_state& lua)
         { "getsession",             &get_session },
         { "getansihost",            &get_ansi_host },
         { "translateslashes",       &translate_slashes },
+        { "reclassifyline",         &reclassify_line },
         // Backward compatibility with the Clink 0.4.8 API.  Clink 1.0.0a1 had
         // moved these APIs away from "clink.", but backward compatibility
         // requires them here as well.
@@ -0,0 +1,308 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "executable_index.h"
+
+#include <core/base.h>
+#include <core/path.h>
+
+//------------------------------------------------------------------------------
+static void get_env(const wchar_t* name, wstr_base& out)
+{
+    out.clear();
+
+    int len = GetEnvironmentVariableW(name, nullptr, 0);
+    if (!len)
+        return;
+
+    wstr<> value;
+    value.reserve(len);
+    if (GetEnvironmentVariableW(name, value.data(), value.size()))
+        out.concat(value.c_str());
+}
+
+//------------------------------------------------------------------------------
+static void get_current_dir(wstr_base& out)
+{
+    out.clear();
+
+    int len = GetCurrentDirectoryW(0, nullptr);
+    if (!len)
+        return;
+
+    wstr<> value;
+    value.reserve(len);
+    if (GetCurrentDirectoryW(value.size(), value.data()))
+        out.concat(value.c_str());
+}
+
+//------------------------------------------------------------------------------
+static unsigned long long get_write_time(const wchar_t* path)
+{
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExW(path, GetFileExInfoStandard, &data))
+        return 0;
+
+    return (unsigned long long)data.ftLastWriteTime.dwHighDateTime << 32 | data.ftLastWriteTime.dwLowDateTime;
+}
+
+//------------------------------------------------------------------------------
+static bool is_fully_qualified(const wchar_t* path)
+{
+    // "\\server\share" and "c:\dir" don't depend on the current directory,
+    // but "dir", ".", "\dir", and "c:dir" do.
+    if (path::is_separator(path[0]))
+        return path::is_separator(path[1]);
+    return iswalpha(path[0]) && path[1] == ':' && path::is_separator(path[2]);
+}
+
+//------------------------------------------------------------------------------
+static void get_full_path(const wchar_t* path, wstr_base& out)
+{
+    out.clear();
+
+    int len = GetFullPathNameW(path, 0, nullptr, nullptr);
+    if (len)
+    {
+        wstr<> full;
+        full.reserve(len);
+        len = GetFullPathNameW(path, full.size(), full.data(), nullptr);
+        if (len)
+            out.concat(full.c_str());
+    }
+
+    if (!len)
+    {
+        out.concat(path);
+        return;
+    }
+
+    // Different spellings of the same directory share an entry.
+    int i = out.length();
+    while (i > 3 && path::is_separator(out[i - 1]))
+        --i;
+    out.truncate(i);
+}
+
+
+
+//------------------------------------------------------------------------------
+executable_index::directory::~directory()
+{
+    if (m_watch)
+        FindCloseChangeNotification(m_watch);
+}
+
+//------------------------------------------------------------------------------
+bool executable_index::directory::is_stale()
+{
+    if (!m_enumerated)
+        return true;
+
+    // A signaled change notification means something in the directory was
+    // added, removed, or renamed.
+    if (m_watch)
+    {
+        if (WaitForSingleObject(m_watch, 0) != WAIT_OBJECT_0)
+            return false;
+        if (!FindNextChangeNotification(m_watch))
+        {
+            FindCloseChangeNotification(m_watch);
+            m_watch = nullptr;
+        }
+        return true;
+    }
+
+    // Without a change notification, fall back to the last write time.
+    return get_write_time(m_path.c_str()) != m_write_time;
+}
+
+
+
+//------------------------------------------------------------------------------
+executable_index::~executable_index()
+{
+    clear();
+}
+
+//------------------------------------------------------------------------------
+executable_index& executable_index::get()
+{
+    static executable_index s_index;
+    return s_index;
+}
+
+//------------------------------------------------------------------------------
+void executable_index::clear()
+{
+    m_path.clear();
+    m_pathext.clear();
+    m_cwd.clear();
+    m_exts.clear();
+    m_dirs.clear();
+    m_relative = false;
+}
+
+//------------------------------------------------------------------------------
+void executable_index::update()
+{
+    wstr_moveable path;
+    wstr_moveable pathext;
+    wstr_moveable cwd;
+    get_env(L"PATH", path);
+    get_env(L"PATHEXT", pathext);
+    if (m_relative)
+        get_current_dir(cwd);
+
+    // A changed %PATHEXT% changes which files are executable, so everything
+    // must be enumerated again.
+    if (!m_pathext.equals(pathext.c_str()))
+    {
+        m_dirs.clear();
+        m_path.clear();
+        m_exts.clear();
+        m_pathext = std::move(pathext);
+
+        wstr_moveable ext;
+        for (const wchar_t* s = m_pathext.c_str(); true; ++s)
+        {
+            if (*s == ';' || !*s)
+            {
+                if (ext.length())
+                    m_exts.emplace_back(std::move(ext));
+                ext.clear();
+                if (!*s)
+                    break;
+            }
+            else
+            {
+                ext.concat(s, 1);
+            }
+        }
+    }
+
+    // A changed %PATH% keeps the directories that are still present.  Relative
+    // directories are keyed by their full paths, so they're resolved again when
+    // the current directory changes.
+    if (!m_path.equals(path.c_str()) || (m_relative && !m_cwd.iequals(cwd.c_str())))
+    {
+        std::vector<std::unique_ptr<directory>> dirs;
+        wstr_moveable dir;
+        wstr_moveable full;
+        bool relative = false;
+        for (const wchar_t* s = path.c_str(); true; ++s)
+        {
+            if (*s == ';' || !*s)
+            {
+                if (dir.length())
+                {
+                    relative |= !is_fully_qualified(dir.c_str());
+                    get_full_path(dir.c_str(), full);
+
+                    std::unique_ptr<directory> entry;
+                    for (auto& old : m_dirs)
+                    {
+                        if (old && old->m_path.iequals(full.c_str()))
+                        {
+                            entry = std::move(old);
+                            break;
+                        }
+                    }
+                    if (!entry)
+                    {
+                        entry = std::make_unique<directory>();
+                        entry->m_path = std::move(full);
+                    }
+                    dirs.emplace_back(std::move(entry));
+                }
+                dir.clear();
+                if (!*s)
+                    break;
+            }
+            else
+            {
+                dir.concat(s, 1);
+            }
+        }
+
+        m_dirs = std::move(dirs);
+        m_path = std::move(path);
+        m_relative = relative;
+        if (m_relative && cwd.empty())
+            get_current_dir(cwd);
+        m_cwd = std::move(cwd);
+    }
+
+    for (auto& dir : m_dirs)
+        if (dir->is_stale())
+            enumerate(*dir);
+}
+
+//------------------------------------------------------------------------------
+bool executable_index::has_executable_ext(const wchar_t* name) const
+{
+    const wchar_t* ext = wcsrchr(name, '.');
+    if (!ext)
+        return false;
+
+    for (const auto& e : m_exts)
+        if (_wcsicmp(ext, e.c_str()) == 0)
+            return true;
+
+    return false;
+}
+
+//------------------------------------------------------------------------------
+void executable_index::enumerate(directory& dir) const
+{
+    dir.m_files.clear();
+    dir.m_enumerated = true;
+
+    // Start watching before enumerating, so changes made during enumeration
+    // aren't missed.
+    if (!dir.m_watch)
+    {
+        const DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME|FILE_NOTIFY_CHANGE_ATTRIBUTES;
+        dir.m_watch = FindFirstChangeNotificationW(dir.m_path.c_str(), false, filter);
+        if (dir.m_watch == INVALID_HANDLE_VALUE)
+            dir.m_watch = nullptr;
+    }
+    if (!dir.m_watch)
+        dir.m_write_time = get_write_time(dir.m_path.c_str());
+
+    wstr<280> pattern;
+    pattern << dir.m_path.c_str();
+    if (!path::is_separator(pattern[pattern.length() - 1]))
+        pattern << L"\\";
+    pattern << L"*";
+
+    WIN32_FIND_DATAW fd;
+    HANDLE h = FindFirstFileExW(pattern.c_str(), FindExInfoBasic, &fd, FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+    if (h == INVALID_HANDLE_VALUE)
+        return;
+
+    do
+    {
+        if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            continue;
+        if (!has_executable_ext(fd.cFileName))
+            continue;
+
+        file f;
+        f.name = fd.cFileName;
+        f.attr = fd.dwFileAttributes;
+        f.orphaned = false;
+        if (f.attr & FILE_ATTRIBUTE_REPARSE_POINT)
+        {
+            wstr<280> full;
+            full << dir.m_path.c_str() << L"\\" << fd.cFileName;
+            struct _stat64 st;
+            f.orphaned = (_wstat64(full.c_str(), &st) < 0);
+        }
+        dir.m_files.emplace_back(std::move(f));
+    }
+    while (FindNextFileW(h, &fd));
+
+    FindClose(h);
+}
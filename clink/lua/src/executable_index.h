@@ -0,0 +1,79 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <core/str.h>
+
+#include <memory>
+#include <vector>
+
+//------------------------------------------------------------------------------
+class executable_index
+{
+    // Caches the executables in each directory in %PATH%, so completing the
+    // first word doesn't need to enumerate every directory for every extension
+    // in %PATHEXT%.  Each directory is enumerated once and filtered by
+    // extension in memory.  Directories are watched with change notifications
+    // (or by their last write time, where notifications aren't available), and
+    // are only enumerated again after they change.  Changing %PATH% or
+    // %PATHEXT% invalidates the affected entries.  Relative directories in
+    // %PATH% are resolved against the current directory.
+
+public:
+    struct file
+    {
+        str_moveable        name;
+        unsigned int        attr;
+        bool                orphaned;
+    };
+
+                            executable_index() = default;
+                            ~executable_index();
+    static executable_index& get();
+    void                    clear();
+    template <typename T> void for_each(bool hidden, bool system, T&& callback);
+
+private:
+    struct directory;
+    void                    update();
+    bool                    has_executable_ext(const wchar_t* name) const;
+    void                    enumerate(directory& dir) const;
+    wstr_moveable           m_path;
+    wstr_moveable           m_pathext;
+    wstr_moveable           m_cwd;
+    std::vector<wstr_moveable> m_exts;
+    std::vector<std::unique_ptr<directory>> m_dirs;
+    bool                    m_relative = false;
+};
+
+//------------------------------------------------------------------------------
+struct executable_index::directory
+{
+                            directory() = default;
+                            ~directory();
+    bool                    is_stale();
+    wstr_moveable           m_path;
+    void*                   m_watch = nullptr;
+    unsigned long long      m_write_time = 0;
+    bool                    m_enumerated = false;
+    std::vector<file>       m_files;
+};
+
+//------------------------------------------------------------------------------
+template <typename T> void executable_index::for_each(bool hidden, bool system, T&& callback)
+{
+    update();
+
+    for (const auto& dir : m_dirs)
+    {
+        for (const auto& f : dir->m_files)
+        {
+            if ((f.attr & FILE_ATTRIBUTE_HIDDEN) && !hidden)
+                continue;
+            if ((f.attr & FILE_ATTRIBUTE_SYSTEM) && !system)
+                continue;
+            callback(f);
+        }
+    }
+}
@@ -8,6 +8,7 @@
 #include <core/os.h>
 #include <core/path.h>
 #include <core/globber.h>
+#include <core/ring_buffer.h>
 
 #include <fcntl.h>
 #include <io.h>
@@ -15,6 +16,7 @@
 #include <process.h>
 #include <list>
 #include <memory>
+#include <vector>
 #include <assert.h>
 
 #ifndef _MSC_VER
@@ -36,7 +38,6 @@ void set_io_wake_event(HANDLE event)
 //------------------------------------------------------------------------------
 struct popenrw_info
 {
-    friend int io_popenyield(lua_State* state);
     friend int io_popenrw(lua_State* state);
 
     static popenrw_info* find(FILE* f)
@@ -77,7 +78,6 @@ struct popenrw_info
     , r(nullptr)
     , w(nullptr)
     , process_handle(0)
-    , async(false)
     {
     }
 
@@ -111,17 +111,11 @@ struct popenrw_info
         return wait;
     }
 
-    bool is_async()
-    {
-        return async;
-    }
-
 private:
     popenrw_info* next;
     FILE* r;
     FILE* w;
     intptr_t process_handle;
-    bool async;
 };
 
 //------------------------------------------------------------------------------
@@ -158,10 +152,9 @@ static int pclosefile(lua_State *state)
     intptr_t process_handle = info->get_wait_handle();
     if (process_handle)
     {
-        bool wait = !info->is_async();
         popenrw_info::remove(info);
         delete info;
-        return luaL_execresult(state, wait ? pclosewait(process_handle) : 0);
+        return luaL_execresult(state, pclosewait(process_handle));
     }
 
     return luaL_fileresult(state, (res == 0), NULL);
@@ -381,37 +374,37 @@ struct pipe_pair
     FILE* local = nullptr;
 };
 
+
+
 //------------------------------------------------------------------------------
-struct popen_buffering : public std::enable_shared_from_this<popen_buffering>
+struct popen_buffering
 {
-    popen_buffering(FILE* r, HANDLE w)
+    // Collects the output of an io.popenyield command in memory as it arrives.
+    // The pipe is read with overlapped IO by the shared popen_pump thread.
+
+    popen_buffering(HANDLE r, bool binary)
     : m_read(r)
-    , m_write(w)
+    , m_binary(binary)
     {
+        InitializeCriticalSection(&m_lock);
+        memset(&m_overlapped, 0, sizeof(m_overlapped));
     }
 
     ~popen_buffering()
     {
-        if (m_thread_handle)
-        {
-            cancel();
-            CloseHandle(m_thread_handle);
-        }
         if (m_read)
-            fclose(m_read);
-        if (m_write)
-            CloseHandle(m_write);
+            CloseHandle(m_read);
+        if (m_overlapped.hEvent)
+            CloseHandle(m_overlapped.hEvent);
         if (m_ready_event)
             CloseHandle(m_ready_event);
         if (m_wake_event)
             CloseHandle(m_wake_event);
+        DeleteCriticalSection(&m_lock);
     }
 
-    bool createthread()
+    bool init()
     {
-        assert(!m_suspended);
-        assert(!m_thread_handle);
-        assert(!m_cancelled);
         assert(!m_ready_event);
         assert(!m_wake_event);
         if (s_wake_event)
@@ -421,95 +414,320 @@ struct popen_buffering : public std::enable_shared_from_this<popen_buffering>
                 return false;
         }
         m_ready_event = CreateEvent(nullptr, true, false, nullptr);
+        m_overlapped.hEvent = CreateEvent(nullptr, true, false, nullptr);
+        return m_ready_event && m_overlapped.hEvent;
+    }
+
+    void cancel();
+
+    bool is_ready() const
+    {
         if (!m_ready_event)
             return false;
-        m_thread_handle = reinterpret_cast<HANDLE>(_beginthreadex(nullptr, 0, &threadproc, this, CREATE_SUSPENDED, nullptr));
-        if (!m_thread_handle)
-            return false;
-        m_holder = shared_from_this(); // Now threadproc holds a strong ref.
-        m_suspended = true;
-        return true;
+        return WaitForSingleObject(m_ready_event, 0) == WAIT_OBJECT_0;
     }
 
-    void go()
+    void wait() const
     {
-        assert(m_suspended);
-        if (m_thread_handle)
-        {
-            m_suspended = false;
-            ResumeThread(m_thread_handle);
-        }
+        if (m_ready_event)
+            WaitForSingleObject(m_ready_event, INFINITE);
     }
 
-    void cancel()
+    bool read(lua_State* state, const char* format, lua_Integer count);
+
+private:
+    friend class popen_pump;
+
+    bool begin_read()
     {
-        m_cancelled = true;
-        if (m_suspended) // Can only be true when there's no concurrency.
-            ResumeThread(m_thread_handle);
+        // ReadFile can complete synchronously; keep reading until it's pending.
+        while (!m_cancelled)
+        {
+            DWORD len = 0;
+            if (!ReadFile(m_read, m_buffer, sizeof_array(m_buffer), &len, &m_overlapped))
+            {
+                m_io_pending = (GetLastError() == ERROR_IO_PENDING);
+                return m_io_pending;
+            }
+            append(len);
+        }
+        return false;
     }
 
-    bool is_ready()
+    bool end_read()
     {
-        if (!m_ready_event)
+        DWORD len = 0;
+        m_io_pending = false;
+        if (!GetOverlappedResult(m_read, &m_overlapped, &len, false))
             return false;
-        return WaitForSingleObject(m_ready_event, 0) == WAIT_OBJECT_0;
+        append(len);
+        return begin_read();
     }
 
-    HANDLE get_ready_event()
+    void append(DWORD len)
     {
-        return m_ready_event;
+        if (!len)
+            return;
+        EnterCriticalSection(&m_lock);
+        m_ring.append(reinterpret_cast<const char*>(m_buffer), len);
+        LeaveCriticalSection(&m_lock);
+        if (m_wake_event)
+            SetEvent(m_wake_event);
     }
 
-private:
-    static unsigned __stdcall threadproc(void* arg)
+    void finish()
     {
-        popen_buffering* _this = static_cast<popen_buffering*>(arg);
-        HANDLE rh = reinterpret_cast<HANDLE>(_get_osfhandle(fileno(_this->m_read)));
-        HANDLE wh = _this->m_write;
-
-        while (!_this->m_cancelled)
+        if (m_io_pending && CancelIo(m_read))
         {
             DWORD len;
-TODO("COROUTINES: could use overlapped IO to enable cancelling even a blocking call.");
-            if (!ReadFile(rh, _this->m_buffer, sizeof_array(m_buffer), &len, nullptr))
-                break;
-
-            DWORD written;
-            if (!WriteFile(wh, _this->m_buffer, len, &written, nullptr))
-                break;
-            if (written != len)
-                break;
+            GetOverlappedResult(m_read, &m_overlapped, &len, true);
         }
-
-        // Reset file pointer so the read handle can read from the beginning.
-        SetFilePointer(wh, 0, nullptr, FILE_BEGIN);
+        m_io_pending = false;
+        CloseHandle(m_read);
+        m_read = nullptr;
 
         // Signal completion events.
-        SetEvent(_this->m_ready_event);
-        if (_this->m_wake_event)
-            SetEvent(_this->m_wake_event);
-
-        // Release threadproc's strong ref.
-        _this->m_holder = nullptr;
-
-        _endthreadex(0);
-        return 0;
+        SetEvent(m_ready_event);
+        if (m_wake_event)
+            SetEvent(m_wake_event);
     }
 
-    FILE* m_read;
-    HANDLE m_write;
-    HANDLE m_thread_handle = 0;
+    void push_text(lua_State* state, unsigned int len, bool keep_eol);
+
+    HANDLE m_read;
     HANDLE m_ready_event = 0;
     HANDLE m_wake_event = 0;
-    bool m_suspended = false;
-
+    OVERLAPPED m_overlapped;
+    CRITICAL_SECTION m_lock;
+    ring_buffer m_ring;
+    const bool m_binary;
     volatile long m_cancelled = false;
-    volatile long m_ready = false;
-
-    std::shared_ptr<popen_buffering> m_holder;
+    bool m_io_pending = false;
     BYTE m_buffer[4096];
 };
 
+//------------------------------------------------------------------------------
+void popen_buffering::push_text(lua_State* state, unsigned int len, bool keep_eol)
+{
+    luaL_Buffer b;
+    char* p = luaL_buffinitsize(state, &b, len);
+    m_ring.read(p, len);
+
+    // Text mode translates CRLF to LF, like the CRT does for files.
+    unsigned int out = len;
+    if (!m_binary)
+    {
+        out = 0;
+        for (unsigned int i = 0; i < len; ++i)
+        {
+            if (p[i] == '\r' && i + 1 < len && p[i + 1] == '\n')
+                continue;
+            p[out++] = p[i];
+        }
+    }
+
+    if (!keep_eol && out && p[out - 1] == '\n')
+        --out;
+
+    luaL_pushresultsize(&b, out);
+}
+
+//------------------------------------------------------------------------------
+// Pushes the value, or nil at the end of the output.  Returns false without
+// pushing anything if the value isn't available yet.
+bool popen_buffering::read(lua_State* state, const char* format, lua_Integer count)
+{
+    const bool done = is_ready();
+
+    EnterCriticalSection(&m_lock);
+
+    bool available = true;
+    const unsigned int size = m_ring.size();
+    if (!format)
+    {
+        // Like files, read(0) returns "" unless at the end of the output.
+        if (size && (size >= count || done))
+            push_text(state, unsigned(min<lua_Integer>(count, size)), true);
+        else if (done)
+            lua_pushnil(state);
+        else
+            available = false;
+    }
+    else if (*format == 'a')
+    {
+        if (done)
+            push_text(state, size, true);
+        else
+            available = false;
+    }
+    else
+    {
+        const bool keep_eol = (*format == 'L');
+        int eol = m_ring.find('\n');
+        if (eol >= 0)
+            push_text(state, eol + 1, keep_eol);
+        else if (done && size)
+            push_text(state, size, keep_eol);
+        else if (done)
+            lua_pushnil(state);
+        else
+            available = false;
+    }
+
+    LeaveCriticalSection(&m_lock);
+    return available;
+}
+
+
+
+//------------------------------------------------------------------------------
+class popen_pump
+{
+    // One thread services the pipes of all running io.popenyield commands,
+    // using overlapped IO.  The thread exits when there are no more pipes, and
+    // is started again as needed.
+
+public:
+    static bool     add(const std::shared_ptr<popen_buffering>& buffering);
+    static void     poke();
+
+private:
+                    popen_pump();
+    static popen_pump& get();
+    static unsigned __stdcall threadproc(void* arg);
+    void            run();
+    CRITICAL_SECTION m_lock;
+    HANDLE          m_control_event;
+    bool            m_running = false;
+    std::list<std::shared_ptr<popen_buffering>> m_pending;
+};
+
+//------------------------------------------------------------------------------
+popen_pump::popen_pump()
+{
+    InitializeCriticalSection(&m_lock);
+    m_control_event = CreateEvent(nullptr, false, false, nullptr);
+}
+
+//------------------------------------------------------------------------------
+popen_pump& popen_pump::get()
+{
+    static popen_pump s_pump;
+    return s_pump;
+}
+
+//------------------------------------------------------------------------------
+bool popen_pump::add(const std::shared_ptr<popen_buffering>& buffering)
+{
+    popen_pump& pump = get();
+    if (!pump.m_control_event)
+        return false;
+
+    bool ok = true;
+    EnterCriticalSection(&pump.m_lock);
+    pump.m_pending.push_back(buffering);
+    if (!pump.m_running)
+    {
+        HANDLE h = reinterpret_cast<HANDLE>(_beginthreadex(nullptr, 0, &threadproc, &pump, 0, nullptr));
+        if (h)
+        {
+            CloseHandle(h);
+            pump.m_running = true;
+        }
+        else
+        {
+            pump.m_pending.pop_back();
+            ok = false;
+        }
+    }
+    LeaveCriticalSection(&pump.m_lock);
+
+    if (ok)
+        SetEvent(pump.m_control_event);
+    return ok;
+}
+
+//------------------------------------------------------------------------------
+void popen_pump::poke()
+{
+    SetEvent(get().m_control_event);
+}
+
+//------------------------------------------------------------------------------
+unsigned __stdcall popen_pump::threadproc(void* arg)
+{
+    static_cast<popen_pump*>(arg)->run();
+    _endthreadex(0);
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+void popen_pump::run()
+{
+    std::vector<std::shared_ptr<popen_buffering>> active;
+    HANDLE handles[MAXIMUM_WAIT_OBJECTS];
+
+    while (true)
+    {
+        // Pick up new pipes, up to the wait limit; the rest stay pending until
+        // a slot frees up.
+        EnterCriticalSection(&m_lock);
+        while (!m_pending.empty() && active.size() < MAXIMUM_WAIT_OBJECTS - 1)
+        {
+            std::shared_ptr<popen_buffering> buffering = m_pending.front();
+            m_pending.pop_front();
+            if (buffering->begin_read())
+                active.emplace_back(std::move(buffering));
+            else
+                buffering->finish();
+        }
+        if (active.empty() && m_pending.empty())
+        {
+            m_running = false;
+            LeaveCriticalSection(&m_lock);
+            break;
+        }
+        LeaveCriticalSection(&m_lock);
+
+        // Drop cancelled pipes.
+        for (size_t i = active.size(); i--;)
+        {
+            if (active[i]->m_cancelled)
+            {
+                active[i]->finish();
+                active.erase(active.begin() + i);
+            }
+        }
+
+        DWORD count = 0;
+        handles[count++] = m_control_event;
+        for (const auto& buffering : active)
+            handles[count++] = buffering->m_overlapped.hEvent;
+
+        DWORD result = WaitForMultipleObjects(count, handles, false, INFINITE);
+        if (result <= WAIT_OBJECT_0 || result >= WAIT_OBJECT_0 + count)
+            continue;
+
+        // Broken pipe means the command has finished writing output.
+        size_t index = result - WAIT_OBJECT_0 - 1;
+        if (!active[index]->end_read())
+        {
+            active[index]->finish();
+            active.erase(active.begin() + index);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void popen_buffering::cancel()
+{
+    if (!m_cancelled)
+    {
+        m_cancelled = true;
+        popen_pump::poke();
+    }
+}
+
 
 
 //------------------------------------------------------------------------------
@@ -608,6 +826,369 @@ int luaL_YieldGuard::__tostring(lua_State* state)
 
 
 
+//------------------------------------------------------------------------------
+#define LUA_POPENSTREAM "clink_popen_stream"
+struct luaL_PopenStream
+{
+    // The file handle returned by io.popenyield.  It behaves like a read-only
+    // pipe from io.popen, except that reading yields (via the waiter function
+    // set by io.popenyield in coroutines.lua) until the requested output has
+    // arrived, instead of blocking.
+
+    static luaL_PopenStream* make_new(lua_State* state);
+    static luaL_PopenStream* test(lua_State* state, int index);
+
+    void init(std::shared_ptr<popen_buffering>& buffering, intptr_t process_handle);
+    bool is_closed() const { return !m_buffering; }
+
+private:
+    static luaL_PopenStream* check(lua_State* state);
+    static int read(lua_State* state);
+    static int lines(lua_State* state);
+    static int seek(lua_State* state);
+    static int setvbuf(lua_State* state);
+    static int flush(lua_State* state);
+    static int write(lua_State* state);
+    static int setwaiter(lua_State* state);
+    static int wait(lua_State* state);
+    static int close(lua_State* state);
+    static int __gc(lua_State* state);
+    static int __tostring(lua_State* state);
+    static int read_line(lua_State* state);
+    static int read_continue(lua_State* state);
+    static int read_formats(lua_State* state, int first, int last);
+    bool read_format(lua_State* state, int index);
+    void wait_for_output(lua_State* state, int first, int last);
+    void release();
+
+    std::shared_ptr<popen_buffering> m_buffering;
+    intptr_t m_process_handle = 0;
+};
+
+//------------------------------------------------------------------------------
+luaL_PopenStream* luaL_PopenStream::make_new(lua_State* state)
+{
+    luaL_PopenStream* ps = (luaL_PopenStream*)lua_newuserdata(state, sizeof(luaL_PopenStream));
+    new (ps) luaL_PopenStream();
+
+    static const luaL_Reg pslib[] =
+    {
+        {"close", close},
+        {"flush", flush},
+        {"lines", lines},
+        {"read", read},
+        {"seek", seek},
+        {"setvbuf", setvbuf},
+        {"write", write},
+        {"_setwaiter", setwaiter},
+        {"_wait", wait},
+        {"__gc", __gc},
+        {"__tostring", __tostring},
+        {nullptr, nullptr}
+    };
+
+    if (luaL_newmetatable(state, LUA_POPENSTREAM))
+    {
+        lua_pushvalue(state, -1);           // push metatable
+        lua_setfield(state, -2, "__index"); // metatable.__index = metatable
+        luaL_setfuncs(state, pslib, 0);     // add methods to new metatable
+    }
+    lua_setmetatable(state, -2);
+
+    return ps;
+}
+
+//------------------------------------------------------------------------------
+luaL_PopenStream* luaL_PopenStream::test(lua_State* state, int index)
+{
+    return (luaL_PopenStream*)luaL_testudata(state, index, LUA_POPENSTREAM);
+}
+
+//------------------------------------------------------------------------------
+void luaL_PopenStream::init(std::shared_ptr<popen_buffering>& buffering, intptr_t process_handle)
+{
+    m_buffering = buffering;
+    m_process_handle = process_handle;
+}
+
+//------------------------------------------------------------------------------
+luaL_PopenStream* luaL_PopenStream::check(lua_State* state)
+{
+    luaL_PopenStream* ps = (luaL_PopenStream*)luaL_checkudata(state, 1, LUA_POPENSTREAM);
+    if (ps->is_closed())
+        luaL_error(state, "attempt to use a closed file");
+    return ps;
+}
+
+//------------------------------------------------------------------------------
+int luaL_PopenStream::read(lua_State* state)
+{
+    check(state);
+    if (lua_gettop(state) < 2)
+        lua_pushliteral(state, "l");
+    return read_formats(state, 2, lua_gettop(state));
+}
+
+//------------------------------------------------------------------------------
+int luaL_PopenStream::lines(lua_State* state)
+{
+    // Like file:lines(), the iterator doesn't close the file.
+    check(state);
+    int n = lua_gettop(state) - 1;
+    luaL_argcheck(state, n <= LUA_MINSTACK - 3, LUA_MINSTACK - 3, "too many arguments");
+    lua_pushinteger(state, n);
+    lua_insert(state, 2);
+    lua_pushcclosure(state, read_line, 2 + n);
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+int luaL_PopenStream::read_line(lua_State* state)
+{
+    // Upvalues are the stream, the number of formats, and the formats.
+    int n = int(lua_tointeger(state, lua_upvalueindex(2)));
+    lua_settop(state, 0);
+    lua_pushvalue(state, lua_upvalueindex(1));
+    luaL_checkstack(state, n + 1, "too many arguments");
+    for (int i = 1; i <= n; ++i)
+        lua_pushvalue(state, lua_upvalueindex(2 + i));
+    if (!n)
+        lua_pushliteral(state, "l");
+
+    check(state);
+    return read_formats(state, 2, lua_gettop(state));
+}
+
+//------------------------------------------------------------------------------
+// The formats are at [first, last] and the results are pushed after them, so
+// the number of results so far says which format to read next.  That lets
+// read_continue pick up where the loop left off after yielding.
+int luaL_PopenStream::read_formats(lua_State* state, int first, int last)
+{
+    for (int i = first + lua_gettop(state) - last; i <= last;)
+    {
+        luaL_PopenStream* ps = check(state);
+        if (!ps->read_format(state, i))
+        {
+            ps->wait_for_output(state, first, last);
+            continue;
+        }
+
+        // Like files, stop at the first format that fails.
+        if (lua_isnil(state, -1))
+            break;
+        ++i;
+    }
+
+    return lua_gettop(state) - last;
+}
+
+//------------------------------------------------------------------------------
+int luaL_PopenStream::read_continue(lua_State* state)
+{
+    int ctx = 0;
+    lua_getctx(state, &ctx);
+    return read_formats(state, ctx >> 16, ctx & 0xffff);
+}
+
+//------------------------------------------------------------------------------
+// The format is "l", "L", "a", or a byte count.
+bool luaL_PopenStream::read_format(lua_State* state, int index)
+{
+    if (lua_type(state, index) == LUA_TNUMBER)
+    {
+        lua_Integer count = lua_tointeger(state, index);
+        luaL_argcheck(state, count >= 0, index, "invalid count");
+        return m_buffering->read(state, nullptr, count);
+    }
+
+    const char* format = luaL_checkstring(state, index);
+    if (*format == '*')
+        format++;
+    if (*format != 'l' && *format != 'L' && *format != 'a')
+        luaL_argerror(state, index, "invalid format");
+
+    return m_buffering->read(state, format, 0);
+}
+
+//------------------------------------------------------------------------------
+void luaL_PopenStream::wait_for_output(lua_State* state, int first, int last)
+{
+    // The waiter yields the coroutine until more output arrives.  If the
+    // coroutine yields, Lua resumes in read_continue instead of returning
+    // here.  Without a waiter, block until the command finishes.
+    lua_getuservalue(state, 1);
+    if (lua_istable(state, -1))
+        lua_getfield(state, -1, "waiter");
+    else
+        lua_pushnil(state);
+    lua_remove(state, -2);
+
+    if (lua_isfunction(state, -1))
+    {
+        lua_callk(state, 0, 0, (first << 16) | last, read_continue);
+    }
+    else
+    {
+        lua_pop(state, 1);
+        m_buffering->wait();
+    }
+}
+
+//------------------------------------------------------------------------------
+// Pipes can't seek.
+int luaL_PopenStream::seek(lua_State* state)
+{
+    static const char* const modenames[] = { "set", "cur", "end", nullptr };
+    check(state);
+    luaL_checkoption(state, 2, "cur", modenames);
+    luaL_optnumber(state, 3, 0);
+    errno = ESPIPE;
+    return luaL_fileresult(state, 0, nullptr);
+}
+
+//------------------------------------------------------------------------------
+// The output is already buffered in memory, so this has no effect.
+int luaL_PopenStream::setvbuf(lua_State* state)
+{
+    static const char* const modenames[] = { "no", "full", "line", nullptr };
+    check(state);
+    luaL_checkoption(state, 2, nullptr, modenames);
+    luaL_optinteger(state, 3, LUAL_BUFFERSIZE);
+    return luaL_fileresult(state, 1, nullptr);
+}
+
+//------------------------------------------------------------------------------
+int luaL_PopenStream::flush(lua_State* state)
+{
+    check(state);
+    return luaL_fileresult(state, 1, nullptr);
+}
+
+//------------------------------------------------------------------------------
+// The stream is read-only, like io.popen(command, "r").
+int luaL_PopenStream::write(lua_State* state)
+{
+    check(state);
+    errno = EBADF;
+    return luaL_fileresult(state, 0, nullptr);
+}
+
+//------------------------------------------------------------------------------
+// Sets the function that yields while waiting for more output; see
+// io.popenyield in coroutines.lua.
+int luaL_PopenStream::setwaiter(lua_State* state)
+{
+    check(state);
+    if (!lua_isnoneornil(state, 2))
+        luaL_checktype(state, 2, LUA_TFUNCTION);
+
+    lua_getuservalue(state, 1);
+    if (!lua_istable(state, -1))
+    {
+        lua_pop(state, 1);
+        lua_createtable(state, 0, 1);
+        lua_pushvalue(state, -1);
+        lua_setuservalue(state, 1);
+    }
+    lua_pushvalue(state, 2);
+    lua_setfield(state, -2, "waiter");
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+// Blocks until the command finishes; for reading outside of a coroutine.
+int luaL_PopenStream::wait(lua_State* state)
+{
+    luaL_PopenStream* ps = check(state);
+    ps->m_buffering->wait();
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+int luaL_PopenStream::close(lua_State* state)
+{
+    luaL_PopenStream* ps = check(state);
+    ps->release();
+    return luaL_execresult(state, 0);
+}
+
+//------------------------------------------------------------------------------
+int luaL_PopenStream::__gc(lua_State* state)
+{
+    luaL_PopenStream* ps = (luaL_PopenStream*)luaL_checkudata(state, 1, LUA_POPENSTREAM);
+    ps->release();
+    ps->~luaL_PopenStream();
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+int luaL_PopenStream::__tostring(lua_State* state)
+{
+    luaL_PopenStream* ps = (luaL_PopenStream*)luaL_checkudata(state, 1, LUA_POPENSTREAM);
+    if (ps->is_closed())
+        lua_pushliteral(state, "file (closed)");
+    else
+        lua_pushfstring(state, "file (%p)", ps);
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+void luaL_PopenStream::release()
+{
+    // Like pclosefile for async commands, this doesn't wait for the process
+    // to exit.
+    if (m_buffering)
+    {
+        m_buffering->cancel();
+        m_buffering = nullptr;
+    }
+    if (m_process_handle)
+    {
+        CloseHandle(reinterpret_cast<HANDLE>(m_process_handle));
+        m_process_handle = 0;
+    }
+}
+
+
+
+//------------------------------------------------------------------------------
+static bool create_overlapped_pipe(HANDLE& local, HANDLE& remote)
+{
+    // Anonymous pipes don't support overlapped IO, so use a uniquely named
+    // pipe.  The local end is read with overlapped IO, and the remote end is
+    // inherited by the child process as its stdout.
+    static volatile long s_serial = 0;
+    wstr<64> name;
+    name.format(L"\\\\.\\pipe\\clink_popen_%u_%u", GetCurrentProcessId(), InterlockedIncrement(&s_serial));
+
+    local = CreateNamedPipeW(name.c_str(),
+                             PIPE_ACCESS_INBOUND|FILE_FLAG_OVERLAPPED|FILE_FLAG_FIRST_PIPE_INSTANCE,
+                             PIPE_TYPE_BYTE|PIPE_READMODE_BYTE|PIPE_WAIT,
+                             1, 0, 4096, 0, nullptr);
+    if (local == INVALID_HANDLE_VALUE)
+    {
+        local = 0;
+        os::map_errno();
+        return false;
+    }
+
+    SECURITY_ATTRIBUTES sa = { sizeof(sa), nullptr, true/*bInheritHandle*/ };
+    remote = CreateFileW(name.c_str(), GENERIC_WRITE, 0, &sa, OPEN_EXISTING, 0, nullptr);
+    if (remote == INVALID_HANDLE_VALUE)
+    {
+        remote = 0;
+        os::map_errno();
+        CloseHandle(local);
+        local = 0;
+        return false;
+    }
+
+    return true;
+}
+
+
+
 //------------------------------------------------------------------------------
 /// -name:  io.popenrw
 /// -arg:   command:string
@@ -730,64 +1311,40 @@ int luaL_YieldGuard::__tostring(lua_State* state)
         return luaL_error(state, "invalid mode " LUA_QS
                           " (should match " LUA_QL("r?[bt]?") " or nil)", mode);
 
-    luaL_Stream* pr = nullptr;
-    luaL_YieldGuard* yg = nullptr;
-    pipe_pair pipe_stdout;
-
-    pr = (luaL_Stream*)lua_newuserdata(state, sizeof(luaL_Stream));
-    luaL_setmetatable(state, LUA_FILEHANDLE);
-    pr->f = nullptr;
-    pr->closef = nullptr;
-
-    yg = luaL_YieldGuard::make_new(state);
+    luaL_PopenStream* ps = luaL_PopenStream::make_new(state);
+    luaL_YieldGuard* yg = luaL_YieldGuard::make_new(state);
 
     bool failed = true;
-    FILE* temp_read = nullptr;
-    HANDLE temp_write = nullptr;
+    HANDLE local = 0;
+    HANDLE remote = 0;
     std::shared_ptr<popen_buffering> buffering;
-    popenrw_info* info = nullptr;
 
     do
     {
-        os::temp_file_mode tfmode = os::temp_file_mode::delete_on_close;
-        if (binary)
-            tfmode |= os::temp_file_mode::binary;
-        str<> name;
-        temp_read = os::create_temp_file(&name, "clk", ".tmp", tfmode);
-        if (!temp_read)
-            break;
-
-        temp_write = dup_handle(GetCurrentProcess(), reinterpret_cast<HANDLE>(_get_osfhandle(fileno(temp_read))));
-        if (!temp_write)
-            break;
-
-        // The pipe and temp_write are both binary to simplify the thread's job.
-        if (!pipe_stdout.init(false/*write*/, true/*binary*/))
+        // The output is collected in memory as it arrives, instead of in a
+        // temporary file, so it can be read before the command finishes.
+        if (!create_overlapped_pipe(local, remote))
             break;
 
-        buffering = std::make_shared<popen_buffering>(pipe_stdout.local, temp_write);
-        pipe_stdout.transfer_local();
-        temp_write = nullptr;
-        if (!buffering->createthread())
+        buffering = std::make_shared<popen_buffering>(local, binary);
+        local = 0;
+        if (!buffering->init())
             break;
 
-        info = new popenrw_info;
-        intptr_t process_handle = popenrw_internal(command, NULL, pipe_stdout.remote);
+        intptr_t process_handle = popenrw_internal(command, NULL, remote);
         if (!process_handle)
             break;
 
-        pr->f = temp_read;
-        pr->closef = &pclosefile;
-        temp_read = nullptr;
-
-        info->r = pr->f;
-        info->process_handle = process_handle;
-        info->async = true;
-        popenrw_info::add(info);
-        info = nullptr;
+        // The child has its own copy; closing ours lets the pipe break when
+        // the child exits.
+        CloseHandle(remote);
+        remote = 0;
 
+        ps->init(buffering, process_handle);
         yg->init(buffering, command);
-        buffering->go();
+
+        if (!popen_pump::add(buffering))
+            break;
 
         failed = false;
     }
@@ -797,11 +1354,10 @@ int luaL_YieldGuard::__tostring(lua_State* state)
     {
         errno_t e = errno;
 
-        if (temp_read)
-            fclose(temp_read);
-        if (temp_write)
-            CloseHandle(temp_write);
-        delete info;
+        if (local)
+            CloseHandle(local);
+        if (remote)
+            CloseHandle(remote);
         buffering = nullptr;
 
         if (failed)
@@ -813,6 +1369,28 @@ int luaL_YieldGuard::__tostring(lua_State* state)
     return (failed) ? luaL_fileresult(state, 0, command) : 2;
 }
 
+//------------------------------------------------------------------------------
+// Replaces io.type so it also recognizes the file handles returned by
+// io.popenyield.  The original io.type is the first upvalue.
+static int io_type(lua_State* state)
+{
+    luaL_checkany(state, 1);
+    if (luaL_PopenStream* ps = luaL_PopenStream::test(state, 1))
+    {
+        if (ps->is_closed())
+            lua_pushliteral(state, "closed file");
+        else
+            lua_pushliteral(state, "file");
+        return 1;
+    }
+
+    lua_settop(state, 1);
+    lua_pushvalue(state, lua_upvalueindex(1));
+    lua_insert(state, 1);
+    lua_call(state, 1, 1);
+    return 1;
+}
+
 //------------------------------------------------------------------------------
 void io_lua_initialise(lua_state& lua)
 {
@@ -835,5 +1413,11 @@ void io_lua_initialise(lua_state& lua)
         lua_rawset(state, -3);
     }
 
+    lua_pushliteral(state, "type");
+    lua_pushliteral(state, "type");
+    lua_rawget(state, -3);
+    lua_pushcclosure(state, io_type, 1);
+    lua_rawset(state, -3);
+
     lua_pop(state, 1);
 }
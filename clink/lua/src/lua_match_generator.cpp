@@ -8,6 +8,7 @@
 #include "lua_state.h"
 #include "line_state_lua.h"
 #include "match_builder_lua.h"
+#include "match_view_lua.h"
 
 #include <core/str_hash.h>
 #include <core/str_unordered_set.h>
@@ -158,7 +159,7 @@ static int plainify(const char* s, char** strip)
 }
 
 //------------------------------------------------------------------------------
-bool lua_match_generator::match_display_filter(char** matches, match_display_filter_entry*** filtered_matches, bool popup)
+bool lua_match_generator::match_display_filter(char** matches, const match_extras* extras, match_display_filter_entry*** filtered_matches, bool popup)
 {
     bool ret = false;
     lua_State* state = m_state.get_state();
@@ -236,40 +237,18 @@ done:
     // Sort the matches.
     sort_match_list(matches + 1, match_count);
 
-    // Convert matches to a Lua table.
-    lua_createtable(state, match_count, 0);
+    // Present the matches to Lua.  The ondisplaymatches event receives a view
+    // that only creates tables and strings for the matches a handler touches;
+    // events.lua converts it into a plain table unless the handler opted in.
+    match_view_lua view(matches + 1, match_count, !!rl_completion_matches_include_type, extras);
     if (ondisplaymatches)
     {
-        str<> tmp;
-
-        for (i = 1; i < match_count; ++i)
-        {
-            const char* match = matches[i];
-            match_type type = match_type::none;
-            if (rl_completion_matches_include_type)
-            {
-                type = match_type(*match);
-                match++;
-            }
-
-            lua_createtable(state, 0, 2);
-
-            lua_pushliteral(state, "match");
-            lua_pushstring(state, match);
-            lua_rawset(state, -3);
-
-            lua_pushliteral(state, "type");
-            match_type_to_string(type, tmp);
-            lua_pushlstring(state, tmp.c_str(), tmp.length());
-            lua_rawset(state, -3);
-
-            lua_rawseti(state, -2, i);
-        }
-
+        view.push(state);
         lua_pushboolean(state, popup);
     }
     else
     {
+        lua_createtable(state, match_count, 0);
         for (i = 1; i < match_count; ++i)
         {
             const char* match = matches[i];
@@ -289,8 +268,9 @@ done:
         goto done;
     }
 
-    // Bail out if filter function didn't return a table.
-    if (!lua_istable(state, -1))
+    // Bail out if filter function didn't return a table (or the view).
+    const bool returned_view = view.is_self(state, -1);
+    if (!returned_view && !lua_istable(state, -1))
         goto done;
 
     // Convert table returned by the Lua filter function to C.
@@ -298,17 +278,26 @@ done:
     bool one_column = false;
     int max_visible_display = 0;
     int max_visible_description = 0;
-    int new_len = int(lua_rawlen(state, -1));
+    int new_len = returned_view ? view.get_count() : int(lua_rawlen(state, -1));
     new_matches = (match_display_filter_entry**)calloc(1 + new_len + 1, sizeof(*new_matches));
     for (i = 1; i <= new_len; ++i)
     {
-        lua_rawgeti(state, -1, i);
-        if (!lua_isnil(state, -1))
+        save_stack_top ss(state);
+
+        const char* match = nullptr;
+        const char* display = nullptr;
+        const char* description = nullptr;
+        match_type type = match_type::none;
+
+        if (returned_view)
         {
-            const char* match = nullptr;
-            const char* display = nullptr;
-            const char* description = nullptr;
-            match_type type = match_type::none;
+            view.get_entry(state, i, match, type, display, description);
+        }
+        else
+        {
+            lua_rawgeti(state, -1, i);
+            if (lua_isnil(state, -1))
+                continue;
 
             if (lua_istable(state, -1))
             {
@@ -342,79 +331,77 @@ done:
             {
                 display = lua_tostring(state, -1);
             }
+        }
 
-            do
+        do
+        {
+            if (!display)
+                break;
+
+            if (!lcd_initialized)
+            {
+                lcd = match;
+                lcd_initialized = true;
+            }
+            else
+            {
+                unsigned int matching = match ? str_compare(match, lcd.c_str()) : 0;
+                if (lcd.length() > matching)
+                    lcd.truncate(matching);
+            }
+
+            size_t alloc_size = sizeof(match_display_filter_entry) + 2;
+            if (match) alloc_size += strlen(match);
+            if (display) alloc_size += strlen(display);
+            if (description) alloc_size += strlen(description);
+
+            match_display_filter_entry *new_match;
+            new_match = (match_display_filter_entry *)malloc(alloc_size);
+            memset(new_match, 0, sizeof(*new_match));
+            new_match->type = (unsigned char)type;
+            new_matches[j] = new_match;
+
+            char* buffer = new_match->buffer;
+            j++;
+
+            new_match->match = append_string_into_buffer(buffer, match);
+            if (match && !new_match->match[0])
             {
-                if (!display)
-                    break;
-
-                if (!lcd_initialized)
-                {
-                    lcd = match;
-                    lcd_initialized = true;
-                }
-                else
-                {
-                    unsigned int matching = match ? str_compare(match, lcd.c_str()) : 0;
-                    if (lcd.length() > matching)
-                        lcd.truncate(matching);
-                }
-
-                size_t alloc_size = sizeof(match_display_filter_entry) + 2;
-                if (match) alloc_size += strlen(match);
-                if (display) alloc_size += strlen(display);
-                if (description) alloc_size += strlen(description);
-
-                match_display_filter_entry *new_match;
-                new_match = (match_display_filter_entry *)malloc(alloc_size);
-                memset(new_match, 0, sizeof(*new_match));
-                new_match->type = (unsigned char)type;
-                new_matches[j] = new_match;
-
-                char* buffer = new_match->buffer;
-                j++;
-
-                new_match->match = append_string_into_buffer(buffer, match);
-                if (match && !new_match->match[0])
-                {
 discard:
-                    free(new_match);
-                    j--;
-                    break;
-                }
-
-                if (!display[0])
-                    goto discard;
-                new_match->display = append_string_into_buffer(buffer, display);
-                new_match->visible_display = plainify(new_match->display, popup ? &buffer : nullptr);
-                if (new_match->visible_display <= 0)
-                    goto discard;
-
-                if (description)
-                {
-                    one_column = true;
-                    new_match->description = append_string_into_buffer(buffer, description);
-                    new_match->visible_description = plainify(new_match->description, popup ? &buffer : nullptr);
-                }
-                else
-                {
-                    // Must append empty string even when no description,
-                    // because do_popup_list expects 3 nul terminated strings.
-                    // Leave new_match->description nullptr to signal there is
-                    // no description (subtly different than having an empty
-                    // description).
-                    append_string_into_buffer(buffer, description);
-                }
-
-                if (max_visible_display < new_match->visible_display)
-                    max_visible_display = new_match->visible_display;
-                if (max_visible_description < new_match->visible_description)
-                    max_visible_description = new_match->visible_description;
+                free(new_match);
+                j--;
+                break;
+            }
+
+            if (!display[0])
+                goto discard;
+            new_match->display = append_string_into_buffer(buffer, display);
+            new_match->visible_display = plainify(new_match->display, popup ? &buffer : nullptr);
+            if (new_match->visible_display <= 0)
+                goto discard;
+
+            if (description)
+            {
+                one_column = true;
+                new_match->description = append_string_into_buffer(buffer, description);
+                new_match->visible_description = plainify(new_match->description, popup ? &buffer : nullptr);
+            }
+            else
+            {
+                // Must append empty string even when no description,
+                // because do_popup_list expects 3 nul terminated strings.
+                // Leave new_match->description nullptr to signal there is
+                // no description (subtly different than having an empty
+                // description).
+                append_string_into_buffer(buffer, description);
             }
-            while (false);
-        }
 
-        lua_pop(state, 1);
+            if (max_visible_display < new_match->visible_display)
+                max_visible_display = new_match->visible_display;
+            if (max_visible_description < new_match->visible_description)
+                max_visible_description = new_match->visible_description;
+        }
+        while (false);
     }
     new_matches[j] = nullptr;
 
@@ -487,7 +474,7 @@ discard:
 }
 
 //------------------------------------------------------------------------------
-void lua_match_generator::filter_matches(char** matches, char completion_type, bool filename_completion_desired)
+void lua_match_generator::filter_matches(char** matches, const match_extras* extras, char completion_type, bool filename_completion_desired)
 {
     lua_State* state = m_state.get_state();
     save_stack_top ss(state);
@@ -524,32 +511,9 @@ void lua_match_generator::filter_matches(char** matches, char completion_type, b
     if (lua_isnil(state, -1))
         return;
 
-    // Convert matches to a Lua table (arg 1).
-    str<> tmp;
-    lua_createtable(state, match_count, 0);
-    for (int i = 1; i <= match_count; ++i)
-    {
-        const char* match = matches[i];
-        match_type type = match_type::none;
-        if (rl_completion_matches_include_type)
-        {
-            type = match_type(*match);
-            match++;
-        }
-
-        lua_createtable(state, 0, 2);
-
-        lua_pushliteral(state, "match");
-        lua_pushstring(state, match);
-        lua_rawset(state, -3);
-
-        lua_pushliteral(state, "type");
-        match_type_to_string(type, tmp);
-        lua_pushlstring(state, tmp.c_str(), tmp.length());
-        lua_rawset(state, -3);
-
-        lua_rawseti(state, -2, i);
-    }
+    // Present the matches to Lua (arg 1).
+    match_view_lua view(matches + 1, match_count, !!rl_completion_matches_include_type, extras);
+    view.push(state);
 
     // Push completion type (arg 2).
     char completion_type_str[2] = { completion_type };
@@ -566,8 +530,8 @@ void lua_match_generator::filter_matches(char** matches, char completion_type, b
         return;
     }
 
-    // If nil is returned then no filtering occurred.
-    if (lua_isnil(state, -1))
+    // If nil or the matches view is returned then no filtering occurred.
+    if (lua_isnil(state, -1) || view.is_self(state, -1))
         return;
 
     // Hash the filtered matches to be kept.
@@ -13,6 +13,7 @@
 static match_builder_lua::method g_methods[] = {
     { "addmatch",           &match_builder_lua::add_match },
     { "addmatches",         &match_builder_lua::add_matches },
+    { "addmatchesfromstring", &match_builder_lua::add_matches_from_string },
     { "setappendcharacter", &match_builder_lua::set_append_character },
     { "setsuppressappend",  &match_builder_lua::set_suppress_append },
     { "setsuppressquoting", &match_builder_lua::set_suppress_quoting },
@@ -170,7 +171,7 @@ int match_builder_lua::set_matches_are_files(lua_State* state)
 
 //------------------------------------------------------------------------------
 /// -name:  builder:addmatches
-/// -arg:   matches:table
+/// -arg:   matches:table|function
 /// -arg:   [type:string]
 /// -ret:   integer, boolean
 /// -show:  builder:addmatches({"abc", "def"}) -- Adds two matches of type "none"
@@ -180,17 +181,22 @@ int match_builder_lua::set_matches_are_files(lua_State* state)
 /// -show:  &nbsp;&nbsp;{ match="remote/origin/master", type="word" },
 /// -show:  &nbsp;&nbsp;{ match="remote/origin/topic", type="word" }
 /// -show:  })
+/// -show:  builder:addmatches(io.lines("words.txt"), "word") -- Adds a match per line
 /// This is the equivalent of calling <a href="#builder:addmatch">builder:addmatch()</a>
 /// in a for-loop. Returns the number of matches added and a boolean indicating
 /// if all matches were added successfully.
 ///
 /// <span class="arg">matches</span> can be a table of match strings, or a table
-/// of tables describing the matches.<br/>
+/// of tables describing the matches.  Or it can be an iterator function (such
+/// as returned by <code>io.lines()</code> or <code>string.gmatch()</code>)
+/// which is called repeatedly until it returns nil; each value it returns is
+/// added the same as a table element.<br/>
 /// <span class="arg">type</span> is used as the type when a match doesn't
 /// explicitly include a type, and is "none" if omitted.
 int match_builder_lua::add_matches(lua_State* state)
 {
-    if (lua_gettop(state) <= 0 || !lua_istable(state, 1))
+    const bool is_func = (lua_gettop(state) > 0 && lua_isfunction(state, 1));
+    if (!is_func && (lua_gettop(state) <= 0 || !lua_istable(state, 1)))
     {
         lua_pushinteger(state, 0);
         lua_pushboolean(state, 0);
@@ -202,21 +208,102 @@ int match_builder_lua::add_matches(lua_State* state)
         return 0;
 
     match_type type = to_match_type(type_str);
+    match_batch batch(m_builder, type);
 
     int count = 0;
-    int total = int(lua_rawlen(state, 1));
-    for (int i = 1; i <= total; ++i)
+    int total = 0;
+    if (is_func)
     {
-        lua_rawgeti(state, 1, i);
-        count += !!add_match_impl(state, -1, type);
-        lua_pop(state, 1);
+        while (true)
+        {
+            lua_pushvalue(state, 1);
+            lua_call(state, 0, 1);
+            if (lua_isnil(state, -1))
+            {
+                lua_pop(state, 1);
+                break;
+            }
+
+            ++total;
+            count += !!add_match_impl(state, -1, type, batch);
+            lua_pop(state, 1);
+        }
+    }
+    else
+    {
+        total = int(lua_rawlen(state, 1));
+        for (int i = 1; i <= total; ++i)
+        {
+            lua_rawgeti(state, 1, i);
+            count += !!add_match_impl(state, -1, type, batch);
+            lua_pop(state, 1);
+        }
+    }
+
+    lua_pushinteger(state, count);
+    lua_pushboolean(state, count == total);
+    return 2;
+}
+
+//------------------------------------------------------------------------------
+/// -name:  builder:addmatchesfromstring
+/// -arg:   text:string
+/// -arg:   [separators:string]
+/// -arg:   [type:string]
+/// -ret:   integer, boolean
+/// -show:  local f = io.popen("git for-each-ref --format=%(refname:short) refs/heads 2>nul")
+/// -show:  if f then
+/// -show:  &nbsp;   builder:addmatchesfromstring(f:read("*a"), "\r\n", "word")
+/// -show:  &nbsp;   f:close()
+/// -show:  end
+/// Splits <span class="arg">text</span> at any of the characters in
+/// <span class="arg">separators</span> and adds each non-empty piece as a
+/// match.  This is much faster than splitting the text in Lua and then adding
+/// the pieces, especially for the output from a command.  Returns the number
+/// of matches added and a boolean indicating if all matches were added
+/// successfully.
+///
+/// <span class="arg">separators</span> may only contain ASCII characters, and
+/// is <code>"\r\n"</code> if omitted, which adds a match for each line.<br/>
+/// <span class="arg">type</span> is the type for all of the matches, and is
+/// "none" if omitted.
+int match_builder_lua::add_matches_from_string(lua_State* state)
+{
+    size_t len;
+    const char* text = (lua_gettop(state) > 0 && lua_isstring(state, 1)) ? lua_tolstring(state, 1, &len) : nullptr;
+    const char* separators = optstring(state, 2, "\r\n");
+    const char* type_str = optstring(state, 3, "");
+    if (!text || !separators || !type_str)
+    {
+        lua_pushinteger(state, 0);
+        lua_pushboolean(state, 0);
+        return 2;
     }
 
+    match_batch batch(m_builder, to_match_type(type_str));
+
+    unsigned int total;
+    unsigned int count = batch.add_from_string(text, unsigned(len), separators, &total);
+
     lua_pushinteger(state, count);
     lua_pushboolean(state, count == total);
     return 2;
 }
 
+//------------------------------------------------------------------------------
+bool match_builder_lua::add_match_impl(lua_State* state, int stack_index, match_type type, match_batch& batch)
+{
+    // Strings use the batch's type, which was resolved once up front.
+    if (lua_type(state, stack_index) == LUA_TSTRING)
+    {
+        size_t len;
+        const char* match = lua_tolstring(state, stack_index, &len);
+        return batch.add(match, unsigned(len));
+    }
+
+    return add_match_impl(state, stack_index, type);
+}
+
 //------------------------------------------------------------------------------
 bool match_builder_lua::add_match_impl(lua_State* state, int stack_index, match_type type)
 {
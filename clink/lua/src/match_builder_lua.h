@@ -6,6 +6,7 @@
 #include "lua_bindable.h"
 
 class match_builder;
+class match_batch;
 struct lua_State;
 enum class match_type : unsigned char;
 
@@ -18,6 +19,7 @@ public:
                     ~match_builder_lua();
     int             add_match(lua_State* state);
     int             add_matches(lua_State* state);
+    int             add_matches_from_string(lua_State* state);
     int             set_append_character(lua_State* state);
     int             set_suppress_append(lua_State* state);
     int             set_suppress_quoting(lua_State* state);
@@ -26,5 +28,6 @@ public:
 
 private:
     bool            add_match_impl(lua_State* state, int stack_index, match_type type);
+    bool            add_match_impl(lua_State* state, int stack_index, match_type type, match_batch& batch);
     match_builder&  m_builder;
 };
@@ -0,0 +1,454 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "match_view_lua.h"
+
+#include <core/base.h>
+#include <lib/matches.h>
+
+//------------------------------------------------------------------------------
+static const char* const c_metatable_name = "match_view_lua_mt";
+
+
+//------------------------------------------------------------------------------
+match_view_lua::match_view_lua(char** matches, int count, bool include_type, const match_extras* extras)
+: m_matches(matches)
+, m_count(count)
+, m_extras(extras)
+, m_include_type(include_type)
+{
+}
+
+//------------------------------------------------------------------------------
+match_view_lua::~match_view_lua()
+{
+    if (m_state == nullptr || m_registry_ref == LUA_NOREF)
+        return;
+
+    // Detach the userdata, in case a script kept a reference to it.
+    lua_rawgeti(m_state, LUA_REGISTRYINDEX, m_registry_ref);
+    if (auto* self = (match_view_lua**)lua_touserdata(m_state, -1))
+        *self = nullptr;
+    lua_pop(m_state, 1);
+
+    luaL_unref(m_state, LUA_REGISTRYINDEX, m_registry_ref);
+    m_registry_ref = LUA_NOREF;
+    m_state = nullptr;
+}
+
+//------------------------------------------------------------------------------
+void match_view_lua::push(lua_State* state)
+{
+    if (m_registry_ref != LUA_NOREF)
+    {
+        lua_rawgeti(state, LUA_REGISTRYINDEX, m_registry_ref);
+        return;
+    }
+
+    m_state = state;
+
+    auto* self = (match_view_lua**)lua_newuserdata(state, sizeof(match_view_lua*));
+    *self = this;
+
+    if (luaL_newmetatable(state, c_metatable_name))
+    {
+        static const luaL_Reg methods[] = {
+            { "getmatch",       &get_match },
+            { "gettype",        &get_type },
+            { "setdisplays",    &set_displays },
+            { "totable",        &to_table },
+            {}
+        };
+
+        lua_pushliteral(state, "__index");
+        lua_createtable(state, 0, sizeof_array(methods) - 1);
+        luaL_setfuncs(state, methods, 0);
+        lua_pushcclosure(state, &index, 1);
+        lua_rawset(state, -3);
+
+        lua_pushliteral(state, "__newindex");
+        lua_pushcfunction(state, &new_index);
+        lua_rawset(state, -3);
+
+        lua_pushliteral(state, "__len");
+        lua_pushcfunction(state, &length);
+        lua_rawset(state, -3);
+
+        lua_pushliteral(state, "__ipairs");
+        lua_pushcfunction(state, &ipairs);
+        lua_rawset(state, -3);
+
+        lua_pushliteral(state, "__pairs");
+        lua_pushcfunction(state, &pairs);
+        lua_rawset(state, -3);
+
+        lua_pushliteral(state, "__tostring");
+        lua_pushcfunction(state, &tostring);
+        lua_rawset(state, -3);
+    }
+    lua_setmetatable(state, -2);
+
+    lua_pushvalue(state, -1);
+    m_registry_ref = luaL_ref(state, LUA_REGISTRYINDEX);
+}
+
+//------------------------------------------------------------------------------
+bool match_view_lua::is_self(lua_State* state, int index) const
+{
+    return check_self(state, index) == this;
+}
+
+//------------------------------------------------------------------------------
+// Gets the fields for the entry at index (1 based).  Any strings that come from
+// Lua are left on the stack so they stay valid; the caller is responsible for
+// restoring the stack top.
+void match_view_lua::get_entry(lua_State* state, int index, const char*& match, match_type& type, const char*& display, const char*& description)
+{
+    match = nullptr;
+    type = match_type::none;
+    display = nullptr;
+    description = nullptr;
+
+    push(state);
+    const int self_index = lua_gettop(state);
+
+    if (get_cached_entry(state, self_index, index))
+    {
+        // A script touched the entry, so use its table since the script may
+        // have modified it.
+        lua_getfield(state, -1, "match");
+        if (lua_isstring(state, -1))
+            match = lua_tostring(state, -1);
+
+        lua_getfield(state, -2, "type");
+        if (lua_isstring(state, -1))
+            type = to_match_type(lua_tostring(state, -1));
+
+        lua_getfield(state, -3, "display");
+        display = lua_isstring(state, -1) ? lua_tostring(state, -1) : match;
+
+        lua_getfield(state, -4, "description");
+        if (lua_isstring(state, -1))
+            description = lua_tostring(state, -1);
+        return;
+    }
+
+    match = get_raw(index, type);
+    display = match;
+    if (size_t(index) < m_displays.size() && !m_displays[index].empty())
+        display = m_displays[index].c_str();
+    if (size_t(index) < m_descriptions.size() && !m_descriptions[index].empty())
+        description = m_descriptions[index].c_str();
+}
+
+//------------------------------------------------------------------------------
+match_view_lua* match_view_lua::check_self(lua_State* state, int index)
+{
+    auto* self = (match_view_lua**)luaL_testudata(state, index, c_metatable_name);
+    return self ? *self : nullptr;
+}
+
+//------------------------------------------------------------------------------
+const char* match_view_lua::get_raw(int index, match_type& type) const
+{
+    const char* match = m_matches[index - 1];
+    if (m_include_type)
+    {
+        type = match_type(*match);
+        match++;
+    }
+    else
+    {
+        type = match_type::none;
+    }
+    return match;
+}
+
+//------------------------------------------------------------------------------
+// Pushes the cached entry table and returns true, or pushes nothing and returns
+// false if the entry hasn't been created yet.
+bool match_view_lua::get_cached_entry(lua_State* state, int self_index, int index)
+{
+    lua_getuservalue(state, self_index);
+    if (lua_istable(state, -1))
+    {
+        lua_rawgeti(state, -1, index);
+        if (lua_istable(state, -1))
+        {
+            lua_remove(state, -2);
+            return true;
+        }
+        lua_pop(state, 1);
+    }
+    lua_pop(state, 1);
+    return false;
+}
+
+//------------------------------------------------------------------------------
+void match_view_lua::push_entry(lua_State* state, int self_index, int index)
+{
+    if (get_cached_entry(state, self_index, index))
+        return;
+
+    match_view_lua* self = check_self(state, self_index);
+
+    match_type type;
+    const char* match = self->get_raw(index, type);
+
+    lua_createtable(state, 0, 6);
+
+    lua_pushliteral(state, "match");
+    lua_pushstring(state, match);
+    lua_rawset(state, -3);
+
+    str<> tmp;
+    match_type_to_string(type, tmp);
+    lua_pushliteral(state, "type");
+    lua_pushlstring(state, tmp.c_str(), tmp.length());
+    lua_rawset(state, -3);
+
+    if (size_t(index) < self->m_displays.size() && !self->m_displays[index].empty())
+    {
+        lua_pushliteral(state, "display");
+        lua_pushstring(state, self->m_displays[index].c_str());
+        lua_rawset(state, -3);
+    }
+
+    if (size_t(index) < self->m_descriptions.size() && !self->m_descriptions[index].empty())
+    {
+        lua_pushliteral(state, "description");
+        lua_pushstring(state, self->m_descriptions[index].c_str());
+        lua_rawset(state, -3);
+    }
+
+    // File matches carry the metadata from when the files were enumerated.
+    const match_file_info* info = nullptr;
+    if (self->m_extras && self->m_include_type)
+        info = self->m_extras->get_file_info(self->m_matches[index - 1]);
+    if (info)
+    {
+        lua_pushliteral(state, "size");
+        lua_pushnumber(state, lua_Number(info->size));
+        lua_rawset(state, -3);
+
+        // Convert from FILETIME to seconds since 1970, the same as os.time().
+        const unsigned long long c_epoch = 116444736000000000ull;
+        lua_pushliteral(state, "mtime");
+        lua_pushnumber(state, lua_Number(info->write_time > c_epoch ? (info->write_time - c_epoch) / 10000000 : 0));
+        lua_rawset(state, -3);
+    }
+
+    // Cache the entry so that changes made by the script are kept.
+    push_cache(state, self_index, self->m_count);
+    lua_pushvalue(state, -2);
+    lua_rawseti(state, -2, index);
+    lua_pop(state, 1);
+}
+
+//------------------------------------------------------------------------------
+// Pushes the table of cached entries, creating it if necessary.
+void match_view_lua::push_cache(lua_State* state, int self_index, int narr)
+{
+    lua_getuservalue(state, self_index);
+    if (!lua_istable(state, -1))
+    {
+        lua_pop(state, 1);
+        lua_createtable(state, narr, 0);
+        lua_pushvalue(state, -1);
+        lua_setuservalue(state, self_index);
+    }
+}
+
+//------------------------------------------------------------------------------
+void match_view_lua::set_override(lua_State* state, int self_index, int index, bool description, const char* value)
+{
+    if (get_cached_entry(state, self_index, index))
+    {
+        lua_pushstring(state, value);
+        lua_setfield(state, -2, description ? "description" : "display");
+        lua_pop(state, 1);
+        return;
+    }
+
+    auto& overrides = description ? m_descriptions : m_displays;
+    if (overrides.size() <= size_t(index))
+        overrides.resize(m_count + 1);
+    overrides[index] = value;
+}
+
+//------------------------------------------------------------------------------
+int match_view_lua::index(lua_State* state)
+{
+    match_view_lua* self = check_self(state, 1);
+
+    if (lua_type(state, 2) == LUA_TNUMBER)
+    {
+        int i = int(lua_tointeger(state, 2));
+        if (!self || i < 1 || i > self->m_count)
+            return 0;
+        push_entry(state, 1, i);
+        return 1;
+    }
+
+    lua_pushvalue(state, 2);
+    lua_rawget(state, lua_upvalueindex(1));
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+int match_view_lua::new_index(lua_State* state)
+{
+    return luaL_error(state, "matches are read-only; use matches:totable() to get a table that can be modified");
+}
+
+//------------------------------------------------------------------------------
+int match_view_lua::length(lua_State* state)
+{
+    match_view_lua* self = check_self(state, 1);
+    lua_pushinteger(state, self ? self->m_count : 0);
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+int match_view_lua::ipairs(lua_State* state)
+{
+    lua_pushcfunction(state, &ipairs_aux);
+    lua_pushvalue(state, 1);
+    lua_pushinteger(state, 0);
+    return 3;
+}
+
+//------------------------------------------------------------------------------
+int match_view_lua::ipairs_aux(lua_State* state)
+{
+    match_view_lua* self = check_self(state, 1);
+    int i = int(luaL_checkinteger(state, 2)) + 1;
+    if (!self)
+        return 0;
+
+    if (i > self->m_count)
+        return 0;
+
+    lua_pushinteger(state, i);
+    push_entry(state, 1, i);
+    return 2;
+}
+
+//------------------------------------------------------------------------------
+int match_view_lua::pairs(lua_State* state)
+{
+    return ipairs(state);
+}
+
+//------------------------------------------------------------------------------
+int match_view_lua::tostring(lua_State* state)
+{
+    match_view_lua* self = check_self(state, 1);
+    lua_pushfstring(state, "matches (%d)", self ? self->m_count : 0);
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+/// -name:  matches:getmatch
+/// -arg:   index:integer
+/// -ret:   string
+/// Returns the match string for the match at <span class="arg">index</span>,
+/// without creating a table for the match.
+int match_view_lua::get_match(lua_State* state)
+{
+    match_view_lua* self = check_self(state, 1);
+    int i = int(luaL_checkinteger(state, 2));
+    if (!self || i < 1 || i > self->m_count)
+        return 0;
+
+    match_type type;
+    lua_pushstring(state, self->get_raw(i, type));
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+/// -name:  matches:gettype
+/// -arg:   index:integer
+/// -ret:   string
+/// Returns the match type for the match at <span class="arg">index</span>,
+/// without creating a table for the match.
+int match_view_lua::get_type(lua_State* state)
+{
+    match_view_lua* self = check_self(state, 1);
+    int i = int(luaL_checkinteger(state, 2));
+    if (!self || i < 1 || i > self->m_count)
+        return 0;
+
+    match_type type;
+    self->get_raw(i, type);
+
+    str<> tmp;
+    match_type_to_string(type, tmp);
+    lua_pushlstring(state, tmp.c_str(), tmp.length());
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+/// -name:  matches:setdisplays
+/// -arg:   displays:table
+/// -arg:   [descriptions:table]
+/// -show:  local function my_filter(matches, popup)
+/// -show:  &nbsp; local displays = {}
+/// -show:  &nbsp; for i = 1, #matches do
+/// -show:  &nbsp;   if matches:gettype(i):find("^dir") then
+/// -show:  &nbsp;     displays[i] = "*"..matches:getmatch(i)
+/// -show:  &nbsp;   end
+/// -show:  &nbsp; end
+/// -show:  &nbsp; matches:setdisplays(displays)
+/// -show:  &nbsp; return matches
+/// -show:  end
+/// Sets the <code>display</code> field (and optionally the
+/// <code>description</code> field) for many matches at once.  The tables are
+/// indexed the same as the matches, and entries that are not strings are
+/// ignored.  Returning the matches object from the filter function then keeps
+/// all of the matches, without creating a table for each one.
+int match_view_lua::set_displays(lua_State* state)
+{
+    match_view_lua* self = check_self(state, 1);
+    if (!self)
+        return 0;
+
+    const int count = self->m_count;
+    for (int arg = 2; arg <= 3; ++arg)
+    {
+        if (!lua_istable(state, arg))
+            continue;
+
+        for (int i = 1; i <= count; ++i)
+        {
+            lua_rawgeti(state, arg, i);
+            if (lua_isstring(state, -1))
+                self->set_override(state, 1, i, arg == 3, lua_tostring(state, -1));
+            lua_pop(state, 1);
+        }
+    }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/// -name:  matches:totable
+/// -ret:   table
+/// Returns a plain table containing a table for each match.  This is useful
+/// for scripts that need a real table, for example to use with
+/// <code>next()</code>, or to sort or rearrange a copy of the matches without
+/// changing the matches themselves.
+int match_view_lua::to_table(lua_State* state)
+{
+    match_view_lua* self = check_self(state, 1);
+    const int count = self ? self->m_count : 0;
+
+    lua_createtable(state, count, 0);
+    for (int i = 1; i <= count; ++i)
+    {
+        push_entry(state, 1, i);
+        lua_rawseti(state, -2, i);
+    }
+    return 1;
+}
@@ -0,0 +1,67 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <core/str.h>
+
+extern "C" {
+#include <lua.h>
+#include <lauxlib.h>
+}
+
+#include <vector>
+
+class match_extras;
+enum class match_type : unsigned char;
+
+//------------------------------------------------------------------------------
+// Presents a list of matches to Lua as an array.  Each element is a table with
+// `match` and `type` fields, but the table for an element is only created when
+// a script indexes it, so showing a large list of matches doesn't have to
+// build a table and strings for every match up front.
+//
+// The view is read-only; matches:totable() returns a plain table for scripts
+// that need one.  Only event handlers that opt in receive the view, and other
+// handlers receive the plain table (see events.lua).
+//
+// The view only works while the match_view_lua object exists; afterwards it is
+// empty.
+class match_view_lua
+{
+public:
+                    match_view_lua(char** matches, int count, bool include_type, const match_extras* extras=nullptr);
+                    ~match_view_lua();
+    void            push(lua_State* state);
+    bool            is_self(lua_State* state, int index) const;
+    int             get_count() const { return m_count; }
+    void            get_entry(lua_State* state, int index, const char*& match, match_type& type, const char*& display, const char*& description);
+
+private:
+    static match_view_lua* check_self(lua_State* state, int index);
+    static void     push_entry(lua_State* state, int self_index, int index);
+    static bool     get_cached_entry(lua_State* state, int self_index, int index);
+    static void     push_cache(lua_State* state, int self_index, int narr);
+    static int      index(lua_State* state);
+    static int      new_index(lua_State* state);
+    static int      length(lua_State* state);
+    static int      ipairs(lua_State* state);
+    static int      ipairs_aux(lua_State* state);
+    static int      pairs(lua_State* state);
+    static int      tostring(lua_State* state);
+    static int      get_match(lua_State* state);
+    static int      get_type(lua_State* state);
+    static int      set_displays(lua_State* state);
+    static int      to_table(lua_State* state);
+    const char*     get_raw(int index, match_type& type) const;
+    void            set_override(lua_State* state, int self_index, int index, bool description, const char* value);
+
+    char**          m_matches;
+    int             m_count;
+    const match_extras* m_extras;
+    bool            m_include_type;
+    lua_State*      m_state = nullptr;
+    int             m_registry_ref = LUA_NOREF;
+    std::vector<str_moveable> m_displays;
+    std::vector<str_moveable> m_descriptions;
+};
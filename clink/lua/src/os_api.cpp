@@ -3,6 +3,7 @@
 
 #include "pch.h"
 #include "lua_state.h"
+#include "executable_index.h"
 
 #include <core/base.h>
 #include <core/globber.h>
@@ -262,6 +263,7 @@ int glob_impl(lua_State* state, bool dirs_only, bool back_compat=false)
     globber.files(!dirs_only);
     globber.hidden(g_glob_hidden.get());
     globber.system(g_glob_system.get());
+    globber.cached(true);
     if (back_compat)
         globber.suffix_dirs(false);
 
@@ -357,6 +359,60 @@ int glob_files(lua_State* state)
     return glob_impl(state, false);
 }
 
+//------------------------------------------------------------------------------
+/// -name:  os.getexecutables
+/// -ret:   table
+/// Collects executable files found in the directories listed in %PATH%, and
+/// returns them in a table with the following scheme:
+/// <span class="tablescheme">{ {name:string, type:string}, ... }</span>.
+///
+/// A file is executable if its extension is listed in %PATHEXT%.  Relative
+/// directories in %PATH% are relative to the current directory.
+///
+/// The <span class="tablescheme">type</span> string is "file", and may also
+/// contain ",hidden", ",readonly", ",link", and ",orphaned" depending on the
+/// attributes (making it usable as a match type for
+/// <a href="#builder:addmatch">builder:addmatch()</a>).
+///
+/// The directories are cached and are only enumerated again after they change,
+/// or after %PATH% or %PATHEXT% change.
+int get_executables(lua_State* state)
+{
+    lua_createtable(state, 0, 0);
+
+    int i = 1;
+    str<16> type;
+    executable_index::get().for_each(g_glob_hidden.get(), g_glob_system.get(), [&] (const executable_index::file& f)
+    {
+        lua_createtable(state, 0, 2);
+
+        lua_pushliteral(state, "name");
+        lua_pushlstring(state, f.name.c_str(), f.name.length());
+        lua_rawset(state, -3);
+
+        type.clear();
+        add_type_tag(type, "file");
+        if (f.attr & FILE_ATTRIBUTE_REPARSE_POINT)
+        {
+            add_type_tag(type, "link");
+            if (f.orphaned)
+                add_type_tag(type, "orphaned");
+        }
+        if (f.attr & FILE_ATTRIBUTE_HIDDEN)
+            add_type_tag(type, "hidden");
+        if (f.attr & FILE_ATTRIBUTE_READONLY)
+            add_type_tag(type, "readonly");
+
+        lua_pushliteral(state, "type");
+        lua_pushlstring(state, type.c_str(), type.length());
+        lua_rawset(state, -3);
+
+        lua_rawseti(state, -2, i++);
+    });
+
+    return 1;
+}
+
 //------------------------------------------------------------------------------
 /// -name:  os.getenv
 /// -arg:   name:string
@@ -898,6 +954,7 @@ void os_lua_initialise(lua_state& lua)
         { "copy",        &copy },
         { "globdirs",    &glob_dirs },
         { "globfiles",   &glob_files },
+        { "getexecutables", &get_executables },
         { "getenv",      &get_env },
         { "setenv",      &set_env },
         { "expandenv",   &expand_env },
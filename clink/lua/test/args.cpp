@@ -673,4 +673,109 @@ TEST_CASE("Lua arg parsers")
             tester.run();
         }
     }
+
+    SECTION("Memo")
+    {
+        // Count how many times the reader parses the word 'one', to see
+        // whether the memoized reader states are reused.
+        const char* script = "\
+            m = clink.argmatcher('argmemo')\
+                :addarg('one', 'two')\
+                :addarg('three', 'four')\
+                :addarg('five', 'six')\
+            parsed = 0\
+            local is_flag = m._is_flag\
+            m._is_flag = function (self, word)\
+                if word == 'one' then parsed = parsed + 1 end\
+                return is_flag(self, word)\
+            end\
+        ";
+
+        REQUIRE(lua.do_string(script));
+
+        tester.set_input("argmemo one ");
+        tester.set_expected_matches("three", "four");
+        tester.run();
+
+        REQUIRE(lua.do_string("assert(parsed > 0) parsed = 0"));
+
+        SECTION("Reused")
+        {
+            tester.set_input("three ");
+            tester.set_expected_matches("five", "six");
+            tester.run();
+
+            REQUIRE(lua.do_string("assert(parsed == 0)"));
+        }
+
+        SECTION("Invalidated by addarg")
+        {
+            REQUIRE(lua.do_string("m:addarg('seven')"));
+
+            tester.set_input("three ");
+            tester.set_expected_matches("five", "six");
+            tester.run();
+
+            REQUIRE(lua.do_string("assert(parsed > 0)"));
+        }
+
+        SECTION("Invalidated by addflags")
+        {
+            REQUIRE(lua.do_string("m:addflags('-x')"));
+
+            tester.set_input("three ");
+            tester.set_expected_matches("five", "six");
+            tester.run();
+
+            REQUIRE(lua.do_string("assert(parsed > 0)"));
+        }
+
+        SECTION("Invalidated by nofiles")
+        {
+            REQUIRE(lua.do_string("m:nofiles()"));
+
+            tester.set_input("three ");
+            tester.set_expected_matches("five", "six");
+            tester.run();
+
+            REQUIRE(lua.do_string("assert(parsed > 0)"));
+        }
+
+        SECTION("Invalidated by loop")
+        {
+            REQUIRE(lua.do_string("m:loop(2)"));
+
+            tester.set_input("three five ");
+            tester.set_expected_matches("three", "four");
+            tester.run();
+
+            REQUIRE(lua.do_string("assert(parsed > 0)"));
+        }
+
+        SECTION("Invalidated by another argmatcher")
+        {
+            REQUIRE(lua.do_string("clink.argmatcher():addarg('x'):addflags('-y')"));
+
+            tester.set_input("three ");
+            tester.set_expected_matches("five", "six");
+            tester.run();
+
+            REQUIRE(lua.do_string("assert(parsed > 0)"));
+        }
+    }
+
+    SECTION("Modified arg list")
+    {
+        REQUIRE(lua.do_string("m = clink.argmatcher('argmod'):addflags('-a', '-b')"));
+
+        tester.set_input("argmod -");
+        tester.set_expected_matches("-a", "-b");
+        tester.run();
+
+        REQUIRE(lua.do_string("m:addflags(function () return { '-c' } end)"));
+
+        tester.set_input("a -");
+        tester.set_expected_matches("-a", "-b", "-c");
+        tester.run();
+    }
 }
@@ -14,6 +14,10 @@
 #include <lua/lua_script_loader.h>
 #include <lua/lua_state.h>
 
+extern "C" {
+#include <lua.h>
+}
+
 //------------------------------------------------------------------------------
 TEST_CASE("Lua word classification")
 {
@@ -189,6 +193,141 @@ TEST_CASE("Lua word classification")
             tester.run();
         }
 
+        SECTION("Flags added")
+        {
+            tester.set_input("xyz --dee ghi");
+            tester.set_expected_classifications("ooo");
+            tester.run();
+
+            REQUIRE(lua.do_string("x:addflags('--dee')"));
+
+            tester.set_input(" abc");
+            tester.set_expected_classifications("ofon");
+            tester.run();
+        }
+
+        SECTION("Reclassify")
+        {
+            // Count how many times the classifiers are given the xyz command.
+            const char* counter = "\
+                xyz_count = 0 \
+                local cc = clink.classifier(1) \
+                function cc:classify(commands) \
+                    for _, command in ipairs(commands) do \
+                        if command.line_state:getword(1) == 'xyz' then \
+                            xyz_count = xyz_count + 1 \
+                        end \
+                    end \
+                end \
+            ";
+
+            REQUIRE(lua.do_string(counter));
+
+            auto get_xyz_count = [&] () {
+                lua_State* state = lua.get_state();
+                lua_getglobal(state, "xyz_count");
+                int count = int(lua_tointeger(state, -1));
+                lua_pop(state, 1);
+                return count;
+            };
+
+            tester.set_input("xyz --dee ghi & argcmd");
+            tester.set_expected_classifications("oooo");
+            tester.run();
+
+            const int count = get_xyz_count();
+            REQUIRE(count > 0);
+
+            SECTION("Unchanged")
+            {
+                // Only the argcmd command changes, so the xyz command keeps
+                // its classifications without being classified again.
+                tester.set_input(" t");
+                tester.set_expected_classifications("ooooo");
+                tester.run();
+
+                REQUIRE(get_xyz_count() == count);
+            }
+
+            SECTION("Argmatcher changed")
+            {
+                // Modifying an argmatcher forces every command to be
+                // classified again, even though the xyz command's text is
+                // unchanged.
+                REQUIRE(lua.do_string("x:addflags('--dee')"));
+
+                tester.set_input(" t");
+                tester.set_expected_classifications("ofooo");
+                tester.run();
+
+                REQUIRE(get_xyz_count() > count);
+            }
+
+            SECTION("Forced")
+            {
+                REQUIRE(lua.do_string("clink.reclassifyline()"));
+
+                tester.set_input(" t");
+                tester.set_expected_classifications("ooooo");
+                tester.run();
+
+                REQUIRE(get_xyz_count() > count);
+            }
+        }
+
+        SECTION("Memo")
+        {
+            // Count how many times the reader parses the word 'one', to see
+            // whether classifying reuses the memoized reader states.
+            const char* script = "\
+                m = clink.argmatcher('argmemo')\
+                    :addarg('one', 'two')\
+                    :addarg('three', 'four')\
+                parsed = 0\
+                local is_flag = m._is_flag\
+                m._is_flag = function (self, word)\
+                    if word == 'one' then parsed = parsed + 1 end\
+                    return is_flag(self, word)\
+                end\
+            ";
+
+            REQUIRE(lua.do_string(script));
+
+            SECTION("Replayed")
+            {
+                tester.set_input("argmemo one");
+                tester.set_expected_classifications("oa");
+                tester.run();
+
+                REQUIRE(lua.do_string("assert(parsed > 0) parsed = 0"));
+
+                tester.set_input(" three");
+                tester.set_expected_classifications("oaa");
+                tester.run();
+
+                REQUIRE(lua.do_string("assert(parsed == 0)"));
+            }
+
+            SECTION("Classifier function")
+            {
+                // What an argmatcher's classifier function does can't be
+                // replayed, so the words are parsed again.
+                REQUIRE(lua.do_string("m:setclassifier(function () end)"));
+
+                tester.set_input("argmemo one");
+                tester.set_expected_classifications("oa");
+                tester.run();
+
+                REQUIRE(lua.do_string("assert(parsed > 0) parsed = 0"));
+
+                tester.set_input(" three");
+                tester.set_expected_classifications("oaa");
+                tester.run();
+
+                REQUIRE(lua.do_string("assert(parsed > 0)"));
+            }
+        }
+
         SECTION("Node matches 3 (.exe)")
         {
             tester.set_input("argcmd.exe t");
@@ -378,6 +517,13 @@ TEST_CASE("Lua word classification")
             tester.run();
         }
 
+        SECTION("Separator edit earlier command")
+        {
+            tester.set_input("cd t\x01" "nullcmd && ");
+            tester.set_expected_classifications("oco");
+            tester.run();
+        }
+
         SECTION("Multiple commands with args")
         {
             tester.set_input("xyz abc green | asdfjkl etc | echo etc | xyz -a def && argcmd t");
@@ -0,0 +1,322 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include "match_view_lua.h"
+
+#include <core/base.h>
+#include <lib/matches.h>
+#include <lua/lua_match_generator.h>
+#include <lua/lua_state.h>
+#include <readline/readline.h>
+
+//------------------------------------------------------------------------------
+TEST_CASE("Lua match view")
+{
+    lua_state lua;
+    lua_State* state = lua.get_state();
+
+    char one[] = "one";
+    char two[] = "two";
+    char three[] = "three";
+    char* matches[] = { one, two, three };
+
+    char dir1[] = "\x07" "dir1";
+    char file1[] = "\x06" "file1";
+    char* typed_matches[] = { dir1, file1 };
+
+    SECTION("Index")
+    {
+        match_view_lua view(matches, sizeof_array(matches), false);
+        view.push(state);
+        lua_setglobal(state, "m");
+
+        const char* script = "\
+            assert(#m == 3)\
+            assert(m[1].match == 'one')\
+            assert(m[1].type == 'none')\
+            assert(m[3].match == 'three')\
+            assert(m[0] == nil)\
+            assert(m[4] == nil)\
+            assert(rawequal(m[2], m[2]))\
+            m[2].display = 'TWO'\
+            assert(m[2].display == 'TWO')\
+            assert(tostring(m) == 'matches (3)')\
+        ";
+
+        REQUIRE(lua.do_string(script));
+
+        const int top = lua_gettop(state);
+        const char* match;
+        const char* display;
+        const char* description;
+        match_type type;
+
+        view.get_entry(state, 1, match, type, display, description);
+        REQUIRE(strcmp(match, "one") == 0);
+        REQUIRE(strcmp(display, "one") == 0);
+        REQUIRE(description == nullptr);
+
+        view.get_entry(state, 2, match, type, display, description);
+        REQUIRE(strcmp(match, "two") == 0);
+        REQUIRE(strcmp(display, "TWO") == 0);
+        lua_settop(state, top);
+    }
+
+    SECTION("Get match and type")
+    {
+        match_view_lua view(typed_matches, sizeof_array(typed_matches), true);
+        view.push(state);
+        lua_setglobal(state, "m");
+
+        const char* script = "\
+            assert(m:getmatch(1) == 'dir1')\
+            assert(m:gettype(1) == 'dir')\
+            assert(m:getmatch(2) == 'file1')\
+            assert(m:gettype(2) == 'file')\
+            assert(m:getmatch(0) == nil)\
+            assert(m:gettype(3) == nil)\
+            assert(debug.getuservalue(m) == nil)\
+            assert(m[1].type == 'dir')\
+            assert(debug.getuservalue(m) ~= nil)\
+        ";
+
+        REQUIRE(lua.do_string(script));
+    }
+
+    SECTION("File info")
+    {
+        char file2[] = "\x06" "file1";
+        char* file_matches[] = { dir1, file1, file2 };
+
+        // 2021-01-01 00:00:00 UTC as a FILETIME.
+        match_file_info info = { 0x20, 1234, 132539328000000000ull };
+        match_extras extras;
+        extras.add(file1, &info, match_width());
+
+        match_view_lua view(file_matches, sizeof_array(file_matches), true, &extras);
+        view.push(state);
+        lua_setglobal(state, "m");
+
+        const char* script = "\
+            assert(m[1].size == nil)\
+            assert(m[2].size == 1234)\
+            assert(m[2].mtime == 1609459200)\
+            assert(m[3].match == 'file1')\
+            assert(m[3].size == nil)\
+        ";
+
+        REQUIRE(lua.do_string(script));
+    }
+
+    SECTION("Set displays")
+    {
+        match_view_lua view(matches, sizeof_array(matches), false);
+        view.push(state);
+        lua_setglobal(state, "m");
+
+        const char* script = "\
+            local e = m[1]\
+            m:setdisplays({ 'ONE', nil, true }, { [2] = 'second' })\
+            assert(e.display == 'ONE')\
+            assert(m[2].description == 'second')\
+            assert(m[3].display == nil)\
+        ";
+
+        REQUIRE(lua.do_string(script));
+
+        const int top = lua_gettop(state);
+        const char* match;
+        const char* display;
+        const char* description;
+        match_type type;
+
+        view.get_entry(state, 1, match, type, display, description);
+        REQUIRE(strcmp(display, "ONE") == 0);
+
+        view.get_entry(state, 2, match, type, display, description);
+        REQUIRE(strcmp(display, "two") == 0);
+        REQUIRE(strcmp(description, "second") == 0);
+
+        view.get_entry(state, 3, match, type, display, description);
+        REQUIRE(strcmp(display, "three") == 0);
+        REQUIRE(description == nullptr);
+        lua_settop(state, top);
+    }
+
+    SECTION("To table")
+    {
+        match_view_lua view(matches, sizeof_array(matches), false);
+        view.push(state);
+        lua_setglobal(state, "m");
+
+        const char* script = "\
+            local e = m[1]\
+            local t = m:totable()\
+            assert(type(t) == 'table')\
+            assert(#t == 3)\
+            assert(rawequal(t[1], e))\
+            assert(t[3].match == 'three')\
+            table.sort(t, function (a, b) return a.match > b.match end)\
+            assert(t[1].match == 'two')\
+            assert(m[1].match == 'one')\
+        ";
+
+        REQUIRE(lua.do_string(script));
+    }
+
+    SECTION("Iterate")
+    {
+        match_view_lua view(matches, sizeof_array(matches), false);
+        view.push(state);
+        lua_setglobal(state, "m");
+
+        const char* script = "\
+            local s = ''\
+            for i, e in ipairs(m) do s = s..i..e.match end\
+            assert(s == '1one2two3three')\
+            s = ''\
+            for i, e in pairs(m) do s = s..i..e.match end\
+            assert(s == '1one2two3three')\
+            s = ''\
+            for i = 1, #m do s = s..m:getmatch(i) end\
+            assert(s == 'onetwothree')\
+        ";
+
+        REQUIRE(lua.do_string(script));
+    }
+
+    SECTION("After event")
+    {
+        {
+            match_view_lua view(matches, sizeof_array(matches), false);
+            view.push(state);
+            lua_setglobal(state, "m");
+            REQUIRE(lua.do_string("e = m[1]"));
+        }
+
+        const char* script = "\
+            assert(#m == 0)\
+            assert(m[1] == nil)\
+            assert(m:getmatch(1) == nil)\
+            assert(m:gettype(1) == nil)\
+            for _ in ipairs(m) do error('not empty') end\
+            assert(#m:totable() == 0)\
+            assert(tostring(m) == 'matches (0)')\
+            assert(e.match == 'one')\
+        ";
+
+        REQUIRE(lua.do_string(script));
+    }
+
+    SECTION("Read only")
+    {
+        match_view_lua view(matches, sizeof_array(matches), false);
+        view.push(state);
+        lua_setglobal(state, "m");
+
+        const char* script = "\
+            assert(type(m) == 'userdata')\
+            assert(not pcall(function () m[1] = 'x' end))\
+            assert(not pcall(function () m[4] = 'four' end))\
+            assert(#m == 3)\
+            assert(m[1].match == 'one')\
+            assert(table.remove(m:totable()).match == 'three')\
+            assert(#m == 3)\
+        ";
+
+        REQUIRE(lua.do_string(script));
+    }
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("Lua match view events")
+{
+    lua_state lua;
+    lua_match_generator lua_generator(lua); // This loads the required lua scripts.
+
+    int include_type = rl_completion_matches_include_type;
+    rl_completion_matches_include_type = 0;
+
+    char* matches[] = {
+        strdup("t"),
+        strdup("one"),
+        strdup("two"),
+        strdup("three"),
+        nullptr,
+    };
+
+    SECTION("Table")
+    {
+        const char* script = "\
+            clink.onfiltermatches(function (m)\
+                assert(type(m) == 'table')\
+                assert(next(m) == 1)\
+                assert(rawget(m, 3).match == 'three')\
+                table.remove(m, 2)\
+                return m\
+            end)\
+        ";
+
+        REQUIRE(lua.do_string(script));
+        lua_generator.filter_matches(matches, nullptr, '?', false);
+
+        REQUIRE(strcmp(matches[1], "one") == 0);
+        REQUIRE(strcmp(matches[2], "three") == 0);
+        REQUIRE(matches[3] == nullptr);
+    }
+
+    SECTION("Assign")
+    {
+        REQUIRE(lua.do_string("clink.onfiltermatches(function (m) m[1] = m[3] m[3] = nil return m end)"));
+        lua_generator.filter_matches(matches, nullptr, '?', false);
+
+        REQUIRE(strcmp(matches[1], "two") == 0);
+        REQUIRE(strcmp(matches[2], "three") == 0);
+        REQUIRE(matches[3] == nullptr);
+    }
+
+    SECTION("View")
+    {
+        const char* script = "\
+            clink.onfiltermatches(function (m)\
+                assert(type(m) == 'userdata')\
+                assert(m:getmatch(2) == 'two')\
+                return { m[3] }\
+            end, true)\
+        ";
+
+        REQUIRE(lua.do_string(script));
+        lua_generator.filter_matches(matches, nullptr, '?', false);
+
+        REQUIRE(strcmp(matches[1], "three") == 0);
+        REQUIRE(matches[2] == nullptr);
+    }
+
+    SECTION("View and table")
+    {
+        const char* script = "\
+            clink.onfiltermatches(function (m)\
+                assert(type(m) == 'userdata')\
+            end, true)\
+            clink.onfiltermatches(function (m)\
+                assert(type(m) == 'table')\
+                table.remove(m, 1)\
+                return m\
+            end)\
+        ";
+
+        REQUIRE(lua.do_string(script));
+        lua_generator.filter_matches(matches, nullptr, '?', false);
+
+        REQUIRE(strcmp(matches[1], "two") == 0);
+        REQUIRE(strcmp(matches[2], "three") == 0);
+        REQUIRE(matches[3] == nullptr);
+    }
+
+    for (char** m = matches; *m; ++m)
+        free(*m);
+
+    rl_completion_matches_include_type = include_type;
+}
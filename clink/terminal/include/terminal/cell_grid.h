@@ -0,0 +1,51 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <core/str.h>
+
+#include <vector>
+
+//------------------------------------------------------------------------------
+class cell_grid
+{
+    // A back buffer for a block of screen rows.  Each row's text (which may
+    // contain SGR escape codes) is split into cells, and compared with the
+    // cells previously rendered on that row.  Only the runs of cells that
+    // changed are rendered, and SGR codes are only emitted where the
+    // attributes change within a run.
+    //
+    // Rows containing other escape codes or control characters can't be split
+    // into cells; they're always rendered in full.
+
+public:
+    void                clear();
+    void                truncate(unsigned int rows);
+    void                update_row(unsigned int row, const char* text, int len, str_base& out);
+
+private:
+    struct cell
+    {
+        unsigned int    offset;     // Offset of the cell's text in row::text.
+        unsigned char   length;     // 0 for the right half of a wide character.
+        unsigned char   width;      // Columns the cell's text occupies.
+        unsigned short  attr;       // Index into row::attrs (0 is the defaults).
+    };
+
+    struct row
+    {
+        str_moveable    text;
+        std::vector<str_moveable> attrs;
+        std::vector<cell> cells;
+        bool            opaque = true;
+    };
+
+    static bool         parse(const char* text, int len, row& out);
+    static bool         is_same(const row& a, const row& b, unsigned int index, const std::vector<int>& attr_map);
+    static bool         is_continuation(const row& r, unsigned int index);
+    static void         set_column(unsigned int column, str_base& out);
+    static void         set_attr(const row& r, unsigned int attr, unsigned int& current, str_base& out);
+    std::vector<row>    m_rows;
+    row                 m_scratch;
+};
@@ -0,0 +1,270 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "cell_grid.h"
+#include "ecma48_iter.h"
+
+#include <core/str_iter.h>
+
+//------------------------------------------------------------------------------
+// Unchanged runs shorter than this are rendered anyway, because moving the
+// cursor past them costs about as much as rendering them.
+static const unsigned int c_min_skip = 6;
+
+
+
+//------------------------------------------------------------------------------
+void cell_grid::clear()
+{
+    m_rows.clear();
+}
+
+//------------------------------------------------------------------------------
+void cell_grid::truncate(unsigned int rows)
+{
+    if (rows < m_rows.size())
+        m_rows.resize(rows);
+}
+
+//------------------------------------------------------------------------------
+// The cursor must be at the start of the row, with default attributes.  This
+// appends to out whatever is needed to change what was previously rendered on
+// the row into text.  Afterwards the attributes are the defaults again, and the
+// cursor is somewhere on the row.
+void cell_grid::update_row(unsigned int index, const char* text, int len, str_base& out)
+{
+    if (len < 0)
+        len = int(strlen(text));
+
+    if (index >= m_rows.size())
+        m_rows.resize(index + 1);
+
+    row& prev = m_rows[index];
+    row& next = m_scratch;
+
+    // Render the whole row if there's nothing to compare against.
+    if (!parse(text, len, next) || prev.opaque)
+    {
+        out.concat(text, len);
+        out.concat("\x1b[m\x1b[K");
+        std::swap(prev, next);
+        return;
+    }
+
+    // Map each attribute of the new row to the same attribute of the previous
+    // row, so that comparing cells needn't compare strings.
+    std::vector<int> attr_map(next.attrs.size(), -1);
+    for (unsigned int i = 0; i < next.attrs.size(); ++i)
+        for (unsigned int j = 0; j < prev.attrs.size(); ++j)
+            if (next.attrs[i].equals(prev.attrs[j].c_str()))
+            {
+                attr_map[i] = j;
+                break;
+            }
+
+    const unsigned int n = unsigned(next.cells.size());
+    const unsigned int o = unsigned(prev.cells.size());
+    unsigned int current = 0;
+
+    unsigned int i = 0;
+    while (i < n)
+    {
+        if (is_same(next, prev, i, attr_map))
+        {
+            ++i;
+            continue;
+        }
+
+        // Back up to the start of a wide character.
+        unsigned int start = i;
+        while (start > 0 && (is_continuation(next, start) || is_continuation(prev, start)))
+            --start;
+
+        // Find the end of the changed run, including short unchanged gaps.
+        unsigned int end = i + 1;
+        while (true)
+        {
+            while (end < n && !is_same(next, prev, end, attr_map))
+                ++end;
+
+            unsigned int gap = end;
+            while (gap < n && gap - end < c_min_skip && is_same(next, prev, gap, attr_map))
+                ++gap;
+
+            if (gap >= n || gap - end >= c_min_skip)
+                break;
+            end = gap;
+        }
+
+        // Don't stop in the middle of a wide character.
+        while (end < n && (is_continuation(next, end) || is_continuation(prev, end)))
+            ++end;
+
+        set_column(start, out);
+        for (unsigned int j = start; j < end; ++j)
+        {
+            const cell& c = next.cells[j];
+            if (!c.length)
+                continue;
+            set_attr(next, c.attr, current, out);
+            out.concat(next.text.c_str() + c.offset, c.length);
+        }
+
+        i = end;
+    }
+
+    set_attr(next, 0, current, out);
+
+    // Erase the rest of the previous row.
+    if (n < o)
+    {
+        set_column(n, out);
+        out.concat("\x1b[K");
+    }
+
+    std::swap(prev, next);
+}
+
+//------------------------------------------------------------------------------
+bool cell_grid::parse(const char* text, int len, row& out)
+{
+    out.text.clear();
+    out.attrs.clear();
+    out.attrs.emplace_back();
+    out.cells.clear();
+    out.opaque = true;
+
+    str<> attr;
+    unsigned short attr_index = 0;
+
+    ecma48_state state;
+    ecma48_iter iter(text, state, len);
+    while (const ecma48_code& code = iter.next())
+    {
+        switch (code.get_type())
+        {
+        case ecma48_code::type_chars:
+            {
+                str_iter inner(code.get_pointer(), code.get_length());
+                const char* ptr = inner.get_pointer();
+                while (int c = inner.next())
+                {
+                    const char* end = inner.get_pointer();
+                    const unsigned int bytes = unsigned(end - ptr);
+                    const int width = clink_wcwidth(c);
+
+                    if (width <= 0 && !out.cells.empty())
+                    {
+                        // Combining marks join the preceding character.
+                        cell* prev = &out.cells.back();
+                        if (!prev->length)
+                            --prev;
+                        if (prev->length + bytes > 0xff)
+                            return false;
+                        out.text.concat(ptr, bytes);
+                        prev->length += bytes;
+                    }
+                    else
+                    {
+                        cell cell;
+                        cell.offset = out.text.length();
+                        cell.length = (unsigned char)bytes;
+                        cell.width = (unsigned char)((width > 1) ? 2 : 1);
+                        cell.attr = attr_index;
+                        out.text.concat(ptr, bytes);
+                        out.cells.push_back(cell);
+
+                        if (cell.width > 1)
+                        {
+                            cell.offset = out.text.length();
+                            cell.length = 0;
+                            cell.width = 0;
+                            out.cells.push_back(cell);
+                        }
+                    }
+
+                    ptr = end;
+                }
+            }
+            break;
+
+        case ecma48_code::type_c1:
+            if (code.get_code() == ecma48_code::c1_csi)
+            {
+                ecma48_code::csi<32> csi;
+                if (code.decode_csi(csi) && csi.final == 'm' && !csi.intermediate && !csi.private_use)
+                {
+                    // A reset discards the attributes before it; otherwise
+                    // the codes accumulate, and replaying them in order
+                    // reproduces the attributes.
+                    if (!csi.param_count || csi.params[0] == 0)
+                        attr.clear();
+                    if (csi.param_count > 1 || (csi.param_count == 1 && csi.params[0] != 0))
+                        attr.concat(code.get_pointer(), code.get_length());
+
+                    attr_index = 0;
+                    if (attr.length())
+                    {
+                        for (attr_index = 1; attr_index < out.attrs.size(); ++attr_index)
+                            if (out.attrs[attr_index].equals(attr.c_str()))
+                                break;
+                        if (attr_index >= out.attrs.size())
+                            out.attrs.emplace_back(attr.c_str());
+                    }
+                    break;
+                }
+            }
+            return false;
+
+        default:
+            return false;
+        }
+    }
+
+    out.opaque = false;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+bool cell_grid::is_same(const row& a, const row& b, unsigned int index, const std::vector<int>& attr_map)
+{
+    if (index >= b.cells.size())
+        return false;
+
+    const cell& ca = a.cells[index];
+    const cell& cb = b.cells[index];
+    return (ca.length == cb.length &&
+            ca.width == cb.width &&
+            attr_map[ca.attr] == int(cb.attr) &&
+            memcmp(a.text.c_str() + ca.offset, b.text.c_str() + cb.offset, ca.length) == 0);
+}
+
+//------------------------------------------------------------------------------
+bool cell_grid::is_continuation(const row& r, unsigned int index)
+{
+    return index < r.cells.size() && !r.cells[index].length;
+}
+
+//------------------------------------------------------------------------------
+void cell_grid::set_column(unsigned int column, str_base& out)
+{
+    str<16> tmp;
+    tmp.format("\x1b[%uG", column + 1);
+    out.concat(tmp.c_str(), tmp.length());
+}
+
+//------------------------------------------------------------------------------
+void cell_grid::set_attr(const row& r, unsigned int attr, unsigned int& current, str_base& out)
+{
+    if (attr == current)
+        return;
+
+    // The attributes accumulate, so reset them unless they're already the
+    // defaults.
+    if (current || !attr)
+        out.concat("\x1b[m");
+    if (attr)
+        out.concat(r.attrs[attr].c_str(), r.attrs[attr].length());
+    current = attr;
+}
@@ -0,0 +1,90 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include "line_editor_tester.h"
+
+#include <terminal/cell_grid.h>
+#include <terminal/printer.h>
+
+//------------------------------------------------------------------------------
+static void update(cell_grid& grid, printer& printer, unsigned int row, const char* text)
+{
+    str<> out;
+    grid.update_row(row, text, -1, out);
+    printer.print(out.c_str(), out.length());
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("Cell grid")
+{
+    test_terminal_out terminal;
+    terminal.capture_output();
+    printer printer(terminal);
+    cell_grid grid;
+
+    update(grid, printer, 0, "abc \x1b[1mdef\x1b[m ghi");
+    update(grid, printer, 1, "second row");
+    terminal.clear_output();
+
+    SECTION("First frame")
+    {
+        grid.clear();
+        update(grid, printer, 0, "abc \x1b[1mdef\x1b[m ghi");
+        REQUIRE(strcmp(terminal.get_output(), "abc \x1b[1mdef\x1b[m ghi\x1b[m\x1b[K") == 0);
+    }
+
+    SECTION("Unchanged")
+    {
+        update(grid, printer, 0, "abc \x1b[1mdef\x1b[m ghi");
+        update(grid, printer, 1, "second row");
+        REQUIRE(strcmp(terminal.get_output(), "") == 0);
+    }
+
+    SECTION("One cell")
+    {
+        update(grid, printer, 0, "abc \x1b[1mdxf\x1b[m ghi");
+        REQUIRE(strcmp(terminal.get_output(), "\x1b[6G\x1b[1mx\x1b[m") == 0);
+    }
+
+    SECTION("Attributes only")
+    {
+        update(grid, printer, 0, "abc \x1b[7mdef\x1b[m ghi");
+        REQUIRE(strcmp(terminal.get_output(), "\x1b[5G\x1b[7mdef\x1b[m") == 0);
+    }
+
+    SECTION("Accumulated attributes")
+    {
+        update(grid, printer, 0, "abc \x1b[1mde\x1b[1mf\x1b[0m ghi");
+        REQUIRE(strcmp(terminal.get_output(), "\x1b[7G\x1b[1m\x1b[1mf\x1b[m") == 0);
+    }
+
+    SECTION("Separate runs")
+    {
+        update(grid, printer, 1, "Second row, longer");
+        REQUIRE(strcmp(terminal.get_output(), "\x1b[1GS\x1b[11G, longer") == 0);
+    }
+
+    SECTION("Shorter")
+    {
+        update(grid, printer, 1, "second");
+        REQUIRE(strcmp(terminal.get_output(), "\x1b[7G\x1b[K") == 0);
+    }
+
+    SECTION("Opaque")
+    {
+        update(grid, printer, 1, "second\trow");
+        REQUIRE(strcmp(terminal.get_output(), "second\trow\x1b[m\x1b[K") == 0);
+        terminal.clear_output();
+        update(grid, printer, 1, "second row");
+        REQUIRE(strcmp(terminal.get_output(), "second row\x1b[m\x1b[K") == 0);
+    }
+
+    SECTION("Truncate")
+    {
+        grid.truncate(1);
+        update(grid, printer, 1, "second row");
+        REQUIRE(strcmp(terminal.get_output(), "second row\x1b[m\x1b[K") == 0);
+    }
+}
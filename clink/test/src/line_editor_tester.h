@@ -42,7 +42,7 @@ public:
     virtual void            begin() override {}
     virtual void            end() override {}
     virtual void            close() override {}
-    virtual void            write(const char* chars, int length) override {}
+    virtual void            write(const char* chars, int length) override { if (m_capture) m_output.concat(chars, length); }
     virtual void            flush() override {}
     virtual int             get_columns() const override { return 80; }
     virtual int             get_rows() const override { return 25; }
@@ -51,6 +51,13 @@ public:
     virtual int             line_has_color(int line, const BYTE* attrs, int num_attrs, BYTE mask=0xff) const { return false; }
     virtual int             find_line(int starting_line, int distance, const char* text, find_line_mode mode, const BYTE* attrs=nullptr, int num_attrs=0, BYTE mask=0xff) const { return 0; }
     virtual void            set_attributes(const attributes attr) {}
+    void                    capture_output(bool capture=true) { m_capture = capture; m_output.clear(); }
+    const char*             get_output() const { return m_output.c_str(); }
+    void                    clear_output() { m_output.clear(); }
+
+private:
+    str<>                   m_output;       // Only written to when capturing.
+    bool                    m_capture = false;
 };
 
 
@@ -78,6 +78,7 @@ extern void qsort_match_list (char** matches, int len);
 
 //------------------------------------------------------------------------------
 rl_match_display_filter_func_t *rl_match_display_filter_func = NULL;
+rl_match_width_func_t *rl_match_width_func = NULL;
 const char *_rl_filtered_color = NULL;
 const char *_rl_selected_color = NULL;
 
@@ -172,6 +173,13 @@ void flush_tmpbuf(void)
     }
 }
 
+//------------------------------------------------------------------------------
+const char* get_tmpbuf(int* len)
+{
+    *len = tmpbuf_length;
+    return tmpbuf_allocated ? tmpbuf_allocated : "";
+}
+
 
 
 //------------------------------------------------------------------------------
@@ -391,13 +399,7 @@ static bool append_match_color_indicator(const char *f, unsigned char match_type
     {
         // Test if NAME has a recognized suffix.
         len = strlen(name);
-        name += len; // Pointer to final \0.
-        for (ext = _rl_color_ext_list; ext != NULL; ext = ext->next)
-        {
-            if (ext->ext.len <= len && strncmp(name - ext->ext.len, ext->ext.string,
-                                               ext->ext.len) == 0)
-                break;
-        }
+        ext = _rl_find_color_ext(name, len);
     }
 
     free(filename); // NULL or savestring return value.
@@ -816,8 +818,10 @@ static const char* visible_part(const char *match)
 //------------------------------------------------------------------------------
 int printable_len(const char* match)
 {
-    const char* temp = printable_part((char*)match);
-    int len = fnwidth(temp);
+    // Use the width measured when the match was added, if available.
+    int len = rl_match_width_func ? rl_match_width_func(match) : -1;
+    if (len < 0)
+        len = fnwidth(printable_part((char*)match));
 
     // If present, use the match type to determine whether there will be a
     // visible stat character, and include it in the max length calculation.
@@ -1203,6 +1207,22 @@ static int prompt_display_matches(int len)
     return 1;
 }
 
+//------------------------------------------------------------------------------
+// Incomplete matches (e.g. files still being enumerated in the background) are
+// followed by a note, so the list isn't mistaken for the full list.
+static void display_loading_note(void)
+{
+    if (!rl_completion_display_only)
+        return;
+
+    if (_rl_display_message_color)
+        fprintf(rl_outstream, "%s", _rl_display_message_color);
+    fprintf(rl_outstream, "(loading more matches...)");
+    if (_rl_display_message_color)
+        fprintf(rl_outstream, "\x1b[m");
+    rl_crlf();
+}
+
 //------------------------------------------------------------------------------
 void display_matches(char** matches)
 {
@@ -1247,6 +1267,7 @@ void display_matches(char** matches)
             }
 
             display_filtered_match_list_internal(filtered_matches, len, max, false);
+            display_loading_note();
 
 done_filtered:
             free_filtered_matches(filtered_matches);
@@ -1263,6 +1284,7 @@ done_filtered:
         append_filename(temp, matches[0], 0, 0, 0);
         fwrite(tmpbuf_allocated, tmpbuf_length, 1, rl_outstream);
         rl_crlf();
+        display_loading_note();
 
         goto done;
     }
@@ -1289,6 +1311,7 @@ done_filtered:
     }
 
     display_match_list_internal(matches, len, max, false);
+    display_loading_note();
 
 done:
     rl_forced_update_display();
@@ -20,6 +20,11 @@ typedef struct match_display_filter_entry match_display_filter_entry;
 typedef match_display_filter_entry** rl_match_display_filter_func_t(char**);
 extern rl_match_display_filter_func_t *rl_match_display_filter_func;
 
+// Returns the visible width of the printable part of a match, or -1 if the
+// width isn't known.
+typedef int rl_match_width_func_t(const char*);
+extern rl_match_width_func_t *rl_match_width_func;
+
 extern const char *_rl_filtered_color;
 extern const char *_rl_selected_color;
 
@@ -29,6 +34,7 @@ extern void rollback_tmpbuf(void);
 extern void append_tmpbuf_char(char c);
 extern void append_tmpbuf_string(const char* s, int len);
 extern void flush_tmpbuf(void);
+extern const char* get_tmpbuf(int* len);
 extern void append_display(const char* to_print, int selected);
 // type is ignored when rl_completion_matches_include_type is set.
 extern int append_filename(char* to_print, const char* full_pathname, int prefix_bytes, unsigned char type, int selected);
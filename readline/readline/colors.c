@@ -335,14 +335,9 @@ _rl_print_color_indicator (const char *f, unsigned char match_type)
     {
       /* Test if NAME has a recognized suffix.  */
       len = strlen (name);
-      name += len;		/* Pointer to final \0.  */
-      for (ext = _rl_color_ext_list; ext != NULL; ext = ext->next)
-        {
-          if (ext->ext.len <= len
-              && strncmp (name - ext->ext.len, ext->ext.string,
-                          ext->ext.len) == 0)
-            break;
-        }
+/* begin_clink_change */
+      ext = _rl_find_color_ext (name, len);
+/* end_clink_change */
     }
 
   free (filename);	/* NULL or savestring return value */
@@ -70,6 +70,11 @@ typedef struct _color_ext_type
     struct bin_str ext;         	/* The extension we're looking for */
     struct bin_str seq;         	/* The sequence to output when we do */
     struct _color_ext_type *next;	/* Next in list */
+/* begin_clink_change */
+    struct _color_ext_type *index_next;	/* Next in the same index slot */
+    unsigned int priority;		/* Position in list; lower wins */
+    int case_sensitive;			/* Another entry differs only in case */
+/* end_clink_change */
   } COLOR_EXT_TYPE;
 
 /* file extensions indicators (.txt, .log, .jpg, ...)
@@ -124,6 +129,7 @@ extern bool _rl_print_prefix_color (void);
 extern bool _rl_print_pager_color (void);
 //extern bool _rl_print_color_indicator (const char *f);
 extern bool _rl_print_color_indicator (const char *f, unsigned char match_type);
+extern COLOR_EXT_TYPE *_rl_find_color_ext (const char *name, size_t len);
 /* end_clink_change */
 extern void _rl_prep_non_filename_text (void);
 
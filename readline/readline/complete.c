@@ -120,6 +120,12 @@ rl_postprocess_lcd_func_t *rl_postprocess_lcd_func = (rl_postprocess_lcd_func_t
 /* If non-zero, then this is the address of a function to call that determines
    whether a file extension is executable. */
 rl_iccpfunc_t *rl_is_exec_func = (rl_iccpfunc_t *)NULL;
+/* If non-zero, then this is the address of a function to call just before a
+   list of matches is freed. */
+rl_vcppfunc_t *rl_free_match_list_hook = (rl_vcppfunc_t *)NULL;
+/* Non-zero means the matches are incomplete (e.g. files are still being
+   enumerated in the background), so completion only lists them. */
+int rl_completion_display_only = 0;
 /* end_clink_change */
 
 #if defined (VISIBLE_STATS) || defined (COLOR_SUPPORT)
@@ -629,6 +635,7 @@ set_completion_defaults (int what_to_do)
 /* begin_clink_change */
   quote_lcd = 0;
   force_quoting = 0;
+  rl_completion_display_only = 0;
   if (orig_text_for_completion)
     xfree (orig_text_for_completion);
   orig_text_for_completion = 0;
@@ -878,7 +885,8 @@ stat_from_match_type (unsigned char match_type, const char* fn, struct stat* fin
 {
   /* The match provider already knew the match type, and they can include the
      match type to save us from wasting IO re-testing the match type. */
-  finfo->st_mode = 0;
+  memset (finfo, 0, sizeof (*finfo));
+  finfo->st_nlink = 1;
 
   if (IS_MATCH_TYPE_DIR (match_type))
     finfo->st_mode |= S_IFDIR;
@@ -2891,6 +2899,11 @@ _rl_free_match_list (char **matches)
   if (matches == 0)
     return;
 
+/* begin_clink_change */
+  if (rl_free_match_list_hook)
+    (*rl_free_match_list_hook) (matches);
+/* end_clink_change */
+
   for (i = 0; matches[i]; i++)
     xfree (matches[i]);
   xfree (matches);
@@ -3014,6 +3027,16 @@ rl_complete_internal (int what_to_do)
 /* end_clink_change */
     last_completion_failed = 0;
 
+/* begin_clink_change */
+  /* Incomplete matches are only listed; inserting the common prefix or a
+     unique match could pick a completion the full list wouldn't. */
+  if (rl_completion_display_only)
+    {
+      what_to_do = '?';
+      saved_last_completion_failed = 0;
+    }
+/* end_clink_change */
+
   switch (what_to_do)
     {
     case TAB:
@@ -3752,12 +3775,15 @@ rl_old_menu_complete (int count, int invoking_key)
   static int orig_start, orig_end;
   static char quote_char;
   static int delimiter;
+/* begin_clink_change */
+  static int listed_only = 0;
+/* end_clink_change */
 
   /* The first time through, we generate the list of matches and set things
      up to insert them. */
 /* begin_clink_change */
   //if (rl_last_func != rl_old_menu_complete)
-  if (rl_last_func != rl_old_menu_complete && rl_last_func != rl_backward_old_menu_complete)
+  if ((rl_last_func != rl_old_menu_complete && rl_last_func != rl_backward_old_menu_complete) || listed_only)
 /* end_clink_change */
     {
       /* Clean up from previous call, if any. */
@@ -3767,6 +3793,9 @@ rl_old_menu_complete (int count, int invoking_key)
 
       match_list_index = match_list_size = 0;
       matches = (char **)NULL;
+/* begin_clink_change */
+      listed_only = 0;
+/* end_clink_change */
 
       rl_completion_invoking_key = invoking_key;
 
@@ -3824,6 +3853,20 @@ rl_old_menu_complete (int count, int invoking_key)
 	}
 /* begin_clink_change */
       no_compute_lcd = 0;
+
+      /* Incomplete matches are only listed. */
+      if (rl_completion_display_only)
+	{
+	  RL_UNSETSTATE(RL_STATE_COMPLETING);
+	  display_matches (matches);
+	  _rl_free_match_list (matches);
+	  matches = (char **)0;
+	  FREE (orig_text);
+	  orig_text = (char *)0;
+	  completion_changed_buffer = 0;
+	  listed_only = 1;
+	  return (0);
+	}
 /* end_clink_change */
 
 /* begin_clink_change
@@ -4012,6 +4055,21 @@ rl_menu_complete (int count, int ignore)
 
       RL_UNSETSTATE(RL_STATE_COMPLETING);
 
+/* begin_clink_change */
+      /* Incomplete matches are only listed. */
+      if (rl_completion_display_only)
+	{
+	  display_matches (matches);
+	  _rl_free_match_list (matches);
+	  matches = (char **)0;
+	  FREE (orig_text);
+	  orig_text = (char *)0;
+	  completion_changed_buffer = 0;
+	  full_completion = 1;
+	  return (0);
+	}
+/* end_clink_change */
+
       for (match_list_size = 0; matches[match_list_size]; match_list_size++)
         ;
 
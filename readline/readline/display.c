@@ -214,6 +214,10 @@ char *rl_display_prompt = (char *)NULL;
    line of the input text, if there is room past the input text. */
 char *rl_display_rprompt = (char *)NULL;
 int _rl_rprompt_shown_len = 0;
+/* Incremented each time the display starts over on a new line, e.g. after
+   something else printed or for a forced redisplay.  Lets the host tell when
+   anything it drew below the line may no longer be on the screen. */
+int _rl_new_line_count = 0;
 /* end_clink_change */
 
 /* Variables used to include the editing mode in the prompt. */
@@ -2787,6 +2791,7 @@ rl_on_new_line (void)
 /* begin_clink_change */
   /* The right side prompt is only shown on the first line. */
   _rl_rprompt_shown_len = 0;
+  _rl_new_line_count++;
 /* end_clink_change */
 
   _rl_last_c_pos = _rl_last_v_pos = 0;
@@ -2878,9 +2883,22 @@ rl_on_new_line_with_prompt (void)
 
   rl_display_prompt = rl_prompt;	/* XXX - make sure it's set */
 
+/* begin_clink_change */
+  _rl_new_line_count++;
+/* end_clink_change */
+
   return 0;
 }
 
+/* begin_clink_change */
+/* Returns the screen line the prompt ends on, relative to where it starts. */
+int
+_rl_get_prompt_last_screen_line (void)
+{
+  return prompt_last_screen_line;
+}
+/* end_clink_change */
+
 /* Actually update the display, period. */
 int
 rl_forced_update_display (void)
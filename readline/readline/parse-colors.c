@@ -90,6 +90,275 @@ struct bin_str _rl_color_indicator[] =
     { LEN_STR_PAIR ("\033[K") },        //  cl: clear to end of line
   };
 
+/* begin_clink_change */
+/* The default indicators, so they can be restored before parsing a changed
+   LS_COLORS value. */
+static struct bin_str default_color_indicator[sizeof (_rl_color_indicator) / sizeof (_rl_color_indicator[0])];
+static int saved_default_color_indicator = 0;
+
+/* The LS_COLORS value that was most recently parsed. */
+static char *parsed_ls_colors = NULL;
+
+/* Index of _rl_color_ext_list, so finding the color for a filename doesn't
+   compare against every extension.  Entries that contain a '.' are hashed by
+   their lower-cased final extension (e.g. ".gz" for ".tar.gz").  The rest
+   (e.g. "README" or "~") are in a trie of their lower-cased characters read
+   from the end backwards.  The earliest entry in the list still wins, so the
+   result is the same as walking the list.
+
+   File names on Windows are case insensitive, so entries match regardless of
+   case, except that entries which differ only in case (e.g. "*.c" and "*.C")
+   each match only their own case, as in GNU ls. */
+typedef struct _color_suffix_node
+  {
+    unsigned char c;
+    struct _color_suffix_node *child;
+    struct _color_suffix_node *sibling;
+    COLOR_EXT_TYPE *exts;		/* Entries ending here, in list order */
+  } COLOR_SUFFIX_NODE;
+
+static COLOR_EXT_TYPE **color_ext_buckets = NULL;
+static unsigned int color_ext_bucket_mask = 0;
+static COLOR_SUFFIX_NODE *color_suffix_root = NULL;
+
+#define LOWER_ASCII(c) ((c) >= 'A' && (c) <= 'Z' ? (c) - 'A' + 'a' : (c))
+
+static unsigned int
+hash_lower (const char *s, size_t len)
+{
+  unsigned int hash = 5381;
+  while (len--)
+    {
+      unsigned char c = (unsigned char)*(s++);
+      hash = ((hash << 5) + hash) ^ LOWER_ASCII (c);
+    }
+  return hash;
+}
+
+static const char *
+last_dot (const char *s, size_t len)
+{
+  while (len--)
+    if (s[len] == '.')
+      return s + len;
+  return NULL;
+}
+
+static int
+strnicmp_ascii (const char *a, const char *b, size_t len)
+{
+  while (len--)
+    {
+      unsigned char ca = (unsigned char)*(a++);
+      unsigned char cb = (unsigned char)*(b++);
+      if (LOWER_ASCII (ca) != LOWER_ASCII (cb))
+        return 1;
+    }
+  return 0;
+}
+
+static void
+append_index_entry (COLOR_EXT_TYPE **head, COLOR_EXT_TYPE *ext)
+{
+  while (*head)
+    {
+      /* Entries that differ only in case are matched case sensitively. */
+      COLOR_EXT_TYPE *other = *head;
+      if (other->ext.len == ext->ext.len
+          && strnicmp_ascii (other->ext.string, ext->ext.string, ext->ext.len) == 0
+          && strncmp (other->ext.string, ext->ext.string, ext->ext.len) != 0)
+        other->case_sensitive = ext->case_sensitive = 1;
+      head = &other->index_next;
+    }
+  *head = ext;
+  ext->index_next = NULL;
+}
+
+static void
+free_suffix_node (COLOR_SUFFIX_NODE *node)
+{
+  while (node)
+    {
+      COLOR_SUFFIX_NODE *sibling = node->sibling;
+      free_suffix_node (node->child);
+      free (node);
+      node = sibling;
+    }
+}
+
+static void
+free_color_ext_index (void)
+{
+  free (color_ext_buckets);
+  color_ext_buckets = NULL;
+  color_ext_bucket_mask = 0;
+  free_suffix_node (color_suffix_root);
+  color_suffix_root = NULL;
+}
+
+static void
+build_color_ext_index (void)
+{
+  COLOR_EXT_TYPE *ext;
+  unsigned int count, size, priority;
+
+  free_color_ext_index ();
+
+  count = 0;
+  for (ext = _rl_color_ext_list; ext != NULL; ext = ext->next)
+    count++;
+  if (!count)
+    return;
+
+  for (size = 16; size < count * 2; size <<= 1)
+    ;
+  color_ext_buckets = (COLOR_EXT_TYPE **)xmalloc (size * sizeof (*color_ext_buckets));
+  memset (color_ext_buckets, 0, size * sizeof (*color_ext_buckets));
+  color_ext_bucket_mask = size - 1;
+
+  color_suffix_root = (COLOR_SUFFIX_NODE *)xmalloc (sizeof (*color_suffix_root));
+  memset (color_suffix_root, 0, sizeof (*color_suffix_root));
+
+  priority = 0;
+  for (ext = _rl_color_ext_list; ext != NULL; ext = ext->next)
+    {
+      const char *dot = last_dot (ext->ext.string, ext->ext.len);
+
+      ext->priority = priority++;
+      ext->case_sensitive = 0;
+      if (dot)
+        {
+          size_t dot_len = ext->ext.len - (dot - ext->ext.string);
+          unsigned int slot = hash_lower (dot, dot_len) & color_ext_bucket_mask;
+          append_index_entry (&color_ext_buckets[slot], ext);
+        }
+      else
+        {
+          COLOR_SUFFIX_NODE *node = color_suffix_root;
+          size_t i = ext->ext.len;
+          while (i--)
+            {
+              unsigned char c = (unsigned char)ext->ext.string[i];
+              COLOR_SUFFIX_NODE *child;
+
+              c = LOWER_ASCII (c);
+              for (child = node->child; child != NULL; child = child->sibling)
+                if (child->c == c)
+                  break;
+              if (child == NULL)
+                {
+                  child = (COLOR_SUFFIX_NODE *)xmalloc (sizeof (*child));
+                  memset (child, 0, sizeof (*child));
+                  child->c = c;
+                  child->sibling = node->child;
+                  node->child = child;
+                }
+              node = child;
+            }
+          append_index_entry (&node->exts, ext);
+        }
+    }
+}
+
+static void
+free_color_ext_list (void)
+{
+  COLOR_EXT_TYPE *e;
+  COLOR_EXT_TYPE *e2;
+
+  free_color_ext_index ();
+  for (e = _rl_color_ext_list; e != NULL; /* empty */)
+    {
+      e2 = e;
+      e = e->next;
+      free (e2);
+    }
+  _rl_color_ext_list = NULL;
+}
+
+static int
+ext_matches (const COLOR_EXT_TYPE *ext, const char *name, size_t len)
+{
+  if (ext->ext.len > len)
+    return 0;
+  name += len - ext->ext.len;
+  if (ext->case_sensitive)
+    return strncmp (name, ext->ext.string, ext->ext.len) == 0;
+  return strnicmp_ascii (name, ext->ext.string, ext->ext.len) == 0;
+}
+
+/* Returns the first entry in _rl_color_ext_list that is a suffix of NAME, or
+   NULL if there isn't one. */
+COLOR_EXT_TYPE *
+_rl_find_color_ext (const char *name, size_t len)
+{
+  COLOR_EXT_TYPE *best = NULL;
+  COLOR_EXT_TYPE *ext;
+  COLOR_SUFFIX_NODE *node;
+  const char *dot;
+  size_t i;
+
+  if (_rl_color_ext_list == NULL)
+    return NULL;
+
+  if (color_suffix_root == NULL)
+    {
+      for (ext = _rl_color_ext_list; ext != NULL; ext = ext->next)
+        if (ext_matches (ext, name, len))
+          return ext;
+      return NULL;
+    }
+
+  /* Entries with an extension.  The first match in the slot is the earliest
+     in the list. */
+  dot = last_dot (name, len);
+  if (dot)
+    {
+      size_t dot_len = len - (dot - name);
+      unsigned int slot = hash_lower (dot, dot_len) & color_ext_bucket_mask;
+      for (ext = color_ext_buckets[slot]; ext != NULL; ext = ext->index_next)
+        if (ext_matches (ext, name, len))
+          {
+            best = ext;
+            break;
+          }
+    }
+
+  /* Entries without an extension; any suffix of the name can match. */
+  node = color_suffix_root;
+  i = len;
+  while (node)
+    {
+      for (ext = node->exts; ext != NULL; ext = ext->index_next)
+        {
+          if (best && best->priority < ext->priority)
+            break;
+          if (ext_matches (ext, name, len))
+            {
+              best = ext;
+              break;
+            }
+        }
+
+      if (i == 0)
+        break;
+
+      {
+        unsigned char c = (unsigned char)name[--i];
+        COLOR_SUFFIX_NODE *child;
+
+        c = LOWER_ASCII (c);
+        for (child = node->child; child != NULL; child = child->sibling)
+          if (child->c == c)
+            break;
+        node = child;
+      }
+    }
+
+  return best;
+}
+/* end_clink_change */
+
 /* Parse a string as part of the LS_COLORS variable; this may involve
    decoding all kinds of escape characters.  If equals_end is set an
    unescaped equal sign ends the string, otherwise only a : or \0
@@ -311,12 +580,37 @@ void _rl_parse_colors(void)
   COLOR_EXT_TYPE *ext;		/* Extension we are working on */
 
   p = sh_get_env_value ("LS_COLORS");
+/* begin_clink_change */
+  /* Parse only when the value has changed.  This is called for every input
+     line, and previously it leaked the old buffer and prepended duplicate
+     entries to the extension list each time. */
+  if (p && parsed_ls_colors && strcmp (p, parsed_ls_colors) == 0)
+    return;
+
+  if (!saved_default_color_indicator)
+    {
+      memcpy (default_color_indicator, _rl_color_indicator, sizeof (default_color_indicator));
+      saved_default_color_indicator = 1;
+    }
+  else
+    memcpy (_rl_color_indicator, default_color_indicator, sizeof (default_color_indicator));
+
+  free_color_ext_list ();
+  free (color_buf);
+  color_buf = NULL;
+  free (parsed_ls_colors);
+  parsed_ls_colors = NULL;
+/* end_clink_change */
   if (p == 0 || *p == '\0')
     {
       _rl_color_ext_list = NULL;
       return;
     }
 
+/* begin_clink_change */
+  parsed_ls_colors = savestring (p);
+/* end_clink_change */
+
   ext = NULL;
   strcpy (label, "??");
 
@@ -423,20 +717,21 @@ void _rl_parse_colors(void)
 
   if (state < 0)
     {
-      COLOR_EXT_TYPE *e;
-      COLOR_EXT_TYPE *e2;
-
       _rl_errmsg ("unparsable value for LS_COLORS environment variable");
+/* begin_clink_change */
+      memcpy (_rl_color_indicator, default_color_indicator, sizeof (default_color_indicator));
       free (color_buf);
-      for (e = _rl_color_ext_list; e != NULL; /* empty */)
-        {
-          e2 = e;
-          e = e->next;
-          free (e2);
-        }
-      _rl_color_ext_list = NULL;
+      color_buf = NULL;
+      free_color_ext_list ();
+      free (parsed_ls_colors);
+      parsed_ls_colors = NULL;
+/* end_clink_change */
       _rl_colored_stats = 0;	/* can't have colored stats without colors */
     }
+/* begin_clink_change */
+  else
+    build_color_ext_index ();
+/* end_clink_change */
 #else /* !COLOR_SUPPORT */
   ;
 #endif /* !COLOR_SUPPORT */
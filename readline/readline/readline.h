@@ -918,6 +918,17 @@ extern rl_qsort_match_list_func_t *rl_qsort_match_list_func;
 /* If non-zero, then this is the address of a function to call that determines
    whether a file extension is executable. */
 extern rl_iccpfunc_t *rl_is_exec_func;
+/* If non-zero, then this is the address of a function to call just before a
+   list of matches is freed, so the host can forget anything it associated
+   with the match strings.
+   It takes one argument: (char** matches) where MATCHES is the array of
+   strings being freed. */
+extern rl_vcppfunc_t *rl_free_match_list_hook;
+
+/* Non-zero means the matches are incomplete, so completion commands only
+   list them and don't insert anything.  The completion entry function may
+   set this; it's reset at the start of each completion. */
+extern int rl_completion_display_only;
 /* end_clink_change */
 
 /* Non-zero means that the results of the matches are to be treated
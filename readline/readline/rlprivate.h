@@ -298,6 +298,9 @@ extern void _rl_clean_up_for_exit PARAMS((void));
 extern void _rl_erase_entire_line PARAMS((void));
 extern int _rl_current_display_line PARAMS((void));
 extern void _rl_refresh_line PARAMS((void));
+/* begin_clink_change */
+extern int _rl_get_prompt_last_screen_line PARAMS((void));
+/* end_clink_change */
 
 /* input.c */
 extern int _rl_any_typein PARAMS((void));
@@ -513,6 +516,9 @@ extern int _rl_vis_botlin;
 extern int _rl_last_c_pos;
 extern int _rl_suppress_redisplay;
 extern int _rl_want_redisplay;
+/* begin_clink_change */
+extern int _rl_new_line_count;
+/* end_clink_change */
 
 extern char *_rl_emacs_mode_str;
 extern int _rl_emacs_modestr_len;